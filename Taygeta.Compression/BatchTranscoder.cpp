@@ -0,0 +1,552 @@
+#include "BatchTranscoder.h"
+#include "JasperImpl.h"
+#include "PlaneResize.h"
+#include "FrameImageData.h"
+#include "FramePool.h"
+
+#include <fstream>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <new>
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <share.h>
+#else
+#include <unistd.h>
+#endif
+
+struct TranscodeJob
+{
+	std::string Input;
+	std::string Output;
+	CPlanarFrame* Frame;
+
+	TranscodeJob(const char* input, const char* output)
+		: Input(input), Output(output), Frame(NULL)
+	{
+	}
+
+	~TranscodeJob(void)
+	{
+		if(Frame)
+		{
+			Frame->Release();
+		}
+	}
+};
+
+static void FreeTurboJpegBuffer(BYTE* data, void*)
+{
+	tjFree(data);
+}
+
+// Bounded hand-off between two stages. Push blocks while the queue is full and Pop
+// blocks while it is empty; after Close, Pop drains what is left and then returns NULL.
+class CJobQueue
+{
+public:
+	CJobQueue(void)
+		: m_capacity(1), m_closed(false), m_cancelled(false)
+	{
+	}
+
+	~CJobQueue(void)
+	{
+		for(size_t i = 0; i < m_jobs.size(); i++)
+		{
+			delete m_jobs[i];
+		}
+	}
+
+	void SetCapacity(int capacity)
+	{
+		m_capacity = capacity > 0 ? capacity : 1;
+	}
+
+	bool Push(TranscodeJob* job)
+	{
+		std::unique_lock<std::mutex> guard(m_lock);
+		while((int)m_jobs.size() >= m_capacity && !m_cancelled)
+		{
+			m_notFull.wait(guard);
+		}
+		if(m_cancelled || m_closed)
+		{
+			return false;
+		}
+
+		m_jobs.push_back(job);
+		m_notEmpty.notify_one();
+		return true;
+	}
+
+	TranscodeJob* Pop(void)
+	{
+		std::unique_lock<std::mutex> guard(m_lock);
+		while(m_jobs.empty() && !m_closed && !m_cancelled)
+		{
+			m_notEmpty.wait(guard);
+		}
+		if(m_jobs.empty() || m_cancelled)
+		{
+			return NULL;
+		}
+
+		TranscodeJob* job = m_jobs.front();
+		m_jobs.pop_front();
+		m_notFull.notify_one();
+		return job;
+	}
+
+	void Close(bool cancel)
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_closed = true;
+		m_cancelled = m_cancelled || cancel;
+		m_notEmpty.notify_all();
+		m_notFull.notify_all();
+	}
+
+	void Reset(void)
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		for(size_t i = 0; i < m_jobs.size(); i++)
+		{
+			delete m_jobs[i];
+		}
+		m_jobs.clear();
+		m_closed = false;
+		m_cancelled = false;
+	}
+
+private:
+	std::mutex m_lock;
+	std::condition_variable m_notEmpty;
+	std::condition_variable m_notFull;
+	std::deque<TranscodeJob*> m_jobs;
+	int m_capacity;
+	bool m_closed;
+	bool m_cancelled;
+};
+
+struct CBatchTranscoder::State
+{
+	TranscodeSettings settings;
+	bool resize;
+	std::string options;
+
+	CJobQueue decodeQueue;
+	CJobQueue resizeQueue;
+	CJobQueue encodeQueue;
+
+	std::vector<std::thread> decoders;
+	std::vector<std::thread> resizers;
+	std::vector<std::thread> encoders;
+	bool running;
+
+	std::atomic<long long> queued;
+	std::atomic<long long> completed;
+	std::atomic<long long> failed;
+	std::atomic<long long> bytesRead;
+	std::atomic<long long> bytesWritten;
+	std::atomic<long long> pixels;
+
+	mutable std::mutex lock;
+	std::vector<TranscodeFailure> failures;
+	std::chrono::steady_clock::time_point started;
+	std::chrono::steady_clock::time_point stopped;
+
+	void Fail(TranscodeJob* job, const char* message)
+	{
+		TranscodeFailure failure;
+		failure.Input = job->Input;
+		failure.Message = message;
+		delete job;
+
+		failed++;
+		std::lock_guard<std::mutex> guard(lock);
+		failures.push_back(failure);
+	}
+
+	void Decode(void);
+	void Resize(void);
+	void Encode(void);
+};
+
+static void ReadFile(const std::string& path, std::vector<BYTE>& buffer)
+{
+	std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+	if(!file)
+	{
+		throw "Failed to open input file";
+	}
+
+	file.seekg(0, std::ios::end);
+	std::streamoff size = file.tellg();
+	if(size <= 0 || size > 0x7FFFFFFF)
+	{
+		throw "Input file is empty or too large";
+	}
+	file.seekg(0, std::ios::beg);
+
+	buffer.resize((size_t)size);
+	if(!file.read((char*)&buffer[0], size))
+	{
+		throw "Failed to read input file";
+	}
+}
+
+void CBatchTranscoder::State::Decode(void)
+{
+	CTurboJpegDecoderImpl decoder;
+	std::vector<BYTE> buffer;
+	CJobQueue& next = resize ? resizeQueue : encodeQueue;
+
+	while(TranscodeJob* job = decodeQueue.Pop())
+	{
+		ImageData data;
+		CPlaneBuffer* storage = NULL;
+		try
+		{
+			ReadFile(job->Input, buffer);
+			decoder.Load(&buffer[0], (int)buffer.size(), data);
+
+			// The decoded buffer goes back to tjFree with the last frame referencing it
+			FrameFormat format;
+			try
+			{
+				format = GetFrameFormat(data.Subsampling, data.Precision);
+				storage = CPlaneBuffer::Wrap(data.Planes[0], 0, FreeTurboJpegBuffer, NULL);
+			}
+			catch(...)
+			{
+				tjFree(data.Planes[0]);
+				throw;
+			}
+			job->Frame = CPlanarFrame::Wrap(data.Width, data.Height, format, data.Planes, data.Pitches, storage);
+			storage->Release();
+		}
+		catch(const char* msg)
+		{
+			if(storage)
+			{
+				storage->Release();
+			}
+			Fail(job, msg);
+			continue;
+		}
+		catch(const std::bad_alloc&)
+		{
+			Fail(job, "Failed to allocate input buffer");
+			continue;
+		}
+
+		bytesRead += buffer.size();
+		pixels += (long long)data.Width * data.Height;
+
+		if(!next.Push(job))
+		{
+			delete job;
+		}
+	}
+}
+
+void CBatchTranscoder::State::Resize(void)
+{
+	while(TranscodeJob* job = resizeQueue.Pop())
+	{
+		CPlanarFrame* src = job->Frame;
+		CPlanarFrame* dst = NULL;
+		try
+		{
+			dst = CFramePool::GetDefault()->Acquire(settings.Width, settings.Height, src->GetFormat());
+			for(int i = 0; i < src->GetPlaneCount(); i++)
+			{
+				ResizePlane(src->GetPlane(i), src->GetRowBytes(i), src->GetLines(i), src->GetPitch(i),
+					dst->GetPlane(i), dst->GetRowBytes(i), dst->GetLines(i), dst->GetPitch(i));
+			}
+		}
+		catch(const char* msg)
+		{
+			if(dst)
+			{
+				dst->Release();
+			}
+			Fail(job, msg);
+			continue;
+		}
+		catch(const std::bad_alloc&)
+		{
+			Fail(job, "Failed to allocate resized frame");
+			continue;
+		}
+
+		job->Frame = dst;
+		src->Release();
+
+		if(!encodeQueue.Push(job))
+		{
+			delete job;
+		}
+	}
+}
+
+static int OpenOutput(const std::string& path)
+{
+#ifdef _WIN32
+	int fd = -1;
+	_sopen_s(&fd, path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _SH_DENYWR, _S_IREAD | _S_IWRITE);
+	return fd;
+#else
+	return open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+}
+
+static int CloseOutput(int fd)
+{
+#ifdef _WIN32
+	return _close(fd);
+#else
+	return close(fd);
+#endif
+}
+
+// Counts what passes through to the file
+class CCountingSink : public CFileDescriptorSink
+{
+public:
+	CCountingSink(int fd)
+		: CFileDescriptorSink(fd), m_written(0)
+	{
+	}
+
+	virtual bool Write(const BYTE* data, int size)
+	{
+		if(!CFileDescriptorSink::Write(data, size))
+		{
+			return false;
+		}
+		m_written += size;
+		return true;
+	}
+
+	long long GetWritten(void) const { return m_written; }
+
+private:
+	long long m_written;
+};
+
+void CBatchTranscoder::State::Encode(void)
+{
+	CJasperImpl encoder;
+
+	while(TranscodeJob* job = encodeQueue.Pop())
+	{
+		int fd = OpenOutput(job->Output);
+		if(fd < 0)
+		{
+			Fail(job, "Failed to create output file");
+			continue;
+		}
+
+		CCountingSink sink(fd);
+		const char* error = NULL;
+		try
+		{
+			ImageData data;
+			GetImageData(job->Frame, data);
+			encoder.Save(data, &sink, options.c_str());
+		}
+		catch(const char* msg)
+		{
+			error = msg;
+		}
+
+		if(CloseOutput(fd) != 0 && !error)
+		{
+			error = "Failed to write output file";
+		}
+
+		if(error)
+		{
+			remove(job->Output.c_str());
+			Fail(job, error);
+			continue;
+		}
+
+		bytesWritten += sink.GetWritten();
+		completed++;
+		delete job;
+	}
+}
+
+CBatchTranscoder::CBatchTranscoder(const TranscodeSettings& settings)
+{
+	if(settings.Rate < 0 || settings.Rate > 1)
+	{
+		throw "Rate must be in range of [0,1]";
+	}
+	if((settings.Width > 0) != (settings.Height > 0))
+	{
+		throw "Width and height must be given together";
+	}
+
+	m_state = new State();
+	m_state->settings = settings;
+	m_state->resize = settings.Width > 0 && settings.Height > 0;
+	m_state->running = false;
+
+	char options[40];
+	snprintf(options, sizeof(options), "rate=%.3f mode=%s", settings.Rate, settings.Lossless ? "int" : "real");
+	m_state->options = options;
+
+	int depth = settings.QueueDepth > 0 ? settings.QueueDepth : 4;
+	m_state->decodeQueue.SetCapacity(depth);
+	m_state->resizeQueue.SetCapacity(depth);
+	m_state->encodeQueue.SetCapacity(depth);
+
+	m_state->queued = 0;
+	m_state->completed = 0;
+	m_state->failed = 0;
+	m_state->bytesRead = 0;
+	m_state->bytesWritten = 0;
+	m_state->pixels = 0;
+}
+
+CBatchTranscoder::~CBatchTranscoder(void)
+{
+	Stop(false);
+	delete m_state;
+}
+
+void CBatchTranscoder::Start(void)
+{
+	if(m_state->running)
+	{
+		throw "Transcoder is already running";
+	}
+
+	int cores = (int)std::thread::hardware_concurrency();
+	if(cores <= 0)
+	{
+		cores = 1;
+	}
+
+	const TranscodeSettings& settings = m_state->settings;
+	int decoders = settings.DecodeThreads > 0 ? settings.DecodeThreads : cores;
+	int resizers = settings.ResizeThreads > 0 ? settings.ResizeThreads : cores;
+	int encoders = settings.EncodeThreads > 0 ? settings.EncodeThreads : cores;
+
+	m_state->decodeQueue.Reset();
+	m_state->resizeQueue.Reset();
+	m_state->encodeQueue.Reset();
+	{
+		std::lock_guard<std::mutex> guard(m_state->lock);
+		m_state->started = std::chrono::steady_clock::now();
+		m_state->running = true;
+	}
+
+	State* state = m_state;
+	for(int i = 0; i < encoders; i++)
+	{
+		m_state->encoders.push_back(std::thread([state]() { state->Encode(); }));
+	}
+	for(int i = 0; m_state->resize && i < resizers; i++)
+	{
+		m_state->resizers.push_back(std::thread([state]() { state->Resize(); }));
+	}
+	for(int i = 0; i < decoders; i++)
+	{
+		m_state->decoders.push_back(std::thread([state]() { state->Decode(); }));
+	}
+}
+
+void CBatchTranscoder::Add(const char* input, const char* output)
+{
+	if(!m_state->running)
+	{
+		throw "Transcoder is not running";
+	}
+
+	TranscodeJob* job = new TranscodeJob(input, output);
+	if(!m_state->decodeQueue.Push(job))
+	{
+		delete job;
+		throw "Transcoder has been stopped";
+	}
+	m_state->queued++;
+}
+
+void CBatchTranscoder::Complete(void)
+{
+	Stop(true);
+}
+
+void CBatchTranscoder::Cancel(void)
+{
+	Stop(false);
+}
+
+static void JoinAll(std::vector<std::thread>& threads)
+{
+	for(size_t i = 0; i < threads.size(); i++)
+	{
+		threads[i].join();
+	}
+	threads.clear();
+}
+
+void CBatchTranscoder::Stop(bool drain)
+{
+	if(!m_state->running)
+	{
+		return;
+	}
+
+	// Each stage is closed only after the one feeding it has finished
+	m_state->decodeQueue.Close(!drain);
+	if(!drain)
+	{
+		m_state->resizeQueue.Close(true);
+		m_state->encodeQueue.Close(true);
+	}
+
+	JoinAll(m_state->decoders);
+	m_state->resizeQueue.Close(!drain);
+	JoinAll(m_state->resizers);
+	m_state->encodeQueue.Close(!drain);
+	JoinAll(m_state->encoders);
+
+	std::lock_guard<std::mutex> guard(m_state->lock);
+	m_state->stopped = std::chrono::steady_clock::now();
+	m_state->running = false;
+}
+
+void CBatchTranscoder::GetProgress(TranscodeProgress* progress) const
+{
+	progress->Queued = m_state->queued;
+	progress->Completed = m_state->completed;
+	progress->Failed = m_state->failed;
+	progress->BytesRead = m_state->bytesRead;
+	progress->BytesWritten = m_state->bytesWritten;
+	progress->Pixels = m_state->pixels;
+
+	std::lock_guard<std::mutex> guard(m_state->lock);
+	std::chrono::steady_clock::time_point end = m_state->running ? std::chrono::steady_clock::now() : m_state->stopped;
+	progress->Seconds = m_state->started == std::chrono::steady_clock::time_point() ? 0 :
+		std::chrono::duration_cast<std::chrono::duration<double>>(end - m_state->started).count();
+}
+
+void CBatchTranscoder::GetFailures(std::vector<TranscodeFailure>* failures) const
+{
+	std::lock_guard<std::mutex> guard(m_state->lock);
+	*failures = m_state->failures;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct TranscodeSettings
+{
+	int DecodeThreads;		// 0 picks one per core for decode, resize and encode each
+	int ResizeThreads;
+	int EncodeThreads;
+	int QueueDepth;			// images allowed to wait between two stages
+	int Width;				// 0 keeps the source size
+	int Height;
+	double Rate;
+	bool Lossless;
+};
+
+struct TranscodeProgress
+{
+	long long Queued;
+	long long Completed;
+	long long Failed;
+	long long BytesRead;
+	long long BytesWritten;
+	long long Pixels;
+	double Seconds;			// since Start
+};
+
+struct TranscodeFailure
+{
+	std::string Input;
+	std::string Message;
+};
+
+// Converts JPEG files to JP2 on a bounded pipeline: decode -> resize (optional) -> encode.
+// Each stage runs its own worker pool and each worker owns its codec instance. Images
+// travel between stages as reference counted frames, so they are never copied. A full
+// queue blocks the stage feeding it, which keeps at most QueueDepth images waiting per
+// stage no matter how many files are queued.
+class CBatchTranscoder
+{
+public:
+	CBatchTranscoder(const TranscodeSettings& settings);
+	virtual ~CBatchTranscoder(void);
+
+	void Start(void);
+
+	// Blocks while the read queue is full
+	void Add(const char* input, const char* output);
+
+	// Waits for every queued file to be written and stops the workers
+	void Complete(void);
+
+	// Drops queued files and stops the workers once their current image is done
+	void Cancel(void);
+
+	void GetProgress(TranscodeProgress* progress) const;
+	void GetFailures(std::vector<TranscodeFailure>* failures) const;
+
+private:
+	struct State;
+	State* m_state;
+
+	void Stop(bool drain);
+};
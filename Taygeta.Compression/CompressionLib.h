@@ -0,0 +1,18 @@
+#pragma once
+
+// Shared by the C++/CLI assembly and the plain native build of the codec core
+// (Makefile), which must not depend on windows.h
+
+#if defined(_WIN32)
+#	include "windows.h"
+#	if defined(COMPRESSION_LIBRARY_EXPORT)
+#		define COMPRESSIONLIB __declspec(dllexport)
+#	else
+#		define COMPRESSIONLIB __declspec(dllimport)
+#	endif
+#	define COMPRESSIONCALL __cdecl
+#else
+#	define COMPRESSIONLIB __attribute__((visibility("default")))
+#	define COMPRESSIONCALL
+typedef unsigned char BYTE;
+#endif
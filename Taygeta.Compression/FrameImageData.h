@@ -0,0 +1,65 @@
+#pragma once
+
+#include "ImageData.h"
+#include "PlanarFrame.h"
+
+// Bridges frames of Taygeta.Native and the ImageData plane description the codecs use
+
+static inline FrameFormat GetFrameFormat(TJSAMP subsampling, int precision)
+{
+	bool wide = precision > 8;
+	switch(subsampling)
+	{
+	case TJSAMP_GRAY:
+		return wide ? FF_Y16 : FF_Y800;
+	case TJSAMP_444:
+		return wide ? FF_YUV16 : FF_YUV;
+	case TJSAMP_420:
+		return wide ? FF_I420P16 : FF_I420;
+	case TJSAMP_422:
+		if(wide)
+		{
+			throw "There is no 16-bit 4:2:2 frame format";
+		}
+		return FF_I422;
+	default:
+		throw "Unsupported subsampling";
+	}
+}
+
+static inline void GetImageData(const CPlanarFrame* frame, ImageData& data)
+{
+	data.Width = frame->GetWidth();
+	data.Height = frame->GetHeight();
+	data.Components = frame->GetPlaneCount();
+	data.Precision = GetFrameFormatDesc(frame->GetFormat())->BytesPerSample > 1 ? 16 : 8;
+
+	switch(frame->GetFormat())
+	{
+	case FF_Y800:
+	case FF_Y16:
+		data.Subsampling = TJSAMP_GRAY;
+		break;
+	case FF_YUV:
+	case FF_YUV16:
+		data.Subsampling = TJSAMP_444;
+		break;
+	case FF_I420:
+	case FF_I420P16:
+		data.Subsampling = TJSAMP_420;
+		break;
+	case FF_I422:
+	case FF_YUY2:
+		data.Subsampling = TJSAMP_422;
+		break;
+	default:
+		throw "Frame format has no codec layout";
+	}
+
+	for(int i = 0; i < data.Components; i++)
+	{
+		data.Planes[i] = frame->GetPlane(i);
+		data.Pitches[i] = frame->GetPitch(i);
+		data.Lines[i] = frame->GetLines(i);
+	}
+}
@@ -1,8 +1,10 @@
 #pragma once
 
 #include "turbojpeg.h"
-#include "windows.h"
+#include "CompressionLib.h"
 
+// Planes are addressed as Planes[i] + y * Pitches[i]. A negative pitch describes a
+// bottom-up plane, Planes[i] then points at its top row.
 struct ImageData
 {
 	int Height;
@@ -12,4 +14,11 @@ struct ImageData
 	int Components;
 	TJSAMP Subsampling;
     int Width;
-};
\ No newline at end of file
+	int Precision;
+};
+
+// Bytes between the starts of two rows, whichever way the plane runs
+inline int AbsPitch(int pitch)
+{
+	return pitch < 0 ? -pitch : pitch;
+}
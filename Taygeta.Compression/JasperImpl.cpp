@@ -1,98 +1,274 @@
-#include "StdAfx.h"
+#include "Stdafx.h"
 #include "JasperImpl.h"
+#include "JasperSamples.h"
 
+#include <mutex>
+
+#define JAS_BAND_ROWS 16
+
+// jas_init and jas_cleanup manage process wide state (the format table) and are not
+// thread safe, so they run once for the first and last instance alive
+static std::mutex s_jasperLock;
+static int s_jasperUsers = 0;
 
 CJasperImpl::CJasperImpl(void)
+	: m_image(NULL)
 {
-	jas_init();
+	std::lock_guard<std::mutex> guard(s_jasperLock);
+	if(s_jasperUsers++ == 0)
+	{
+		jas_init();
+	}
 }
 
 
 CJasperImpl::~CJasperImpl(void)
 {
-	jas_cleanup();
+	ReleaseImage();
+
+	std::lock_guard<std::mutex> guard(s_jasperLock);
+	if(--s_jasperUsers == 0)
+	{
+		jas_cleanup();
+	}
 }
 
-void CJasperImpl::Save(ImageData& data, BYTE** buffer, int* size, double quality)
+void CJasperImpl::ReleaseImage(void)
 {
-	jas_image_cmptparm_t *cmptparm;
-	uint_fast16_t cmptno, numcmpts=3;
+	if(m_image)
+	{
+		jas_image_destroy(m_image);
+		m_image = NULL;
+	}
+}
 
-	for (cmptno = 0, cmptparm = m_cmptparms; cmptno < numcmpts; ++cmptno, ++cmptparm) 
+// Component bands are sized exactly, as jasper lays out matrix rows by their column count
+static jas_matrix_t* GetBand(jas_matrix_t* band, int rows, int cols)
+{
+	if(band && jas_matrix_numrows(band) == rows && jas_matrix_numcols(band) == cols)
 	{
-		cmptparm->tlx = 0;
-		cmptparm->tly = 0;
-		cmptparm->width = data.Pitches[cmptno];
-		cmptparm->height = data.Lines[cmptno];
-		cmptparm->prec = 8;
-		cmptparm->sgnd = false;
+		return band;
 	}
 
-	m_cmptparms[0].hstep = 1;
-	m_cmptparms[0].vstep = 1;
-	m_cmptparms[1].hstep = 2;
-	m_cmptparms[1].vstep = 2;
-	m_cmptparms[2].hstep = 2;
-	m_cmptparms[2].vstep = 2;
+	if(band)
+	{
+		jas_matrix_destroy(band);
+	}
+
+	band = jas_matrix_create(rows, cols);
+	if(!band)
+	{
+		throw "Failed to allocate component band";
+	}
+	return band;
+}
+
+static void GetSamplingSteps(TJSAMP subsampling, int* hstep, int* vstep)
+{
+	switch(subsampling)
+	{
+	case TJSAMP_GRAY:
+	case TJSAMP_444:
+		*hstep = 1;
+		*vstep = 1;
+		break;
+	case TJSAMP_422:
+		*hstep = 2;
+		*vstep = 1;
+		break;
+	case TJSAMP_420:
+		*hstep = 2;
+		*vstep = 2;
+		break;
+	default:
+		throw "Unsupported subsampling";
+	}
+}
+
+void CJasperImpl::Save(ImageData& data, IJasperSink* sink, const char* options)
+{
+	int numcmpts = data.Subsampling == TJSAMP_GRAY ? 1 : 3;
+	if(data.Components != numcmpts)
+	{
+		throw "Planar input is required";
+	}
+
+	if(data.Precision < 1 || data.Precision > 16)
+	{
+		throw "Precision must be in range of [1,16]";
+	}
 
-	m_image = jas_image_create(numcmpts, m_cmptparms, JAS_CLRSPC_SYCBCR);
+	int hstep, vstep;
+	GetSamplingSteps(data.Subsampling, &hstep, &vstep);
+	int bytesPerSample = data.Precision > 8 ? 2 : 1;
+
+	jas_image_cmptparm_t cmptparms[3];
+	for(int c = 0; c < numcmpts; c++)
+	{
+		int hs = c == 0 ? 1 : hstep;
+		int vs = c == 0 ? 1 : vstep;
+		int width = (data.Width + hs - 1) / hs;
+		int height = (data.Height + vs - 1) / vs;
+
+		cmptparms[c].tlx = 0;
+		cmptparms[c].tly = 0;
+		cmptparms[c].hstep = hs;
+		cmptparms[c].vstep = vs;
+		cmptparms[c].width = width < AbsPitch(data.Pitches[c]) / bytesPerSample ? width : AbsPitch(data.Pitches[c]) / bytesPerSample;
+		cmptparms[c].height = height < data.Lines[c] ? height : data.Lines[c];
+		cmptparms[c].prec = data.Precision;
+		cmptparms[c].sgnd = false;
+	}
+
+	ReleaseImage();
+	m_image = jas_image_create(numcmpts, cmptparms, numcmpts == 1 ? JAS_CLRSPC_SGRAY : JAS_CLRSPC_SYCBCR);
 	if(!m_image)
 	{
 		throw "Failed to create image";
 	}
-	jas_image_setcmpttype(m_image, 0, JAS_IMAGE_CT_COLOR(JAS_CLRSPC_CHANIND_YCBCR_Y));
-	jas_image_setcmpttype(m_image, 1, JAS_IMAGE_CT_COLOR(JAS_CLRSPC_CHANIND_YCBCR_CB));
-	jas_image_setcmpttype(m_image, 2, JAS_IMAGE_CT_COLOR(JAS_CLRSPC_CHANIND_YCBCR_CR));
 
-	int bufferSize = data.Width * data.Height;
-	long* plane = new long[bufferSize];
-	memset(plane, 0, bufferSize);
+	if(numcmpts == 1)
+	{
+		jas_image_setcmpttype(m_image, 0, JAS_IMAGE_CT_COLOR(JAS_CLRSPC_CHANIND_GRAY_Y));
+	}
+	else
+	{
+		jas_image_setcmpttype(m_image, 0, JAS_IMAGE_CT_COLOR(JAS_CLRSPC_CHANIND_YCBCR_Y));
+		jas_image_setcmpttype(m_image, 1, JAS_IMAGE_CT_COLOR(JAS_CLRSPC_CHANIND_YCBCR_CB));
+		jas_image_setcmpttype(m_image, 2, JAS_IMAGE_CT_COLOR(JAS_CLRSPC_CHANIND_YCBCR_CR));
+	}
 
-	for(int i = 0; i < data.Components; i++)
-	{		
-		int size = data.Pitches[i] * data.Lines[i];
-		for(int j = 0; j < size ; j++)
-		{
-			plane[j] = (long)data.Planes[i][j];
-		}
+	jas_matrix_t* band = NULL;
+	for(int c = 0; c < numcmpts; c++)
+	{
+		int width = cmptparms[c].width;
+		int height = cmptparms[c].height;
 
-		int res = jas_image_writecmpt2(m_image, i, 0, 0, data.Pitches[i], data.Lines[i], plane);
-		if(res < 0)
+		for(int y = 0; y < height; y += JAS_BAND_ROWS)
 		{
-			char szoutopts[255];
-			sprintf_s(szoutopts,"Failed to write component %d data", i);
-			throw szoutopts;
+			int n = height - y < JAS_BAND_ROWS ? height - y : JAS_BAND_ROWS;
+			try
+			{
+				band = GetBand(band, n, width);
+			}
+			catch(...)
+			{
+				ReleaseImage();
+				throw;
+			}
+
+			for(int r = 0; r < n; r++)
+			{
+				const BYTE* src = data.Planes[c] + (y + r) * data.Pitches[c];
+				jas_seqent_t* dst = jas_matrix_getref(band, r, 0);
+				if(bytesPerSample == 1)
+				{
+					jas_widen_row8(src, dst, width);
+				}
+				else
+				{
+					jas_widen_row16((const uint16_t*)src, dst, width);
+				}
+			}
+
+			if(jas_image_writecmpt(m_image, c, 0, y, width, n, band))
+			{
+				jas_matrix_destroy(band);
+				ReleaseImage();
+				throw "Failed to write component data";
+			}
 		}
 	}
-	delete plane;
-	int outfmt = jas_image_strtofmt("jp2");
 
-	char szoutopts[32];
-	sprintf_s(szoutopts,"rate=%.3f", quality);
+	if(band)
+	{
+		jas_matrix_destroy(band);
+	}
 
-	jas_stream_t* stream = jas_stream_memopen(NULL, 0);
+	jas_stream_t* stream = jas_stream_sinkopen(sink);
 	if(!stream)
 	{
+		ReleaseImage();
 		throw "Failed to create output stream";
 	}
 
-	int res = jas_image_encode(m_image, stream, outfmt, szoutopts);
-	if(res < 0)
+	int res = jas_image_encode(m_image, stream, jas_image_strtofmt("jp2"), (char*)options);
+	int closeRes = jas_stream_close(stream);
+	ReleaseImage();
+
+	if(res < 0 || closeRes < 0)
 	{
-		jas_stream_close(stream);
 		throw "Failed to encode image";
 	}
-	jas_stream_flush(stream);
-	jas_stream_memobj_t * jmem = (jas_stream_memobj_t *)stream->obj_;
-	*size = jmem->len_;
-	*buffer = jmem->buf_;
-	jmem->myalloc_ = 0;
+}
 
-	jas_stream_close(stream);
+int CJasperImpl::FindPrecision(ImageData& data)
+{
+	int hstep, vstep;
+	GetSamplingSteps(data.Subsampling, &hstep, &vstep);
+
+	// Only the samples Save encodes, the padding of pooled rows may hold anything
+	uint16_t maxValue = 0;
+	for(int c = 0; c < data.Components; c++)
+	{
+		int hs = c == 0 ? 1 : hstep;
+		int vs = c == 0 ? 1 : vstep;
+		int width = (data.Width + hs - 1) / hs;
+		int height = (data.Height + vs - 1) / vs;
+		width = width < AbsPitch(data.Pitches[c]) / 2 ? width : AbsPitch(data.Pitches[c]) / 2;
+		height = height < data.Lines[c] ? height : data.Lines[c];
+
+		for(int y = 0; y < height; y++)
+		{
+			const uint16_t* row = (const uint16_t*)(data.Planes[c] + y * data.Pitches[c]);
+			uint16_t rowMax = jas_max_row16(row, width);
+			if(rowMax > maxValue)
+			{
+				maxValue = rowMax;
+			}
+		}
+	}
+
+	int precision = 9;
+	while(precision < 16 && (maxValue >> precision) != 0)
+	{
+		precision++;
+	}
+	return precision;
 }
 
 void CJasperImpl::Load(BYTE* buffer, int size, ImageData& data)
 {
+	Decode(buffer, size, data);
+
+	int bytesPerSample = data.Precision > 8 ? 2 : 1;
+	for(int i = 0; i < data.Components; i++)
+	{
+		int width = jas_image_cmptwidth(m_image, i);
+		data.Pitches[i] = width * bytesPerSample;
+		data.Lines[i] = jas_image_cmptheight(m_image, i);
+		data.Planes[i] = new BYTE[data.Pitches[i] * data.Lines[i]];
+	}
+
+	try
+	{
+		ReadPlanes(data);
+	}
+	catch(...)
+	{
+		for(int i = 0; i < data.Components; i++)
+		{
+			delete[] data.Planes[i];
+			data.Planes[i] = NULL;
+		}
+		throw;
+	}
+}
+
+void CJasperImpl::Decode(BYTE* buffer, int size, ImageData& info)
+{
+	ReleaseImage();
+
 	jas_stream_t* stream = jas_stream_memopen((char*)buffer, size);
 	if(!stream)
 	{
@@ -106,71 +282,151 @@ void CJasperImpl::Load(BYTE* buffer, int size, ImageData& data)
 	}
 
 	jas_image_t* img = jas_image_decode(stream, outfmt, "");
-	if(!m_image)
+	jas_stream_close(stream);
+	if(!img)
 	{
-		jas_stream_close(stream);
 		throw "Failed to decode image";
 	}
-	data.Width = jas_image_width(img);
-	data.Height = jas_image_height(img);
-	data.Components = jas_image_numcmpts(img);
+	m_image = img;
+
+	int numcmpts = jas_image_numcmpts(img);
+	if(numcmpts != 1 && numcmpts != 3)
+	{
+		ReleaseImage();
+		throw "Unsupported number of components";
+	}
 
-	if(data.Components == 3)
+	if(jas_image_cmpthstep(img, 0) != 1 || jas_image_cmptvstep(img, 0) != 1)
 	{
-		long* buf = new long[data.Width * data.Height + data.Width * data.Height / 2];
-		memset(buf, 0, data.Width * data.Height + data.Width * data.Height / 2);
+		ReleaseImage();
+		throw "Subsampled luma component is not supported";
+	}
 
-		data.Planes[0] = new BYTE[data.Width * data.Height];
-		data.Planes[1] = new BYTE[data.Width * data.Height / 4];
-		data.Planes[2] = new BYTE[data.Width * data.Height / 4];
+	info.Width = jas_image_width(img);
+	info.Height = jas_image_height(img);
+	info.Components = numcmpts;
+	info.Subsampling = TJSAMP_GRAY;
+	info.Precision = 0;
 
-		int res = jas_image_readcmpt2(img, 0, 0, 0, data.Width, data.Height, buf);
-		res = jas_image_readcmpt2(img, 1, 0, 0, data.Width / 2, data.Height / 2, buf + data.Width * data.Height);
-		res = jas_image_readcmpt2(img, 2, 0, 0, data.Width / 2, data.Height / 2, buf + (data.Width * data.Height + data.Width * data.Height / 4));
-		if(res < 0)
+	for(int i = 0; i < numcmpts; i++)
+	{
+		if(jas_image_cmptprec(img, i) > info.Precision)
 		{
-			delete buf;
-			jas_stream_close(stream);
-			jas_image_destroy(img);
-			throw "Failed to read component data";
+			info.Precision = jas_image_cmptprec(img, i);
 		}
+	}
 
-		for(int i = 0; i < data.Width * data.Height; i++)
+	if(numcmpts == 3)
+	{
+		int hstep = jas_image_cmpthstep(img, 1);
+		int vstep = jas_image_cmptvstep(img, 1);
+		if(hstep != jas_image_cmpthstep(img, 2) || vstep != jas_image_cmptvstep(img, 2))
 		{
-			data.Planes[0][i] = (BYTE)buf[i];
+			ReleaseImage();
+			throw "Chroma components differ in subsampling";
 		}
 
-		for(int i = 0; i < data.Width * data.Height / 4; i++)
+		if(hstep == 1 && vstep == 1)
+		{
+			info.Subsampling = TJSAMP_444;
+		}
+		else if(hstep == 2 && vstep == 1)
+		{
+			info.Subsampling = TJSAMP_422;
+		}
+		else if(hstep == 2 && vstep == 2)
 		{
-			data.Planes[1][i] = (BYTE)buf[i + data.Width * data.Height];
-			data.Planes[2][i] = (BYTE)buf[i + (data.Width * data.Height + data.Width * data.Height / 4)];
+			info.Subsampling = TJSAMP_420;
 		}
+		else
+		{
+			ReleaseImage();
+			throw "Unsupported chroma subsampling";
+		}
+	}
+}
 
-		delete buf;
+void CJasperImpl::ReadPlanes(ImageData& target)
+{
+	if(!m_image)
+	{
+		throw "No decoded image";
 	}
-	else
+
+	int numcmpts = jas_image_numcmpts(m_image);
+	bool packed = numcmpts == 3 && target.Components == 1;
+	if(packed && target.Subsampling != TJSAMP_422)
+	{
+		throw "Packed output is only supported for 4:2:2";
+	}
+	if(!packed && target.Components != numcmpts)
 	{
-		long* buf = new long[data.Width * data.Height];
-		memset(buf, 0, data.Width * data.Height);
-		data.Planes[0] = new BYTE[data.Width * data.Height];
-		
-		int res = jas_image_readcmpt2(img, 0, 0, 0, data.Width, data.Height, buf);
-		if(res < 0)
+		throw "Target plane count does not match the image";
+	}
+
+	int bytesPerSample = target.Precision > 8 ? 2 : 1;
+	if(packed && bytesPerSample != 1)
+	{
+		throw "Packed output is only supported for 8-bit samples";
+	}
+
+	jas_matrix_t* band = NULL;
+
+	for(int c = 0; c < numcmpts; c++)
+	{
+		int plane = packed ? 0 : c;
+		int width = jas_image_cmptwidth(m_image, c);
+		int height = jas_image_cmptheight(m_image, c);
+		int prec = jas_image_cmptprec(m_image, c);
+		int bias = jas_image_cmptsgnd(m_image, c) ? 1 << (prec - 1) : 0;
+		int targetPrec = bytesPerSample == 1 ? 8 : 16;
+		int shift = prec > targetPrec ? prec - targetPrec : 0;
+
+		// Odd sized images carry one more chroma sample than a plane of half the luma size holds
+		int step = packed ? (c == 0 ? 2 : 4) : 1;
+		int offset = packed ? (c == 0 ? 0 : (c == 1 ? 1 : 3)) : 0;
+		int cols = AbsPitch(target.Pitches[plane]) / (bytesPerSample * (packed ? 2 : 1));
+		int rows = target.Lines[plane];
+		if(packed && c > 0)
 		{
-			delete buf;
-			jas_stream_close(stream);
-			jas_image_destroy(img);
-			throw "Failed to read component data";
+			cols /= 2;
 		}
+		cols = cols < width ? cols : width;
+		rows = rows < height ? rows : height;
 
-		for(int i = 0; i < data.Width * data.Height; i++)
+		for(int y = 0; y < rows; y += JAS_BAND_ROWS)
 		{
-			data.Planes[0][i] = (BYTE)buf[i];
-		}
+			int n = rows - y < JAS_BAND_ROWS ? rows - y : JAS_BAND_ROWS;
+			band = GetBand(band, n, width);
+			if(jas_image_readcmpt(m_image, c, 0, y, width, n, band))
+			{
+				jas_matrix_destroy(band);
+				throw "Failed to read component data";
+			}
 
-		delete buf;
+			for(int r = 0; r < n; r++)
+			{
+				const jas_seqent_t* src = jas_matrix_getref(band, r, 0);
+				BYTE* dst = target.Planes[plane] + (y + r) * target.Pitches[plane] + offset;
+
+				if(packed)
+				{
+					jas_narrow_row8_step(src, dst, cols, step, bias, shift);
+				}
+				else if(bytesPerSample == 1)
+				{
+					jas_narrow_row8(src, dst, cols, bias, shift);
+				}
+				else
+				{
+					jas_narrow_row16(src, (uint16_t*)dst, cols, bias, shift);
+				}
+			}
+		}
 	}
 
-	jas_stream_close(stream);
-	jas_image_destroy(img);
+	if(band)
+	{
+		jas_matrix_destroy(band);
+	}
 }
@@ -5,10 +5,12 @@
 #include <math.h>
 #include <float.h>
 #include <assert.h>
+#include <string.h>
 
-#include "jasper\jasper.h"
+#include "jasper/jasper.h"
 #include "turbojpeg.h"
 #include "ImageData.h"
+#include "JasperSinkStream.h"
 
 class CJasperImpl
 {
@@ -18,12 +20,26 @@ public:
 
 private:
 	jas_image_t* m_image;
-	jas_stream_t* m_stream;
-	jas_matrix_t* m_cmpts[3];
-	jas_image_cmptparm_t m_cmptparms[3];
+
+	void ReleaseImage(void);
 public:
-	void Save(ImageData& data, BYTE** buffer, int* size, double quality);
+	// Encodes planar 8-bit (Precision <= 8) or 16-bit (Precision 9..16) samples as JP2
+	// into the sink. options is passed to the jasper encoder as is.
+	void Save(ImageData& data, IJasperSink* sink, const char* options);
 	void Load(BYTE* buffer, int size, ImageData& data);
+
+	// Precision needed to hold every sample of 16-bit planes, never below 9 bits
+	// so that the image still decodes into 16-bit planes
+	static int FindPrecision(ImageData& data);
+
+	// Decodes the codestream and describes its layout (Subsampling, Components, Precision)
+	// without reading any samples. Components is 1 for gray and 3 otherwise.
+	void Decode(BYTE* buffer, int size, ImageData& info);
+
+	// Narrows the decoded components straight into the caller's planes. Planes hold 8-bit
+	// samples unless target.Precision is above 8. A 4:2:2 target with a single plane is
+	// packed as YUY2.
+	void ReadPlanes(ImageData& target);
 };
 
 class CTurboJpegDecoderImpl
@@ -39,35 +55,124 @@ public:
 		tjDestroy(m_handle);
 	}
 
+	// Decodes into one tjAlloc'ed buffer owned by data.Planes[0], release it with tjFree.
+	// Planes follow the tjBufSizeYUV layout: widths and heights are padded to the MCU
+	// and every row is rounded up to 4 bytes.
 	void Load(BYTE* buffer, int size, ImageData& data)
 	{
 		int w, h, smp;
-		int res = tjDecompressHeader2(m_handle, buffer, size, &w, &h, &smp);
-		if(res == -1)
-		{
-			throw tjGetErrorStr();
-		}
+		GetHeader(buffer, size, &w, &h, &smp);
 
 		unsigned long outSize = tjBufSizeYUV(w, h, smp);
-		if(outSize == -1)
+		if(outSize == (unsigned long)-1)
 		{
 			throw "Arguments are out of bounds";
 		}
 		BYTE* outBuffer = tjAlloc(outSize);
-		res = tjDecompressToYUV(m_handle, buffer, size, outBuffer, TJFLAG_BOTTOMUP);
+		if(!outBuffer)
+		{
+			throw "Failed to allocate output buffer";
+		}
+		int res = tjDecompressToYUV(m_handle, buffer, size, outBuffer, TJFLAG_BOTTOMUP);
 		if(res == -1)
 		{
+			tjFree(outBuffer);
 			throw tjGetErrorStr();
 		}
 
+		int pw = Pad(w, tjMCUWidth[smp] / 8);
+		int ph = Pad(h, tjMCUHeight[smp] / 8);
+
 		data.Width = w;
 		data.Height = h;
 		data.Subsampling = (TJSAMP)smp;
+		data.Precision = 8;
+		data.Components = smp == TJSAMP_GRAY ? 1 : 3;
 		data.Planes[0] = outBuffer;
-		data.Pitches[0] = outSize;
+		data.Pitches[0] = Pad(pw, 4);
+		data.Lines[0] = ph;
+
+		for(int i = 1; i < data.Components; i++)
+		{
+			data.Pitches[i] = Pad(pw * 8 / tjMCUWidth[smp], 4);
+			data.Lines[i] = ph * 8 / tjMCUHeight[smp];
+			data.Planes[i] = data.Planes[i - 1] + data.Pitches[i - 1] * data.Lines[i - 1];
+		}
+	}
+
+	// Size and layout (Subsampling, Components, Precision) without decoding the image
+	void ReadHeader(BYTE* buffer, int size, ImageData& info)
+	{
+		int w, h, smp;
+		GetHeader(buffer, size, &w, &h, &smp);
+
+		info.Width = w;
+		info.Height = h;
+		info.Subsampling = (TJSAMP)smp;
+		info.Precision = 8;
+		info.Components = smp == TJSAMP_GRAY ? 1 : 3;
+	}
+
+	// Copies decoded planes into the target, clipping to the smaller of both layouts.
+	// A 4:2:2 target with a single plane is packed as YUY2.
+	static void CopyPlanes(const ImageData& src, ImageData& target)
+	{
+		if(target.Components == 1 && src.Components == 3)
+		{
+			if(src.Subsampling != TJSAMP_422)
+			{
+				throw "Packed output is only supported for 4:2:2";
+			}
+
+			int rows = target.Lines[0] < src.Lines[0] ? target.Lines[0] : src.Lines[0];
+			int pairs = AbsPitch(target.Pitches[0]) / 4 < src.Pitches[1] ? AbsPitch(target.Pitches[0]) / 4 : src.Pitches[1];
+			for(int y = 0; y < rows; y++)
+			{
+				const BYTE* py = src.Planes[0] + y * src.Pitches[0];
+				const BYTE* pu = src.Planes[1] + y * src.Pitches[1];
+				const BYTE* pv = src.Planes[2] + y * src.Pitches[2];
+				BYTE* dst = target.Planes[0] + y * target.Pitches[0];
+				for(int x = 0; x < pairs; x++)
+				{
+					dst[4 * x] = py[2 * x];
+					dst[4 * x + 1] = pu[x];
+					dst[4 * x + 2] = py[2 * x + 1];
+					dst[4 * x + 3] = pv[x];
+				}
+			}
+			return;
+		}
+
+		if(target.Components != src.Components)
+		{
+			throw "Target plane count does not match the image";
+		}
+
+		for(int i = 0; i < src.Components; i++)
+		{
+			int rows = target.Lines[i] < src.Lines[i] ? target.Lines[i] : src.Lines[i];
+			int bytes = AbsPitch(target.Pitches[i]) < src.Pitches[i] ? AbsPitch(target.Pitches[i]) : src.Pitches[i];
+			for(int y = 0; y < rows; y++)
+			{
+				memcpy(target.Planes[i] + y * target.Pitches[i], src.Planes[i] + y * src.Pitches[i], bytes);
+			}
+		}
 	}
 
 private:
 	tjhandle m_handle;
+
+	void GetHeader(BYTE* buffer, int size, int* w, int* h, int* smp)
+	{
+		if(tjDecompressHeader2(m_handle, buffer, size, w, h, smp) == -1)
+		{
+			throw tjGetErrorStr();
+		}
+	}
+
+	static inline int Pad(int value, int alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
 };
 
@@ -0,0 +1,197 @@
+#include "JasperSamples.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define JAS_SAMPLES_SSE2
+#endif
+
+static inline int ClampSample(jas_seqent_t value, int bias, int shift, int maxValue)
+{
+	int v = ((int)value + bias) >> shift;
+	return v < 0 ? 0 : (v > maxValue ? maxValue : v);
+}
+
+#ifdef JAS_SAMPLES_SSE2
+
+// jas_seqent_t is 32 bits wide on Win32 and 64 bits wide on LP64 targets
+static inline __m128i LoadSamples(const jas_seqent_t* src)
+{
+	if(sizeof(jas_seqent_t) == 4)
+	{
+		return _mm_loadu_si128((const __m128i*)src);
+	}
+
+	__m128i lo = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)src), _MM_SHUFFLE(2, 0, 2, 0));
+	__m128i hi = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)src + 1), _MM_SHUFFLE(2, 0, 2, 0));
+	return _mm_unpacklo_epi64(lo, hi);
+}
+
+static inline void StoreSamples(jas_seqent_t* dst, __m128i v)
+{
+	if(sizeof(jas_seqent_t) == 4)
+	{
+		_mm_storeu_si128((__m128i*)dst, v);
+		return;
+	}
+
+	__m128i zero = _mm_setzero_si128();
+	_mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi32(v, zero));
+	_mm_storeu_si128((__m128i*)dst + 1, _mm_unpackhi_epi32(v, zero));
+}
+
+static inline __m128i LoadBiased(const jas_seqent_t* src, __m128i bias, __m128i shift)
+{
+	return _mm_sra_epi32(_mm_add_epi32(LoadSamples(src), bias), shift);
+}
+
+#endif
+
+void jas_narrow_row8(const jas_seqent_t* src, BYTE* dst, int count, int bias, int shift)
+{
+	int x = 0;
+
+#ifdef JAS_SAMPLES_SSE2
+	__m128i vbias = _mm_set1_epi32(bias);
+	__m128i vshift = _mm_cvtsi32_si128(shift);
+	for(; x + 16 <= count; x += 16)
+	{
+		__m128i a = LoadBiased(src + x, vbias, vshift);
+		__m128i b = LoadBiased(src + x + 4, vbias, vshift);
+		__m128i c = LoadBiased(src + x + 8, vbias, vshift);
+		__m128i d = LoadBiased(src + x + 12, vbias, vshift);
+		__m128i packed = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+		_mm_storeu_si128((__m128i*)(dst + x), packed);
+	}
+#endif
+
+	for(; x < count; x++)
+	{
+		dst[x] = (BYTE)ClampSample(src[x], bias, shift, 255);
+	}
+}
+
+void jas_narrow_row16(const jas_seqent_t* src, uint16_t* dst, int count, int bias, int shift)
+{
+	int x = 0;
+
+#ifdef JAS_SAMPLES_SSE2
+	// SSE2 has no unsigned 32->16 pack, so the range is moved to signed and back
+	__m128i vbias = _mm_set1_epi32(bias);
+	__m128i vshift = _mm_cvtsi32_si128(shift);
+	__m128i offset32 = _mm_set1_epi32(32768);
+	__m128i offset16 = _mm_set1_epi16((short)0x8000);
+	for(; x + 8 <= count; x += 8)
+	{
+		__m128i a = _mm_sub_epi32(LoadBiased(src + x, vbias, vshift), offset32);
+		__m128i b = _mm_sub_epi32(LoadBiased(src + x + 4, vbias, vshift), offset32);
+		__m128i packed = _mm_xor_si128(_mm_packs_epi32(a, b), offset16);
+		_mm_storeu_si128((__m128i*)(dst + x), packed);
+	}
+#endif
+
+	for(; x < count; x++)
+	{
+		dst[x] = (uint16_t)ClampSample(src[x], bias, shift, 65535);
+	}
+}
+
+void jas_narrow_row8_step(const jas_seqent_t* src, BYTE* dst, int count, int step, int bias, int shift)
+{
+	for(int x = 0; x < count; x++)
+	{
+		dst[x * step] = (BYTE)ClampSample(src[x], bias, shift, 255);
+	}
+}
+
+void jas_widen_row8(const BYTE* src, jas_seqent_t* dst, int count)
+{
+	int x = 0;
+
+#ifdef JAS_SAMPLES_SSE2
+	__m128i zero = _mm_setzero_si128();
+	for(; x + 16 <= count; x += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + x));
+		__m128i lo = _mm_unpacklo_epi8(v, zero);
+		__m128i hi = _mm_unpackhi_epi8(v, zero);
+		StoreSamples(dst + x, _mm_unpacklo_epi16(lo, zero));
+		StoreSamples(dst + x + 4, _mm_unpackhi_epi16(lo, zero));
+		StoreSamples(dst + x + 8, _mm_unpacklo_epi16(hi, zero));
+		StoreSamples(dst + x + 12, _mm_unpackhi_epi16(hi, zero));
+	}
+#endif
+
+	for(; x < count; x++)
+	{
+		dst[x] = src[x];
+	}
+}
+
+void jas_widen_row16(const uint16_t* src, jas_seqent_t* dst, int count)
+{
+	int x = 0;
+
+#ifdef JAS_SAMPLES_SSE2
+	__m128i zero = _mm_setzero_si128();
+	for(; x + 8 <= count; x += 8)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + x));
+		StoreSamples(dst + x, _mm_unpacklo_epi16(v, zero));
+		StoreSamples(dst + x + 4, _mm_unpackhi_epi16(v, zero));
+	}
+#endif
+
+	for(; x < count; x++)
+	{
+		dst[x] = src[x];
+	}
+}
+
+void jas_swap_row16(const uint16_t* src, uint16_t* dst, int count)
+{
+	int x = 0;
+
+#ifdef JAS_SAMPLES_SSE2
+	for(; x + 8 <= count; x += 8)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + x));
+		_mm_storeu_si128((__m128i*)(dst + x), _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+	}
+#endif
+
+	for(; x < count; x++)
+	{
+		dst[x] = (uint16_t)((src[x] << 8) | (src[x] >> 8));
+	}
+}
+
+uint16_t jas_max_row16(const uint16_t* src, int count)
+{
+	int x = 0;
+	uint16_t result = 0;
+
+#ifdef JAS_SAMPLES_SSE2
+	// No unsigned 16-bit max in SSE2, flipping the sign bit makes the signed max do
+	__m128i offset = _mm_set1_epi16((short)0x8000);
+	__m128i vmax = _mm_set1_epi16((short)0x8000);
+	for(; x + 8 <= count; x += 8)
+	{
+		__m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(src + x)), offset);
+		vmax = _mm_max_epi16(vmax, v);
+	}
+
+	vmax = _mm_max_epi16(vmax, _mm_shuffle_epi32(vmax, _MM_SHUFFLE(1, 0, 3, 2)));
+	vmax = _mm_max_epi16(vmax, _mm_shuffle_epi32(vmax, _MM_SHUFFLE(2, 3, 0, 1)));
+	vmax = _mm_max_epi16(vmax, _mm_shufflelo_epi16(vmax, _MM_SHUFFLE(2, 3, 0, 1)));
+	result = (uint16_t)(_mm_cvtsi128_si32(vmax) ^ 0x8000);
+#endif
+
+	for(; x < count; x++)
+	{
+		if(src[x] > result)
+		{
+			result = src[x];
+		}
+	}
+	return result;
+}
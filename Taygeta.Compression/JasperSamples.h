@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+#include "jasper/jasper.h"
+#include "CompressionLib.h"
+
+// Row conversions between jasper matrix rows and 8/16-bit sample planes.
+// Samples are offset by bias, shifted right by shift and saturated to the target range.
+void jas_narrow_row8(const jas_seqent_t* src, BYTE* dst, int count, int bias, int shift);
+void jas_narrow_row16(const jas_seqent_t* src, uint16_t* dst, int count, int bias, int shift);
+
+// Zero-extends 8/16-bit samples into a jasper matrix row
+void jas_widen_row8(const BYTE* src, jas_seqent_t* dst, int count);
+void jas_widen_row16(const uint16_t* src, jas_seqent_t* dst, int count);
+
+// Swaps the bytes of 16-bit samples, between big-endian planes and host order. dst may be src.
+void jas_swap_row16(const uint16_t* src, uint16_t* dst, int count);
+
+// Largest sample in a 16-bit row, used to find the precision of high bit depth sources
+uint16_t jas_max_row16(const uint16_t* src, int count);
+
+// Same as jas_narrow_row8 but writes every step-th byte, used to pack 4:2:2 into YUY2
+void jas_narrow_row8_step(const jas_seqent_t* src, BYTE* dst, int count, int step, int bias, int shift);
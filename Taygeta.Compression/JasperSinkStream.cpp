@@ -0,0 +1,298 @@
+#include "JasperSinkStream.h"
+
+#include <string.h>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+CFileDescriptorSink::CFileDescriptorSink(int fd)
+	: m_fd(fd)
+{
+}
+
+bool CFileDescriptorSink::Write(const BYTE* data, int size)
+{
+	while(size > 0)
+	{
+#ifdef _WIN32
+		int written = _write(m_fd, data, size);
+#else
+		int written = (int)write(m_fd, data, size);
+#endif
+		if(written <= 0)
+		{
+			return false;
+		}
+		data += written;
+		size -= written;
+	}
+	return true;
+}
+
+CMemorySink::CMemorySink(BYTE* buffer, size_t capacity)
+	: m_buffer(buffer), m_capacity(capacity), m_size(0)
+{
+}
+
+bool CMemorySink::Write(const BYTE* data, int size)
+{
+	if(m_size < m_capacity)
+	{
+		size_t n = m_capacity - m_size < (size_t)size ? m_capacity - m_size : (size_t)size;
+		memcpy(m_buffer + m_size, data, n);
+	}
+	m_size += size;
+	return true;
+}
+
+struct CRingBufferSink::State
+{
+	std::mutex lock;
+	std::condition_variable notEmpty;
+	std::condition_variable notFull;
+	std::vector<BYTE> buffer;
+	int head;
+	int count;
+	bool closed;
+};
+
+CRingBufferSink::CRingBufferSink(int capacity)
+{
+	m_state = new State();
+	m_state->buffer.resize(capacity);
+	m_state->head = 0;
+	m_state->count = 0;
+	m_state->closed = false;
+}
+
+CRingBufferSink::~CRingBufferSink(void)
+{
+	delete m_state;
+}
+
+bool CRingBufferSink::Write(const BYTE* data, int size)
+{
+	int capacity = (int)m_state->buffer.size();
+	std::unique_lock<std::mutex> guard(m_state->lock);
+	while(size > 0)
+	{
+		while(m_state->count == capacity && !m_state->closed)
+		{
+			m_state->notFull.wait(guard);
+		}
+		if(m_state->closed)
+		{
+			return false;
+		}
+
+		int tail = (m_state->head + m_state->count) % capacity;
+		int chunk = capacity - m_state->count;
+		if(chunk > capacity - tail)
+		{
+			chunk = capacity - tail;
+		}
+		if(chunk > size)
+		{
+			chunk = size;
+		}
+
+		memcpy(&m_state->buffer[tail], data, chunk);
+		m_state->count += chunk;
+		data += chunk;
+		size -= chunk;
+		m_state->notEmpty.notify_one();
+	}
+	return true;
+}
+
+int CRingBufferSink::Read(BYTE* buffer, int size)
+{
+	int capacity = (int)m_state->buffer.size();
+	std::unique_lock<std::mutex> guard(m_state->lock);
+	while(m_state->count == 0 && !m_state->closed)
+	{
+		m_state->notEmpty.wait(guard);
+	}
+
+	int read = 0;
+	while(read < size && m_state->count > 0)
+	{
+		int chunk = capacity - m_state->head;
+		if(chunk > m_state->count)
+		{
+			chunk = m_state->count;
+		}
+		if(chunk > size - read)
+		{
+			chunk = size - read;
+		}
+
+		memcpy(buffer + read, &m_state->buffer[m_state->head], chunk);
+		m_state->head = (m_state->head + chunk) % capacity;
+		m_state->count -= chunk;
+		read += chunk;
+	}
+
+	m_state->notFull.notify_one();
+	return read;
+}
+
+void CRingBufferSink::Close(void)
+{
+	std::lock_guard<std::mutex> guard(m_state->lock);
+	m_state->closed = true;
+	m_state->notEmpty.notify_all();
+	m_state->notFull.notify_all();
+}
+
+// Bytes in [base, base + window.size()) are still open to being rewritten.
+// Everything in front of base has been handed to the sink.
+struct jas_sink_obj_t
+{
+	IJasperSink* sink;
+	std::vector<BYTE> window;
+	long base;
+	long pos;
+	bool failed;
+};
+
+static bool sink_commit(jas_sink_obj_t* obj, long upto)
+{
+	long count = upto - obj->base;
+	if(count <= 0)
+	{
+		return true;
+	}
+
+	if(count > (long)obj->window.size())
+	{
+		obj->window.resize(count, 0);
+	}
+
+	if(!obj->failed && !obj->sink->Write(&obj->window[0], (int)count))
+	{
+		obj->failed = true;
+	}
+
+	obj->window.erase(obj->window.begin(), obj->window.begin() + count);
+	obj->base = upto;
+	return !obj->failed;
+}
+
+static int sink_read(jas_stream_obj_t* /*obj*/, char* /*buf*/, int /*cnt*/)
+{
+	return -1;
+}
+
+static int sink_write(jas_stream_obj_t* obj, char* buf, int cnt)
+{
+	jas_sink_obj_t* sink = (jas_sink_obj_t*)obj;
+	if(sink->failed)
+	{
+		return -1;
+	}
+
+	size_t offset = sink->pos - sink->base;
+	if(offset + cnt > sink->window.size())
+	{
+		sink->window.resize(offset + cnt);
+	}
+	memcpy(&sink->window[offset], buf, cnt);
+	sink->pos += cnt;
+	return cnt;
+}
+
+static long sink_seek(jas_stream_obj_t* obj, long offset, int origin)
+{
+	jas_sink_obj_t* sink = (jas_sink_obj_t*)obj;
+	long newpos;
+
+	switch(origin)
+	{
+	case SEEK_SET:
+		newpos = offset;
+		break;
+	case SEEK_CUR:
+		newpos = sink->pos + offset;
+		break;
+	case SEEK_END:
+		newpos = sink->base + (long)sink->window.size() + offset;
+		break;
+	default:
+		return -1;
+	}
+
+	if(newpos < sink->base)
+	{
+		return -1;
+	}
+
+	// The coder only seeks back to patch the header of the tile it is working on,
+	// so nothing in front of the seek target will be touched again.
+	if(newpos < sink->pos && !sink_commit(sink, newpos))
+	{
+		return -1;
+	}
+
+	sink->pos = newpos;
+	return newpos;
+}
+
+static int sink_close(jas_stream_obj_t* obj)
+{
+	jas_sink_obj_t* sink = (jas_sink_obj_t*)obj;
+	bool ok = sink_commit(sink, sink->base + (long)sink->window.size());
+	delete sink;
+	return ok ? 0 : -1;
+}
+
+static jas_stream_ops_t jas_stream_sinkops =
+{
+	sink_read,
+	sink_write,
+	sink_seek,
+	sink_close
+};
+
+jas_stream_t* jas_stream_sinkopen(IJasperSink* sink)
+{
+	// jasper does not export a constructor for custom streams, so this mirrors what
+	// jas_stream_create and jas_stream_initbuf do for a fully buffered write stream
+	jas_stream_t* stream = (jas_stream_t*)jas_malloc(sizeof(jas_stream_t));
+	if(!stream)
+	{
+		return NULL;
+	}
+	memset(stream, 0, sizeof(jas_stream_t));
+
+	stream->bufbase_ = (unsigned char*)jas_malloc(JAS_STREAM_BUFSIZE + JAS_STREAM_MAXPUTBACK);
+	if(!stream->bufbase_)
+	{
+		jas_free(stream);
+		return NULL;
+	}
+
+	stream->openmode_ = JAS_STREAM_WRITE | JAS_STREAM_BINARY;
+	stream->bufmode_ = JAS_STREAM_FULLBUF | JAS_STREAM_FREEBUF;
+	stream->bufsize_ = JAS_STREAM_BUFSIZE;
+	stream->bufstart_ = &stream->bufbase_[JAS_STREAM_MAXPUTBACK];
+	stream->ptr_ = stream->bufstart_;
+	stream->cnt_ = 0;
+	stream->rwlimit_ = -1;
+
+	jas_sink_obj_t* obj = new jas_sink_obj_t();
+	obj->sink = sink;
+	obj->base = 0;
+	obj->pos = 0;
+	obj->failed = false;
+
+	stream->ops_ = &jas_stream_sinkops;
+	stream->obj_ = obj;
+	return stream;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "jasper/jasper.h"
+#include "CompressionLib.h"
+
+// Receives encoded data from a sink stream once it can no longer change
+class IJasperSink
+{
+public:
+	virtual ~IJasperSink(void) {}
+	virtual bool Write(const BYTE* data, int size) = 0;
+};
+
+// Writes encoded data to an open file descriptor
+class CFileDescriptorSink : public IJasperSink
+{
+public:
+	CFileDescriptorSink(int fd);
+	virtual bool Write(const BYTE* data, int size);
+
+private:
+	int m_fd;
+};
+
+// Writes encoded data into a fixed caller buffer. Data past its end is only counted, so
+// GetSize tells how large the buffer has to be when it was too small.
+class CMemorySink : public IJasperSink
+{
+public:
+	CMemorySink(BYTE* buffer, size_t capacity);
+	virtual bool Write(const BYTE* data, int size);
+
+	size_t GetSize(void) const { return m_size; }
+
+private:
+	BYTE* m_buffer;
+	size_t m_capacity;
+	size_t m_size;
+};
+
+// Bounded single-producer/single-consumer byte ring. The encoder blocks in Write
+// while the ring is full, so a consumer thread has to drain it with Read.
+class CRingBufferSink : public IJasperSink
+{
+public:
+	CRingBufferSink(int capacity);
+	virtual ~CRingBufferSink(void);
+
+	virtual bool Write(const BYTE* data, int size);
+
+	// Returns number of bytes copied, or 0 once the ring is closed and drained
+	int Read(BYTE* buffer, int size);
+	void Close(void);
+
+private:
+	struct State;
+	State* m_state;
+};
+
+// Opens a write-only jasper stream that forwards finalized bytes to the sink while
+// encoding is in progress. Data is held back only from the last position the coder
+// may seek back to (the start of the current tile), which the coder holds in memory
+// anyway. The sink must outlive the stream.
+jas_stream_t* jas_stream_sinkopen(IJasperSink* sink);
@@ -0,0 +1,279 @@
+#include "Jpeg2000Layers.h"
+
+#define J2K_SOC 0xFF4F
+#define J2K_SOT 0xFF90
+#define J2K_SOD 0xFF93
+#define J2K_SOP 0xFF91
+#define J2K_EOC 0xFFD9
+#define J2K_COD 0xFF52
+
+#define J2K_COD_SOP 0x02
+#define J2K_PRG_LRCP 0
+
+#define JP2_BOX_JP2C 0x6A703263
+
+static inline int ReadUInt16(const BYTE* p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+static inline unsigned int ReadUInt32(const BYTE* p)
+{
+	return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | p[3];
+}
+
+static inline void WriteUInt32(BYTE* p, unsigned int value)
+{
+	p[0] = (BYTE)(value >> 24);
+	p[1] = (BYTE)(value >> 16);
+	p[2] = (BYTE)(value >> 8);
+	p[3] = (BYTE)value;
+}
+
+CJpeg2000LayerExtractor::CJpeg2000LayerExtractor(const BYTE* buffer, int size)
+	: m_buffer(buffer), m_size(size), m_boxStart(-1), m_boxHeaderSize(0),
+	  m_codestreamStart(0), m_codestreamEnd(size), m_layers(0)
+{
+	FindCodestream();
+	ParseCodestream();
+}
+
+CJpeg2000LayerExtractor::~CJpeg2000LayerExtractor(void)
+{
+}
+
+void CJpeg2000LayerExtractor::FindCodestream(void)
+{
+	if(m_size >= 2 && ReadUInt16(m_buffer) == J2K_SOC)
+	{
+		return;
+	}
+
+	int pos = 0;
+	while(pos + 8 <= m_size)
+	{
+		unsigned int length = ReadUInt32(m_buffer + pos);
+		unsigned int type = ReadUInt32(m_buffer + pos + 4);
+		int headerSize = 8;
+
+		if(length == 1)
+		{
+			if(pos + 16 > m_size || ReadUInt32(m_buffer + pos + 8) != 0)
+			{
+				throw "Unsupported JP2 box size";
+			}
+			length = ReadUInt32(m_buffer + pos + 12);
+			headerSize = 16;
+		}
+		else if(length == 0)
+		{
+			length = m_size - pos;
+		}
+
+		if(length < (unsigned int)headerSize || length > (unsigned int)(m_size - pos))
+		{
+			throw "Corrupt JP2 box";
+		}
+
+		if(type == JP2_BOX_JP2C)
+		{
+			m_boxStart = pos;
+			m_boxHeaderSize = headerSize;
+			m_codestreamStart = pos + headerSize;
+			m_codestreamEnd = pos + length;
+			return;
+		}
+		pos += length;
+	}
+
+	throw "No JPEG-2000 codestream found";
+}
+
+void CJpeg2000LayerExtractor::ParseCodestream(void)
+{
+	const BYTE* buf = m_buffer;
+	int end = m_codestreamEnd;
+	int p = m_codestreamStart;
+	int scod = 0;
+	int progression = -1;
+
+	if(p + 2 > end || ReadUInt16(buf + p) != J2K_SOC)
+	{
+		throw "Missing SOC marker";
+	}
+	p += 2;
+
+	while(true)
+	{
+		if(p + 4 > end)
+		{
+			throw "Truncated main header";
+		}
+
+		int marker = ReadUInt16(buf + p);
+		if(marker == J2K_SOT)
+		{
+			break;
+		}
+
+		int length = ReadUInt16(buf + p + 2);
+		if(marker == J2K_COD)
+		{
+			if(length < 7 || p + 9 > end)
+			{
+				throw "Corrupt COD marker";
+			}
+			scod = buf[p + 4];
+			progression = buf[p + 5];
+			m_layers = ReadUInt16(buf + p + 6);
+		}
+		p += 2 + length;
+	}
+
+	if(m_layers <= 0 || progression != J2K_PRG_LRCP || !(scod & J2K_COD_SOP))
+	{
+		throw "Codestream is not layer truncatable, LRCP progression with SOP markers is required";
+	}
+
+	while(p + 2 <= end)
+	{
+		int marker = ReadUInt16(buf + p);
+		if(marker == J2K_EOC)
+		{
+			break;
+		}
+		if(marker != J2K_SOT || p + 12 > end)
+		{
+			throw "Missing SOT marker";
+		}
+
+		TilePart tile;
+		tile.Start = p;
+
+		int lsot = ReadUInt16(buf + p + 2);
+		unsigned int psot = ReadUInt32(buf + p + 6);
+		if(buf[p + 10] != 0)
+		{
+			throw "Tiles split into several tile-parts are not supported";
+		}
+
+		if(psot == 0)
+		{
+			tile.End = ReadUInt16(buf + end - 2) == J2K_EOC ? end - 2 : end;
+		}
+		else
+		{
+			if(psot > (unsigned int)(end - p))
+			{
+				throw "Tile-part exceeds codestream";
+			}
+			tile.End = p + psot;
+		}
+
+		int q = p + 2 + lsot;
+		while(true)
+		{
+			if(q + 2 > tile.End)
+			{
+				throw "Missing SOD marker";
+			}
+
+			marker = ReadUInt16(buf + q);
+			if(marker == J2K_SOD)
+			{
+				break;
+			}
+			if(q + 4 > tile.End)
+			{
+				throw "Truncated tile-part header";
+			}
+			if(marker == J2K_COD && (q + 8 > tile.End || !(buf[q + 4] & J2K_COD_SOP) ||
+				buf[q + 5] != J2K_PRG_LRCP || ReadUInt16(buf + q + 6) != m_layers))
+			{
+				throw "Tile coding style differs from the main header";
+			}
+			q += 2 + ReadUInt16(buf + q + 2);
+		}
+		tile.DataStart = q + 2;
+
+		// Packet bodies never contain 0xFF followed by a byte above 0x8F,
+		// so every SOP marker found here starts a packet
+		for(int i = tile.DataStart; i + 1 < tile.End; i++)
+		{
+			if(buf[i] == 0xFF && buf[i + 1] == (J2K_SOP & 0xFF))
+			{
+				tile.Packets.push_back(i);
+				i += 5;
+			}
+		}
+
+		if(tile.Packets.size() % m_layers != 0)
+		{
+			throw "Packet count does not match the number of layers";
+		}
+
+		m_tiles.push_back(tile);
+		p = tile.End;
+	}
+
+	if(m_tiles.empty())
+	{
+		throw "Codestream contains no tiles";
+	}
+}
+
+int CJpeg2000LayerExtractor::GetCut(const TilePart& tile, int layers) const
+{
+	int packetsPerLayer = (int)tile.Packets.size() / m_layers;
+	if(layers >= m_layers || packetsPerLayer == 0)
+	{
+		return tile.End;
+	}
+	return tile.Packets[layers * packetsPerLayer];
+}
+
+int CJpeg2000LayerExtractor::GetExtractedSize(int layers) const
+{
+	int size = m_tiles[0].Start + 2 + (m_size - m_codestreamEnd);
+	for(size_t i = 0; i < m_tiles.size(); i++)
+	{
+		size += GetCut(m_tiles[i], layers) - m_tiles[i].Start;
+	}
+	return size;
+}
+
+void CJpeg2000LayerExtractor::Extract(int layers, std::vector<BYTE>* output) const
+{
+	if(layers < 1 || layers > m_layers)
+	{
+		throw "Layer count out of range";
+	}
+
+	output->clear();
+	output->reserve(GetExtractedSize(layers));
+
+	// Box headers and the codestream main header are kept as they are
+	output->insert(output->end(), m_buffer, m_buffer + m_tiles[0].Start);
+
+	for(size_t i = 0; i < m_tiles.size(); i++)
+	{
+		const TilePart& tile = m_tiles[i];
+		int cut = GetCut(tile, layers);
+		size_t tileStart = output->size();
+
+		output->insert(output->end(), m_buffer + tile.Start, m_buffer + cut);
+		WriteUInt32(&(*output)[tileStart + 6], cut - tile.Start);
+	}
+
+	output->push_back(0xFF);
+	output->push_back(0xD9);
+
+	if(m_boxStart >= 0 && ReadUInt32(m_buffer + m_boxStart) != 0)
+	{
+		unsigned int boxLength = (unsigned int)(output->size() - m_boxStart);
+		int lengthOffset = m_boxHeaderSize == 16 ? 12 : 0;
+		WriteUInt32(&(*output)[m_boxStart + lengthOffset], boxLength);
+	}
+
+	output->insert(output->end(), m_buffer + m_codestreamEnd, m_buffer + m_size);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+#include "CompressionLib.h"
+
+// Truncates a layered JPEG-2000 codestream (raw or JP2 wrapped) to its first N quality
+// layers without decoding it. The codestream must use LRCP progression and carry SOP
+// markers, which is what Jpeg2000Compressor writes when given layer rates.
+class CJpeg2000LayerExtractor
+{
+public:
+	CJpeg2000LayerExtractor(const BYTE* buffer, int size);
+	virtual ~CJpeg2000LayerExtractor(void);
+
+	int GetLayerCount(void) const { return m_layers; }
+	int GetExtractedSize(int layers) const;
+	void Extract(int layers, std::vector<BYTE>* output) const;
+
+private:
+	struct TilePart
+	{
+		int Start;			// offset of the SOT marker
+		int DataStart;		// first byte after SOD
+		int End;
+		std::vector<int> Packets;	// offsets of the SOP markers
+	};
+
+	const BYTE* m_buffer;
+	int m_size;
+	int m_boxStart;			// jp2c box header, -1 for a raw codestream
+	int m_boxHeaderSize;
+	int m_codestreamStart;
+	int m_codestreamEnd;
+	int m_layers;
+	std::vector<TilePart> m_tiles;
+
+	void FindCodestream(void);
+	void ParseCodestream(void);
+	int GetCut(const TilePart& tile, int layers) const;
+};
@@ -1,232 +1,251 @@
 #pragma once
 
 #include "JasperImpl.h"
-#include "jasper\jasper.h"
+#include "JasperSamples.h"
+#include "Jpeg2000Layers.h"
+#include "jasper/jasper.h"
 #include "turbojpeg.h"
 #include "LibjpegEncoderImpl.h"
+#include "ManagedStreamSink.h"
+#include "BatchTranscoder.h"
+#include "EncodedFrameRing.h"
 
 using namespace System; 
 using namespace System::IO;
 using namespace System::Runtime::InteropServices;
+using namespace System::Collections::Generic;
 using namespace Taygeta::Imaging;
 
 namespace Taygeta { namespace Compression 
 {
+	// Y16 holds big-endian samples, as swscale reads them, while the codec takes them in host
+	// order. Encoding swaps a copy of the plane into buffer, decoding swaps the plane in place.
+	static inline void CopySwapped16(ImageData& data, std::vector<uint16_t>& buffer)
+	{
+		buffer.resize((size_t)data.Width * data.Lines[0]);
+		for(int y = 0; y < data.Lines[0]; y++)
+		{
+			jas_swap_row16((const uint16_t*)(data.Planes[0] + y * data.Pitches[0]), &buffer[(size_t)y * data.Width], data.Width);
+		}
+		data.Planes[0] = (BYTE*)&buffer[0];
+		data.Pitches[0] = data.Width * 2;
+	}
+
+	static inline void SwapInPlace16(ImageData& data)
+	{
+		for(int y = 0; y < data.Lines[0]; y++)
+		{
+			uint16_t* row = (uint16_t*)(data.Planes[0] + y * data.Pitches[0]);
+			jas_swap_row16(row, row, data.Width);
+		}
+	}
+
 	public ref class Jpeg2000Compressor
 	{
 	public:
 		Jpeg2000Compressor()
 		{
-			jas_init();
+			m_impl = new CJasperImpl();
 		}
 
 		virtual ~Jpeg2000Compressor()
 		{
-			jas_cleanup();
+			delete m_impl;
 		}
 
 		void Save(PlanarImage^ image, Stream^ stream, double quality, bool bLossless)
 		{
-			if(image->PixelType != PixelAlignmentType::YUV &&
-               image->PixelType != PixelAlignmentType::I420 &&
-			   image->PixelType != PixelAlignmentType::Y800)
-			{
-				throw gcnew ArgumentException("Pixel type not supported");
-			}
-
-			if(stream == nullptr)
-			{
-				throw gcnew ArgumentNullException("stream");
-			}
+			Save(image, stream, quality, bLossless, 0);
+		}
 
+		// Saves with an explicit sample precision of 9 to 16 bits for 16-bit pixel types (Y16,
+		// YUV16, I420P16), which must hold the largest sample. With precision 0 it is taken from
+		// the largest sample in the image.
+		void Save(PlanarImage^ image, Stream^ stream, double quality, bool bLossless, int precision)
+		{
 			if(quality < 0 || quality > 1)
 			{
 				throw gcnew ArgumentException("Quality must be in range of [0,1]");
 			}
 
-			jas_image_t* jimage = NULL;
-			jas_matrix_t* cmpts[3];
-			for(int z = 0; z< 3; z++)
+			char szoutopts[40];
+			const char* mode = bLossless == true ? "int" : "real";
+			sprintf_s(szoutopts,"rate=%.3f mode=%s", quality, mode);
+
+			Encode(image, stream, szoutopts, precision);
+		}
+
+		// Writes a single codestream holding one quality layer per rate. Layer rates must
+		// be ascending; any prefix of the layers can later be cut out with Jpeg2000LayerExtractor.
+		void Save(PlanarImage^ image, Stream^ stream, array<double>^ layerRates, bool bLossless)
+		{
+			if(layerRates == nullptr)
 			{
-				cmpts[z] = NULL;
+				throw gcnew ArgumentNullException("layerRates");
 			}
-			jas_image_cmptparm_t cmptparm[3];
-			BYTE* planes[3];
-			int bufferSize = image->Width * image->Height;
-			long* plane = new long[bufferSize];
 
-			switch(image->PixelType)
+			if(layerRates->Length == 0 || layerRates->Length > MaxQualityLayers)
 			{
-			case PixelAlignmentType::YUV:
-
-				for (int c = 0; c < 3; c++) 
-				{
-					cmptparm[c].tlx = 0;
-					cmptparm[c].tly = 0;
-					cmptparm[c].hstep = 1;
-					cmptparm[c].vstep = 1;
-					cmptparm[c].width = image->Pitches[c];
-					cmptparm[c].height = image->Lines[c];
-					cmptparm[c].prec = 8;
-					cmptparm[c].sgnd = false;
-					cmpts[c] = jas_matrix_create(1, image->Pitches[c]);
-				}
+				throw gcnew ArgumentException("Between 1 and 16 quality layers are supported");
+			}
 
-				jimage = jas_image_create(3, cmptparm, JAS_CLRSPC_SYCBCR);
-				if(!jimage)
+			for(int i = 0; i < layerRates->Length; i++)
+			{
+				if(layerRates[i] <= 0 || layerRates[i] > 1 || (i > 0 && layerRates[i] <= layerRates[i - 1]))
 				{
-					throw gcnew InvalidOperationException("Failed to create image");
+					throw gcnew ArgumentException("Layer rates must be ascending and in range of (0,1]");
 				}
-				jas_image_setcmpttype(jimage, 0, JAS_IMAGE_CT_COLOR(JAS_CLRSPC_CHANIND_YCBCR_Y));
-				jas_image_setcmpttype(jimage, 1, JAS_IMAGE_CT_COLOR(JAS_CLRSPC_CHANIND_YCBCR_CB));
-				jas_image_setcmpttype(jimage, 2, JAS_IMAGE_CT_COLOR(JAS_CLRSPC_CHANIND_YCBCR_CR));
-
-				planes[0] = (BYTE*)image->Planes[0].ToPointer();
-				planes[1] = (BYTE*)image->Planes[1].ToPointer();
-				planes[2] = (BYTE*)image->Planes[2].ToPointer();
+			}
 
-				for (int y = 0; y < image->Lines[0]; ++y) 
-				{
-					for (int x = 0; x < image->Pitches[0]; ++x) 
-					{
-						jas_matrix_setv(cmpts[0], x, planes[0][x + y * image->Pitches[0]]);	
-						jas_matrix_setv(cmpts[1], x, planes[1][x + y * image->Pitches[1]]);	
-						jas_matrix_setv(cmpts[2], x, planes[2][x + y * image->Pitches[2]]);	
-					}
-		
-					for (int c = 0; c < 3; ++c) 
-					{
-						jas_image_writecmpt(jimage, c, 0, y, image->Pitches[0], 1, cmpts[c]);
-					}					
-				}
+			char szoutopts[256];
+			const char* mode = bLossless == true ? "int" : "real";
+			int len = sprintf_s(szoutopts, "rate=%.4f mode=%s prg=lrcp sop", layerRates[layerRates->Length - 1], mode);
+			for(int i = 0; i < layerRates->Length - 1; i++)
+			{
+				len += sprintf_s(szoutopts + len, sizeof(szoutopts) - len, "%s%.4f", i == 0 ? " ilyrrates=" : ",", layerRates[i]);
+			}
 
-				break;
+			Encode(image, stream, szoutopts, 0);
+		}
 
-			case PixelAlignmentType::I420:
+	private:
+		static const int MaxQualityLayers = 16;
 
-				for (int c = 0; c < 3; c++) 
-				{
-					cmptparm[c].tlx = 0;
-					cmptparm[c].tly = 0;
-					cmptparm[c].width = image->Pitches[c];
-					cmptparm[c].height = image->Lines[c];
-					cmptparm[c].prec = 8;
-					cmptparm[c].sgnd = false;
-					cmpts[c] = jas_matrix_create(1, image->Pitches[c]);
-				}
+		CJasperImpl* m_impl;
 
-				cmptparm[0].hstep = 1;
-				cmptparm[0].vstep = 1;
-				cmptparm[1].hstep = 2;
-				cmptparm[1].vstep = 2;
-				cmptparm[2].hstep = 2;
-				cmptparm[2].vstep = 2;
+		void Encode(PlanarImage^ image, Stream^ stream, const char* options, int precision)
+		{
+			if(stream == nullptr)
+			{
+				throw gcnew ArgumentNullException("stream");
+			}
 
-				jimage = jas_image_create(3, cmptparm, JAS_CLRSPC_SYCBCR);
-				if(!jimage)
-				{
-					throw gcnew InvalidOperationException("Failed to create image");
-				}
-				jas_image_setcmpttype(jimage, 0, JAS_IMAGE_CT_COLOR(JAS_CLRSPC_CHANIND_YCBCR_Y));
-				jas_image_setcmpttype(jimage, 1, JAS_IMAGE_CT_COLOR(JAS_CLRSPC_CHANIND_YCBCR_CB));
-				jas_image_setcmpttype(jimage, 2, JAS_IMAGE_CT_COLOR(JAS_CLRSPC_CHANIND_YCBCR_CR));
+			ImageData data;
+			data.Width = image->Width;
+			data.Height = image->Height;
+			data.Components = image->NumberOfPlanes;
+			data.Precision = 8;
 
-				planes[0] = (BYTE*)image->Planes[0].ToPointer();
-				planes[1] = (BYTE*)image->Planes[1].ToPointer();
-				planes[2] = (BYTE*)image->Planes[2].ToPointer();
-			
-				memset(plane, 0, bufferSize);
-
-				for(int i = 0; i < 3; i++)
-				{		
-					int size = image->Pitches[i] * image->Lines[i];
-					for(int j = 0; j < size ; j++)
-					{
-						plane[j] = (long)planes[i][j];
-					}
-
-					int res = jas_image_writecmpt2(jimage, i, 0, 0, image->Pitches[i], image->Lines[i], plane);
-					if(res < 0)
-					{
-						char szoutopts[255];
-						sprintf_s(szoutopts,"Failed to write component %d data", i);
-						throw gcnew InvalidOperationException(gcnew String(szoutopts));
-					}
-				}
+			switch(image->PixelType)
+			{
+			case PixelAlignmentType::Y800:
+				data.Subsampling = TJSAMP_GRAY;
+				break;
+			case PixelAlignmentType::YUV:
+				data.Subsampling = TJSAMP_444;
+				break;
+			case PixelAlignmentType::I420:
+				data.Subsampling = TJSAMP_420;
+				break;
+			case PixelAlignmentType::Y16:
+				data.Subsampling = TJSAMP_GRAY;
+				data.Precision = 16;
 				break;
+			case PixelAlignmentType::YUV16:
+				data.Subsampling = TJSAMP_444;
+				data.Precision = 16;
+				break;
+			case PixelAlignmentType::I420P16:
+				data.Subsampling = TJSAMP_420;
+				data.Precision = 16;
+				break;
+			default:
+				throw gcnew ArgumentException("Pixel type not supported");
+			}
 
-			case PixelAlignmentType::Y800:
+			for(int i = 0; i < image->NumberOfPlanes; i++)
+			{
+				data.Planes[i] = (BYTE*)image->Planes[i].ToPointer();
+				data.Pitches[i] = image->Pitches[i];
+				data.Lines[i] = image->Lines[i];
+			}
 
-				for (int c = 0; c < 1; c++) 
-				{
-					cmptparm[c].tlx = 0;
-					cmptparm[c].tly = 0;
-					cmptparm[c].hstep = 1;
-					cmptparm[c].vstep = 1;
-					cmptparm[c].width = image->Pitches[c];
-					cmptparm[c].height = image->Lines[c];
-					cmptparm[c].prec = 8;
-					cmptparm[c].sgnd = false;
-					cmpts[c] = jas_matrix_create(1, image->Pitches[c]);
-				}
+			std::vector<uint16_t> swapped;
+			if(image->PixelType == PixelAlignmentType::Y16)
+			{
+				CopySwapped16(data, swapped);
+			}
 
-				jimage = jas_image_create(1, cmptparm, JAS_CLRSPC_SGRAY);
-				if(!jimage)
+			if(data.Precision > 8)
+			{
+				if(precision != 0 && (precision < 9 || precision > 16))
 				{
-					throw gcnew InvalidOperationException("Failed to create image");
+					throw gcnew ArgumentException("Precision must be 0 or in range of [9,16]");
 				}
-				jas_image_setcmpttype(jimage, 0, JAS_IMAGE_CT_COLOR(JAS_CLRSPC_CHANIND_GRAY_Y));
-
-				BYTE* planes[3];
-				planes[0] = (BYTE*)image->Planes[0].ToPointer();
 
-				for (int y = 0; y < image->Lines[0]; ++y) 
+				// A narrower codestream would cut the high bits off and lose the round trip
+				int samplePrecision = CJasperImpl::FindPrecision(data);
+				if(precision != 0 && precision < samplePrecision)
 				{
-					for (int x = 0; x < image->Pitches[0]; ++x) 
-					{
-						jas_matrix_setv(cmpts[0], x, planes[0][x + y * image->Pitches[0]]);	
-					}
-		
-					jas_image_writecmpt(jimage, 0, 0, y, image->Pitches[0], 1, cmpts[0]);					
+					throw gcnew ArgumentException("Samples exceed the given precision");
 				}
-				break;
+				data.Precision = precision != 0 ? precision : samplePrecision;
 			}
 
-			int outfmt = jas_image_strtofmt("jp2");
+			CManagedStreamSink sink(stream);
+			try
+			{
+				m_impl->Save(data, &sink, options);
+			}
+			catch(const char* msg)
+			{
+				sink.ThrowIfFailed();
+				throw gcnew InvalidOperationException(gcnew String(msg));
+			}
+		}
+	};
 
-			char szoutopts[40];
-			char* mode = bLossless == true ? "int" : "real";
-			sprintf_s(szoutopts,"rate=%.3f mode=%s", quality, mode);
+	public ref class Jpeg2000LayerExtractor
+	{
+	public:
+		// Gets the number of quality layers in a layered codestream
+		static int GetLayerCount(array<byte>^ buffer)
+		{
+			if(buffer == nullptr || buffer->Length == 0)
+			{
+				throw gcnew ArgumentException("Codestream buffer is empty", "buffer");
+			}
 
-			jas_stream_t* jstream = jas_stream_memopen(NULL, 0);
-			if(!stream)
+			pin_ptr<BYTE> pBuf = &buffer[0];
+			try
+			{
+				CJpeg2000LayerExtractor extractor(pBuf, buffer->Length);
+				return extractor.GetLayerCount();
+			}
+			catch(const char* msg)
 			{
-				throw gcnew InvalidOperationException("Failed to create output stream");
+				throw gcnew InvalidOperationException(gcnew String(msg));
 			}
+		}
 
-			int res = jas_image_encode(jimage, jstream, outfmt, szoutopts);
-			if(res < 0)
+		// Cuts the codestream down to its first layers without decoding it
+		static array<byte>^ Extract(array<byte>^ buffer, int layers)
+		{
+			if(buffer == nullptr || buffer->Length == 0)
 			{
-				jas_stream_close(jstream);
-				throw gcnew InvalidOperationException("Failed to encode image");
+				throw gcnew ArgumentException("Codestream buffer is empty", "buffer");
 			}
-			jas_stream_flush(jstream);
-			jas_stream_memobj_t* jmem = (jas_stream_memobj_t*)jstream->obj_;
-			
-			array<byte>^ buf = gcnew array<byte>(jmem->len_);
-			Marshal::Copy(IntPtr(jmem->buf_), buf, 0, jmem->len_);
-			stream->Write(buf, 0, jmem->len_);
 
-			delete plane;
-			jas_image_destroy(jimage);
-			jas_stream_close(jstream);
-			for(int z = 0; z< 3; z++)
+			if(layers <= 0)
 			{
-				if(cmpts[z] != NULL)
-				{
-					jas_matrix_destroy(cmpts[z]);
-				}
+				throw gcnew ArgumentOutOfRangeException("layers");
 			}
+
+			pin_ptr<BYTE> pBuf = &buffer[0];
+			std::vector<BYTE> output;
+			try
+			{
+				CJpeg2000LayerExtractor extractor(pBuf, buffer->Length);
+				extractor.Extract(layers, &output);
+			}
+			catch(const char* msg)
+			{
+				throw gcnew InvalidOperationException(gcnew String(msg));
+			}
+
+			array<byte>^ result = gcnew array<byte>(output.size());
+			Marshal::Copy(IntPtr(&output[0]), result, 0, output.size());
+			return result;
 		}
 	};
 
@@ -245,11 +264,8 @@ namespace Taygeta { namespace Compression
 
 		PlanarImage^ Load(array<byte>^ buffer)
 		{
-			BYTE* pBuf = new BYTE[buffer->Length];
-			Marshal::Copy(buffer, 0, IntPtr(pBuf), buffer->Length);
-			PlanarImage^ image = Load(IntPtr(pBuf), buffer->Length);
-			delete pBuf;
-			return image;
+			pin_ptr<BYTE> pBuf = &buffer[0];
+			return Load(IntPtr(pBuf), buffer->Length);
 		}
 
 		PlanarImage^ Load(IntPtr pBuffer, int bufferSize)
@@ -257,28 +273,61 @@ namespace Taygeta { namespace Compression
 			ImageData data;
 			try
 			{
-				m_impl->Load((BYTE*)pBuffer.ToPointer(), bufferSize, data);
+				m_impl->Decode((BYTE*)pBuffer.ToPointer(), bufferSize, data);
 			}
-			catch(char* msg)
+			catch(const char* msg)
 			{
 				throw gcnew InvalidOperationException(gcnew String(msg));
 			}
-			array<IntPtr>^ buffers = gcnew array<IntPtr>(data.Components);
-			for(int i=0; i<data.Components; i++)
+
+			// There is no 16-bit 4:2:2 pixel type, such images are narrowed into YUY2
+			bool wide = data.Precision > 8 && data.Subsampling != TJSAMP_422;
+			PlanarImage^ image = gcnew PlanarImage(data.Width, data.Height, GetPixelAlignmentType(data.Subsampling, wide));
+			data.Components = image->NumberOfPlanes;
+			data.Precision = wide ? 16 : 8;
+			for(int i = 0; i < image->NumberOfPlanes; i++)
+			{
+				data.Planes[i] = (BYTE*)image->Planes[i].ToPointer();
+				data.Pitches[i] = image->Pitches[i];
+				data.Lines[i] = image->Lines[i];
+			}
+
+			try
+			{
+				m_impl->ReadPlanes(data);
+			}
+			catch(const char* msg)
 			{
-				buffers[i] = IntPtr(data.Planes[i]);
+				delete image;
+				throw gcnew InvalidOperationException(gcnew String(msg));
 			}
-			PixelAlignmentType pType = data.Components == 3 ? PixelAlignmentType::I420 : PixelAlignmentType::Y800;
-			PlanarImage^ image = gcnew PlanarImage(data.Width, data.Height, pType, buffers);
-			for(int i=0; i<data.Components; i++)
+
+			if(image->PixelType == PixelAlignmentType::Y16)
 			{
-				delete data.Planes[i];
+				SwapInPlace16(data);
 			}
 			return image;
 		}
 
 	private:
 		CJasperImpl* m_impl;
+
+		static inline PixelAlignmentType GetPixelAlignmentType(TJSAMP samp, bool wide)
+		{
+			switch(samp)
+			{
+			case TJSAMP_444:
+				return wide ? PixelAlignmentType::YUV16 : PixelAlignmentType::YUV;
+			case TJSAMP_422:
+				return PixelAlignmentType::YUY2;
+			case TJSAMP_420:
+				return wide ? PixelAlignmentType::I420P16 : PixelAlignmentType::I420;
+			case TJSAMP_GRAY:
+				return wide ? PixelAlignmentType::Y16 : PixelAlignmentType::Y800;
+			default:
+				throw gcnew InvalidOperationException("Unsupported subsampling");
+			}
+		}
 	};
 
 	public ref class JpegDecompressor
@@ -299,11 +348,39 @@ namespace Taygeta { namespace Compression
 			pin_ptr<BYTE> pBuf = &buffer[0];
 			
 			ImageData data;
-			m_impl->Load(pBuf, buffer->Length, data);
-			PlanarImage^ img = gcnew PlanarImage(data.Width, data.Height, 
-				GetPixelAlignmentType(data.Subsampling), IntPtr(data.Planes[0]), data.Pitches[0]);
+			try
+			{
+				m_impl->Load(pBuf, buffer->Length, data);
+			}
+			catch(const char* msg)
+			{
+				throw gcnew InvalidOperationException(gcnew String(msg));
+			}
+
+			PlanarImage^ img = nullptr;
+			try
+			{
+				img = gcnew PlanarImage(data.Width, data.Height, GetPixelAlignmentType(data.Subsampling));
 
-			tjFree(data.Planes[0]);
+				ImageData target = data;
+				target.Components = img->NumberOfPlanes;
+				for(int i = 0; i < img->NumberOfPlanes; i++)
+				{
+					target.Planes[i] = (BYTE*)img->Planes[i].ToPointer();
+					target.Pitches[i] = img->Pitches[i];
+					target.Lines[i] = img->Lines[i];
+				}
+				CTurboJpegDecoderImpl::CopyPlanes(data, target);
+			}
+			catch(const char* msg)
+			{
+				delete img;
+				throw gcnew InvalidOperationException(gcnew String(msg));
+			}
+			finally
+			{
+				tjFree(data.Planes[0]);
+			}
 			return img;
 		}
 
@@ -324,11 +401,213 @@ namespace Taygeta { namespace Compression
 				return PixelAlignmentType::Y800;
 			case TJSAMP_440:
 			default:
-				throw "Unsupported subsampling YUV440";  
+				throw gcnew InvalidOperationException("Unsupported subsampling YUV440");
 			}
 		}
 	};
 
+	public value struct EncodedFrameRingStatistics
+	{
+		__int64 Appended;
+		__int64 Dropped;
+		__int64 Frames;
+		__int64 FirstFrame;
+		TimeSpan LastTimestamp;
+	};
+
+	// Frames of an encoded frame ring, held in place until disposed. Frame numbers count
+	// from the first frame ever appended.
+	public ref class EncodedFrameSnapshot
+	{
+	public:
+		virtual ~EncodedFrameSnapshot(void)
+		{
+			this->!EncodedFrameSnapshot();
+		}
+
+		// A snapshot that is never disposed still gives its pin on the ring back
+		!EncodedFrameSnapshot(void)
+		{
+			delete m_impl;
+			m_impl = NULL;
+		}
+
+		property int Count
+		{
+			int get() { return m_impl->GetCount(); }
+		}
+
+		TimeSpan GetTimestamp(int index)
+		{
+			return TimeSpan(GetFrame(index).Timestamp);
+		}
+
+		__int64 GetFrameNumber(int index)
+		{
+			return GetFrame(index).Number;
+		}
+
+		// Copy of the encoded bytes of a frame
+		array<byte>^ GetData(int index)
+		{
+			EncodedFrame frame = GetFrame(index);
+			array<byte>^ data = gcnew array<byte>((int)frame.Size);
+			Marshal::Copy(IntPtr((void*)frame.Data), data, 0, (int)frame.Size);
+			return data;
+		}
+
+		// Index of the last frame at or before the timestamp, -1 when it precedes the first
+		int Find(TimeSpan timestamp)
+		{
+			return m_impl->Find(timestamp.Ticks);
+		}
+
+		// Writes the frames back to back without copying them, JPEG frames make a Motion
+		// JPEG stream. Returns the bytes written.
+		__int64 WriteTo(String^ path)
+		{
+			IntPtr pPath = Marshal::StringToHGlobalAnsi(path);
+			try
+			{
+				return (__int64)m_impl->WriteTo((const char*)pPath.ToPointer());
+			}
+			catch(const char* msg)
+			{
+				throw gcnew IOException(gcnew String(msg));
+			}
+			finally
+			{
+				Marshal::FreeHGlobal(pPath);
+			}
+		}
+
+	internal:
+		EncodedFrameSnapshot(CEncodedFrameSnapshot* impl)
+			: m_impl(impl)
+		{
+		}
+
+	private:
+		CEncodedFrameSnapshot* m_impl;
+
+		EncodedFrame GetFrame(int index)
+		{
+			if(index < 0 || index >= m_impl->GetCount())
+			{
+				throw gcnew ArgumentOutOfRangeException("index");
+			}
+
+			EncodedFrame frame;
+			m_impl->GetFrame(index, &frame);
+			return frame;
+		}
+	};
+
+	// Last seconds of an encoded stream in fixed memory for event triggered recording, see
+	// CEncodedFrameRing. Frames are appended by one thread, usually through
+	// JpegCompressor::Save; snapshots may be taken from any thread meanwhile.
+	public ref class EncodedFrameRing
+	{
+	public:
+		EncodedFrameRing(__int64 capacity, int maxFrames)
+		{
+			if(capacity <= 0 || (unsigned __int64)capacity > (size_t)-1)
+			{
+				throw gcnew ArgumentOutOfRangeException("capacity");
+			}
+			if(maxFrames <= 0)
+			{
+				throw gcnew ArgumentOutOfRangeException("maxFrames");
+			}
+
+			try
+			{
+				m_impl = new CEncodedFrameRing((size_t)capacity, maxFrames);
+			}
+			catch(const char* msg)
+			{
+				throw gcnew OutOfMemoryException(gcnew String(msg));
+			}
+		}
+
+		virtual ~EncodedFrameRing(void)
+		{
+			delete m_impl;
+			m_impl = NULL;
+		}
+
+		// Returns false when the frame was dropped, see CEncodedFrameRing::Append
+		bool Append(array<byte>^ data, int offset, int count, TimeSpan timestamp)
+		{
+			if(data == nullptr)
+			{
+				throw gcnew ArgumentNullException("data");
+			}
+			if(offset < 0 || count <= 0 || offset > data->Length - count)
+			{
+				throw gcnew ArgumentOutOfRangeException("count");
+			}
+
+			pin_ptr<byte> p = &data[offset];
+			return Append((const BYTE*)p, count, timestamp);
+		}
+
+		// Frames with timestamps in [from, to]
+		EncodedFrameSnapshot^ Snapshot(TimeSpan from, TimeSpan to)
+		{
+			try
+			{
+				return gcnew EncodedFrameSnapshot(m_impl->Snapshot(from.Ticks, to.Ticks));
+			}
+			catch(const char* msg)
+			{
+				throw gcnew InvalidOperationException(gcnew String(msg));
+			}
+		}
+
+		// Frames of the last duration before the newest one
+		EncodedFrameSnapshot^ Snapshot(TimeSpan duration)
+		{
+			EncodedRingStats stats;
+			m_impl->GetStats(&stats);
+			TimeSpan last(stats.LastTimestamp);
+			return Snapshot(last - duration, last);
+		}
+
+		property EncodedFrameRingStatistics Statistics
+		{
+			EncodedFrameRingStatistics get()
+			{
+				EncodedRingStats stats;
+				m_impl->GetStats(&stats);
+
+				EncodedFrameRingStatistics result;
+				result.Appended = stats.Appended;
+				result.Dropped = stats.Dropped;
+				result.Frames = stats.Frames;
+				result.FirstFrame = stats.FirstFrame;
+				result.LastTimestamp = TimeSpan(stats.LastTimestamp);
+				return result;
+			}
+		}
+
+	internal:
+		bool Append(const BYTE* data, size_t size, TimeSpan timestamp)
+		{
+			try
+			{
+				return m_impl->Append(data, size, timestamp.Ticks);
+			}
+			catch(const char* msg)
+			{
+				throw gcnew ArgumentException(gcnew String(msg), "timestamp");
+			}
+		}
+
+	private:
+		CEncodedFrameRing* m_impl;
+	};
+
 	public ref class JpegCompressor
 	{
 	public:
@@ -342,9 +621,82 @@ namespace Taygeta { namespace Compression
 			delete m_impl;
 		}
 
+		// RGB24, RGBA and ARGB images are converted to 4:2:0 while they are encoded
 		void Save(PlanarImage^ image, Stream^ stream, int quality)
 		{
-			ImageData iData;
+			std::vector<BYTE> buffer;
+			Encode(image, &buffer, quality);
+			int outputDataSize = buffer.size();
+			array<byte>^ buf = gcnew array<byte>(outputDataSize);
+			Marshal::Copy(IntPtr(&buffer[0]), buf, 0, outputDataSize);
+			stream->Write(buf, 0, outputDataSize);
+		}
+
+		// Encodes straight into the ring, returns false when the ring dropped the frame
+		bool Save(PlanarImage^ image, EncodedFrameRing^ ring, TimeSpan timestamp, int quality)
+		{
+			if(ring == nullptr)
+			{
+				throw gcnew ArgumentNullException("ring");
+			}
+
+			std::vector<BYTE> buffer;
+			Encode(image, &buffer, quality);
+			return ring->Append(&buffer[0], buffer.size(), timestamp);
+		}
+
+	private:
+		CLibjpegEncoderImpl* m_impl;
+
+		void Encode(PlanarImage^ image, std::vector<BYTE>* buffer, int quality)
+		{
+			try
+			{
+				RgbImageData rgbData;
+				if(GetRgbImageData(image, rgbData))
+				{
+					m_impl->Save(rgbData, buffer, quality);
+				}
+				else
+				{
+					ImageData iData;
+					GetImageData(image, iData);
+					m_impl->Save(iData, buffer, quality);
+				}
+			}
+			catch(const char* msg)
+			{
+				throw gcnew InvalidOperationException(gcnew String(msg));
+			}
+		}
+
+		static bool GetRgbImageData(PlanarImage^ image, RgbImageData& rgbData)
+		{
+			switch(image->PixelType)
+			{
+			case PixelAlignmentType::RGB24:
+				rgbData.Layout = RL_BGR24;
+				break;
+			case PixelAlignmentType::RGBA:
+				rgbData.Layout = RL_RGBA;
+				break;
+			case PixelAlignmentType::ARGB:
+				rgbData.Layout = RL_ARGB;
+				break;
+			default:
+				return false;
+			}
+
+			rgbData.Width = image->Width;
+			rgbData.Height = image->Height;
+			rgbData.Data = (const BYTE*)image->Planes[0].ToPointer();
+			rgbData.Pitch = image->Pitches[0];
+			rgbData.Subsampling = TJSAMP_420;
+			return true;
+		}
+
+		static void GetImageData(PlanarImage^ image, ImageData& iData)
+		{
 			iData.Width = image->Width;
 			iData.Height = image->Height;
 			for(int i=0; i< image->NumberOfPlanes; i++)
@@ -356,18 +708,8 @@ namespace Taygeta { namespace Compression
 
 			iData.Components = image->NumberOfPlanes;
 			iData.Subsampling = GetSubsampingType(image->PixelType);
-
-			std::vector<BYTE> buffer;
-			m_impl->Save(iData, &buffer, quality);
-			int outputDataSize = buffer.size();
-			array<byte>^ buf = gcnew array<byte>(outputDataSize);
-			Marshal::Copy(IntPtr(&buffer[0]), buf, 0, outputDataSize);
-			stream->Write(buf, 0, outputDataSize);
 		}
 
-	private:
-		CLibjpegEncoderImpl* m_impl;
-
 		static inline TJSAMP GetSubsampingType(PixelAlignmentType pType)
 		{
 			switch(pType)
@@ -385,5 +727,126 @@ namespace Taygeta { namespace Compression
 			}
 		}
 	};
+
+	public value struct BatchTranscodeProgress
+	{
+		__int64 Queued;
+		__int64 Completed;
+		__int64 Failed;
+		__int64 BytesRead;
+		__int64 BytesWritten;
+		__int64 Pixels;
+		double Seconds;
+	};
+
+	// Converts JPEG files to JPEG2000 on native worker pools, see CBatchTranscoder.
+	// Width and height of 0 keep the source size.
+	public ref class BatchTranscoder
+	{
+	public:
+		BatchTranscoder(double quality, bool bLossless, int width, int height)
+		{
+			if(quality < 0 || quality > 1)
+			{
+				throw gcnew ArgumentException("Quality must be in range of [0,1]");
+			}
+
+			TranscodeSettings settings;
+			settings.DecodeThreads = 0;
+			settings.ResizeThreads = 0;
+			settings.EncodeThreads = 0;
+			settings.QueueDepth = 0;
+			settings.Width = width;
+			settings.Height = height;
+			settings.Rate = quality;
+			settings.Lossless = bLossless;
+
+			try
+			{
+				m_impl = new CBatchTranscoder(settings);
+				m_impl->Start();
+			}
+			catch(const char* msg)
+			{
+				delete m_impl;
+				m_impl = NULL;
+				throw gcnew InvalidOperationException(gcnew String(msg));
+			}
+		}
+
+		virtual ~BatchTranscoder(void)
+		{
+			delete m_impl;
+		}
+
+		void Add(String^ input, String^ output)
+		{
+			IntPtr pInput = Marshal::StringToHGlobalAnsi(input);
+			IntPtr pOutput = Marshal::StringToHGlobalAnsi(output);
+			try
+			{
+				m_impl->Add((const char*)pInput.ToPointer(), (const char*)pOutput.ToPointer());
+			}
+			catch(const char* msg)
+			{
+				throw gcnew InvalidOperationException(gcnew String(msg));
+			}
+			finally
+			{
+				Marshal::FreeHGlobal(pInput);
+				Marshal::FreeHGlobal(pOutput);
+			}
+		}
+
+		// Waits for all added files to be written
+		void Complete()
+		{
+			m_impl->Complete();
+		}
+
+		void Cancel()
+		{
+			m_impl->Cancel();
+		}
+
+		property BatchTranscodeProgress Progress
+		{
+			BatchTranscodeProgress get()
+			{
+				TranscodeProgress progress;
+				m_impl->GetProgress(&progress);
+
+				BatchTranscodeProgress result;
+				result.Queued = progress.Queued;
+				result.Completed = progress.Completed;
+				result.Failed = progress.Failed;
+				result.BytesRead = progress.BytesRead;
+				result.BytesWritten = progress.BytesWritten;
+				result.Pixels = progress.Pixels;
+				result.Seconds = progress.Seconds;
+				return result;
+			}
+		}
+
+		// Input file and error message of every file that failed
+		property IList<KeyValuePair<String^, String^>>^ Failures
+		{
+			IList<KeyValuePair<String^, String^>>^ get()
+			{
+				std::vector<TranscodeFailure> failures;
+				m_impl->GetFailures(&failures);
+
+				List<KeyValuePair<String^, String^>>^ result = gcnew List<KeyValuePair<String^, String^>>();
+				for(size_t i = 0; i < failures.size(); i++)
+				{
+					result->Add(KeyValuePair<String^, String^>(gcnew String(failures[i].Input.c_str()), gcnew String(failures[i].Message.c_str())));
+				}
+				return result;
+			}
+		}
+
+	private:
+		CBatchTranscoder* m_impl;
+	};
 }}
 
@@ -1,10 +1,13 @@
-#include "StdAfx.h"
+#include "Stdafx.h"
 #include "LibjpegEncoderImpl.h"
 
+#include <string.h>
+
 
 CLibjpegEncoderImpl::CLibjpegEncoderImpl(void)
 {
-	cinfo.err = jpeg_std_error(&jerr);
+	cinfo.err = jpeg_std_error(&jerr.pub);
+	jerr.pub.error_exit = ErrorExit;
 	jpeg_create_compress(&cinfo); 
 }
 
@@ -14,8 +17,92 @@ CLibjpegEncoderImpl::~CLibjpegEncoderImpl(void)
 	jpeg_destroy_compress(&cinfo);
 }
 
+// Rows past the last line of a plane repeat it, so a partial last block never reads
+// outside the plane; with a bottom-up plane that memory lies before its top row
+static JSAMPROW GetRow(const ImageData& data, int plane, int line)
+{
+	line = line < data.Lines[plane] ? line : data.Lines[plane] - 1;
+	return data.Planes[plane] + (ptrdiff_t)line * data.Pitches[plane];
+}
+
+void CLibjpegEncoderImpl::ErrorExit(j_common_ptr cinfo)
+{
+	EncoderError* err = (EncoderError*)cinfo->err;
+	(*cinfo->err->format_message)(cinfo, err->message);
+	longjmp(err->jump, 1);
+}
+
 void CLibjpegEncoderImpl::Save(ImageData& imgData, vector<BYTE>* byteArray, int quality)
 {
+	jpeg_memory_dest(&cinfo, byteArray);
+	Compress(imgData, quality);
+}
+
+size_t CLibjpegEncoderImpl::Save(ImageData& imgData, BYTE* buffer, size_t capacity, int quality)
+{
+	size_t size = 0;
+	jpeg_buffer_dest(&cinfo, buffer, capacity, &size);
+	Compress(imgData, quality);
+	return size;
+}
+
+void CLibjpegEncoderImpl::Save(const RgbImageData& imgData, vector<BYTE>* byteArray, int quality)
+{
+	jpeg_memory_dest(&cinfo, byteArray);
+	CompressRgb(imgData, quality);
+}
+
+size_t CLibjpegEncoderImpl::Save(const RgbImageData& imgData, BYTE* buffer, size_t capacity, int quality)
+{
+	size_t size = 0;
+	jpeg_buffer_dest(&cinfo, buffer, capacity, &size);
+	CompressRgb(imgData, quality);
+	return size;
+}
+
+// Raw YCbCr input in blocks of 16 rows for 4:2:0 and of 8 otherwise
+void CLibjpegEncoderImpl::StartCompress(int width, int height, TJSAMP subsampling, int quality)
+{
+	bool gray = subsampling == TJSAMP_GRAY;
+	cinfo.image_width = width;
+	cinfo.image_height = height;
+	cinfo.input_components = gray ? 1 : 3;
+	cinfo.in_color_space = gray ? JCS_GRAYSCALE : JCS_YCbCr;
+	jpeg_set_defaults(&cinfo);
+
+	if(!gray)
+	{
+		int factor = subsampling == TJSAMP_420 ? 2 : 1;
+		cinfo.comp_info[0].h_samp_factor = factor;
+		cinfo.comp_info[0].v_samp_factor = factor;
+		cinfo.comp_info[1].h_samp_factor = 1;
+		cinfo.comp_info[1].v_samp_factor = 1;
+		cinfo.comp_info[2].h_samp_factor = 1;
+		cinfo.comp_info[2].v_samp_factor = 1;
+	}
+
+	cinfo.smoothing_factor = 0;
+	cinfo.raw_data_in = TRUE;
+	jpeg_set_quality(&cinfo, quality, TRUE);
+	cinfo.dct_method = JDCT_FASTEST;
+
+	jpeg_start_compress(&cinfo, TRUE);
+}
+
+void CLibjpegEncoderImpl::Compress(ImageData& imgData, int quality)
+{
+	if(imgData.Subsampling != TJSAMP_420 && imgData.Subsampling != TJSAMP_444 && imgData.Subsampling != TJSAMP_GRAY)
+	{
+		throw "Unsupported subsampling";
+	}
+
+	// Nothing below has a destructor to skip, the jump only leaves libjpeg calls
+	if(setjmp(jerr.jump))
+	{
+		jpeg_abort_compress(&cinfo);
+		throw (const char*)jerr.message;
+	}
+
 	JSAMPROW y[16],cb[16],cr[16]; // y[2][5] = color sample of row 2 and pixel column 5; (one plane) 
 	JSAMPARRAY data[3]; // t[0][2][5] = color sample 0 of row 2 and column 5  
 
@@ -23,106 +110,139 @@ void CLibjpegEncoderImpl::Save(ImageData& imgData, vector<BYTE>* byteArray, int
 	data[1] = cb; 
 	data[2] = cr; 
 
-	cinfo.image_width = imgData.Width; 
-	cinfo.image_height = imgData.Height; 
-	int blockSize;
-
-	switch(imgData.Subsampling)
-	{
-	case TJSAMP_420:
-		cinfo.input_components = 3; 
-		cinfo.in_color_space = JCS_YCbCr;
-		jpeg_set_defaults(&cinfo); 
-		blockSize = 2 * DCTSIZE;
-
-		cinfo.comp_info[0].h_samp_factor = 2; 
-		cinfo.comp_info[0].v_samp_factor = 2; 
-		cinfo.comp_info[1].h_samp_factor = 1; 
-		cinfo.comp_info[1].v_samp_factor = 1; 
-		cinfo.comp_info[2].h_samp_factor = 1; 
-		cinfo.comp_info[2].v_samp_factor = 1;
-
-		cinfo.smoothing_factor = 0;
-		cinfo.raw_data_in = TRUE; 
-		jpeg_set_quality(&cinfo, quality, TRUE); 
-		cinfo.dct_method = JDCT_FASTEST; 
-		
-		jpeg_memory_dest(&cinfo, byteArray);
-		jpeg_start_compress(&cinfo, TRUE); 
+	StartCompress(imgData.Width, imgData.Height, imgData.Subsampling, quality);
+	int blockSize = imgData.Subsampling == TJSAMP_420 ? 2 * DCTSIZE : DCTSIZE;
 
-		for (int j = 0; j < imgData.Height; j += blockSize) 
+	for (int j = 0; j < imgData.Height; j += blockSize) 
+	{ 
+		for (int i = 0; i < blockSize; i++)
 		{ 
-			for (int i = 0; i < blockSize; i++)
-			{ 
-				y[i] = imgData.Planes[0] + imgData.Pitches[0] * (i + j); 
+			y[i] = GetRow(imgData, 0, i + j); 
+			if (imgData.Subsampling == TJSAMP_420)
+			{
 				if (i % 2 == 0) 
 				{ 
-					cb[i / 2] = imgData.Planes[1] + imgData.Pitches[1] * (i + j) / 2; 
-					cr[i / 2] = imgData.Planes[2] + imgData.Pitches[2] * (i + j) / 2; 
+					cb[i / 2] = GetRow(imgData, 1, (i + j) / 2); 
+					cr[i / 2] = GetRow(imgData, 2, (i + j) / 2); 
 				} 
-			} 
-			jpeg_write_raw_data(&cinfo, data, blockSize); 
+			}
+			else if (imgData.Subsampling == TJSAMP_444)
+			{
+				cb[i] = GetRow(imgData, 1, i + j); 
+				cr[i] = GetRow(imgData, 2, i + j); 
+			}
 		} 
-		break;
-
-	case TJSAMP_444:
-		cinfo.input_components = 3; 
-		cinfo.in_color_space = JCS_YCbCr;
-		jpeg_set_defaults(&cinfo); 
-		blockSize = DCTSIZE;
-
-		cinfo.comp_info[0].h_samp_factor = 1; 
-		cinfo.comp_info[0].v_samp_factor = 1; 
-		cinfo.comp_info[1].h_samp_factor = 1; 
-		cinfo.comp_info[1].v_samp_factor = 1; 
-		cinfo.comp_info[2].h_samp_factor = 1; 
-		cinfo.comp_info[2].v_samp_factor = 1;
+		jpeg_write_raw_data(&cinfo, data, blockSize); 
+	} 
 
-		blockSize = DCTSIZE;
-		cinfo.smoothing_factor = 0;
-		cinfo.raw_data_in = TRUE; 
-		jpeg_set_quality(&cinfo, quality, TRUE); 
-		cinfo.dct_method = JDCT_FASTEST; 
+	jpeg_finish_compress(&cinfo); 
+}
 
-		jpeg_memory_dest(&cinfo, byteArray);
-		jpeg_start_compress(&cinfo, TRUE); 
+static inline const BYTE* GetRgbRow(const RgbImageData& data, int line)
+{
+	return data.Data + (ptrdiff_t)line * data.Pitch;
+}
 
-		for (int j = 0; j < imgData.Height; j += blockSize) 
-		{ 
-			for (int i = 0; i < blockSize; i++)
-			{ 
-				y[i] = imgData.Planes[0] + imgData.Pitches[0] * (i + j); 
-				cb[i] = imgData.Planes[1] + imgData.Pitches[1] * (i + j); 
-				cr[i] = imgData.Planes[2] + imgData.Pitches[2] * (i + j); 
-			} 
-			jpeg_write_raw_data(&cinfo, data, blockSize); 
-		} 
-		break;
+// libjpeg reads whole blocks, samples past the image repeat its last column
+static inline void PadRow(BYTE* row, int width, int stride)
+{
+	memset(row + width, row[width - 1], stride - width);
+}
 
-	case TJSAMP_GRAY:
-		cinfo.input_components = 1; 
-		cinfo.in_color_space = JCS_GRAYSCALE;
-		jpeg_set_defaults(&cinfo); 
-		blockSize = DCTSIZE;
+// Converts an MCU row at a time into m_rgbRows, gray images drop the chroma
+void CLibjpegEncoderImpl::CompressRgb(const RgbImageData& imgData, int quality)
+{
+	if(imgData.Subsampling != TJSAMP_420 && imgData.Subsampling != TJSAMP_444 && imgData.Subsampling != TJSAMP_GRAY)
+	{
+		throw "Unsupported subsampling";
+	}
+	if(imgData.Layout < 0 || imgData.Layout >= RL_COUNT)
+	{
+		throw "Unsupported RGB layout";
+	}
+	if(imgData.Width <= 0 || imgData.Height <= 0)
+	{
+		throw "Empty image";
+	}
 
-		cinfo.smoothing_factor = 0;
-		cinfo.raw_data_in = TRUE; 
-		jpeg_set_quality(&cinfo, quality, TRUE); 
-		cinfo.dct_method = JDCT_FASTEST; 
+	bool subsampled = imgData.Subsampling == TJSAMP_420;
+	int blockSize = subsampled ? 2 * DCTSIZE : DCTSIZE;
+	int step = subsampled ? 2 : 1;
+	int chromaWidth = subsampled ? (imgData.Width + 1) / 2 : imgData.Width;
+	int lumaStride = (imgData.Width + blockSize - 1) / blockSize * blockSize;
+	int chromaStride = subsampled ? lumaStride / 2 : lumaStride;
+	m_rgbRows.resize((size_t)lumaStride * blockSize + (size_t)chromaStride * DCTSIZE * 2);
+
+	BYTE* luma = &m_rgbRows[0];
+	BYTE* u = luma + (size_t)lumaStride * blockSize;
+	BYTE* v = u + (size_t)chromaStride * DCTSIZE;
+
+	const RgbRowKernels* kernels = GetRgbRowKernels();
+	RgbToYuvRowFunc row = kernels->RgbToYuv[imgData.Layout];
+	RgbToYuv420RowFunc row420 = kernels->RgbToYuv420[imgData.Layout];
+	RgbToYuvCoefs coefs;
+	GetRgbToYuvCoefs(YM_BT601, YR_FULL, &coefs);
+
+	// Nothing below has a destructor to skip, the jump only leaves libjpeg calls
+	if(setjmp(jerr.jump))
+	{
+		jpeg_abort_compress(&cinfo);
+		throw (const char*)jerr.message;
+	}
 
-		jpeg_memory_dest(&cinfo, byteArray);
-		jpeg_start_compress(&cinfo, TRUE); 
+	JSAMPROW y[16], cb[16], cr[16];
+	JSAMPARRAY data[3];
 
-		for (int j = 0; j < imgData.Height; j += blockSize) 
-		{ 
-			for (int i = 0; i < blockSize; i++)
-			{ 
-				y[i] = imgData.Planes[0] + imgData.Pitches[0] * (i + j); 
-			} 
-			jpeg_write_raw_data(&cinfo, data, blockSize); 
-		} 
-		break;
+	data[0] = y;
+	data[1] = cb;
+	data[2] = cr;
+
+	StartCompress(imgData.Width, imgData.Height, imgData.Subsampling, quality);
+
+	for(int j = 0; j < imgData.Height; j += blockSize)
+	{
+		for(int i = 0; i < blockSize; i += step)
+		{
+			int c = i / step;
+
+			// Rows past the image repeat its last one
+			if(j + i >= imgData.Height)
+			{
+				for(int k = i; k < i + step; k++)
+				{
+					y[k] = y[i - 1];
+				}
+				cb[c] = cb[c - 1];
+				cr[c] = cr[c - 1];
+				continue;
+			}
+
+			cb[c] = u + (size_t)c * chromaStride;
+			cr[c] = v + (size_t)c * chromaStride;
+			for(int k = i; k < i + step; k++)
+			{
+				y[k] = luma + (size_t)k * lumaStride;
+			}
+
+			if(subsampled)
+			{
+				int next = j + i + 1 < imgData.Height ? j + i + 1 : j + i;
+				row420(GetRgbRow(imgData, j + i), GetRgbRow(imgData, next), y[i], y[i + 1], cb[c], cr[c], imgData.Width, &coefs);
+			}
+			else
+			{
+				row(GetRgbRow(imgData, j + i), y[i], cb[c], cr[c], imgData.Width, &coefs);
+			}
+
+			for(int k = i; k < i + step; k++)
+			{
+				PadRow(y[k], imgData.Width, lumaStride);
+			}
+			PadRow(cb[c], chromaWidth, chromaStride);
+			PadRow(cr[c], chromaWidth, chromaStride);
+		}
+		jpeg_write_raw_data(&cinfo, data, blockSize);
 	}
 
-	jpeg_finish_compress(&cinfo); 
+	jpeg_finish_compress(&cinfo);
 }
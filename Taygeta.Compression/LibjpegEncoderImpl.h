@@ -5,13 +5,27 @@
 #include <math.h>
 #include <float.h>
 #include <assert.h>
+#include <setjmp.h>
 #include "ImageData.h"
 #include "jpeglib.h"
 #include "jpeg_memory_dest.h"
+#include "RgbKernels.h"
 #include <vector>
 
 using namespace std;
 
+// Packed RGB rows at Data + y * Pitch, a negative pitch for bottom-up images. They are
+// converted to JFIF YCbCr (BT.601, full range) one MCU row at a time while encoding.
+struct RgbImageData
+{
+	int Width;
+	int Height;
+	const BYTE* Data;
+	int Pitch;
+	RgbLayout Layout;
+	TJSAMP Subsampling;		// 4:2:0, 4:4:4 or gray
+};
+
 class CLibjpegEncoderImpl
 {
 public:
@@ -19,8 +33,30 @@ public:
 	virtual ~CLibjpegEncoderImpl(void);
 	void Save(ImageData& imgData, vector<BYTE>* byteArray , int quality);
 
+	// Encodes into a caller buffer and returns the size of the image. A size above
+	// capacity means the buffer was too small and holds only the start of it.
+	size_t Save(ImageData& imgData, BYTE* buffer, size_t capacity, int quality);
+
+	void Save(const RgbImageData& imgData, vector<BYTE>* byteArray, int quality);
+	size_t Save(const RgbImageData& imgData, BYTE* buffer, size_t capacity, int quality);
+
 private:
+	// libjpeg reports errors by calling error_exit, which must not return. It jumps
+	// back into Compress, which throws the message once out of the library.
+	struct EncoderError
+	{
+		jpeg_error_mgr pub;
+		jmp_buf jump;
+		char message[JMSG_LENGTH_MAX];
+	};
+
 	jpeg_compress_struct cinfo;
-	jpeg_error_mgr jerr;
+	EncoderError jerr;
+	vector<BYTE> m_rgbRows;		// YCbCr of one MCU row of an RGB source
+
+	void Compress(ImageData& imgData, int quality);
+	void CompressRgb(const RgbImageData& imgData, int quality);
+	void StartCompress(int width, int height, TJSAMP subsampling, int quality);
+	static void ErrorExit(j_common_ptr cinfo);
 };
 
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vcclr.h>
+#include "JasperSinkStream.h"
+
+using namespace System;
+using namespace System::IO;
+using namespace System::Runtime::InteropServices;
+
+// Forwards sink data to a managed stream through one reusable transfer buffer.
+// Exceptions thrown by the stream are kept until the native encoder has unwound.
+class CManagedStreamSink : public IJasperSink
+{
+public:
+	CManagedStreamSink(Stream^ stream)
+	{
+		m_stream = stream;
+		m_chunk = gcnew array<byte>(ChunkSize);
+	}
+
+	virtual bool Write(const BYTE* data, int size)
+	{
+		try
+		{
+			while(size > 0)
+			{
+				int count = size < ChunkSize ? size : ChunkSize;
+				Marshal::Copy(IntPtr((void*)data), m_chunk, 0, count);
+				m_stream->Write(m_chunk, 0, count);
+				data += count;
+				size -= count;
+			}
+		}
+		catch(Exception^ ex)
+		{
+			m_error = ex;
+			return false;
+		}
+		return true;
+	}
+
+	void ThrowIfFailed()
+	{
+		Exception^ ex = m_error;
+		if(ex != nullptr)
+		{
+			throw gcnew IOException("Failed to write encoded data", ex);
+		}
+	}
+
+private:
+	static const int ChunkSize = 64 * 1024;
+
+	gcroot<Stream^> m_stream;
+	gcroot<array<byte>^> m_chunk;
+	gcroot<Exception^> m_error;
+};
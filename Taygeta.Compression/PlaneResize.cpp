@@ -0,0 +1,91 @@
+#include "PlaneResize.h"
+
+#include <stddef.h>
+#include <vector>
+
+#define RESIZE_FRACTION_BITS 8
+#define RESIZE_ONE (1 << RESIZE_FRACTION_BITS)
+
+// Maps target pixel centers to source coordinates, split into an index and an
+// 8-bit blend weight towards the next sample
+static void GetTaps(int srcSize, int dstSize, std::vector<int>& index, std::vector<int>& weight)
+{
+	index.resize(dstSize);
+	weight.resize(dstSize);
+
+	long long step = ((long long)srcSize << 16) / dstSize;
+	long long pos = step / 2 - (1 << 15);
+	for(int i = 0; i < dstSize; i++, pos += step)
+	{
+		if(pos <= 0)
+		{
+			index[i] = 0;
+			weight[i] = 0;
+		}
+		else if((pos >> 16) >= srcSize - 1)
+		{
+			index[i] = srcSize > 1 ? srcSize - 2 : 0;
+			weight[i] = srcSize > 1 ? RESIZE_ONE : 0;
+		}
+		else
+		{
+			index[i] = (int)(pos >> 16);
+			weight[i] = (int)((pos & 0xFFFF) >> (16 - RESIZE_FRACTION_BITS));
+		}
+	}
+}
+
+void ResizePlane(const BYTE* src, int srcWidth, int srcHeight, int srcPitch,
+				 BYTE* dst, int dstWidth, int dstHeight, int dstPitch)
+{
+	if(srcWidth <= 0 || srcHeight <= 0 || dstWidth <= 0 || dstHeight <= 0)
+	{
+		throw "Invalid plane size";
+	}
+
+	std::vector<int> xIndex, xWeight, yIndex, yWeight;
+	GetTaps(srcWidth, dstWidth, xIndex, xWeight);
+	GetTaps(srcHeight, dstHeight, yIndex, yWeight);
+
+	// Horizontally filtered rows, kept at 8 bits of extra precision
+	std::vector<int> row0(dstWidth), row1(dstWidth);
+	int cachedRow = -2;
+	int xNext = srcWidth > 1 ? 1 : 0;
+	int yNext = srcHeight > 1 ? 1 : 0;
+
+	for(int y = 0; y < dstHeight; y++)
+	{
+		int sy = yIndex[y];
+		if(sy != cachedRow)
+		{
+			const BYTE* s0 = src + (ptrdiff_t)sy * srcPitch;
+			const BYTE* s1 = src + (ptrdiff_t)(sy + yNext) * srcPitch;
+			bool reuse = sy == cachedRow + 1;
+			if(reuse)
+			{
+				row0.swap(row1);
+			}
+
+			for(int x = 0; x < dstWidth; x++)
+			{
+				const BYTE* p1 = s1 + xIndex[x];
+				int w = xWeight[x];
+				row1[x] = (p1[0] << RESIZE_FRACTION_BITS) + (p1[xNext] - p1[0]) * w;
+				if(!reuse)
+				{
+					const BYTE* p0 = s0 + xIndex[x];
+					row0[x] = (p0[0] << RESIZE_FRACTION_BITS) + (p0[xNext] - p0[0]) * w;
+				}
+			}
+			cachedRow = sy;
+		}
+
+		int w = yWeight[y];
+		BYTE* d = dst + (ptrdiff_t)y * dstPitch;
+		for(int x = 0; x < dstWidth; x++)
+		{
+			int v = (row0[x] << RESIZE_FRACTION_BITS) + (row1[x] - row0[x]) * w;
+			d[x] = (BYTE)((v + (1 << (2 * RESIZE_FRACTION_BITS - 1))) >> (2 * RESIZE_FRACTION_BITS));
+		}
+	}
+}
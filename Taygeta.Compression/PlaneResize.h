@@ -0,0 +1,9 @@
+#pragma once
+
+#include "CompressionLib.h"
+
+// Bilinear resize of a single 8-bit plane, used where swscale is not available
+// (the native batch transcoder). Source and target must not overlap; either pitch may
+// be negative for a bottom-up plane.
+void ResizePlane(const BYTE* src, int srcWidth, int srcHeight, int srcPitch,
+				 BYTE* dst, int dstWidth, int dstHeight, int dstPitch);
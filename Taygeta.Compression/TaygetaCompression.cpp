@@ -0,0 +1,596 @@
+#include "TaygetaCompression.h"
+#include "JasperImpl.h"
+#include "Jpeg2000Layers.h"
+#include "LibjpegEncoderImpl.h"
+#include "BatchTranscoder.h"
+
+#include <new>
+#include <limits.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+struct TcJpegEncoder
+{
+	CLibjpegEncoderImpl Impl;
+};
+
+struct TcJpegDecoder
+{
+	CTurboJpegDecoderImpl Impl;
+};
+
+struct TcJp2Codec
+{
+	CJasperImpl Impl;
+};
+
+struct TcTranscoder
+{
+	TcTranscoder(const TranscodeSettings& settings) : Impl(settings)
+	{
+	}
+
+	CBatchTranscoder Impl;
+	std::vector<TranscodeFailure> Failures;
+};
+
+// libjpeg and TurboJPEG format their messages into buffers of their own, so the
+// message is copied
+static THREAD_LOCAL char s_lastError[JMSG_LENGTH_MAX];
+
+static void SetError(const char* message)
+{
+	strncpy(s_lastError, message, sizeof(s_lastError) - 1);
+	s_lastError[sizeof(s_lastError) - 1] = 0;
+}
+
+static void ToImageData(const TcImage* image, ImageData& data)
+{
+	data.Width = image->Width;
+	data.Height = image->Height;
+	data.Subsampling = (TJSAMP)image->Subsampling;
+	data.Components = image->Components;
+	data.Precision = image->Precision;
+	for(int i = 0; i < 4; i++)
+	{
+		data.Planes[i] = image->Planes[i];
+		data.Pitches[i] = image->Pitches[i];
+		data.Lines[i] = image->Lines[i];
+	}
+}
+
+static void GetInfo(const ImageData& data, TcImage* info)
+{
+	memset(info, 0, sizeof(TcImage));
+	info->Width = data.Width;
+	info->Height = data.Height;
+	info->Subsampling = data.Subsampling;
+	info->Components = data.Components;
+	info->Precision = data.Precision;
+}
+
+// The codecs take int sizes
+static int GetInputSize(size_t size)
+{
+	if(size > INT_MAX)
+	{
+		throw "Input is too large";
+	}
+	return (int)size;
+}
+
+static int GetOutputResult(size_t needed, size_t capacity, size_t* size)
+{
+	*size = needed;
+	return needed > capacity ? 1 : 0;
+}
+
+const char* COMPRESSIONCALL tc_get_last_error(void)
+{
+	return s_lastError;
+}
+
+TcJpegEncoder* COMPRESSIONCALL tc_jpeg_encoder_create(void)
+{
+	try
+	{
+		return new TcJpegEncoder();
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	catch(...)
+	{
+		SetError("Unexpected error");
+	}
+	return NULL;
+}
+
+void COMPRESSIONCALL tc_jpeg_encoder_destroy(TcJpegEncoder* encoder)
+{
+	delete encoder;
+}
+
+size_t COMPRESSIONCALL tc_jpeg_max_size(int width, int height, int subsampling)
+{
+	unsigned long size = tjBufSize(width, height, subsampling);
+	return size == (unsigned long)-1 ? 0 : size;
+}
+
+int COMPRESSIONCALL tc_jpeg_encode(TcJpegEncoder* encoder, const TcImage* image, int quality,
+	void* output, size_t capacity, size_t* size)
+{
+	try
+	{
+		ImageData data;
+		ToImageData(image, data);
+		return GetOutputResult(encoder->Impl.Save(data, (BYTE*)output, capacity, quality), capacity, size);
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	catch(...)
+	{
+		SetError("Unexpected error");
+	}
+	return -1;
+}
+
+int COMPRESSIONCALL tc_jpeg_encode_rgb(TcJpegEncoder* encoder, const void* rgb, int pitch, int layout,
+	int width, int height, int subsampling, int quality, void* output, size_t capacity, size_t* size)
+{
+	try
+	{
+		if(layout < 0 || layout >= RL_COUNT)
+		{
+			throw "Unsupported RGB layout";
+		}
+
+		RgbImageData data;
+		data.Width = width;
+		data.Height = height;
+		data.Data = (const BYTE*)rgb;
+		data.Pitch = pitch;
+		data.Layout = (RgbLayout)layout;
+		data.Subsampling = (TJSAMP)subsampling;
+		return GetOutputResult(encoder->Impl.Save(data, (BYTE*)output, capacity, quality), capacity, size);
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	catch(...)
+	{
+		SetError("Unexpected error");
+	}
+	return -1;
+}
+
+TcJpegDecoder* COMPRESSIONCALL tc_jpeg_decoder_create(void)
+{
+	try
+	{
+		return new TcJpegDecoder();
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	catch(...)
+	{
+		SetError("Unexpected error");
+	}
+	return NULL;
+}
+
+void COMPRESSIONCALL tc_jpeg_decoder_destroy(TcJpegDecoder* decoder)
+{
+	delete decoder;
+}
+
+int COMPRESSIONCALL tc_jpeg_read_header(TcJpegDecoder* decoder, const void* data, size_t size, TcImage* info)
+{
+	try
+	{
+		ImageData header;
+		decoder->Impl.ReadHeader((BYTE*)data, GetInputSize(size), header);
+		GetInfo(header, info);
+		return 0;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	catch(...)
+	{
+		SetError("Unexpected error");
+	}
+	return -1;
+}
+
+int COMPRESSIONCALL tc_jpeg_decode(TcJpegDecoder* decoder, const void* data, size_t size, TcImage* target)
+{
+	ImageData decoded;
+	decoded.Planes[0] = NULL;
+	try
+	{
+		decoder->Impl.Load((BYTE*)data, GetInputSize(size), decoded);
+
+		ImageData planes;
+		ToImageData(target, planes);
+		CTurboJpegDecoderImpl::CopyPlanes(decoded, planes);
+		tjFree(decoded.Planes[0]);
+		return 0;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	catch(...)
+	{
+		SetError("Unexpected error");
+	}
+	tjFree(decoded.Planes[0]);
+	return -1;
+}
+
+TcJp2Codec* COMPRESSIONCALL tc_jp2_create(void)
+{
+	try
+	{
+		return new TcJp2Codec();
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	catch(...)
+	{
+		SetError("Unexpected error");
+	}
+	return NULL;
+}
+
+void COMPRESSIONCALL tc_jp2_destroy(TcJp2Codec* codec)
+{
+	delete codec;
+}
+
+int COMPRESSIONCALL tc_jp2_find_precision(const TcImage* image)
+{
+	try
+	{
+		ImageData data;
+		ToImageData(image, data);
+		return CJasperImpl::FindPrecision(data);
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(...)
+	{
+		SetError("Unexpected error");
+	}
+	return -1;
+}
+
+int COMPRESSIONCALL tc_jp2_encode(TcJp2Codec* codec, const TcImage* image, const char* options,
+	void* output, size_t capacity, size_t* size)
+{
+	try
+	{
+		ImageData data;
+		ToImageData(image, data);
+		CMemorySink sink((BYTE*)output, capacity);
+		codec->Impl.Save(data, &sink, options);
+		return GetOutputResult(sink.GetSize(), capacity, size);
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	catch(...)
+	{
+		SetError("Unexpected error");
+	}
+	return -1;
+}
+
+int COMPRESSIONCALL tc_jp2_encode_fd(TcJp2Codec* codec, const TcImage* image, const char* options, int fd)
+{
+	try
+	{
+		ImageData data;
+		ToImageData(image, data);
+		CFileDescriptorSink sink(fd);
+		codec->Impl.Save(data, &sink, options);
+		return 0;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	catch(...)
+	{
+		SetError("Unexpected error");
+	}
+	return -1;
+}
+
+int COMPRESSIONCALL tc_jp2_read_header(TcJp2Codec* codec, const void* data, size_t size, TcImage* info)
+{
+	try
+	{
+		ImageData header;
+		codec->Impl.Decode((BYTE*)data, GetInputSize(size), header);
+		GetInfo(header, info);
+		return 0;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	catch(...)
+	{
+		SetError("Unexpected error");
+	}
+	return -1;
+}
+
+int COMPRESSIONCALL tc_jp2_read_planes(TcJp2Codec* codec, TcImage* target)
+{
+	try
+	{
+		ImageData planes;
+		ToImageData(target, planes);
+		codec->Impl.ReadPlanes(planes);
+		return 0;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	catch(...)
+	{
+		SetError("Unexpected error");
+	}
+	return -1;
+}
+
+int COMPRESSIONCALL tc_jp2_get_layer_count(const void* data, size_t size)
+{
+	try
+	{
+		CJpeg2000LayerExtractor extractor((const BYTE*)data, GetInputSize(size));
+		return extractor.GetLayerCount();
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	catch(...)
+	{
+		SetError("Unexpected error");
+	}
+	return -1;
+}
+
+int COMPRESSIONCALL tc_jp2_extract_layers(const void* data, size_t size, int layers,
+	void* output, size_t capacity, size_t* outputSize)
+{
+	try
+	{
+		CJpeg2000LayerExtractor extractor((const BYTE*)data, GetInputSize(size));
+		if(layers < 1 || layers > extractor.GetLayerCount())
+		{
+			throw "Layer count out of range";
+		}
+
+		size_t needed = (size_t)extractor.GetExtractedSize(layers);
+		if(needed > capacity)
+		{
+			return GetOutputResult(needed, capacity, outputSize);
+		}
+
+		std::vector<BYTE> extracted;
+		extractor.Extract(layers, &extracted);
+		memcpy(output, &extracted[0], extracted.size());
+		return GetOutputResult(extracted.size(), capacity, outputSize);
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	catch(...)
+	{
+		SetError("Unexpected error");
+	}
+	return -1;
+}
+
+TcTranscoder* COMPRESSIONCALL tc_transcoder_create(const TcTranscodeSettings* settings)
+{
+	TcTranscoder* transcoder = NULL;
+	try
+	{
+		TranscodeSettings native;
+		native.DecodeThreads = settings->DecodeThreads;
+		native.ResizeThreads = settings->ResizeThreads;
+		native.EncodeThreads = settings->EncodeThreads;
+		native.QueueDepth = settings->QueueDepth;
+		native.Width = settings->Width;
+		native.Height = settings->Height;
+		native.Rate = settings->Rate;
+		native.Lossless = settings->Lossless != 0;
+
+		transcoder = new TcTranscoder(native);
+		transcoder->Impl.Start();
+		return transcoder;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	catch(...)
+	{
+		SetError("Unexpected error");
+	}
+
+	delete transcoder;
+	return NULL;
+}
+
+void COMPRESSIONCALL tc_transcoder_destroy(TcTranscoder* transcoder)
+{
+	delete transcoder;
+}
+
+int COMPRESSIONCALL tc_transcoder_add(TcTranscoder* transcoder, const char* input, const char* output)
+{
+	try
+	{
+		transcoder->Impl.Add(input, output);
+		return 0;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	catch(...)
+	{
+		SetError("Unexpected error");
+	}
+	return -1;
+}
+
+void COMPRESSIONCALL tc_transcoder_complete(TcTranscoder* transcoder)
+{
+	try
+	{
+		transcoder->Impl.Complete();
+	}
+	catch(...)
+	{
+		SetError("Unexpected error");
+	}
+}
+
+void COMPRESSIONCALL tc_transcoder_cancel(TcTranscoder* transcoder)
+{
+	try
+	{
+		transcoder->Impl.Cancel();
+	}
+	catch(...)
+	{
+		SetError("Unexpected error");
+	}
+}
+
+void COMPRESSIONCALL tc_transcoder_get_progress(TcTranscoder* transcoder, TcTranscodeProgress* progress)
+{
+	TranscodeProgress native;
+	try
+	{
+		transcoder->Impl.GetProgress(&native);
+	}
+	catch(...)
+	{
+		SetError("Unexpected error");
+		memset(progress, 0, sizeof(TcTranscodeProgress));
+		return;
+	}
+	progress->Queued = native.Queued;
+	progress->Completed = native.Completed;
+	progress->Failed = native.Failed;
+	progress->BytesRead = native.BytesRead;
+	progress->BytesWritten = native.BytesWritten;
+	progress->Pixels = native.Pixels;
+	progress->Seconds = native.Seconds;
+}
+
+int COMPRESSIONCALL tc_transcoder_get_failure_count(TcTranscoder* transcoder)
+{
+	try
+	{
+		transcoder->Impl.GetFailures(&transcoder->Failures);
+		return (int)transcoder->Failures.size();
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	catch(...)
+	{
+		SetError("Unexpected error");
+	}
+	return -1;
+}
+
+int COMPRESSIONCALL tc_transcoder_get_failure(TcTranscoder* transcoder, int index, const char** input, const char** message)
+{
+	if(index < 0 || (size_t)index >= transcoder->Failures.size())
+	{
+		return 1;
+	}
+
+	*input = transcoder->Failures[index].Input.c_str();
+	*message = transcoder->Failures[index].Message.c_str();
+	return 0;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <stddef.h>
+#include "CompressionLib.h"
+
+// Flat C entry points over the codec core (libjpeg encoder, TurboJPEG decoder, jasper),
+// usable without the C++/CLI classes and built on Linux by the Makefile. Contexts are
+// explicit and not thread safe, use one per thread. Output goes to caller buffers.
+// Functions never throw: they return 0 on success and -1 on failure, with the message
+// in tc_get_last_error; encoders return 1 when the output buffer is too small, setting
+// *size to the size needed.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Same values as TJSAMP
+enum TcSubsampling
+{
+	TC_SAMP_444 = 0,
+	TC_SAMP_422 = 1,
+	TC_SAMP_420 = 2,
+	TC_SAMP_GRAY = 3
+};
+
+// Planes of an image, row y of plane i starts at Planes[i] + y * Pitches[i]. A negative
+// pitch describes a bottom-up plane.
+struct TcImage
+{
+	int Width;
+	int Height;
+	int Subsampling;		// TcSubsampling
+	int Components;			// 1 for gray or 4:2:2 packed as YUY2, 3 for planar YCbCr
+	int Precision;			// bits per sample, planes hold 16-bit samples above 8
+	BYTE* Planes[4];
+	int Pitches[4];
+	int Lines[4];
+};
+
+typedef struct TcJpegEncoder TcJpegEncoder;
+typedef struct TcJpegDecoder TcJpegDecoder;
+typedef struct TcJp2Codec TcJp2Codec;
+
+// Message of the last failed call on this thread
+COMPRESSIONLIB const char* COMPRESSIONCALL tc_get_last_error(void);
+
+// JPEG from planar 4:4:4, 4:2:0 or gray images with 8-bit samples. max_size is an upper
+// bound of the encoded size, 0 for invalid arguments.
+COMPRESSIONLIB TcJpegEncoder* COMPRESSIONCALL tc_jpeg_encoder_create(void);
+COMPRESSIONLIB void COMPRESSIONCALL tc_jpeg_encoder_destroy(TcJpegEncoder* encoder);
+COMPRESSIONLIB size_t COMPRESSIONCALL tc_jpeg_max_size(int width, int height, int subsampling);
+COMPRESSIONLIB int COMPRESSIONCALL tc_jpeg_encode(TcJpegEncoder* encoder, const struct TcImage* image, int quality,
+	void* output, size_t capacity, size_t* size);
+
+// JPEG from packed RGB rows at rgb + y * pitch, a negative pitch for bottom-up images.
+// layout is the RgbLayout of Taygeta.Native (0 BGR24, 1 BGRA, 2 RGBA, 3 ARGB). Rows are
+// converted to YCbCr as they are encoded, subsampling is 4:4:4, 4:2:0 or gray.
+COMPRESSIONLIB int COMPRESSIONCALL tc_jpeg_encode_rgb(TcJpegEncoder* encoder, const void* rgb, int pitch, int layout,
+	int width, int height, int subsampling, int quality, void* output, size_t capacity, size_t* size);
+
+// read_header fills in size and layout only. decode writes into the caller's planes,
+// clipping to the smaller of both layouts; a 4:2:2 image decodes into one YUY2 plane
+// when target->Components is 1.
+COMPRESSIONLIB TcJpegDecoder* COMPRESSIONCALL tc_jpeg_decoder_create(void);
+COMPRESSIONLIB void COMPRESSIONCALL tc_jpeg_decoder_destroy(TcJpegDecoder* decoder);
+COMPRESSIONLIB int COMPRESSIONCALL tc_jpeg_read_header(TcJpegDecoder* decoder, const void* data, size_t size, struct TcImage* info);
+COMPRESSIONLIB int COMPRESSIONCALL tc_jpeg_decode(TcJpegDecoder* decoder, const void* data, size_t size, struct TcImage* target);
+
+// JPEG-2000 (JP2). options go to the jasper encoder as they are, such as
+// "rate=0.100 mode=real". find_precision gives the precision 16-bit planes need, -1 for
+// images it cannot scan.
+COMPRESSIONLIB TcJp2Codec* COMPRESSIONCALL tc_jp2_create(void);
+COMPRESSIONLIB void COMPRESSIONCALL tc_jp2_destroy(TcJp2Codec* codec);
+COMPRESSIONLIB int COMPRESSIONCALL tc_jp2_find_precision(const struct TcImage* image);
+COMPRESSIONLIB int COMPRESSIONCALL tc_jp2_encode(TcJp2Codec* codec, const struct TcImage* image, const char* options,
+	void* output, size_t capacity, size_t* size);
+COMPRESSIONLIB int COMPRESSIONCALL tc_jp2_encode_fd(TcJp2Codec* codec, const struct TcImage* image, const char* options, int fd);
+
+// read_header decodes the codestream and fills in size and layout; read_planes then
+// narrows the samples into the caller's planes, 16-bit ones when target->Precision is
+// above 8. A 4:2:2 image goes into one YUY2 plane when target->Components is 1.
+COMPRESSIONLIB int COMPRESSIONCALL tc_jp2_read_header(TcJp2Codec* codec, const void* data, size_t size, struct TcImage* info);
+COMPRESSIONLIB int COMPRESSIONCALL tc_jp2_read_planes(TcJp2Codec* codec, struct TcImage* target);
+
+// Quality layers of a codestream written with layer rates, see CJpeg2000LayerExtractor.
+// get_layer_count returns -1 on failure.
+COMPRESSIONLIB int COMPRESSIONCALL tc_jp2_get_layer_count(const void* data, size_t size);
+COMPRESSIONLIB int COMPRESSIONCALL tc_jp2_extract_layers(const void* data, size_t size, int layers,
+	void* output, size_t capacity, size_t* outputSize);
+
+// Batch conversion of JPEG files to JP2 on worker pools, see CBatchTranscoder. create
+// starts the workers and returns NULL on failure; destroy cancels what is still queued.
+// add blocks while the queue is full, complete waits for every added file to be written
+// and cancel drops the files not started yet. get_failure_count takes a snapshot of the
+// failed files and returns their number; get_failure points into it until the next
+// snapshot and returns 1 for an index out of range.
+struct TcTranscodeSettings
+{
+	int DecodeThreads;		// 0 for one per core, for each stage
+	int ResizeThreads;
+	int EncodeThreads;
+	int QueueDepth;			// images allowed to wait between two stages, 0 for 4
+	int Width;				// 0 keeps the source size
+	int Height;
+	double Rate;			// in range of [0,1]
+	int Lossless;
+};
+
+struct TcTranscodeProgress
+{
+	long long Queued;
+	long long Completed;
+	long long Failed;
+	long long BytesRead;
+	long long BytesWritten;
+	long long Pixels;
+	double Seconds;
+};
+
+typedef struct TcTranscoder TcTranscoder;
+
+COMPRESSIONLIB TcTranscoder* COMPRESSIONCALL tc_transcoder_create(const struct TcTranscodeSettings* settings);
+COMPRESSIONLIB void COMPRESSIONCALL tc_transcoder_destroy(TcTranscoder* transcoder);
+COMPRESSIONLIB int COMPRESSIONCALL tc_transcoder_add(TcTranscoder* transcoder, const char* input, const char* output);
+COMPRESSIONLIB void COMPRESSIONCALL tc_transcoder_complete(TcTranscoder* transcoder);
+COMPRESSIONLIB void COMPRESSIONCALL tc_transcoder_cancel(TcTranscoder* transcoder);
+COMPRESSIONLIB void COMPRESSIONCALL tc_transcoder_get_progress(TcTranscoder* transcoder, struct TcTranscodeProgress* progress);
+COMPRESSIONLIB int COMPRESSIONCALL tc_transcoder_get_failure_count(TcTranscoder* transcoder);
+COMPRESSIONLIB int COMPRESSIONCALL tc_transcoder_get_failure(TcTranscoder* transcoder, int index, const char** input, const char** message);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,150 @@
+#include "TaygetaCompression.h"
+#include "TestCheck.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+// 9 to 16-bit images must come back from a reversible (mode=int) codestream sample for
+// sample, with the precision given explicitly or found in the samples. Rows are padded
+// with samples wider than the image holds, which the precision scan has to skip.
+
+#define ROW_PADDING 3
+
+struct TestImage
+{
+	TcImage Image;
+	std::vector<uint16_t> Planes[3];
+	int Widths[3];
+};
+
+static void CreateImage(int width, int height, int subsampling, int bits, TestImage* test)
+{
+	TcImage& image = test->Image;
+	image.Width = width;
+	image.Height = height;
+	image.Subsampling = subsampling;
+	image.Components = subsampling == TC_SAMP_GRAY ? 1 : 3;
+	image.Precision = 16;
+
+	int maxValue = (1 << bits) - 1;
+	for(int c = 0; c < image.Components; c++)
+	{
+		bool half = c > 0 && subsampling == TC_SAMP_420;
+		int w = half ? (width + 1) / 2 : width;
+		int h = half ? (height + 1) / 2 : height;
+		int pitch = w + ROW_PADDING;
+
+		std::vector<uint16_t>& plane = test->Planes[c];
+		plane.assign((size_t)pitch * h, 0xffff);
+		for(int y = 0; y < h; y++)
+		{
+			for(int x = 0; x < w; x++)
+			{
+				plane[(size_t)y * pitch + x] = (uint16_t)(rand() % (maxValue + 1));
+			}
+		}
+		plane[0] = (uint16_t)maxValue;
+
+		test->Widths[c] = w;
+		image.Planes[c] = (BYTE*)&plane[0];
+		image.Pitches[c] = pitch * 2;
+		image.Lines[c] = h;
+	}
+}
+
+static void RoundTrip(TcJp2Codec* codec, TestImage& test, int precision)
+{
+	TcImage image = test.Image;
+	image.Precision = precision;
+
+	std::vector<BYTE> encoded(4096);
+	size_t size = 0;
+	int result = tc_jp2_encode(codec, &image, "mode=int", &encoded[0], encoded.size(), &size);
+	if(result == 1)
+	{
+		encoded.resize(size);
+		result = tc_jp2_encode(codec, &image, "mode=int", &encoded[0], encoded.size(), &size);
+	}
+	CHECK_EQ(result, 0);
+	if(result != 0)
+	{
+		return;
+	}
+
+	TcImage info;
+	CHECK_EQ(tc_jp2_read_header(codec, &encoded[0], size, &info), 0);
+	CHECK_EQ(info.Width, image.Width);
+	CHECK_EQ(info.Height, image.Height);
+	CHECK_EQ(info.Subsampling, image.Subsampling);
+	CHECK_EQ(info.Components, image.Components);
+	CHECK_EQ(info.Precision, precision);
+
+	std::vector<uint16_t> decoded[3];
+	TcImage target = info;
+	target.Precision = 16;
+	for(int c = 0; c < image.Components; c++)
+	{
+		decoded[c].assign((size_t)test.Widths[c] * image.Lines[c], 0);
+		target.Planes[c] = (BYTE*)&decoded[c][0];
+		target.Pitches[c] = test.Widths[c] * 2;
+		target.Lines[c] = image.Lines[c];
+	}
+	CHECK_EQ(tc_jp2_read_planes(codec, &target), 0);
+
+	int mismatches = 0;
+	for(int c = 0; c < image.Components; c++)
+	{
+		int pitch = image.Pitches[c] / 2;
+		for(int y = 0; y < image.Lines[c]; y++)
+		{
+			for(int x = 0; x < test.Widths[c]; x++)
+			{
+				mismatches += decoded[c][(size_t)y * test.Widths[c] + x] != test.Planes[c][(size_t)y * pitch + x];
+			}
+		}
+	}
+	CHECK_EQ(mismatches, 0);
+}
+
+int main()
+{
+	static const int subsamplings[] = { TC_SAMP_GRAY, TC_SAMP_444, TC_SAMP_420 };
+
+	TcJp2Codec* codec = tc_jp2_create();
+	CHECK(codec != NULL);
+	if(!codec)
+	{
+		return TEST_RESULT();
+	}
+
+	srand(1);
+	for(int bits = 9; bits <= 16; bits++)
+	{
+		for(size_t s = 0; s < sizeof(subsamplings) / sizeof(subsamplings[0]); s++)
+		{
+			TestImage test;
+			CreateImage(37, 23, subsamplings[s], bits, &test);
+
+			int detected = tc_jp2_find_precision(&test.Image);
+			CHECK_EQ(detected, bits);
+
+			RoundTrip(codec, test, detected);
+			RoundTrip(codec, test, bits);
+			if(bits < 16)
+			{
+				RoundTrip(codec, test, 16);
+			}
+		}
+	}
+
+	// Errors of the codec core come back as -1 with a message, never as exceptions
+	TestImage invalid;
+	CreateImage(37, 23, TC_SAMP_420, 12, &invalid);
+	invalid.Image.Subsampling = 7;
+	CHECK_EQ(tc_jp2_find_precision(&invalid.Image), -1);
+	CHECK(tc_get_last_error()[0] != 0);
+
+	tc_jp2_destroy(codec);
+	return TEST_RESULT();
+}
@@ -4,7 +4,7 @@
 //
 //
 
-#include "stdafx.h"
+#include "Stdafx.h"
 #include <iostream>
 #include "jpeg_memory_dest.h"
 
@@ -60,8 +60,8 @@ void jpeg_memory_term_destination(j_compress_ptr cinfo)
 
 void jpeg_memory_dest(j_compress_ptr cinfo, std::vector<BYTE>* data)
 {
-  if (cinfo->dest == NULL) 
-    {   /* first time for this JPEG object? */
+  if (cinfo->dest == NULL || cinfo->dest->init_destination != jpeg_memory_init_destination) 
+    {   /* first time for this JPEG object, or it wrote somewhere else before? */
       cinfo->dest = (struct jpeg_destination_mgr*)
         (*cinfo->mem->alloc_small)((j_common_ptr) cinfo, JPOOL_PERMANENT,
                                    sizeof(struct jpeg_memory_destination_mgr));
@@ -73,4 +73,72 @@ void jpeg_memory_dest(j_compress_ptr cinfo, std::vector<BYTE>* data)
 
   struct jpeg_memory_destination_mgr* mgr = (struct jpeg_memory_destination_mgr*)cinfo->dest;
   mgr->data = data;
-}
\ No newline at end of file
+}
+
+// Writes into a fixed caller buffer. Output past its end goes to a scratch block that is
+// only counted, so the total size is known even when the buffer was too small.
+struct jpeg_buffer_destination_mgr
+{
+  struct jpeg_destination_mgr pub;
+
+  JOCTET* buffer;
+  size_t capacity;
+  size_t* size;
+  size_t done;          // bytes in the regions filled before the current one
+  size_t region;        // size of the current region
+  JOCTET scratch[OUTPUT_BUF_SIZE];
+};
+
+static void jpeg_buffer_set_region(struct jpeg_buffer_destination_mgr* mgr, JOCTET* data, size_t size)
+{
+  mgr->pub.next_output_byte = data;
+  mgr->pub.free_in_buffer   = size;
+  mgr->region               = size;
+}
+
+void jpeg_buffer_init_destination(j_compress_ptr cinfo)
+{
+  struct jpeg_buffer_destination_mgr* mgr = (struct jpeg_buffer_destination_mgr*)cinfo->dest;
+
+  mgr->done = 0;
+  if (mgr->capacity > 0)
+    jpeg_buffer_set_region(mgr, mgr->buffer, mgr->capacity);
+  else
+    jpeg_buffer_set_region(mgr, mgr->scratch, OUTPUT_BUF_SIZE);
+}
+
+boolean jpeg_buffer_empty_output_buffer(j_compress_ptr cinfo)
+{
+  struct jpeg_buffer_destination_mgr* mgr = (struct jpeg_buffer_destination_mgr*)cinfo->dest;
+
+  // Called with the whole region full, free_in_buffer must be ignored
+  mgr->done += mgr->region;
+  jpeg_buffer_set_region(mgr, mgr->scratch, OUTPUT_BUF_SIZE);
+  return TRUE;
+}
+
+void jpeg_buffer_term_destination(j_compress_ptr cinfo)
+{
+  struct jpeg_buffer_destination_mgr* mgr = (struct jpeg_buffer_destination_mgr*)cinfo->dest;
+
+  *mgr->size = mgr->done + mgr->region - cinfo->dest->free_in_buffer;
+}
+
+void jpeg_buffer_dest(j_compress_ptr cinfo, BYTE* buffer, size_t capacity, size_t* size)
+{
+  if (cinfo->dest == NULL || cinfo->dest->init_destination != jpeg_buffer_init_destination) 
+    {
+      cinfo->dest = (struct jpeg_destination_mgr*)
+        (*cinfo->mem->alloc_small)((j_common_ptr) cinfo, JPOOL_PERMANENT,
+                                   sizeof(struct jpeg_buffer_destination_mgr));
+    }
+
+  cinfo->dest->init_destination    = jpeg_buffer_init_destination;
+  cinfo->dest->empty_output_buffer = jpeg_buffer_empty_output_buffer;
+  cinfo->dest->term_destination    = jpeg_buffer_term_destination;
+
+  struct jpeg_buffer_destination_mgr* mgr = (struct jpeg_buffer_destination_mgr*)cinfo->dest;
+  mgr->buffer   = buffer;
+  mgr->capacity = capacity;
+  mgr->size     = size;
+}
@@ -13,8 +13,12 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <jpeglib.h>
-#include "windows.h"
+#include "CompressionLib.h"
 
 void jpeg_memory_dest(j_compress_ptr cinfo, std::vector<BYTE>* data);
+
+// Compressed size goes to *size when compression finishes; above capacity, the buffer
+// holds only the start of the image
+void jpeg_buffer_dest(j_compress_ptr cinfo, BYTE* buffer, size_t capacity, size_t* size);
 
 #endif
\ No newline at end of file
@@ -3,18 +3,24 @@ using System.Collections.Generic;
 using System.Drawing;
 using System.Drawing.Imaging;
 using System.Runtime.InteropServices;
+using System.Threading.Tasks;
 using FFMPEG;
 
 namespace Taygeta.Imaging
 {
     public unsafe sealed class ConverterResizer : IDisposable
     {
+        // Scale bands below this size cost more in margins and thread handoff than they save
+        const long MinBandPixels = 64 * 1024;
+
         Size m_sourceSize, m_targetSize;
         PixelAlignmentType m_sourceType, m_targetType;
         IntPtr m_context = IntPtr.Zero;
+        int m_threads = 1;
         static Dictionary<PixelAlignmentType, SwScale.SwsPixelFormat> m_pixelTypeMapper = new Dictionary<PixelAlignmentType, SwScale.SwsPixelFormat>();
         static Dictionary<PixelFormat, SwScale.SwsPixelFormat> m_rgbMapper = new Dictionary<PixelFormat, SwScale.SwsPixelFormat>();
-        static byte** pInput;
+        static Dictionary<PixelAlignmentType, RgbLayout> m_rgbLayoutMapper = new Dictionary<PixelAlignmentType, RgbLayout>();
+        static Dictionary<PixelFormat, RgbLayout> m_bitmapLayoutMapper = new Dictionary<PixelFormat, RgbLayout>();
 
         static ConverterResizer()
         {
@@ -32,16 +38,19 @@ namespace Taygeta.Imaging
             m_pixelTypeMapper.Add(PixelAlignmentType.RGB24, SwScale.SwsPixelFormat.PIX_FMT_BGR24);
             m_pixelTypeMapper.Add(PixelAlignmentType.RGBA, SwScale.SwsPixelFormat.PIX_FMT_RGBA);
             m_pixelTypeMapper.Add(PixelAlignmentType.ARGB, SwScale.SwsPixelFormat.PIX_FMT_ARGB);
+            m_pixelTypeMapper.Add(PixelAlignmentType.YUV16, SwScale.SwsPixelFormat.PIX_FMT_YUV444P16LE);
+            m_pixelTypeMapper.Add(PixelAlignmentType.I420P16, SwScale.SwsPixelFormat.PIX_FMT_YUV420P16LE);
 
             m_rgbMapper.Add(PixelFormat.Format8bppIndexed, SwScale.SwsPixelFormat.PIX_FMT_GRAY8);
             m_rgbMapper.Add(PixelFormat.Format32bppArgb, SwScale.SwsPixelFormat.PIX_FMT_BGRA);
             m_rgbMapper.Add(PixelFormat.Format24bppRgb, SwScale.SwsPixelFormat.PIX_FMT_BGR24);
 
-            pInput = (byte**)Marshal.AllocHGlobal(sizeof(byte*) * 4).ToPointer();
-            for (int i = 0; i < 4; i++)
-            {
-                pInput[i] = null;
-            }
+            // Byte orders the swscale formats above store
+            m_rgbLayoutMapper.Add(PixelAlignmentType.RGB24, RgbLayout.BGR24);
+            m_rgbLayoutMapper.Add(PixelAlignmentType.RGBA, RgbLayout.RGBA);
+            m_rgbLayoutMapper.Add(PixelAlignmentType.ARGB, RgbLayout.ARGB);
+            m_bitmapLayoutMapper.Add(PixelFormat.Format32bppArgb, RgbLayout.BGRA);
+            m_bitmapLayoutMapper.Add(PixelFormat.Format24bppRgb, RgbLayout.BGR24);
         }
 
         public ConverterResizer(Size sourceSize, PixelAlignmentType sourceType, Size targetSize, PixelAlignmentType targetType)
@@ -71,9 +80,27 @@ namespace Taygeta.Imaging
             }
         }
 
+        /// <summary>
+        /// Gets or sets the threads DoTheWork scales on, 1 by default and 0 for one per processor.
+        /// See Apply(PlanarImage, PlanarImage, int).
+        /// </summary>
+        public int Threads
+        {
+            get { return m_threads; }
+            set { m_threads = value; }
+        }
+
         public PlanarImage DoTheWork(PlanarImage source)
         {
             PlanarImage target = new PlanarImage(m_targetSize.Width, m_targetSize.Height, m_targetType);
+            ScalerKey key = new ScalerKey(m_sourceSize.Width, m_sourceSize.Height, m_pixelTypeMapper[m_sourceType],
+                                          m_targetSize.Width, m_targetSize.Height, m_pixelTypeMapper[m_targetType],
+                                          SwScale.ConvertionFlags.SWS_BICUBIC);
+            if (m_threads != 1 && ScaleBands(key, source, target, m_threads))
+            {
+                return target;
+            }
+
             int result = SwScale.sws_scale(m_context, source.PixelDataPointer, source.Pitches, 0, source.Height, target.PixelDataPointer, target.Pitches);
             if (result != target.Height)
             {
@@ -85,52 +112,441 @@ namespace Taygeta.Imaging
 
         public static void Apply(PlanarImage source, PlanarImage target)
         {
-            IntPtr context = SwScale.sws_getContext(source.Width, source.Height, m_pixelTypeMapper[source.PixelType],
-                                            target.Width, target.Height, m_pixelTypeMapper[target.PixelType],
-                                            SwScale.ConvertionFlags.SWS_BICUBIC, IntPtr.Zero, IntPtr.Zero, IntPtr.Zero);
+            Apply(source, target, 1);
+        }
 
-            int result = SwScale.sws_scale(context, source.PixelDataPointer, source.Pitches, 0, source.Height, target.PixelDataPointer, target.Pitches);
-            if (result != target.Height)
+        /// <summary>
+        /// Converts and scales source into target with swscale on up to threads threads, 0 for one per
+        /// processor. The target is split into row bands, each scaled by a context of its own; the result
+        /// is the same as on one thread. Scales whose vertical step swscale cannot place exactly at a band
+        /// start, such as 720 to 1080 rows, run on one thread. Exact 2x, 4x and 8x reductions of YUV images
+        /// keeping their pixel type average 2x2 blocks natively instead.
+        /// </summary>
+        public static void Apply(PlanarImage source, PlanarImage target, int threads)
+        {
+            if (source.Size == target.Size && ConvertNative(source, target))
             {
-                throw new InvalidOperationException();
+                return;
+            }
+            if (source.PixelType == target.PixelType && ReduceNative(source, target, threads))
+            {
+                return;
             }
 
-            SwScale.sws_freeContext(context);
+            ApplySwscale(source, target, SwScale.ConvertionFlags.SWS_BICUBIC, threads);
         }
 
-        public static Bitmap ToBitmap(PlanarImage source, PixelFormat format, ColorSpace colorspace = ColorSpace.DEFAULT)
+        /// <summary>
+        /// Converts and scales source into target with the native scaler and filter, on up to threads
+        /// threads. Its separable filters give the quality of the same filter in swscale, faster on RGB,
+        /// with identical results on any thread count. Pixel types it does not cover and sizes whose
+        /// managed planes round chroma down go through swscale with the matching filter.
+        /// </summary>
+        public static void Apply(PlanarImage source, PlanarImage target, ScaleFilter filter, int threads)
         {
-            IntPtr context = SwScale.sws_getContext(source.Width, source.Height, m_pixelTypeMapper[source.PixelType],
-                                             source.Width, source.Height, m_rgbMapper[format],
-                                             SwScale.ConvertionFlags.SWS_BICUBIC, IntPtr.Zero, IntPtr.Zero, IntPtr.Zero);
+            if (ScaleNative(source, new Rectangle(0, 0, source.Width, source.Height), target, filter, threads))
+            {
+                return;
+            }
+            ApplySwscale(source, target, GetSwsFlags(filter), threads);
+        }
 
+        public static void Apply(PlanarImage source, Rectangle sourceArea, PlanarImage target)
+        {
+            Apply(source, sourceArea, target, 1);
+        }
 
-            int* pCoef = SwScale.sws_getCoefficients(colorspace);
-            int* inv_table;
-            int* table;
-            int srcRange, dstRange, brightness, contrast, saturation;
+        public static void Apply(PlanarImage source, Rectangle sourceArea, PlanarImage target, int threads)
+        {
+            Apply(source, sourceArea, target, ScaleFilter.Bilinear, threads);
+        }
 
-            int result = SwScale.sws_getColorspaceDetails(context, out inv_table, out srcRange, out table, out dstRange, out brightness, out contrast, out saturation);
-            if (result != -1)
+        /// <summary>
+        /// Crops sourceArea out of source, scales it to the size of target with filter and converts it to the
+        /// pixel type of target in one native pass over the source planes, on up to threads threads. Chroma is
+        /// placed as centred on the luma it covers, so areas at odd offsets keep it where it was. Pixel types
+        /// the native scaler does not cover and sizes whose managed planes round chroma down are cropped
+        /// first and go through swscale.
+        /// </summary>
+        public static void Apply(PlanarImage source, Rectangle sourceArea, PlanarImage target, ScaleFilter filter, int threads)
+        {
+            if (sourceArea.X < 0 || sourceArea.Y < 0 || sourceArea.Width <= 0 || sourceArea.Height <= 0 ||
+                sourceArea.Right > source.Width || sourceArea.Bottom > source.Height)
             {
-                result = SwScale.sws_setColorspaceDetails(context, pCoef, srcRange, pCoef, dstRange, brightness, contrast, saturation);
+                throw new ArgumentOutOfRangeException("sourceArea");
             }
 
-            Bitmap bmp = new Bitmap(source.Width, source.Height, format);
-            BitmapData data = bmp.LockBits(new Rectangle(0, 0, source.Width, source.Height), ImageLockMode.ReadWrite, format);
+            if (ScaleNative(source, sourceArea, target, filter, threads))
+            {
+                return;
+            }
+
+            using (PlanarImage cropped = Cropper.Crop(source, sourceArea))
+            {
+                ApplySwscale(cropped, target, GetSwsFlags(filter), threads);
+            }
+        }
+
+        private static void ApplySwscale(PlanarImage source, PlanarImage target, SwScale.ConvertionFlags flags, int threads)
+        {
+            ScalerKey key = new ScalerKey(source.Width, source.Height, m_pixelTypeMapper[source.PixelType],
+                                          target.Width, target.Height, m_pixelTypeMapper[target.PixelType], flags);
+            if (threads != 1 && ScaleBands(key, source, target, threads))
+            {
+                return;
+            }
+            Scale(key, source.PixelDataPointer, source.Pitches, target.PixelDataPointer, target.Pitches);
+        }
+
+        private static SwScale.ConvertionFlags GetSwsFlags(ScaleFilter filter)
+        {
+            switch (filter)
+            {
+                case ScaleFilter.Bilinear:
+                    return SwScale.ConvertionFlags.SWS_BILINEAR;
+                case ScaleFilter.Lanczos3:
+                    return SwScale.ConvertionFlags.SWS_LANCZOS;
+                case ScaleFilter.Area:
+                    return SwScale.ConvertionFlags.SWS_AREA;
+                default:
+                    return SwScale.ConvertionFlags.SWS_BICUBIC;
+            }
+        }
+
+        // swscale places row y of a scale y * step down the source, the step being the height ratio in
+        // 16.16 fixed point. A band scaled on its own lands on the rows of the whole frame only when the
+        // step is exact in luma and chroma and the band starts on whole steps, on chroma rows of both
+        // images and on the 8 rows of the dither pattern. Each band is scaled from a source slice reaching
+        // past it by the filter support, into scratch rows of which the band is copied out. Returns false
+        // for scales that cannot be split.
+        private static bool ScaleBands(ScalerKey key, PlanarImage source, PlanarImage target, int threads)
+        {
+            int sourceRows = GetChromaRowStep(source.PixelType);
+            int targetRows = GetChromaRowStep(target.PixelType);
+            long sourceHeight = source.Height, targetHeight = target.Height;
+            if (sourceHeight % sourceRows != 0 || targetHeight % targetRows != 0 ||
+                (sourceHeight << 16) % targetHeight != 0 ||
+                ((sourceHeight / sourceRows) << 16) % (targetHeight / targetRows) != 0)
+            {
+                return false;
+            }
 
-            unsafe
+            // Band starts in target rows: step p source rows per q target rows
+            long gcd = Gcd(sourceHeight, targetHeight);
+            long p = sourceHeight / gcd, q = targetHeight / gcd;
+            long unit = q / Gcd(q, 8 * targetRows) * 8 * targetRows;
+            while (unit / q * p % sourceRows != 0)
+            {
+                unit *= 2;
+            }
+
+            // Half the filter support with a few rows to spare, chroma rows counted in luma rows
+            long size = GetFilterSize(key.Flags);
+            long taps = p > q ? size * ((p + q - 1) / q) : size + 1;
+            long chromaP = p * targetRows, chromaQ = q * sourceRows;
+            long chromaTaps = chromaP > chromaQ ? size * ((chromaP + chromaQ - 1) / chromaQ) : size + 1;
+            long sourceMargin = Math.Max(taps / 2 + 4, (chromaTaps / 2 + 4) * sourceRows);
+            long margin = RoundUp((sourceMargin * q + p - 1) / p, unit);
+
+            if (threads <= 0)
+            {
+                threads = Environment.ProcessorCount;
+            }
+            long minRows = Math.Max(2 * margin, MinBandPixels / Math.Max(target.Width, 1));
+            long rows = RoundUp(Math.Max((targetHeight + threads - 1) / threads, minRows), unit);
+            if (rows >= targetHeight)
+            {
+                return false;
+            }
+
+            int bands = (int)((targetHeight + rows - 1) / rows);
+            ParallelOptions options = new ParallelOptions();
+            options.MaxDegreeOfParallelism = threads;
+            try
+            {
+                Parallel.For(0, bands, options, band =>
+                {
+                    long first = band * rows;
+                    long last = Math.Min(first + rows, targetHeight);
+                    ScaleBand(key, source, target, first, last, margin, p, q, sourceRows, targetRows);
+                });
+            }
+            catch (AggregateException e)
+            {
+                throw e.InnerException;
+            }
+            return true;
+        }
+
+        private static void ScaleBand(ScalerKey key, PlanarImage source, PlanarImage target, long first, long last,
+                                      long margin, long p, long q, int sourceRows, int targetRows)
+        {
+            long top = Math.Max(first - margin, 0);
+            long bottom = Math.Min(last + margin, target.Height);
+            long sourceTop = top * p / q;
+
+            ScalerKey bandKey = key;
+            bandKey.SourceHeight = (int)(bottom * p / q - sourceTop);
+            bandKey.TargetHeight = (int)(bottom - top);
+
+            byte** slice = stackalloc byte*[4];
+            for (int i = 0; i < 4; i++)
+            {
+                slice[i] = i < source.NumberOfPlanes ?
+                    (byte*)(source.Planes[i] + (int)(sourceTop / (i == 0 ? 1 : sourceRows)) * source.Pitches[i]).ToPointer() : null;
+            }
+
+            using (PlanarImage scratch = new PlanarImage(target.Width, bandKey.TargetHeight, target.PixelType))
+            {
+                Scale(bandKey, slice, source.Pitches, scratch.PixelDataPointer, scratch.Pitches);
+                for (int i = 0; i < target.NumberOfPlanes; i++)
+                {
+                    int rows = i == 0 ? 1 : targetRows;
+                    TaygetaNative.tn_copy_plane(target.Planes[i] + (int)(first / rows) * target.Pitches[i], target.Pitches[i],
+                                                scratch.Planes[i] + (int)((first - top) / rows) * scratch.Pitches[i], scratch.Pitches[i],
+                                                Math.Min(Math.Abs(target.Pitches[i]), scratch.Pitches[i]), (int)((last - first) / rows));
+                }
+            }
+        }
+
+        // Luma rows per chroma row
+        private static int GetChromaRowStep(PixelAlignmentType type)
+        {
+            switch (type)
+            {
+                case PixelAlignmentType.I420:
+                case PixelAlignmentType.YV12:
+                case PixelAlignmentType.NV12:
+                case PixelAlignmentType.NV21:
+                case PixelAlignmentType.I420P16:
+                    return 2;
+                case PixelAlignmentType.Y410:
+                    return 4;
+                default:
+                    return 1;
+            }
+        }
+
+        // Filter taps per source row of a 1:1 scale, as swscale sizes its filters
+        private static int GetFilterSize(SwScale.ConvertionFlags flags)
+        {
+            if ((flags & (SwScale.ConvertionFlags.SWS_SINC | SwScale.ConvertionFlags.SWS_SPLINE)) != 0)
+            {
+                return 20;
+            }
+            if ((flags & (SwScale.ConvertionFlags.SWS_X | SwScale.ConvertionFlags.SWS_GAUSS)) != 0)
+            {
+                return 8;
+            }
+            if ((flags & SwScale.ConvertionFlags.SWS_LANCZOS) != 0)
+            {
+                return 6;
+            }
+            if ((flags & (SwScale.ConvertionFlags.SWS_BICUBIC | SwScale.ConvertionFlags.SWS_BICUBLIN)) != 0)
+            {
+                return 4;
+            }
+            return 2;
+        }
+
+        private static long Gcd(long a, long b)
+        {
+            while (b != 0)
             {
-                pInput[0] = (byte*)data.Scan0.ToPointer();
+                long t = a % b;
+                a = b;
+                b = t;
+            }
+            return a;
+        }
+
+        private static long RoundUp(long value, long unit)
+        {
+            return (value + unit - 1) / unit * unit;
+        }
 
-                result = SwScale.sws_scale(context, source.PixelDataPointer, source.Pitches, 0, source.Height, pInput, new int[] { data.Stride, 0, 0, 0 });
-                if (result != source.Height)
+        // Runs sws_scale over the whole height on a context of the scaler cache
+        private static void Scale(ScalerKey key, byte** source, int[] sourcePitches, byte** target, int[] targetPitches)
+        {
+            IntPtr context = ScalerCache.Acquire(key);
+            try
+            {
+                int result = SwScale.sws_scale(context, source, sourcePitches, 0, key.SourceHeight, target, targetPitches);
+                if (result != key.TargetHeight)
                 {
                     throw new InvalidOperationException();
                 }
             }
+            finally
+            {
+                ScalerCache.Release(key, context);
+            }
+        }
+
+        // Same size repacks between YUV layouts and conversions between YUV and RGB run on the native
+        // SIMD kernels, RGB with the swscale defaults of BT.601 and limited range. Returns false for pairs
+        // they do not cover and for odd sizes, where the managed planes round chroma down.
+        private static bool ConvertNative(PlanarImage source, PlanarImage target)
+        {
+            int sourceFormat = TaygetaNative.GetFrameFormat(source.PixelType);
+            int targetFormat = TaygetaNative.GetFrameFormat(target.PixelType);
+            RgbLayout layout;
+            if (m_rgbLayoutMapper.TryGetValue(target.PixelType, out layout))
+            {
+                return ConvertToRgbNative(source, target.Planes[0], target.Pitches[0], layout, ColorSpace.DEFAULT, false, null);
+            }
+            if (m_rgbLayoutMapper.TryGetValue(source.PixelType, out layout))
+            {
+                return ConvertFromRgbNative(source.Planes[0], source.Pitches[0], layout, target, ColorSpace.DEFAULT, false);
+            }
+            if (TaygetaNative.tn_can_convert(sourceFormat, targetFormat) == 0)
+            {
+                return false;
+            }
+
+            int result = TaygetaNative.tn_convert(source.Width, source.Height, sourceFormat, source.Planes, source.Pitches, source.Lines,
+                                                  targetFormat, target.Planes, target.Pitches, target.Lines);
+            if (result < 0)
+            {
+                throw new InvalidOperationException(TaygetaNative.GetLastError());
+            }
+            return result == 0;
+        }
+
+        // Box reductions by 2, 4 or 8 on the native SIMD kernels. Returns false for other ratios, pixel
+        // types they do not cover and target sizes off the chroma blocks.
+        private static bool ReduceNative(PlanarImage source, PlanarImage target, int threads)
+        {
+            int format = TaygetaNative.GetFrameFormat(source.PixelType);
+            int result = TaygetaNative.tn_reduce(source.Width, source.Height, format, source.Planes, source.Pitches, source.Lines,
+                                                 target.Width, target.Height, target.Planes, target.Pitches, target.Lines, threads);
+            if (result < 0)
+            {
+                throw new InvalidOperationException(TaygetaNative.GetLastError());
+            }
+            return result == 0;
+        }
+
+        // Crop, scale and conversion in one pass of the native scaler. Returns false for pairs it does
+        // not cover and for odd sizes.
+        private static bool ScaleNative(PlanarImage source, Rectangle sourceArea, PlanarImage target, ScaleFilter filter, int threads)
+        {
+            int sourceFormat = TaygetaNative.GetFrameFormat(source.PixelType);
+            int targetFormat = TaygetaNative.GetFrameFormat(target.PixelType);
+            if (TaygetaNative.tn_can_scale(sourceFormat, targetFormat) == 0)
+            {
+                return false;
+            }
+
+            int result = TaygetaNative.tn_scale(source.Width, source.Height, sourceFormat, source.Planes, source.Pitches, source.Lines,
+                                                sourceArea.X, sourceArea.Y, sourceArea.Width, sourceArea.Height,
+                                                target.Width, target.Height, targetFormat, target.Planes, target.Pitches, target.Lines,
+                                                (int)filter, threads);
+            if (result < 0)
+            {
+                throw new InvalidOperationException(TaygetaNative.GetLastError());
+            }
+            return result == 0;
+        }
+
+        // YUV to packed RGB on the native SIMD kernels, in row bands on every processor, with the tone
+        // adjustment applied to the samples on the way. Returns false for sources they do not cover and
+        // for odd sizes.
+        private static bool ConvertToRgbNative(PlanarImage source, IntPtr target, int pitch, RgbLayout layout,
+                                               ColorSpace colorspace, bool fullRange, ToneAdjustment tone)
+        {
+            int sourceFormat = TaygetaNative.GetFrameFormat(source.PixelType);
+            if (TaygetaNative.tn_can_convert_to_rgb(sourceFormat) == 0)
+            {
+                return false;
+            }
+
+            int result = TaygetaNative.tn_convert_to_rgb(source.Width, source.Height, sourceFormat, source.Planes, source.Pitches, source.Lines,
+                                                         target, pitch, layout, (int)colorspace, fullRange ? 1 : 0,
+                                                         tone != null ? tone.GetMap() : null, 0);
+            if (result < 0)
+            {
+                throw new InvalidOperationException(TaygetaNative.GetLastError());
+            }
+            return result == 0;
+        }
+
+        // Packed RGB to YUV on the native SIMD kernels, the reverse of ConvertToRgbNative
+        private static bool ConvertFromRgbNative(IntPtr source, int pitch, RgbLayout layout, PlanarImage target,
+                                                 ColorSpace colorspace, bool fullRange)
+        {
+            int targetFormat = TaygetaNative.GetFrameFormat(target.PixelType);
+            if (TaygetaNative.tn_can_convert_from_rgb(targetFormat) == 0)
+            {
+                return false;
+            }
+
+            int result = TaygetaNative.tn_convert_from_rgb(target.Width, target.Height, source, pitch, layout,
+                                                           targetFormat, target.Planes, target.Pitches, target.Lines, (int)colorspace, fullRange ? 1 : 0, 0);
+            if (result < 0)
+            {
+                throw new InvalidOperationException(TaygetaNative.GetLastError());
+            }
+            return result == 0;
+        }
+
+        // fullRange takes the YUV samples as 0..255 rather than 16..235. 24 and 32-bit bitmaps of
+        // even sized YUV images convert natively, the rest through swscale. tone, when given, adjusts
+        // the samples on the way without touching source; native conversions fuse it into theirs.
+        public static Bitmap ToBitmap(PlanarImage source, PixelFormat format, ColorSpace colorspace = ColorSpace.DEFAULT, bool fullRange = false,
+                                      ToneAdjustment tone = null)
+        {
+            RgbLayout layout;
+            if (m_bitmapLayoutMapper.TryGetValue(format, out layout) &&
+                TaygetaNative.tn_can_convert_to_rgb(TaygetaNative.GetFrameFormat(source.PixelType)) != 0)
+            {
+                Bitmap native = new Bitmap(source.Width, source.Height, format);
+                BitmapData nativeData = native.LockBits(new Rectangle(0, 0, source.Width, source.Height), ImageLockMode.WriteOnly, format);
+                bool converted;
+                try
+                {
+                    converted = ConvertToRgbNative(source, nativeData.Scan0, nativeData.Stride, layout, colorspace, fullRange, tone);
+                }
+                finally
+                {
+                    native.UnlockBits(nativeData);
+                }
+
+                if (converted)
+                {
+                    return native;
+                }
+                native.Dispose();
+            }
+
+            if (tone != null)
+            {
+                using (PlanarImage adjusted = (PlanarImage)source.Clone())
+                {
+                    tone.Apply(adjusted, 0);
+                    return ToBitmap(adjusted, format, colorspace, fullRange);
+                }
+            }
+
+            ScalerKey key = new ScalerKey(source.Width, source.Height, m_pixelTypeMapper[source.PixelType],
+                                          source.Width, source.Height, m_rgbMapper[format], SwScale.ConvertionFlags.SWS_BICUBIC);
+            key.Colorspace = colorspace;
+            key.SourceFullRange = fullRange;
+
+            Bitmap bmp = new Bitmap(source.Width, source.Height, format);
+            BitmapData data = bmp.LockBits(new Rectangle(0, 0, source.Width, source.Height), ImageLockMode.ReadWrite, format);
+            try
+            {
+                byte** pBitmap = stackalloc byte*[4];
+                pBitmap[0] = (byte*)data.Scan0.ToPointer();
+                pBitmap[1] = pBitmap[2] = pBitmap[3] = null;
+                Scale(key, source.PixelDataPointer, source.Pitches, pBitmap, new int[] { data.Stride, 0, 0, 0 });
+            }
+            finally
+            {
+                bmp.UnlockBits(data);
+            }
 
-            bmp.UnlockBits(data);
             if (bmp.Palette != null && bmp.Palette.Entries != null && bmp.Palette.Entries.Length > 0)
             {
                 ColorPalette cp = bmp.Palette;
@@ -140,50 +556,60 @@ namespace Taygeta.Imaging
                 }
                 bmp.Palette = cp;
             }
-
-            SwScale.sws_freeContext(context);
             return bmp;
         }
 
-        public static PlanarImage FromBitmap(Bitmap source, PixelAlignmentType format, ColorSpace colorspace = ColorSpace.DEFAULT)
+        // fullRange writes the YUV samples as 0..255 rather than 16..235. 24 and 32-bit bitmaps convert
+        // natively to even sized I420, YV12, NV12, NV21, YUV and Y800 images, the rest through swscale.
+        public static PlanarImage FromBitmap(Bitmap source, PixelAlignmentType format, ColorSpace colorspace = ColorSpace.DEFAULT, bool fullRange = false)
         {
-            IntPtr context = SwScale.sws_getContext(source.Width, source.Height, m_rgbMapper[source.PixelFormat],
-                                             source.Width, source.Height, m_pixelTypeMapper[format],
-                                             SwScale.ConvertionFlags.SWS_BICUBIC, IntPtr.Zero, IntPtr.Zero, IntPtr.Zero);
-
-            int* pCoef = SwScale.sws_getCoefficients(colorspace);
-            int* inv_table;
-            int* table;
-            int srcRange, dstRange, brightness, contrast, saturation;
-
-            int result = SwScale.sws_getColorspaceDetails(context, out inv_table, out srcRange, out table, out dstRange, out brightness, out contrast, out saturation);
-            if (result != -1)
+            RgbLayout layout;
+            if (m_bitmapLayoutMapper.TryGetValue(source.PixelFormat, out layout) &&
+                TaygetaNative.tn_can_convert_from_rgb(TaygetaNative.GetFrameFormat(format)) != 0)
             {
-                result = SwScale.sws_setColorspaceDetails(context, pCoef, srcRange, table, dstRange, brightness, contrast, saturation);
+                PlanarImage native = new PlanarImage(source.Width, source.Height, format);
+                BitmapData nativeData = source.LockBits(new Rectangle(0, 0, source.Width, source.Height), ImageLockMode.ReadOnly, source.PixelFormat);
+                bool converted;
+                try
+                {
+                    converted = ConvertFromRgbNative(nativeData.Scan0, nativeData.Stride, layout, native, colorspace, fullRange);
+                }
+                finally
+                {
+                    source.UnlockBits(nativeData);
+                }
+
+                if (converted)
+                {
+                    return native;
+                }
+                native.Dispose();
             }
 
+            ScalerKey key = new ScalerKey(source.Width, source.Height, m_rgbMapper[source.PixelFormat],
+                                          source.Width, source.Height, m_pixelTypeMapper[format], SwScale.ConvertionFlags.SWS_BICUBIC);
+            key.Colorspace = colorspace;
+            key.TargetFullRange = fullRange;
+
             PlanarImage yuv = new PlanarImage(source.Width, source.Height, format);
             BitmapData data = source.LockBits(new Rectangle(0, 0, source.Width, source.Height), ImageLockMode.ReadOnly, source.PixelFormat);
-
-            unsafe
+            try
             {
-                pInput[0] = (byte*)data.Scan0.ToPointer();
-                result = SwScale.sws_scale(context, pInput, new int[] { data.Stride, 0, 0, 0 }, 0, source.Height, yuv.PixelDataPointer, yuv.Pitches);
-                if (result != yuv.Height)
-                {
-                    throw new InvalidOperationException();
-                }
+                byte** pBitmap = stackalloc byte*[4];
+                pBitmap[0] = (byte*)data.Scan0.ToPointer();
+                pBitmap[1] = pBitmap[2] = pBitmap[3] = null;
+                Scale(key, pBitmap, new int[] { data.Stride, 0, 0, 0 }, yuv.PixelDataPointer, yuv.Pitches);
+            }
+            finally
+            {
+                source.UnlockBits(data);
             }
-
-            source.UnlockBits(data);
-            SwScale.sws_freeContext(context);
             return yuv;
         }
 
         public void Dispose()
         {
             SwScale.sws_freeContext(m_context);
-            Marshal.FreeHGlobal(new IntPtr(pInput));               
         }
     }
 }
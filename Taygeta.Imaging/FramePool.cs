@@ -0,0 +1,110 @@
+﻿using System;
+using System.Runtime.InteropServices;
+
+namespace Taygeta.Imaging
+{
+    /// <summary>
+    /// Usage counters of the native frame pool
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    public struct FramePoolStatistics
+    {
+        /// <summary>
+        /// Allocations served from released planes
+        /// </summary>
+        public long Hits;
+
+        /// <summary>
+        /// Allocations that went to the heap
+        /// </summary>
+        public long Misses;
+
+        /// <summary>
+        /// Bytes held by the pool, in use or idle
+        /// </summary>
+        public long BytesResident;
+
+        /// <summary>
+        /// Bytes released and waiting for reuse
+        /// </summary>
+        public long BytesIdle;
+
+        /// <summary>
+        /// Highest number of resident bytes seen
+        /// </summary>
+        public long BytesPeak;
+    }
+
+    /// <summary>
+    /// Page size backing pooled planes
+    /// </summary>
+    public enum LargePageMode
+    {
+        /// <summary>
+        /// Normal pages
+        /// </summary>
+        None = 0,
+
+        /// <summary>
+        /// Transparent huge pages where the system has them
+        /// </summary>
+        Transparent = 1,
+
+        /// <summary>
+        /// Reserved huge pages, which need system configuration or the lock pages privilege. Falls back
+        /// to transparent huge pages.
+        /// </summary>
+        Explicit = 2
+    }
+
+    /// <summary>
+    /// Process wide pool all planar image pixel planes are allocated from. Planes released
+    /// by disposed images are reused by the next image of the same geometry.
+    /// </summary>
+    public static class FramePool
+    {
+        /// <summary>
+        /// Gets current pool counters
+        /// </summary>
+        public static FramePoolStatistics Statistics
+        {
+            get
+            {
+                FramePoolStatistics stats;
+                TaygetaNative.tn_pool_get_stats(out stats);
+                return stats;
+            }
+        }
+
+        /// <summary>
+        /// Sets the upper bound of released memory kept for reuse
+        /// </summary>
+        public static long MaxIdleBytes
+        {
+            set { TaygetaNative.tn_pool_set_max_idle(value); }
+        }
+
+        /// <summary>
+        /// Selects where new planes come from. Huge pages cut TLB misses on large frames; NUMA local
+        /// planes are placed on the node of the thread that allocates them and reused only there.
+        /// None without NUMA placement is the default heap.
+        /// </summary>
+        /// <param name="largePages"></param>
+        /// <param name="numaLocal"></param>
+        public static void SetAllocator(LargePageMode largePages, bool numaLocal)
+        {
+            if (TaygetaNative.tn_pool_set_allocator((int)largePages, numaLocal ? 1 : 0) != 0)
+            {
+                throw new ArgumentException(TaygetaNative.GetLastError(), "largePages");
+            }
+        }
+
+        /// <summary>
+        /// Frees idle planes not needed since the previous call. Meant to be called periodically.
+        /// </summary>
+        public static void Trim()
+        {
+            TaygetaNative.tn_pool_trim();
+        }
+    }
+}
@@ -0,0 +1,247 @@
+﻿using System;
+using System.IO;
+
+namespace Taygeta.Imaging
+{
+    /// <summary>
+    /// Publishes images to a named shared memory ring that other processes read with FrameRingReader.
+    /// The writer never waits for readers: when every slot is still held by one, the image is dropped.
+    /// </summary>
+    public sealed class FrameRingWriter : IDisposable
+    {
+        private IntPtr m_writer;
+        private PixelAlignmentType m_pixelType;
+        private int m_width;
+        private int m_height;
+
+        /// <summary>
+        /// Creates the ring
+        /// </summary>
+        /// <param name="name">Name readers open the ring by</param>
+        /// <param name="slots">Number of preallocated images, at least 2</param>
+        /// <param name="pixelType"></param>
+        /// <param name="width"></param>
+        /// <param name="height"></param>
+        public FrameRingWriter(string name, int slots, PixelAlignmentType pixelType, int width, int height)
+        {
+            m_pixelType = pixelType;
+            m_width = width;
+            m_height = height;
+            m_writer = TaygetaNative.tn_ring_create(name, slots, TaygetaNative.GetFrameFormat(pixelType), width, height);
+            if (m_writer == IntPtr.Zero)
+            {
+                throw new IOException(TaygetaNative.GetLastError());
+            }
+        }
+
+        /// <summary>
+        /// Gets number of images published so far
+        /// </summary>
+        public long FrameCount
+        {
+            get { return GetStats().Frames; }
+        }
+
+        /// <summary>
+        /// Gets number of images dropped because no slot was free
+        /// </summary>
+        public long DroppedCount
+        {
+            get { return GetStats().Dropped; }
+        }
+
+        /// <summary>
+        /// Copies an image into the next free slot and publishes it
+        /// </summary>
+        /// <param name="image"></param>
+        /// <param name="timestamp"></param>
+        /// <returns>False when the image was dropped</returns>
+        public bool Write(PlanarImage image, TimeSpan timestamp)
+        {
+            if (image.PixelType != m_pixelType || image.Width != m_width || image.Height != m_height)
+            {
+                throw new ArgumentException("Image does not match the ring", "image");
+            }
+
+            int result = TaygetaNative.tn_ring_write(Handle, TaygetaNative.GetFrameFormat(m_pixelType), m_width, m_height, image.Planes, image.Pitches, timestamp.Ticks);
+            if (result < 0)
+            {
+                throw new IOException(TaygetaNative.GetLastError());
+            }
+            return result == 0;
+        }
+
+        /// <summary>
+        /// Removes the ring name, readers that have the ring open keep their images
+        /// </summary>
+        public void Dispose()
+        {
+            if (m_writer != IntPtr.Zero)
+            {
+                TaygetaNative.tn_ring_close_writer(m_writer);
+                m_writer = IntPtr.Zero;
+            }
+            GC.SuppressFinalize(this);
+        }
+
+        ~FrameRingWriter()
+        {
+            if (m_writer != IntPtr.Zero)
+            {
+                TaygetaNative.tn_ring_close_writer(m_writer);
+            }
+        }
+
+        private FrameRingStats GetStats()
+        {
+            FrameRingStats stats;
+            TaygetaNative.tn_ring_get_writer_stats(Handle, out stats);
+            return stats;
+        }
+
+        private IntPtr Handle
+        {
+            get
+            {
+                if (m_writer == IntPtr.Zero)
+                {
+                    throw new ObjectDisposedException("FrameRingWriter");
+                }
+                return m_writer;
+            }
+        }
+    }
+
+    /// <summary>
+    /// Reads the images of a frame ring in the order they were published, starting with the first one
+    /// published after opening. Images are not copied: they reference the shared slot, which the writer
+    /// does not reuse until the image is disposed, so they should be disposed promptly and not written to.
+    /// A reader that falls a whole ring behind skips to the oldest image still available. Instances are
+    /// not thread safe; open one per consumer.
+    /// </summary>
+    public sealed class FrameRingReader : IDisposable
+    {
+        private IntPtr m_reader;
+        private PixelAlignmentType m_pixelType;
+        private int m_width;
+        private int m_height;
+
+        /// <summary>
+        /// Opens a ring created by a FrameRingWriter
+        /// </summary>
+        /// <param name="name"></param>
+        public FrameRingReader(string name)
+        {
+            m_reader = TaygetaNative.tn_ring_open(name);
+            if (m_reader == IntPtr.Zero)
+            {
+                throw new IOException(TaygetaNative.GetLastError());
+            }
+
+            int format;
+            TaygetaNative.tn_ring_get_format(m_reader, out format, out m_width, out m_height);
+            m_pixelType = (PixelAlignmentType)format;
+        }
+
+        /// <summary>
+        /// Gets pixel type of the images
+        /// </summary>
+        public PixelAlignmentType PixelType
+        {
+            get { return m_pixelType; }
+        }
+
+        public int Width
+        {
+            get { return m_width; }
+        }
+
+        public int Height
+        {
+            get { return m_height; }
+        }
+
+        /// <summary>
+        /// Gets number of images read so far
+        /// </summary>
+        public long FrameCount
+        {
+            get { return GetStats().Frames; }
+        }
+
+        /// <summary>
+        /// Gets number of images overwritten before this reader got to them
+        /// </summary>
+        public long DroppedCount
+        {
+            get { return GetStats().Dropped; }
+        }
+
+        /// <summary>
+        /// Waits for the next image
+        /// </summary>
+        /// <param name="millisecondsTimeout">Time to wait, -1 to wait for ever</param>
+        /// <param name="sequence">Publish number of the image, gaps show dropped images</param>
+        /// <param name="timestamp"></param>
+        /// <returns>Image over the shared slot, null when the timeout passed</returns>
+        public PlanarImage Read(int millisecondsTimeout, out long sequence, out TimeSpan timestamp)
+        {
+            IntPtr frame;
+            long ticks;
+            int result = TaygetaNative.tn_ring_read(Handle, millisecondsTimeout, out frame, out sequence, out ticks);
+            if (result < 0)
+            {
+                throw new IOException(TaygetaNative.GetLastError());
+            }
+
+            if (result != 0)
+            {
+                sequence = 0;
+                timestamp = TimeSpan.Zero;
+                return null;
+            }
+            timestamp = new TimeSpan(ticks);
+            return new PlanarImage(frame);
+        }
+
+        /// <summary>
+        /// Closes the ring, images already read stay valid
+        /// </summary>
+        public void Dispose()
+        {
+            if (m_reader != IntPtr.Zero)
+            {
+                TaygetaNative.tn_ring_close_reader(m_reader);
+                m_reader = IntPtr.Zero;
+            }
+            GC.SuppressFinalize(this);
+        }
+
+        ~FrameRingReader()
+        {
+            if (m_reader != IntPtr.Zero)
+            {
+                TaygetaNative.tn_ring_close_reader(m_reader);
+            }
+        }
+
+        private FrameRingStats GetStats()
+        {
+            FrameRingStats stats;
+            TaygetaNative.tn_ring_get_reader_stats(Handle, out stats);
+            return stats;
+        }
+
+        private IntPtr Handle
+        {
+            get
+            {
+                if (m_reader == IntPtr.Zero)
+                {
+                    throw new ObjectDisposedException("FrameRingReader");
+                }
+                return m_reader;
+            }
+        }
+    }
+}
@@ -13,7 +13,7 @@ namespace Taygeta.Imaging
         Y800,
 
         /// <summary>
-        /// 16 bits per pixel gray scale bitmap
+        /// 16 bits per pixel gray scale bitmap, samples are big-endian
         /// </summary>
         Y16,
 
@@ -75,6 +75,16 @@ namespace Taygeta.Imaging
         /// <summary>
         /// 32 bits per pixel alpha, blue, green, and red
         /// </summary>
-        ARGB
+        ARGB,
+
+        /// <summary>
+        /// 48 bits per pixel planar 4:4:4 format with 16 bits for each of the Y, U and V samples
+        /// </summary>
+        YUV16,
+
+        /// <summary>
+        /// Same as I420 but with 16 bits per sample
+        /// </summary>
+        I420P16
     }
 }
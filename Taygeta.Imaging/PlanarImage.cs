@@ -20,18 +20,30 @@ namespace Taygeta.Imaging
         private byte** m_pDataPtr = null;
         private Size m_size = Size.Empty;
         private int m_totalImageSize = 0;
+        private IntPtr m_frame = IntPtr.Zero;
 
         /// <summary>
-        /// 
+        /// Loads image from file. Raw frame files are memory mapped, pixel data is paged in on first access;
+        /// files saved by earlier versions are deserialized.
         /// </summary>
         /// <param name="fileName"></param>
         /// <returns></returns>
         public static PlanarImage Load(string fileName)
         {
-            FileStream fs = File.OpenRead(fileName);
-            PlanarImage image = Load(fs);
-            fs.Close();
-            return image;
+            if (RawFrameFile.IsRawFrame(fileName))
+            {
+                IntPtr frame = TaygetaNative.tn_raw_map(fileName);
+                if (frame == IntPtr.Zero)
+                {
+                    throw new IOException(TaygetaNative.GetLastError());
+                }
+                return new PlanarImage(frame);
+            }
+
+            using (FileStream fs = File.OpenRead(fileName))
+            {
+                return Load(fs);
+            }
         }
 
         /// <summary>
@@ -41,6 +53,12 @@ namespace Taygeta.Imaging
         /// <returns></returns>
         public static PlanarImage Load(Stream stream)
         {
+            // Deserializing earlier files needs the magic check, which needs seeking
+            if (!stream.CanSeek || RawFrameFile.IsRawFrame(stream))
+            {
+                return RawFrameFile.Read(stream);
+            }
+
             BinaryFormatter bf = new BinaryFormatter();
             PlanarImage yuv = (PlanarImage)bf.Deserialize(stream);
             return yuv;
@@ -94,7 +112,7 @@ namespace Taygeta.Imaging
             Planes = new IntPtr[PlaneSizes.Length];
             for (int i = 0; i < PlaneSizes.Length; i++)
             {
-                Planes[i] = Marshal.AllocHGlobal(PlaneSizes[i] * sizeof(byte));
+                Planes[i] = TaygetaNative.AllocPlane(PlaneSizes[i]);
             }
         }
 
@@ -115,7 +133,7 @@ namespace Taygeta.Imaging
             Planes = new IntPtr[PlaneSizes.Length];
             for (int i = 0; i < PlaneSizes.Length; i++)
             {
-                Planes[i] = Marshal.AllocHGlobal(PlaneSizes[i] * sizeof(byte));
+                Planes[i] = TaygetaNative.AllocPlane(PlaneSizes[i]);
                 RtlMoveMemory(Planes[i], planes[i], PlaneSizes[i]);
             }
 
@@ -151,6 +169,62 @@ namespace Taygeta.Imaging
             }
         }
 
+        /// <summary>
+        /// Takes over a native frame, the planes stay owned by the frame
+        /// </summary>
+        /// <param name="frame"></param>
+        internal PlanarImage(IntPtr frame)
+            : this(frame, GetPixelType(frame))
+        {
+        }
+
+        private PlanarImage(IntPtr frame, PixelAlignmentType pixelType)
+        {
+            FrameInfo info;
+            TaygetaNative.tn_frame_get_info(frame, out info);
+
+            m_frame = frame;
+            Width = info.Width;
+            Height = info.Height;
+            PixelType = pixelType;
+            Init();
+
+            Planes = new IntPtr[NumberOfPlanes];
+            UpdatePlanes();
+        }
+
+        private static PixelAlignmentType GetPixelType(IntPtr frame)
+        {
+            FrameInfo info;
+            TaygetaNative.tn_frame_get_info(frame, out info);
+            if (!Enum.IsDefined(typeof(PixelAlignmentType), info.Format))
+            {
+                TaygetaNative.tn_frame_release(frame);
+                throw new NotSupportedException("Frame format " + info.Format + " has no pixel alignment type");
+            }
+            return (PixelAlignmentType)info.Format;
+        }
+
+        // Reads plane pointers and layout back from the native frame
+        private void UpdatePlanes()
+        {
+            FrameInfo info;
+            TaygetaNative.tn_frame_get_info(m_frame, out info);
+            for (int i = 0; i < NumberOfPlanes; i++)
+            {
+                Planes[i] = info.Data[i];
+                Pitches[i] = info.Pitches[i];
+                Lines[i] = info.Lines[i];
+                PlaneSizes[i] = Math.Abs(info.Pitches[i]) * info.Lines[i];
+
+                if (m_pDataPtr != null)
+                {
+                    m_pDataPtr[i] = (byte*)Planes[i].ToPointer();
+                }
+            }
+            m_totalImageSize = 0;
+        }
+
         /// <summary>
         /// Swaps Cb and Cr planes (usually needed for YV12 format)
         /// </summary>
@@ -256,6 +330,22 @@ namespace Taygeta.Imaging
                     PlaneSizes = new int[1] { Pitches[0] * Lines[0] };
                     break;
 
+                case PixelAlignmentType.YUV16:
+                    BitsPerPixel = 48;
+                    NumberOfPlanes = 3;
+                    Pitches = new int[3] { Width * 2, Width * 2, Width * 2 };
+                    Lines = new int[3] { Height, Height, Height };
+                    PlaneSizes = new int[3] { Pitches[0] * Lines[0], Pitches[1] * Lines[1], Pitches[2] * Lines[2] };
+                    break;
+
+                case PixelAlignmentType.I420P16:
+                    BitsPerPixel = 24;
+                    NumberOfPlanes = 3;
+                    Pitches = new int[3] { Width * 2, Width / 2 * 2, Width / 2 * 2 };
+                    Lines = new int[3] { Height, Height / 2, Height / 2 };
+                    PlaneSizes = new int[3] { Pitches[0] * Lines[0], Pitches[1] * Lines[1], Pitches[2] * Lines[2] };
+                    break;
+
                 default:
                     throw new InvalidOperationException("Unknown pixel alignment type " + PixelType);
             }
@@ -280,6 +370,18 @@ namespace Taygeta.Imaging
             return ConverterResizer.ToBitmap(this, format);
         }
 
+        /// <summary>
+        /// Convert planar image to .NET Bitmap object, adjusting the tone on the way
+        /// </summary>
+        /// <param name="format"></param>
+        /// <param name="tone"></param>
+        /// <returns></returns>
+        public Bitmap ToBitmap(PixelFormat format, ToneAdjustment tone)
+        {
+            VerifyIsSupported(format);
+            return ConverterResizer.ToBitmap(this, format, fullRange: tone != null && tone.FullRange, tone: tone);
+        }
+
         /// <summary>
         /// Converts planar image to another pixel alignment type
         /// </summary>
@@ -304,6 +406,39 @@ namespace Taygeta.Imaging
             return result;
         }
 
+        /// <summary>
+        /// Resizes planar image with the native scaler and the given filter
+        /// </summary>
+        /// <param name="newSize"></param>
+        /// <param name="filter"></param>
+        /// <returns></returns>
+        public PlanarImage Resize(Size newSize, ScaleFilter filter)
+        {
+            PlanarImage result = new PlanarImage(newSize.Width, newSize.Height, this.PixelType);
+            ConverterResizer.Apply(this, result, filter, 1);
+            return result;
+        }
+
+        /// <summary>
+        /// Rotates and flips planar image, keeping its pixel type
+        /// </summary>
+        /// <param name="type"></param>
+        /// <returns></returns>
+        public PlanarImage Rotate(RotateFlipType type)
+        {
+            return Rotator.Rotate(this, type, 1);
+        }
+
+        /// <summary>
+        /// Adjusts brightness, contrast, gamma and saturation of YUV planar image in place
+        /// </summary>
+        /// <param name="tone"></param>
+        public void AdjustTone(ToneAdjustment tone)
+        {
+            LeaseWrite();
+            tone.Apply(this, 1);
+        }
+
         /// <summary>
         /// Performs both conversion and resize in a single operation
         /// </summary>
@@ -332,6 +467,25 @@ namespace Taygeta.Imaging
             return Cropper.Crop(this, cropArea);
         }
 
+        /// <summary>
+        /// Crops, resizes and converts in a single pass over the planes of current instance
+        /// </summary>
+        /// <param name="cropArea"></param>
+        /// <param name="newPixelType"></param>
+        /// <param name="newSize"></param>
+        /// <returns></returns>
+        public PlanarImage CropConvertAndResize(Rectangle cropArea, PixelAlignmentType newPixelType, Size newSize)
+        {
+            if (cropArea.X + cropArea.Width > this.Width || cropArea.Y + cropArea.Height > this.Height)
+            {
+                throw new InvalidOperationException("Cropping size bigger than the image size");
+            }
+
+            PlanarImage result = new PlanarImage(newSize.Width, newSize.Height, newPixelType);
+            ConverterResizer.Apply(this, cropArea, result);
+            return result;
+        }
+
         /// <summary>
         /// Gets the width of the bitmap
         /// </summary>
@@ -409,11 +563,23 @@ namespace Taygeta.Imaging
 
         private void Dispose(bool disposing)
         {
+            if (Planes == null)
+            {
+                return;
+            }
+
+            if (m_frame != IntPtr.Zero)
+            {
+                TaygetaNative.tn_frame_release(m_frame);
+                m_frame = IntPtr.Zero;
+                Array.Clear(Planes, 0, Planes.Length);
+            }
+
             for (int i = 0; i < Planes.Length; i++)
             {
                 if (Planes[i] != IntPtr.Zero)
                 {
-                    Marshal.FreeHGlobal(Planes[i]);
+                    TaygetaNative.tn_pool_free(Planes[i]);
                     Planes[i] = IntPtr.Zero;
                 }
             }
@@ -439,16 +605,102 @@ namespace Taygeta.Imaging
         }
 
         /// <summary>
-        /// Performs deep cloning of this instance
+        /// Performs deep cloning of this instance. Planes come from the frame pool and are copied once each.
         /// </summary>
         /// <returns></returns>
         public object Clone()
         {
-            BinaryFormatter bf = new BinaryFormatter();
-            MemoryStream ms = new MemoryStream();
-            bf.Serialize(ms, this);
-            ms.Position = 0;
-            return bf.Deserialize(ms);
+            if (m_frame != IntPtr.Zero)
+            {
+                IntPtr frame = TaygetaNative.tn_frame_clone(m_frame);
+                if (frame == IntPtr.Zero)
+                {
+                    throw new OutOfMemoryException(TaygetaNative.GetLastError());
+                }
+                return new PlanarImage(frame, PixelType);
+            }
+
+            PlanarImage clone = new PlanarImage(Width, Height, PixelType);
+            for (int i = 0; i < NumberOfPlanes; i++)
+            {
+                TaygetaNative.tn_copy_plane(clone.Planes[i], clone.Pitches[i], Planes[i], Pitches[i], clone.Pitches[i], Lines[i]);
+            }
+            return clone;
+        }
+
+        /// <summary>
+        /// Creates a copy-on-write clone sharing the pixel data with this instance. Either image must take
+        /// the write lease with LeaseWrite before its planes are written.
+        /// </summary>
+        /// <returns></returns>
+        public PlanarImage CloneShared()
+        {
+            if (m_frame == IntPtr.Zero)
+            {
+                // The planes move into a native frame the clones can share. Layouts the native
+                // side does not describe (odd chroma sizes) get a deep copy instead.
+                m_frame = TaygetaNative.tn_frame_adopt(TaygetaNative.GetFrameFormat(PixelType), Width, Height, Planes, Pitches, Lines);
+                if (m_frame == IntPtr.Zero)
+                {
+                    return (PlanarImage)Clone();
+                }
+            }
+
+            IntPtr frame = TaygetaNative.tn_frame_clone_shared(m_frame);
+            if (frame == IntPtr.Zero)
+            {
+                throw new OutOfMemoryException(TaygetaNative.GetLastError());
+            }
+            return new PlanarImage(frame, PixelType);
+        }
+
+        /// <summary>
+        /// Creates an upside down image sharing the pixel data with this instance. No pixels are moved:
+        /// the planes of the result start at the last row and have negative pitches. Either image must
+        /// take the write lease with LeaseWrite before its planes are written.
+        /// </summary>
+        /// <returns></returns>
+        public PlanarImage FlipVertical()
+        {
+            if (m_frame == IntPtr.Zero)
+            {
+                m_frame = TaygetaNative.tn_frame_adopt(TaygetaNative.GetFrameFormat(PixelType), Width, Height, Planes, Pitches, Lines);
+                if (m_frame == IntPtr.Zero)
+                {
+                    throw new NotSupportedException(TaygetaNative.GetLastError());
+                }
+            }
+
+            IntPtr frame = TaygetaNative.tn_frame_flip(m_frame);
+            if (frame == IntPtr.Zero)
+            {
+                throw new OutOfMemoryException(TaygetaNative.GetLastError());
+            }
+            return new PlanarImage(frame, PixelType);
+        }
+
+        /// <summary>
+        /// Takes the write lease. While the planes are shared with a clone they are copied first,
+        /// so Planes and PixelDataPointer may change.
+        /// </summary>
+        /// <returns>True when the planes were copied</returns>
+        public bool LeaseWrite()
+        {
+            if (m_frame == IntPtr.Zero)
+            {
+                return false;
+            }
+
+            int result = TaygetaNative.tn_frame_lease_write(m_frame);
+            if (result < 0)
+            {
+                throw new OutOfMemoryException(TaygetaNative.GetLastError());
+            }
+            if (result > 0)
+            {
+                UpdatePlanes();
+            }
+            return result > 0;
         }
 
         /// <summary>
@@ -463,10 +715,10 @@ namespace Taygeta.Imaging
             info.AddValue("BitsPerPixel", BitsPerPixel);
             info.AddValue("PixelType", PixelType);
             info.AddValue("PlaneSizes", PlaneSizes);
-            info.AddValue("Pitches", Pitches);
+            info.AddValue("Pitches", Array.ConvertAll(Pitches, Math.Abs));
             info.AddValue("Lines", Lines);
             info.AddValue("NumberOfPlanes", NumberOfPlanes);
-            PixelData px = new PixelData(this.PlaneSizes, this.Planes);
+            PixelData px = new PixelData(this.PlaneSizes, this.Planes, this.Pitches, this.Lines);
             info.AddValue("PixelData", px.Save());
         }
 
@@ -483,20 +735,23 @@ namespace Taygeta.Imaging
         }
 
         /// <summary>
-        /// Serializes current instance into provided stream
+        /// Writes current instance into provided stream in raw frame format
         /// </summary>
         /// <param name="stream"></param>
         public void Save(Stream stream)
         {
-            BinaryFormatter bf = new BinaryFormatter();
-            bf.Serialize(stream, this);
+            RawFrameFile.Write(this, stream);
         }
 
+        /// <summary>
+        /// Writes current instance into raw frame file, header and planes go out in a single vectored write
+        /// </summary>
+        /// <param name="fileName"></param>
         public void Save(string fileName)
         {
-            using (FileStream fs = File.Create(fileName))
-            { 
-                Save(fs);
+            if (TaygetaNative.tn_raw_write(fileName, (int)PixelType, Width, Height, Planes, Pitches) != 0)
+            {
+                throw new IOException(TaygetaNative.GetLastError());
             }
         }
 
@@ -534,12 +789,23 @@ namespace Taygeta.Imaging
         {
             Dictionary<int, byte[]> m_buffers = new Dictionary<int, byte[]>();
 
-            public PixelData(int[] planeSizes, IntPtr[] planes)
+            public PixelData(int[] planeSizes, IntPtr[] planes, int[] pitches, int[] lines)
             {
                 for (int i = 0; i < planeSizes.Length; i++)
                 {
                     m_buffers[i] = new byte[planeSizes[i]];
-                    Marshal.Copy(planes[i], m_buffers[i], 0, planeSizes[i]);
+                    if (pitches[i] > 0)
+                    {
+                        Marshal.Copy(planes[i], m_buffers[i], 0, planeSizes[i]);
+                        continue;
+                    }
+
+                    // Bottom-up planes are stored top row first
+                    int pitch = -pitches[i];
+                    for (int y = 0; y < lines[i]; y++)
+                    {
+                        Marshal.Copy(planes[i] - y * pitch, m_buffers[i], y * pitch, pitch);
+                    }
                 }
             }
 
@@ -570,7 +836,7 @@ namespace Taygeta.Imaging
                 IntPtr[] planes = new IntPtr[m_buffers.Count];
                 for (int i = 0; i < planes.Length; i++)
                 {
-                    planes[i] = Marshal.AllocHGlobal(m_buffers[i].Length);
+                    planes[i] = TaygetaNative.AllocPlane(m_buffers[i].Length);
                     Marshal.Copy(m_buffers[i], 0, planes[i], m_buffers[i].Length);
                 }
 
@@ -0,0 +1,245 @@
+﻿using System;
+using System.IO;
+using System.Runtime.InteropServices;
+
+namespace Taygeta.Imaging
+{
+    /// <summary>
+    /// Stream based reader and writer of the raw frame file format (see RawFrameFile.h in Taygeta.Native).
+    /// Files are used for paths through the native library, which maps them instead of reading.
+    /// </summary>
+    internal static class RawFrameFile
+    {
+        public const uint Magic = 0x57415254;
+        public const uint Version = 1;
+        public const int PageSize = 4096;
+        public const int HeaderLength = 104;
+
+        const int maxPlanes = 4;
+        const int copyBufferSize = 64 * 1024;
+
+        /// <summary>
+        /// Checks the first bytes of a stream for the raw frame magic, the stream position is restored
+        /// </summary>
+        public static bool IsRawFrame(Stream stream)
+        {
+            if (!stream.CanSeek)
+            {
+                throw new NotSupportedException("Format detection requires a seekable stream");
+            }
+
+            long position = stream.Position;
+            byte[] magic = new byte[4];
+            int read = ReadFully(stream, magic, 0, magic.Length);
+            stream.Position = position;
+            return read == magic.Length && BitConverter.ToUInt32(magic, 0) == Magic;
+        }
+
+        public static bool IsRawFrame(string fileName)
+        {
+            using (FileStream fs = File.OpenRead(fileName))
+            {
+                return IsRawFrame(fs);
+            }
+        }
+
+        public static void Write(PlanarImage image, Stream stream)
+        {
+            int planes = image.NumberOfPlanes;
+            long[] offsets = new long[planes];
+            long position = PageSize;
+            for (int i = 0; i < planes; i++)
+            {
+                offsets[i] = AlignPage(position);
+                position = offsets[i] + (long)Math.Abs(image.Pitches[i]) * image.Lines[i];
+            }
+
+            byte[] page = new byte[PageSize];
+            using (BinaryWriter writer = new BinaryWriter(new MemoryStream(page)))
+            {
+                writer.Write(Magic);
+                writer.Write(Version);
+                writer.Write((uint)PageSize);
+                writer.Write((int)image.PixelType);
+                writer.Write(image.Width);
+                writer.Write(image.Height);
+                writer.Write(planes);
+                writer.Write(0);
+                for (int i = 0; i < maxPlanes; i++)
+                {
+                    writer.Write(i < planes ? Math.Abs(image.Pitches[i]) : 0);
+                }
+                for (int i = 0; i < maxPlanes; i++)
+                {
+                    writer.Write(i < planes ? image.Lines[i] : 0);
+                }
+                for (int i = 0; i < maxPlanes; i++)
+                {
+                    writer.Write(i < planes ? offsets[i] : 0L);
+                }
+                writer.Write(position);
+            }
+            stream.Write(page, 0, page.Length);
+
+            Array.Clear(page, 0, HeaderLength);
+            byte[] buffer = new byte[copyBufferSize];
+            long written = PageSize;
+            for (int i = 0; i < planes; i++)
+            {
+                stream.Write(page, 0, (int)(offsets[i] - written));
+
+                int pitch = image.Pitches[i];
+                int size = Math.Abs(pitch) * image.Lines[i];
+                if (pitch > 0)
+                {
+                    for (int done = 0; done < size; done += buffer.Length)
+                    {
+                        int count = Math.Min(buffer.Length, size - done);
+                        Marshal.Copy(image.Planes[i] + done, buffer, 0, count);
+                        stream.Write(buffer, 0, count);
+                    }
+                }
+                else
+                {
+                    // Files are top-down, rows of a bottom-up plane go out one by one
+                    byte[] row = new byte[-pitch];
+                    for (int y = 0; y < image.Lines[i]; y++)
+                    {
+                        Marshal.Copy(image.Planes[i] + y * pitch, row, 0, row.Length);
+                        stream.Write(row, 0, row.Length);
+                    }
+                }
+                written = offsets[i] + size;
+            }
+        }
+
+        public static PlanarImage Read(Stream stream)
+        {
+            byte[] page = new byte[PageSize];
+            if (ReadFully(stream, page, 0, HeaderLength) != HeaderLength)
+            {
+                throw new InvalidDataException("Truncated raw frame header");
+            }
+
+            int format, width, height, planes;
+            uint headerSize;
+            int[] pitches = new int[maxPlanes];
+            int[] lines = new int[maxPlanes];
+            long[] offsets = new long[maxPlanes];
+            using (BinaryReader reader = new BinaryReader(new MemoryStream(page, 0, HeaderLength)))
+            {
+                if (reader.ReadUInt32() != Magic)
+                {
+                    throw new InvalidDataException("Not a raw frame file");
+                }
+                if (reader.ReadUInt32() != Version)
+                {
+                    throw new InvalidDataException("Unsupported raw frame version");
+                }
+                headerSize = reader.ReadUInt32();
+                format = reader.ReadInt32();
+                width = reader.ReadInt32();
+                height = reader.ReadInt32();
+                planes = reader.ReadInt32();
+                reader.ReadInt32();
+                for (int i = 0; i < maxPlanes; i++)
+                {
+                    pitches[i] = reader.ReadInt32();
+                }
+                for (int i = 0; i < maxPlanes; i++)
+                {
+                    lines[i] = reader.ReadInt32();
+                }
+                for (int i = 0; i < maxPlanes; i++)
+                {
+                    offsets[i] = reader.ReadInt64();
+                }
+            }
+
+            if (!Enum.IsDefined(typeof(PixelAlignmentType), format) || width <= 0 || height <= 0)
+            {
+                throw new InvalidDataException("Corrupt raw frame header");
+            }
+
+            PlanarImage image = new PlanarImage(width, height, (PixelAlignmentType)format);
+            try
+            {
+                if (planes != image.NumberOfPlanes)
+                {
+                    throw new InvalidDataException("Corrupt raw frame header");
+                }
+
+                // Planes come in file order, so the stream never has to seek back
+                long position = HeaderLength;
+                byte[] row = new byte[0];
+                for (int i = 0; i < planes; i++)
+                {
+                    if (offsets[i] < Math.Max(position, headerSize) || pitches[i] <= 0 || lines[i] < image.Lines[i])
+                    {
+                        throw new InvalidDataException("Corrupt raw frame header");
+                    }
+                    Skip(stream, offsets[i] - position);
+
+                    if (row.Length < pitches[i])
+                    {
+                        row = new byte[pitches[i]];
+                    }
+
+                    int rowBytes = Math.Min(pitches[i], image.Pitches[i]);
+                    for (int y = 0; y < lines[i]; y++)
+                    {
+                        if (ReadFully(stream, row, 0, pitches[i]) != pitches[i])
+                        {
+                            throw new InvalidDataException("Truncated raw frame file");
+                        }
+                        if (y < image.Lines[i])
+                        {
+                            Marshal.Copy(row, 0, image.Planes[i] + y * image.Pitches[i], rowBytes);
+                        }
+                    }
+                    position = offsets[i] + (long)pitches[i] * lines[i];
+                }
+            }
+            catch
+            {
+                image.Dispose();
+                throw;
+            }
+            return image;
+        }
+
+        private static long AlignPage(long position)
+        {
+            return (position + PageSize - 1) & ~(long)(PageSize - 1);
+        }
+
+        private static void Skip(Stream stream, long count)
+        {
+            byte[] buffer = new byte[(int)Math.Min(count, copyBufferSize)];
+            while (count > 0)
+            {
+                int read = stream.Read(buffer, 0, (int)Math.Min(count, buffer.Length));
+                if (read == 0)
+                {
+                    throw new InvalidDataException("Truncated raw frame file");
+                }
+                count -= read;
+            }
+        }
+
+        private static int ReadFully(Stream stream, byte[] buffer, int offset, int count)
+        {
+            int total = 0;
+            while (total < count)
+            {
+                int read = stream.Read(buffer, offset + total, count - total);
+                if (read == 0)
+                {
+                    break;
+                }
+                total += read;
+            }
+            return total;
+        }
+    }
+}
@@ -0,0 +1,268 @@
+﻿using System;
+using System.IO;
+
+namespace Taygeta.Imaging
+{
+    /// <summary>
+    /// File layout of a raw frame sequence
+    /// </summary>
+    public enum RawSequenceContainer
+    {
+        /// <summary>
+        /// Page aligned frame records with a timestamp index, frames are used straight from the mapped file
+        /// </summary>
+        Native = 0,
+
+        /// <summary>
+        /// YUV4MPEG2, readable by most video tools. Timestamps follow from the frame rate.
+        /// </summary>
+        Y4M = 1
+    }
+
+    /// <summary>
+    /// Appends images of one size and pixel type to a new sequence file
+    /// </summary>
+    public sealed class RawSequenceWriter : IDisposable
+    {
+        private IntPtr m_writer;
+        private PixelAlignmentType m_pixelType;
+        private int m_width;
+        private int m_height;
+
+        /// <summary>
+        /// Creates the sequence file
+        /// </summary>
+        /// <param name="fileName"></param>
+        /// <param name="container"></param>
+        /// <param name="pixelType"></param>
+        /// <param name="width"></param>
+        /// <param name="height"></param>
+        /// <param name="rateNumerator">Frame rate numerator, 0 when not known</param>
+        /// <param name="rateDenominator"></param>
+        public RawSequenceWriter(string fileName, RawSequenceContainer container, PixelAlignmentType pixelType,
+            int width, int height, int rateNumerator, int rateDenominator)
+        {
+            m_pixelType = pixelType;
+            m_width = width;
+            m_height = height;
+            m_writer = TaygetaNative.tn_seq_create(fileName, (int)container, TaygetaNative.GetFrameFormat(pixelType), width, height, rateNumerator, rateDenominator);
+            if (m_writer == IntPtr.Zero)
+            {
+                throw new IOException(TaygetaNative.GetLastError());
+            }
+        }
+
+        /// <summary>
+        /// Gets number of images appended so far
+        /// </summary>
+        public long FrameCount { get; private set; }
+
+        /// <summary>
+        /// Appends an image. Timestamps of the native container must not decrease.
+        /// </summary>
+        /// <param name="image"></param>
+        /// <param name="timestamp"></param>
+        public void Append(PlanarImage image, TimeSpan timestamp)
+        {
+            if (m_writer == IntPtr.Zero)
+            {
+                throw new ObjectDisposedException("RawSequenceWriter");
+            }
+            if (image.PixelType != m_pixelType || image.Width != m_width || image.Height != m_height)
+            {
+                throw new ArgumentException("Image does not match the sequence", "image");
+            }
+
+            if (TaygetaNative.tn_seq_append(m_writer, TaygetaNative.GetFrameFormat(m_pixelType), m_width, m_height, image.Planes, image.Pitches, timestamp.Ticks) != 0)
+            {
+                throw new IOException(TaygetaNative.GetLastError());
+            }
+            FrameCount++;
+        }
+
+        /// <summary>
+        /// Writes the frame index and closes the file
+        /// </summary>
+        public void Close()
+        {
+            if (m_writer != IntPtr.Zero)
+            {
+                IntPtr writer = m_writer;
+                m_writer = IntPtr.Zero;
+                GC.SuppressFinalize(this);
+                if (TaygetaNative.tn_seq_close_writer(writer) != 0)
+                {
+                    throw new IOException(TaygetaNative.GetLastError());
+                }
+            }
+        }
+
+        /// <summary>
+        /// Closes the file
+        /// </summary>
+        public void Dispose()
+        {
+            Close();
+        }
+
+        ~RawSequenceWriter()
+        {
+            if (m_writer != IntPtr.Zero)
+            {
+                TaygetaNative.tn_seq_close_writer(m_writer);
+            }
+        }
+    }
+
+    /// <summary>
+    /// Random access to a native or Y4M sequence. Images are mapped from the file rather than read, and
+    /// reading one hints the system to fetch the following ones. Instances may be used from several threads.
+    /// </summary>
+    public sealed class RawSequenceReader : IDisposable
+    {
+        private IntPtr m_reader;
+        private SequenceInfo m_info;
+
+        /// <summary>
+        /// Opens a sequence file
+        /// </summary>
+        /// <param name="fileName"></param>
+        public RawSequenceReader(string fileName)
+            : this(fileName, 2)
+        {
+        }
+
+        /// <summary>
+        /// Opens a sequence file
+        /// </summary>
+        /// <param name="fileName"></param>
+        /// <param name="readahead">Number of frames to prefetch after every read</param>
+        public RawSequenceReader(string fileName, int readahead)
+        {
+            m_reader = TaygetaNative.tn_seq_open(fileName, readahead);
+            if (m_reader == IntPtr.Zero)
+            {
+                throw new IOException(TaygetaNative.GetLastError());
+            }
+            TaygetaNative.tn_seq_get_info(m_reader, out m_info);
+        }
+
+        /// <summary>
+        /// Gets container of the file
+        /// </summary>
+        public RawSequenceContainer Container
+        {
+            get { return (RawSequenceContainer)m_info.Container; }
+        }
+
+        /// <summary>
+        /// Gets pixel type of the images
+        /// </summary>
+        public PixelAlignmentType PixelType
+        {
+            get { return (PixelAlignmentType)m_info.Format; }
+        }
+
+        public int Width
+        {
+            get { return m_info.Width; }
+        }
+
+        public int Height
+        {
+            get { return m_info.Height; }
+        }
+
+        /// <summary>
+        /// Gets frame rate numerator, 0 when the rate is not known
+        /// </summary>
+        public int RateNumerator
+        {
+            get { return m_info.RateNum; }
+        }
+
+        public int RateDenominator
+        {
+            get { return m_info.RateDen; }
+        }
+
+        public long FrameCount
+        {
+            get { return m_info.FrameCount; }
+        }
+
+        /// <summary>
+        /// Gets timestamp of an image
+        /// </summary>
+        /// <param name="frame"></param>
+        /// <returns></returns>
+        public TimeSpan GetTimestamp(long frame)
+        {
+            long ticks;
+            if (TaygetaNative.tn_seq_get_timestamp(Handle, frame, out ticks) != 0)
+            {
+                throw new ArgumentOutOfRangeException("frame", TaygetaNative.GetLastError());
+            }
+            return new TimeSpan(ticks);
+        }
+
+        /// <summary>
+        /// Finds last image at or before the timestamp
+        /// </summary>
+        /// <param name="timestamp"></param>
+        /// <returns>Frame number, -1 when the timestamp precedes the first image</returns>
+        public long FindFrame(TimeSpan timestamp)
+        {
+            return TaygetaNative.tn_seq_find_frame(Handle, timestamp.Ticks);
+        }
+
+        /// <summary>
+        /// Maps an image from the file. Pixel data is paged in on first access; writing to the image
+        /// never changes the file.
+        /// </summary>
+        /// <param name="frame"></param>
+        /// <returns></returns>
+        public PlanarImage ReadFrame(long frame)
+        {
+            IntPtr native = TaygetaNative.tn_seq_read(Handle, frame);
+            if (native == IntPtr.Zero)
+            {
+                throw new IOException(TaygetaNative.GetLastError());
+            }
+            return new PlanarImage(native);
+        }
+
+        /// <summary>
+        /// Closes the file, images already read stay valid
+        /// </summary>
+        public void Dispose()
+        {
+            if (m_reader != IntPtr.Zero)
+            {
+                TaygetaNative.tn_seq_close_reader(m_reader);
+                m_reader = IntPtr.Zero;
+            }
+            GC.SuppressFinalize(this);
+        }
+
+        ~RawSequenceReader()
+        {
+            if (m_reader != IntPtr.Zero)
+            {
+                TaygetaNative.tn_seq_close_reader(m_reader);
+            }
+        }
+
+        private IntPtr Handle
+        {
+            get
+            {
+                if (m_reader == IntPtr.Zero)
+                {
+                    throw new ObjectDisposedException("RawSequenceReader");
+                }
+                return m_reader;
+            }
+        }
+    }
+}
@@ -0,0 +1,48 @@
+﻿using System;
+using System.Drawing;
+using System.Drawing.Imaging;
+
+namespace Taygeta.Imaging
+{
+    static class Rotator
+    {
+        // Rotations and flips keep the pixel type: planar and packed YUV the native kernels cover
+        // move plane to plane in cache-sized tiles, anything else goes through a Bitmap
+        public static PlanarImage Rotate(PlanarImage source, RotateFlipType type, int threads)
+        {
+            bool swap = IsQuarterTurn(type);
+            PlanarImage result = new PlanarImage(swap ? source.Height : source.Width, swap ? source.Width : source.Height, source.PixelType);
+            if (RotateNative(source, result, type, threads))
+            {
+                return result;
+            }
+
+            result.Dispose();
+            using (Bitmap bitmap = ConverterResizer.ToBitmap(source, PixelFormat.Format32bppArgb))
+            {
+                bitmap.RotateFlip(type);
+                return ConverterResizer.FromBitmap(bitmap, source.PixelType);
+            }
+        }
+
+        private static bool IsQuarterTurn(RotateFlipType type)
+        {
+            return type == RotateFlipType.Rotate90FlipNone || type == RotateFlipType.Rotate270FlipNone ||
+                   type == RotateFlipType.Rotate90FlipX || type == RotateFlipType.Rotate270FlipX;
+        }
+
+        // Returns false for pixel types the native kernels do not cover and sizes off the chroma blocks
+        private static bool RotateNative(PlanarImage source, PlanarImage target, RotateFlipType type, int threads)
+        {
+            int format = TaygetaNative.GetFrameFormat(source.PixelType);
+            int result = TaygetaNative.tn_rotate(source.Width, source.Height, format, source.Planes, source.Pitches, source.Lines,
+                                                 target.Width, target.Height, target.Planes, target.Pitches, target.Lines,
+                                                 (int)type, threads);
+            if (result < 0)
+            {
+                throw new InvalidOperationException(TaygetaNative.GetLastError());
+            }
+            return result == 0;
+        }
+    }
+}
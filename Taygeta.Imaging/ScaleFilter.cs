@@ -0,0 +1,31 @@
+﻿using System;
+
+namespace Taygeta.Imaging
+{
+    /// <summary>
+    /// Resampling filters of the native scaler, see ConverterResizer.Apply. Each widens with the
+    /// reduction when shrinking.
+    /// </summary>
+    public enum ScaleFilter
+    {
+        /// <summary>
+        /// Linear interpolation between the two nearest samples
+        /// </summary>
+        Bilinear,
+
+        /// <summary>
+        /// Cubic over the four nearest samples, the SWS_BICUBIC filter of swscale
+        /// </summary>
+        Bicubic,
+
+        /// <summary>
+        /// Lanczos over the six nearest samples, sharper than bicubic with slight ringing
+        /// </summary>
+        Lanczos3,
+
+        /// <summary>
+        /// Mean of the samples each target sample covers, bilinear when enlarging
+        /// </summary>
+        Area
+    }
+}
@@ -0,0 +1,306 @@
+using System;
+using System.Collections.Generic;
+using FFMPEG;
+
+namespace Taygeta.Imaging
+{
+    /// <summary>
+    /// Usage counters of the scaler context cache
+    /// </summary>
+    public struct ScalerCacheStatistics
+    {
+        /// <summary>
+        /// Scales served by an idle context of the same settings
+        /// </summary>
+        public long Hits;
+
+        /// <summary>
+        /// Scales that had to create a context
+        /// </summary>
+        public long Misses;
+
+        /// <summary>
+        /// Idle contexts freed to stay within the capacity
+        /// </summary>
+        public long Evictions;
+
+        /// <summary>
+        /// Contexts waiting for reuse
+        /// </summary>
+        public int Idle;
+
+        /// <summary>
+        /// Contexts taken by scales running now
+        /// </summary>
+        public int InUse;
+    }
+
+    /// <summary>
+    /// Settings a swscale context is made for. Contexts with equal keys produce the same output.
+    /// </summary>
+    internal struct ScalerKey : IEquatable<ScalerKey>
+    {
+        public int SourceWidth, SourceHeight, TargetWidth, TargetHeight;
+        public SwScale.SwsPixelFormat SourceFormat, TargetFormat;
+        public SwScale.ConvertionFlags Flags;
+        public ColorSpace Colorspace;
+
+        // Take the YUV samples of that side as 0..255 rather than 16..235
+        public bool SourceFullRange, TargetFullRange;
+
+        public ScalerKey(int sourceWidth, int sourceHeight, SwScale.SwsPixelFormat sourceFormat,
+                         int targetWidth, int targetHeight, SwScale.SwsPixelFormat targetFormat, SwScale.ConvertionFlags flags)
+        {
+            SourceWidth = sourceWidth;
+            SourceHeight = sourceHeight;
+            SourceFormat = sourceFormat;
+            TargetWidth = targetWidth;
+            TargetHeight = targetHeight;
+            TargetFormat = targetFormat;
+            Flags = flags;
+            Colorspace = ColorSpace.DEFAULT;
+            SourceFullRange = false;
+            TargetFullRange = false;
+        }
+
+        public bool Equals(ScalerKey other)
+        {
+            return SourceWidth == other.SourceWidth && SourceHeight == other.SourceHeight && SourceFormat == other.SourceFormat &&
+                   TargetWidth == other.TargetWidth && TargetHeight == other.TargetHeight && TargetFormat == other.TargetFormat &&
+                   Flags == other.Flags && Colorspace == other.Colorspace &&
+                   SourceFullRange == other.SourceFullRange && TargetFullRange == other.TargetFullRange;
+        }
+
+        public override bool Equals(object obj)
+        {
+            return obj is ScalerKey && Equals((ScalerKey)obj);
+        }
+
+        public override int GetHashCode()
+        {
+            int hash = SourceWidth;
+            hash = hash * 31 + SourceHeight;
+            hash = hash * 31 + (int)SourceFormat;
+            hash = hash * 31 + TargetWidth;
+            hash = hash * 31 + TargetHeight;
+            hash = hash * 31 + (int)TargetFormat;
+            hash = hash * 31 + (int)Flags;
+            hash = hash * 31 + (int)Colorspace;
+            return hash * 4 + (SourceFullRange ? 2 : 0) + (TargetFullRange ? 1 : 0);
+        }
+    }
+
+    /// <summary>
+    /// Process wide cache of swscale contexts, so that filter setup is paid once per set of sizes,
+    /// formats and colorspace rather than once per frame. A scale takes a context out of the cache
+    /// and puts it back when done: a context is never used by two threads at once, and threads
+    /// scaling alike at the same time each get one of their own. Idle contexts beyond the capacity
+    /// are freed least recently used first.
+    /// </summary>
+    public static class ScalerCache
+    {
+        class IdleContext
+        {
+            public ScalerKey Key;
+            public IntPtr Context;
+        }
+
+        static readonly object m_lock = new object();
+
+        // Idle contexts from least to most recently released, and the nodes of each key in the same order
+        static LinkedList<IdleContext> m_idle = new LinkedList<IdleContext>();
+        static Dictionary<ScalerKey, List<LinkedListNode<IdleContext>>> m_byKey = new Dictionary<ScalerKey, List<LinkedListNode<IdleContext>>>();
+
+        static int m_capacity = 32;
+        static int m_inUse;
+        static long m_hits, m_misses, m_evictions;
+
+        /// <summary>
+        /// Gets current cache counters
+        /// </summary>
+        public static ScalerCacheStatistics Statistics
+        {
+            get
+            {
+                lock (m_lock)
+                {
+                    ScalerCacheStatistics stats;
+                    stats.Hits = m_hits;
+                    stats.Misses = m_misses;
+                    stats.Evictions = m_evictions;
+                    stats.Idle = m_idle.Count;
+                    stats.InUse = m_inUse;
+                    return stats;
+                }
+            }
+        }
+
+        /// <summary>
+        /// Gets or sets the number of idle contexts kept, 32 by default. 0 frees every context after use.
+        /// </summary>
+        public static int Capacity
+        {
+            get
+            {
+                return m_capacity;
+            }
+            set
+            {
+                if (value < 0)
+                {
+                    throw new ArgumentOutOfRangeException("value");
+                }
+
+                List<IntPtr> evicted;
+                lock (m_lock)
+                {
+                    m_capacity = value;
+                    evicted = Evict();
+                }
+                Free(evicted);
+            }
+        }
+
+        /// <summary>
+        /// Frees all idle contexts. Contexts in use are freed when they come back over the capacity.
+        /// </summary>
+        public static void Clear()
+        {
+            List<IntPtr> evicted = new List<IntPtr>();
+            lock (m_lock)
+            {
+                foreach (IdleContext idle in m_idle)
+                {
+                    evicted.Add(idle.Context);
+                }
+                m_idle.Clear();
+                m_byKey.Clear();
+            }
+            Free(evicted);
+        }
+
+        /// <summary>
+        /// Takes an idle context made for key, or creates one. Every context taken must be given back
+        /// with Release.
+        /// </summary>
+        internal static IntPtr Acquire(ScalerKey key)
+        {
+            lock (m_lock)
+            {
+                List<LinkedListNode<IdleContext>> nodes;
+                if (m_byKey.TryGetValue(key, out nodes))
+                {
+                    LinkedListNode<IdleContext> node = nodes[nodes.Count - 1];
+                    nodes.RemoveAt(nodes.Count - 1);
+                    if (nodes.Count == 0)
+                    {
+                        m_byKey.Remove(key);
+                    }
+                    m_idle.Remove(node);
+
+                    m_hits++;
+                    m_inUse++;
+                    return node.Value.Context;
+                }
+                m_misses++;
+            }
+
+            // Filter setup runs outside the lock
+            IntPtr context = CreateContext(key);
+            lock (m_lock)
+            {
+                m_inUse++;
+            }
+            return context;
+        }
+
+        /// <summary>
+        /// Gives a context taken with Acquire back for reuse
+        /// </summary>
+        internal static void Release(ScalerKey key, IntPtr context)
+        {
+            List<IntPtr> evicted;
+            lock (m_lock)
+            {
+                m_inUse--;
+
+                IdleContext idle = new IdleContext();
+                idle.Key = key;
+                idle.Context = context;
+                LinkedListNode<IdleContext> node = m_idle.AddLast(idle);
+
+                List<LinkedListNode<IdleContext>> nodes;
+                if (!m_byKey.TryGetValue(key, out nodes))
+                {
+                    nodes = new List<LinkedListNode<IdleContext>>();
+                    m_byKey.Add(key, nodes);
+                }
+                nodes.Add(node);
+
+                evicted = Evict();
+            }
+            Free(evicted);
+        }
+
+        static unsafe IntPtr CreateContext(ScalerKey key)
+        {
+            IntPtr context = SwScale.sws_getContext(key.SourceWidth, key.SourceHeight, key.SourceFormat,
+                                                    key.TargetWidth, key.TargetHeight, key.TargetFormat,
+                                                    key.Flags, IntPtr.Zero, IntPtr.Zero, IntPtr.Zero);
+            if (context == IntPtr.Zero)
+            {
+                throw new InvalidOperationException("Context initialization failed. Supplied arguments may be invalid");
+            }
+
+            int* pCoef = SwScale.sws_getCoefficients(key.Colorspace);
+            int* inv_table;
+            int* table;
+            int srcRange, dstRange, brightness, contrast, saturation;
+
+            int result = SwScale.sws_getColorspaceDetails(context, out inv_table, out srcRange, out table, out dstRange, out brightness, out contrast, out saturation);
+            if (result != -1)
+            {
+                SwScale.sws_setColorspaceDetails(context, pCoef, key.SourceFullRange ? 1 : srcRange, pCoef, key.TargetFullRange ? 1 : dstRange,
+                                                 brightness, contrast, saturation);
+            }
+            return context;
+        }
+
+        // Unlinks the least recently used idle contexts beyond the capacity, to be freed outside the lock
+        static List<IntPtr> Evict()
+        {
+            List<IntPtr> evicted = null;
+            while (m_idle.Count > m_capacity)
+            {
+                LinkedListNode<IdleContext> node = m_idle.First;
+                m_idle.RemoveFirst();
+
+                List<LinkedListNode<IdleContext>> nodes = m_byKey[node.Value.Key];
+                nodes.RemoveAt(0);
+                if (nodes.Count == 0)
+                {
+                    m_byKey.Remove(node.Value.Key);
+                }
+
+                if (evicted == null)
+                {
+                    evicted = new List<IntPtr>();
+                }
+                evicted.Add(node.Value.Context);
+                m_evictions++;
+            }
+            return evicted;
+        }
+
+        static void Free(List<IntPtr> contexts)
+        {
+            if (contexts != null)
+            {
+                foreach (IntPtr context in contexts)
+                {
+                    SwScale.sws_freeContext(context);
+                }
+            }
+        }
+    }
+}
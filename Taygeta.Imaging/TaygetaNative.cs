@@ -0,0 +1,254 @@
+﻿using System;
+using System.Runtime.InteropServices;
+using System.Security;
+
+namespace Taygeta.Imaging
+{
+    [SuppressUnmanagedCodeSecurity]
+    internal static class TaygetaNative
+    {
+        const string libraryName = "Taygeta.Native.dll";
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl, EntryPoint = "tn_get_last_error")]
+        private static extern IntPtr tn_get_last_error_ptr();
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr tn_pool_alloc(UIntPtr size);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void tn_pool_free(IntPtr data);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void tn_pool_trim();
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void tn_pool_set_max_idle(long bytes);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int tn_pool_set_allocator(int largePages, int numaLocal);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void tn_pool_get_stats(out FramePoolStatistics stats);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void tn_frame_release(IntPtr frame);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void tn_frame_get_info(IntPtr frame, out FrameInfo info);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr tn_frame_adopt(int format, int width, int height, IntPtr[] planes, int[] pitches, int[] lines);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr tn_frame_clone(IntPtr frame);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr tn_frame_clone_shared(IntPtr frame);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int tn_frame_lease_write(IntPtr frame);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr tn_frame_flip(IntPtr frame);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void tn_copy_plane(IntPtr dst, int dstPitch, IntPtr src, int srcPitch, int rowBytes, int lines);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int tn_get_cpu_features();
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void tn_set_cpu_feature_mask(int mask);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int tn_can_convert(int srcFormat, int dstFormat);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int tn_convert(int width, int height, int srcFormat, IntPtr[] srcPlanes, int[] srcPitches, int[] srcLines,
+                                            int dstFormat, IntPtr[] dstPlanes, int[] dstPitches, int[] dstLines);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int tn_can_convert_to_rgb(int srcFormat);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int tn_convert_to_rgb(int width, int height, int srcFormat, IntPtr[] srcPlanes, int[] srcPitches, int[] srcLines,
+                                                   IntPtr dst, int dstPitch, RgbLayout layout, int matrix, int fullRange,
+                                                   [In] ToneMap[] tone, int threads);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int tn_can_convert_from_rgb(int dstFormat);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int tn_convert_from_rgb(int width, int height, IntPtr src, int srcPitch, RgbLayout layout,
+                                                     int dstFormat, IntPtr[] dstPlanes, int[] dstPitches, int[] dstLines, int matrix, int fullRange, int threads);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int tn_can_scale(int srcFormat, int dstFormat);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int tn_scale(int srcWidth, int srcHeight, int srcFormat, IntPtr[] srcPlanes, int[] srcPitches, int[] srcLines,
+                                          int x, int y, int rectWidth, int rectHeight,
+                                          int dstWidth, int dstHeight, int dstFormat, IntPtr[] dstPlanes, int[] dstPitches, int[] dstLines,
+                                          int filter, int threads);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int tn_reduce(int srcWidth, int srcHeight, int format, IntPtr[] srcPlanes, int[] srcPitches, int[] srcLines,
+                                           int dstWidth, int dstHeight, IntPtr[] dstPlanes, int[] dstPitches, int[] dstLines, int threads);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int tn_rotate(int srcWidth, int srcHeight, int format, IntPtr[] srcPlanes, int[] srcPitches, int[] srcLines,
+                                           int dstWidth, int dstHeight, IntPtr[] dstPlanes, int[] dstPitches, int[] dstLines,
+                                           int rotation, int threads);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int tn_tone_map(double brightness, double contrast, double gamma, double saturation, int fullRange, out ToneMap map);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int tn_can_adjust_tone(int format);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int tn_adjust_tone(int width, int height, int format, IntPtr[] planes, int[] pitches, int[] lines,
+                                                ref ToneMap map, int threads);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi, BestFitMapping = false)]
+        public static extern int tn_raw_write(string path, int format, int width, int height, IntPtr[] planes, int[] pitches);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi, BestFitMapping = false)]
+        public static extern IntPtr tn_raw_map(string path);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi, BestFitMapping = false)]
+        public static extern IntPtr tn_seq_create(string path, int container, int format, int width, int height, int rateNum, int rateDen);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int tn_seq_append(IntPtr writer, int format, int width, int height, IntPtr[] planes, int[] pitches, long timestamp);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int tn_seq_close_writer(IntPtr writer);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi, BestFitMapping = false)]
+        public static extern IntPtr tn_seq_open(string path, int readahead);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void tn_seq_get_info(IntPtr reader, out SequenceInfo info);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int tn_seq_get_timestamp(IntPtr reader, long frame, out long timestamp);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern long tn_seq_find_frame(IntPtr reader, long timestamp);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern IntPtr tn_seq_read(IntPtr reader, long frame);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void tn_seq_close_reader(IntPtr reader);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi, BestFitMapping = false)]
+        public static extern IntPtr tn_ring_create(string name, int slots, int format, int width, int height);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int tn_ring_write(IntPtr writer, int format, int width, int height, IntPtr[] planes, int[] pitches, long timestamp);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void tn_ring_get_writer_stats(IntPtr writer, out FrameRingStats stats);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void tn_ring_close_writer(IntPtr writer);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl, CharSet = CharSet.Ansi, BestFitMapping = false)]
+        public static extern IntPtr tn_ring_open(string name);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void tn_ring_get_format(IntPtr reader, out int format, out int width, out int height);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern int tn_ring_read(IntPtr reader, int timeoutMs, out IntPtr frame, out long sequence, out long timestamp);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void tn_ring_get_reader_stats(IntPtr reader, out FrameRingStats stats);
+
+        [DllImport(libraryName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void tn_ring_close_reader(IntPtr reader);
+
+        /// <summary>
+        /// Message of the last failed native call on this thread
+        /// </summary>
+        public static string GetLastError()
+        {
+            return Marshal.PtrToStringAnsi(tn_get_last_error_ptr());
+        }
+
+        /// <summary>
+        /// Native frame format of a pixel type. PlanarImage keeps YV12 chroma in U, V order, which is I420 to the native side.
+        /// </summary>
+        public static int GetFrameFormat(PixelAlignmentType pixelType)
+        {
+            return (int)(pixelType == PixelAlignmentType.YV12 ? PixelAlignmentType.I420 : pixelType);
+        }
+
+        /// <summary>
+        /// Allocates plane memory from the native frame pool
+        /// </summary>
+        public static IntPtr AllocPlane(int size)
+        {
+            IntPtr data = tn_pool_alloc(new UIntPtr((uint)size));
+            if (data == IntPtr.Zero)
+            {
+                throw new OutOfMemoryException("Failed to allocate pixel plane of " + size + " bytes");
+            }
+            return data;
+        }
+    }
+
+    // Packed RGB byte orders of the native conversions
+    internal enum RgbLayout : int
+    {
+        BGR24 = 0,
+        BGRA,
+        RGBA,
+        ARGB
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct FrameInfo
+    {
+        public int Width;
+        public int Height;
+        public int Format;
+        public int Planes;
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 4)]
+        public IntPtr[] Data;
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 4)]
+        public int[] Pitches;
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 4)]
+        public int[] Lines;
+    }
+
+    // Luma curve and chroma gain in 1/128 of a tone adjustment
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct ToneMap
+    {
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 256)]
+        public byte[] Luma;
+        public int ChromaGain;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct SequenceInfo
+    {
+        public int Container;
+        public int Format;
+        public int Width;
+        public int Height;
+        public int RateNum;
+        public int RateDen;
+        public long FrameCount;
+    }
+
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct FrameRingStats
+    {
+        public long Frames;
+        public long Dropped;
+    }
+}
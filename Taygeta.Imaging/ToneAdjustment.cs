@@ -0,0 +1,175 @@
+﻿using System;
+
+namespace Taygeta.Imaging
+{
+    /// <summary>
+    /// Brightness, contrast, gamma and saturation of 8-bit YUV images. Luma goes through a curve and
+    /// chroma is scaled around 128, in place with PlanarImage.AdjustTone or on the way into a bitmap
+    /// with PlanarImage.ToBitmap, without a pass through RGB.
+    /// </summary>
+    public sealed class ToneAdjustment
+    {
+        private double m_brightness = 0;
+        private double m_contrast = 1;
+        private double m_gamma = 1;
+        private double m_saturation = 1;
+        private bool m_fullRange = false;
+
+        // Built by the native library on first use after a change
+        private ToneMap[] m_map;
+
+        /// <summary>
+        /// Added to luma last, in parts of black to white: -1 makes everything black, 0 leaves it
+        /// </summary>
+        public double Brightness
+        {
+            get { return m_brightness; }
+            set
+            {
+                if (double.IsNaN(value))
+                {
+                    throw new ArgumentOutOfRangeException("value");
+                }
+                m_brightness = value;
+                m_map = null;
+            }
+        }
+
+        /// <summary>
+        /// Scales luma around mid gray and chroma around 128, 1 leaves them
+        /// </summary>
+        public double Contrast
+        {
+            get { return m_contrast; }
+            set
+            {
+                if (!(value >= 0))
+                {
+                    throw new ArgumentOutOfRangeException("value");
+                }
+                m_contrast = value;
+                m_map = null;
+            }
+        }
+
+        /// <summary>
+        /// Bends luma between black and white; above 1 lifts the mid tones, 1 leaves them
+        /// </summary>
+        public double Gamma
+        {
+            get { return m_gamma; }
+            set
+            {
+                if (!(value > 0))
+                {
+                    throw new ArgumentOutOfRangeException("value");
+                }
+                m_gamma = value;
+                m_map = null;
+            }
+        }
+
+        /// <summary>
+        /// Scales chroma around 128 on top of the contrast, 0 makes the image gray and 1 leaves it
+        /// </summary>
+        public double Saturation
+        {
+            get { return m_saturation; }
+            set
+            {
+                if (!(value >= 0))
+                {
+                    throw new ArgumentOutOfRangeException("value");
+                }
+                m_saturation = value;
+                m_map = null;
+            }
+        }
+
+        /// <summary>
+        /// Takes luma as 0..255 rather than 16..235
+        /// </summary>
+        public bool FullRange
+        {
+            get { return m_fullRange; }
+            set
+            {
+                m_fullRange = value;
+                m_map = null;
+            }
+        }
+
+        /// <summary>
+        /// True for pixel types the adjustment covers: Y800, YUV, YUY2, UYVY, YV12, I420, NV12, NV21,
+        /// Y411 and Y410
+        /// </summary>
+        public static bool IsSupported(PixelAlignmentType pixelType)
+        {
+            return TaygetaNative.tn_can_adjust_tone(TaygetaNative.GetFrameFormat(pixelType)) != 0;
+        }
+
+        // A single element array, so it can stand for a null map in tn_convert_to_rgb
+        internal ToneMap[] GetMap()
+        {
+            ToneMap[] map = m_map;
+            if (map == null)
+            {
+                map = new ToneMap[1];
+                if (TaygetaNative.tn_tone_map(m_brightness, m_contrast, m_gamma, m_saturation, m_fullRange ? 1 : 0, out map[0]) < 0)
+                {
+                    throw new InvalidOperationException(TaygetaNative.GetLastError());
+                }
+                m_map = map;
+            }
+            return map;
+        }
+
+        // Adjusts the planes of image in place, which the caller holds the write lease of. Sizes the
+        // native kernels refuse, where the managed planes round chroma down, take the same map here.
+        internal void Apply(PlanarImage image, int threads)
+        {
+            int format = TaygetaNative.GetFrameFormat(image.PixelType);
+            if (TaygetaNative.tn_can_adjust_tone(format) == 0)
+            {
+                throw new NotSupportedException("Tone adjustment needs 8-bit YUV images");
+            }
+
+            ToneMap[] map = GetMap();
+            int result = TaygetaNative.tn_adjust_tone(image.Width, image.Height, format, image.Planes, image.Pitches, image.Lines,
+                                                      ref map[0], threads);
+            if (result < 0)
+            {
+                throw new InvalidOperationException(TaygetaNative.GetLastError());
+            }
+            if (result > 0)
+            {
+                ApplyManaged(image, map[0]);
+            }
+        }
+
+        private static unsafe void ApplyManaged(PlanarImage image, ToneMap map)
+        {
+            bool packed = image.PixelType == PixelAlignmentType.YUY2 || image.PixelType == PixelAlignmentType.UYVY;
+            int lumaByte = image.PixelType == PixelAlignmentType.UYVY ? 1 : 0;
+            for (int p = 0; p < image.NumberOfPlanes; p++)
+            {
+                int bytes = Math.Abs(image.Pitches[p]);
+                for (int y = 0; y < image.Lines[p]; y++)
+                {
+                    byte* row = (byte*)image.Planes[p] + (long)y * image.Pitches[p];
+                    for (int x = 0; x < bytes; x++)
+                    {
+                        bool luma = packed ? (x & 1) == lumaByte : p == 0;
+                        row[x] = luma ? map.Luma[row[x]] : ScaleChroma(row[x], map.ChromaGain);
+                    }
+                }
+            }
+        }
+
+        private static byte ScaleChroma(byte c, int gain)
+        {
+            int v = 128 + (((c - 128) * gain + 64) >> 7);
+            return (byte)(v < 0 ? 0 : v > 255 ? 255 : v);
+        }
+    }
+}
@@ -0,0 +1,100 @@
+#include "CpuFeatures.h"
+
+#ifdef CPU_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// Detection runs once; threads racing to it store the same value
+static volatile int s_detected = -1;
+static volatile int s_mask = CPU_ALL;
+
+#ifdef CPU_X86
+
+static void GetCpuid(int leaf, int regs[4])
+{
+#ifdef _MSC_VER
+	__cpuidex(regs, leaf, 0);
+#else
+	unsigned int a, b, c, d;
+	__cpuid_count(leaf, 0, a, b, c, d);
+	regs[0] = a;
+	regs[1] = b;
+	regs[2] = c;
+	regs[3] = d;
+#endif
+}
+
+// XCR0 tells which register states the system saves on context switches
+static unsigned long long GetXcr0(void)
+{
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	unsigned int a, d;
+	__asm__ __volatile__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+	return ((unsigned long long)d << 32) | a;
+#endif
+}
+
+static int DetectCpuFeatures(void)
+{
+	int regs[4];
+	GetCpuid(0, regs);
+	int maxLeaf = regs[0];
+
+	GetCpuid(1, regs);
+	int features = 0;
+	if(regs[3] & (1 << 26))
+	{
+		features |= CPU_SSE2;
+	}
+	if(regs[2] & (1 << 9))
+	{
+		features |= CPU_SSSE3;
+	}
+
+	// AVX2 needs OSXSAVE and the XMM and YMM states enabled besides the CPUID bit
+	bool osxsave = (regs[2] & (1 << 27)) != 0;
+	if(maxLeaf >= 7 && osxsave && (GetXcr0() & 6) == 6)
+	{
+		GetCpuid(7, regs);
+		if(regs[1] & (1 << 5))
+		{
+			features |= CPU_AVX2;
+		}
+
+		// AVX512F, AVX512BW and AVX512_VBMI, with the opmask and both halves of ZMM saved
+		if((regs[1] & (1 << 16)) && (regs[1] & (1 << 30)) && (regs[2] & (1 << 1)) && (GetXcr0() & 0xe6) == 0xe6)
+		{
+			features |= CPU_AVX512VBMI;
+		}
+	}
+	return features;
+}
+
+#else
+
+static int DetectCpuFeatures(void)
+{
+	return 0;
+}
+
+#endif
+
+int GetCpuFeatures(void)
+{
+	if(s_detected < 0)
+	{
+		s_detected = DetectCpuFeatures();
+	}
+	return s_detected & s_mask;
+}
+
+void SetCpuFeatureMask(int mask)
+{
+	s_mask = mask & CPU_ALL;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "NativeLib.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define CPU_X86
+#endif
+
+// GCC and Clang only emit the instructions of a set inside functions that ask for it,
+// MSVC compiles intrinsics of any set anywhere
+#if defined(CPU_X86) && defined(__GNUC__)
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512VBMI __attribute__((target("avx512f,avx512bw,avx512vbmi")))
+#else
+#define TARGET_SSSE3
+#define TARGET_AVX2
+#define TARGET_AVX512VBMI
+#endif
+
+enum CpuFeature
+{
+	CPU_SSE2 = 1,
+	CPU_SSSE3 = 2,
+	CPU_AVX2 = 4,
+	CPU_AVX512VBMI = 8,		// with AVX512F and AVX512BW
+
+	CPU_ALL = CPU_SSE2 | CPU_SSSE3 | CPU_AVX2 | CPU_AVX512VBMI
+};
+
+// Instruction sets the kernels may use: those the processor reports, AVX2 only when the
+// system saves the YMM registers and AVX-512 only when it saves the ZMM ones, limited by
+// the feature mask
+NATIVELIB int GetCpuFeatures(void);
+
+// Limits the instruction sets kernels are picked from, 0 runs the scalar reference
+// kernels. Affects kernels looked up afterwards.
+NATIVELIB void SetCpuFeatureMask(int mask);
@@ -0,0 +1,379 @@
+#include "EncodedFrameRing.h"
+#include "NativeFile.h"
+#include "PlaneBuffer.h"
+#include "RefCount.h"
+
+#include <atomic>
+#include <vector>
+#include <string.h>
+#include <stdint.h>
+
+#define ENCODED_RING_NO_PIN (~(uint64_t)0)
+
+struct IndexEntry
+{
+	uint64_t Position;		// arena offset counted from the start of the stream
+	size_t Size;
+	int64_t Timestamp;
+};
+
+// Frames [tail, head) are in the ring. A snapshot pins the number of its first frame;
+// the writer drops a new frame rather than evict a pinned one. Index entries and arena
+// bytes of a frame are only reused after it was evicted, so readers use them in place.
+struct CEncodedFrameRing::State
+{
+	volatile long refCount;
+	BYTE* arena;
+	size_t capacity;
+	IndexEntry* index;
+	uint64_t maxFrames;
+
+	std::atomic<uint64_t> head;
+	std::atomic<uint64_t> tail;
+	std::atomic<uint64_t> pins[ENCODED_RING_MAX_SNAPSHOTS];
+	std::atomic<long long> appended;
+	std::atomic<long long> dropped;
+	std::atomic<long long> lastTimestamp;
+
+	// Written by the append thread only
+	uint64_t writePosition;
+
+	const IndexEntry& GetEntry(uint64_t frame) const
+	{
+		return index[frame % maxFrames];
+	}
+
+	// Evicts the oldest frame unless a snapshot holds it. The tail moves before the pins
+	// are checked and a snapshot checks the tail after pinning, so at least one of the two
+	// sees the other.
+	bool Evict(uint64_t frame)
+	{
+		tail.store(frame + 1);
+		for(int i = 0; i < ENCODED_RING_MAX_SNAPSHOTS; i++)
+		{
+			if(pins[i].load() <= frame)
+			{
+				tail.store(frame);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void Release(void)
+	{
+		if(AtomicDecrement(&refCount) == 0)
+		{
+			AlignedFree(arena);
+			delete[] index;
+			delete this;
+		}
+	}
+};
+
+struct CEncodedFrameSnapshot::State
+{
+	CEncodedFrameRing::State* ring;
+	int pin;
+	uint64_t first;
+	int count;
+};
+
+CEncodedFrameRing::CEncodedFrameRing(size_t capacity, int maxFrames)
+	: m_state(NULL)
+{
+	if(capacity == 0 || maxFrames <= 0)
+	{
+		throw "Ring capacity must be positive";
+	}
+
+	BYTE* arena = AlignedAlloc(capacity);
+	if(!arena)
+	{
+		throw "Failed to allocate ring";
+	}
+
+	try
+	{
+		m_state = new State();
+		m_state->index = new IndexEntry[maxFrames];
+	}
+	catch(...)
+	{
+		delete m_state;
+		AlignedFree(arena);
+		throw;
+	}
+
+	m_state->refCount = 1;
+	m_state->arena = arena;
+	m_state->capacity = capacity;
+	m_state->maxFrames = (uint64_t)maxFrames;
+	m_state->head.store(0);
+	m_state->tail.store(0);
+	for(int i = 0; i < ENCODED_RING_MAX_SNAPSHOTS; i++)
+	{
+		m_state->pins[i].store(ENCODED_RING_NO_PIN);
+	}
+	m_state->appended.store(0);
+	m_state->dropped.store(0);
+	m_state->lastTimestamp.store(0);
+	m_state->writePosition = 0;
+}
+
+CEncodedFrameRing::~CEncodedFrameRing(void)
+{
+	m_state->Release();
+}
+
+bool CEncodedFrameRing::Append(const BYTE* data, size_t size, long long timestamp)
+{
+	State* s = m_state;
+	uint64_t head = s->head.load();
+	uint64_t tail = s->tail.load();
+
+	if(head > 0 && timestamp < s->lastTimestamp.load())
+	{
+		throw "Timestamps must not decrease";
+	}
+	if(size == 0 || size > s->capacity)
+	{
+		s->dropped++;
+		return false;
+	}
+
+	// Frames are never split, one that does not fit before the end of the arena starts
+	// over at the beginning
+	uint64_t position = s->writePosition;
+	size_t offset = (size_t)(position % s->capacity);
+	if(offset + size > s->capacity)
+	{
+		position += s->capacity - offset;
+	}
+	uint64_t end = position + size;
+
+	while(tail < head && (end - s->GetEntry(tail).Position > s->capacity || head - tail >= s->maxFrames))
+	{
+		if(!s->Evict(tail))
+		{
+			s->dropped++;
+			return false;
+		}
+		tail++;
+	}
+
+	memcpy(s->arena + position % s->capacity, data, size);
+	IndexEntry& entry = s->index[head % s->maxFrames];
+	entry.Position = position;
+	entry.Size = size;
+	entry.Timestamp = timestamp;
+	s->writePosition = end;
+
+	s->lastTimestamp.store(timestamp);
+	s->head.store(head + 1);
+	s->appended++;
+	return true;
+}
+
+CEncodedFrameSnapshot* CEncodedFrameRing::Snapshot(long long from, long long to)
+{
+	State* s = m_state;
+
+	int pin = -1;
+	for(int i = 0; i < ENCODED_RING_MAX_SNAPSHOTS && pin < 0; i++)
+	{
+		uint64_t expected = ENCODED_RING_NO_PIN;
+		if(s->pins[i].compare_exchange_strong(expected, s->tail.load()))
+		{
+			pin = i;
+		}
+	}
+	if(pin < 0)
+	{
+		throw "Too many open snapshots";
+	}
+
+	// The pin holds once the tail is seen at or below it after it was set
+	uint64_t first = s->pins[pin].load();
+	while(s->tail.load() > first)
+	{
+		first = s->tail.load();
+		s->pins[pin].store(first);
+	}
+	uint64_t last = s->head.load();
+
+	// Timestamps in the ring ascend, so the range is found by two binary searches
+	uint64_t lo = first;
+	uint64_t hi = last;
+	while(lo < hi)
+	{
+		uint64_t mid = lo + (hi - lo) / 2;
+		if(s->GetEntry(mid).Timestamp < from)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	uint64_t begin = lo;
+	hi = last;
+	while(lo < hi)
+	{
+		uint64_t mid = lo + (hi - lo) / 2;
+		if(s->GetEntry(mid).Timestamp <= to)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	// Frames before the range are not needed, moving the pin up lets the writer have them.
+	// An empty snapshot holds nothing and gives its pin back right away.
+	if(lo == begin)
+	{
+		s->pins[pin].store(ENCODED_RING_NO_PIN);
+		pin = -1;
+	}
+	else
+	{
+		s->pins[pin].store(begin);
+	}
+
+	CEncodedFrameSnapshot* snapshot = NULL;
+	try
+	{
+		snapshot = new CEncodedFrameSnapshot();
+		snapshot->m_state = new CEncodedFrameSnapshot::State();
+	}
+	catch(...)
+	{
+		delete snapshot;
+		if(pin >= 0)
+		{
+			s->pins[pin].store(ENCODED_RING_NO_PIN);
+		}
+		throw;
+	}
+
+	AtomicIncrement(&s->refCount);
+	snapshot->m_state->ring = s;
+	snapshot->m_state->pin = pin;
+	snapshot->m_state->first = begin;
+	snapshot->m_state->count = (int)(lo - begin);
+	return snapshot;
+}
+
+void CEncodedFrameRing::GetStats(EncodedRingStats* stats) const
+{
+	uint64_t tail = m_state->tail.load();
+	uint64_t head = m_state->head.load();
+	stats->Appended = m_state->appended.load();
+	stats->Dropped = m_state->dropped.load();
+	stats->Frames = head > tail ? (long long)(head - tail) : 0;
+	stats->FirstFrame = (long long)tail;
+	stats->LastTimestamp = m_state->lastTimestamp.load();
+}
+
+CEncodedFrameSnapshot::CEncodedFrameSnapshot(void)
+	: m_state(NULL)
+{
+}
+
+CEncodedFrameSnapshot::~CEncodedFrameSnapshot(void)
+{
+	if(m_state)
+	{
+		if(m_state->pin >= 0)
+		{
+			m_state->ring->pins[m_state->pin].store(ENCODED_RING_NO_PIN);
+		}
+		m_state->ring->Release();
+		delete m_state;
+	}
+}
+
+int CEncodedFrameSnapshot::GetCount(void) const
+{
+	return m_state->count;
+}
+
+void CEncodedFrameSnapshot::GetFrame(int index, EncodedFrame* frame) const
+{
+	if(index < 0 || index >= m_state->count)
+	{
+		throw "Frame index is out of range";
+	}
+
+	CEncodedFrameRing::State* ring = m_state->ring;
+	uint64_t number = m_state->first + index;
+	const IndexEntry& entry = ring->GetEntry(number);
+	frame->Data = ring->arena + entry.Position % ring->capacity;
+	frame->Size = entry.Size;
+	frame->Timestamp = entry.Timestamp;
+	frame->Number = (long long)number;
+}
+
+int CEncodedFrameSnapshot::Find(long long timestamp) const
+{
+	int lo = 0;
+	int hi = m_state->count;
+	while(lo < hi)
+	{
+		int mid = lo + (hi - lo) / 2;
+		if(m_state->ring->GetEntry(m_state->first + mid).Timestamp <= timestamp)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	return lo - 1;
+}
+
+unsigned long long CEncodedFrameSnapshot::WriteTo(const char* path) const
+{
+	// Frames that follow each other in the arena go out as one segment
+	std::vector<FileSegment> segments;
+	unsigned long long total = 0;
+	for(int i = 0; i < m_state->count; i++)
+	{
+		EncodedFrame frame;
+		GetFrame(i, &frame);
+		if(!segments.empty() && segments.back().Data + segments.back().Size == frame.Data)
+		{
+			segments.back().Size += frame.Size;
+		}
+		else
+		{
+			FileSegment segment;
+			segment.Data = frame.Data;
+			segment.Size = frame.Size;
+			segments.push_back(segment);
+		}
+		total += frame.Size;
+	}
+
+	CNativeFile* file = CNativeFile::Create(path);
+	try
+	{
+		if(!segments.empty())
+		{
+			file->Write(&segments[0], (int)segments.size());
+		}
+		file->Close();
+	}
+	catch(...)
+	{
+		delete file;
+		throw;
+	}
+	delete file;
+	return total;
+}
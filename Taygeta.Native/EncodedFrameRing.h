@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stddef.h>
+#include "NativeLib.h"
+
+#define ENCODED_RING_MAX_SNAPSHOTS 32
+
+struct EncodedFrame
+{
+	const BYTE* Data;
+	size_t Size;
+	long long Timestamp;
+	long long Number;		// position in the stream, counted from the first frame appended
+};
+
+struct EncodedRingStats
+{
+	long long Appended;
+	long long Dropped;		// larger than the ring, or the space was held by a snapshot
+	long long Frames;		// frames in the ring now
+	long long FirstFrame;	// number of the oldest frame in the ring
+	long long LastTimestamp;
+};
+
+class CEncodedFrameSnapshot;
+
+// Fixed size history of an encoded stream, such as the JPEG frames of one camera. Frames
+// are kept back to back in one arena with a timestamp index; appending a frame drops the
+// oldest ones once the arena or the index is full. Append never blocks and takes no lock;
+// it is called by a single writer thread while any number of threads take snapshots.
+class NATIVELIB CEncodedFrameRing
+{
+public:
+	CEncodedFrameRing(size_t capacity, int maxFrames);
+	virtual ~CEncodedFrameRing(void);
+
+	// Copies a frame in. Timestamps must not decrease. Returns false when the frame was
+	// dropped because it is larger than the ring or its space is still held by a snapshot.
+	bool Append(const BYTE* data, size_t size, long long timestamp);
+
+	// Frames with from <= timestamp <= to, found by binary search. The frames are left in
+	// place and kept from being overwritten until the snapshot is deleted, which may be
+	// after the ring.
+	CEncodedFrameSnapshot* Snapshot(long long from, long long to);
+
+	void GetStats(EncodedRingStats* stats) const;
+
+private:
+	friend class CEncodedFrameSnapshot;
+	struct State;
+	State* m_state;
+
+	CEncodedFrameRing(const CEncodedFrameRing&);
+	CEncodedFrameRing& operator=(const CEncodedFrameRing&);
+};
+
+class NATIVELIB CEncodedFrameSnapshot
+{
+public:
+	virtual ~CEncodedFrameSnapshot(void);
+
+	int GetCount(void) const;
+	void GetFrame(int index, EncodedFrame* frame) const;
+
+	// Last frame at or before the timestamp, -1 when it precedes the first one
+	int Find(long long timestamp) const;
+
+	// Writes the frames back to back to a new file straight from the ring, JPEG frames
+	// make a Motion JPEG stream. Returns the bytes written.
+	unsigned long long WriteTo(const char* path) const;
+
+private:
+	friend class CEncodedFrameRing;
+	CEncodedFrameSnapshot(void);
+	CEncodedFrameSnapshot(const CEncodedFrameSnapshot&);
+	CEncodedFrameSnapshot& operator=(const CEncodedFrameSnapshot&);
+
+	struct State;
+	State* m_state;
+};
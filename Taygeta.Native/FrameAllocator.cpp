@@ -0,0 +1,186 @@
+#include "FrameAllocator.h"
+#include "PlaneBuffer.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+#endif
+
+#define LARGE_PAGE_DEFAULT_SIZE (2 * 1024 * 1024)
+
+static CHeapFrameAllocator s_heapAllocator;
+
+BYTE* CHeapFrameAllocator::Allocate(size_t size, int)
+{
+	return AlignedAlloc(size);
+}
+
+void CHeapFrameAllocator::Free(BYTE* data, size_t, int)
+{
+	AlignedFree(data);
+}
+
+CHeapFrameAllocator* CHeapFrameAllocator::GetDefault(void)
+{
+	return &s_heapAllocator;
+}
+
+static CSystemFrameAllocator s_systemAllocators[3][2] =
+{
+	{ CSystemFrameAllocator(LP_NONE, false), CSystemFrameAllocator(LP_NONE, true) },
+	{ CSystemFrameAllocator(LP_TRANSPARENT, false), CSystemFrameAllocator(LP_TRANSPARENT, true) },
+	{ CSystemFrameAllocator(LP_EXPLICIT, false), CSystemFrameAllocator(LP_EXPLICIT, true) }
+};
+
+CSystemFrameAllocator* CSystemFrameAllocator::GetDefault(LargePageMode largePages, bool numaLocal)
+{
+	if(largePages < LP_NONE || largePages > LP_EXPLICIT)
+	{
+		throw "Unknown large page mode";
+	}
+	return &s_systemAllocators[largePages][numaLocal ? 1 : 0];
+}
+
+CSystemFrameAllocator::CSystemFrameAllocator(LargePageMode largePages, bool numaLocal)
+	: m_largePages(largePages), m_numaLocal(numaLocal), m_largePageSize(LARGE_PAGE_DEFAULT_SIZE)
+{
+#ifdef _WIN32
+	size_t minimum = GetLargePageMinimum();
+	if(minimum > 0)
+	{
+		m_largePageSize = minimum;
+	}
+#endif
+}
+
+bool CSystemFrameAllocator::UsesLargePages(size_t size) const
+{
+	return m_largePages != LP_NONE && size >= m_largePageSize / 2;
+}
+
+size_t CSystemFrameAllocator::GetMappedSize(size_t size) const
+{
+	return UsesLargePages(size) ? (size + m_largePageSize - 1) / m_largePageSize * m_largePageSize : size;
+}
+
+int CSystemFrameAllocator::GetNode(void) const
+{
+	if(!m_numaLocal)
+	{
+		return -1;
+	}
+
+#ifdef _WIN32
+	PROCESSOR_NUMBER processor;
+	USHORT node;
+	GetCurrentProcessorNumberEx(&processor);
+	return GetNumaProcessorNodeEx(&processor, &node) ? node : -1;
+#elif defined(__linux__)
+	unsigned cpu = 0;
+	unsigned node = 0;
+	return syscall(SYS_getcpu, &cpu, &node, NULL) == 0 ? (int)node : -1;
+#else
+	return -1;
+#endif
+}
+
+#ifdef _WIN32
+
+static BYTE* VirtualAllocOnNode(size_t size, DWORD type, int node)
+{
+	if(node >= 0)
+	{
+		return (BYTE*)VirtualAllocExNuma(GetCurrentProcess(), NULL, size, type, PAGE_READWRITE, (DWORD)node);
+	}
+	return (BYTE*)VirtualAlloc(NULL, size, type, PAGE_READWRITE);
+}
+
+BYTE* CSystemFrameAllocator::Allocate(size_t size, int node)
+{
+	size_t mapped = GetMappedSize(size);
+	BYTE* data = NULL;
+
+	// Large pages need the lock pages privilege, without it the allocation fails
+	if(m_largePages == LP_EXPLICIT && UsesLargePages(size) && GetLargePageMinimum() > 0)
+	{
+		data = VirtualAllocOnNode(mapped, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, node);
+	}
+	if(!data)
+	{
+		data = VirtualAllocOnNode(mapped, MEM_RESERVE | MEM_COMMIT, node);
+	}
+	return data;
+}
+
+void CSystemFrameAllocator::Free(BYTE* data, size_t, int)
+{
+	VirtualFree(data, 0, MEM_RELEASE);
+}
+
+#else
+
+BYTE* CSystemFrameAllocator::Allocate(size_t size, int node)
+{
+	size_t mapped = GetMappedSize(size);
+	void* data = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+	if(m_largePages == LP_EXPLICIT && UsesLargePages(size))
+	{
+		data = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	}
+#endif
+
+	if(data == MAP_FAILED && UsesLargePages(size))
+	{
+		// Transparent huge pages only back huge page aligned ranges, the mapping is made
+		// larger and cut down to an aligned one
+		BYTE* base = (BYTE*)mmap(NULL, mapped + m_largePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(base != (BYTE*)MAP_FAILED)
+		{
+			size_t head = (m_largePageSize - (size_t)base % m_largePageSize) % m_largePageSize;
+			if(head > 0)
+			{
+				munmap(base, head);
+			}
+			munmap(base + head + mapped, m_largePageSize - head);
+			data = base + head;
+#ifdef MADV_HUGEPAGE
+			madvise(data, mapped, MADV_HUGEPAGE);
+#endif
+		}
+	}
+
+	if(data == MAP_FAILED)
+	{
+		data = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(data == MAP_FAILED)
+		{
+			return NULL;
+		}
+	}
+
+#ifdef __linux__
+	// Pages are placed when first touched, which has not happened yet. The node is only
+	// preferred so that a full node falls back to others instead of failing.
+	if(node >= 0 && node < (int)(sizeof(unsigned long) * 8))
+	{
+		unsigned long mask = 1UL << node;
+		syscall(SYS_mbind, data, mapped, MPOL_PREFERRED, &mask, sizeof(mask) * 8, 0);
+	}
+#endif
+	return (BYTE*)data;
+}
+
+void CSystemFrameAllocator::Free(BYTE* data, size_t size, int)
+{
+	munmap(data, GetMappedSize(size));
+}
+
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stddef.h>
+#include "NativeLib.h"
+
+// Source of the blocks a frame pool hands out. Blocks remember the allocator they came
+// from, so an allocator must live as long as any of its blocks.
+class NATIVELIB IFrameAllocator
+{
+public:
+	virtual ~IFrameAllocator(void) {}
+
+	// Memory aligned to FRAME_ALIGNMENT; node is the one GetNode gave, or -1
+	virtual BYTE* Allocate(size_t size, int node) = 0;
+	virtual void Free(BYTE* data, size_t size, int node) = 0;
+
+	// NUMA node memory for the calling thread should come from, -1 when the allocator
+	// does not place memory. The pool only reuses blocks of the same node.
+	virtual int GetNode(void) const = 0;
+};
+
+// Aligned heap memory, the default of every pool
+class NATIVELIB CHeapFrameAllocator : public IFrameAllocator
+{
+public:
+	virtual BYTE* Allocate(size_t size, int node);
+	virtual void Free(BYTE* data, size_t size, int node);
+	virtual int GetNode(void) const { return -1; }
+
+	static CHeapFrameAllocator* GetDefault(void);
+};
+
+enum LargePageMode
+{
+	LP_NONE = 0,
+	LP_TRANSPARENT,		// transparent huge pages where the system has them
+	LP_EXPLICIT			// reserved huge pages (hugetlbfs, MEM_LARGE_PAGES), transparent ones otherwise
+};
+
+// Blocks mapped straight from the system, optionally backed by huge pages and placed on
+// the NUMA node of the thread that allocates them. Blocks of at least half a huge page
+// are rounded up to whole huge pages, smaller ones use normal pages. Explicit huge pages
+// fall back to the next best kind when none are reserved or, on Windows, the process
+// lacks the lock pages privilege; Windows has no transparent huge pages.
+class NATIVELIB CSystemFrameAllocator : public IFrameAllocator
+{
+public:
+	CSystemFrameAllocator(LargePageMode largePages, bool numaLocal);
+
+	virtual BYTE* Allocate(size_t size, int node);
+	virtual void Free(BYTE* data, size_t size, int node);
+	virtual int GetNode(void) const;
+
+	// Shared instance for each combination, never destroyed
+	static CSystemFrameAllocator* GetDefault(LargePageMode largePages, bool numaLocal);
+
+private:
+	bool UsesLargePages(size_t size) const;
+	size_t GetMappedSize(size_t size) const;
+
+	LargePageMode m_largePages;
+	bool m_numaLocal;
+	size_t m_largePageSize;
+};
@@ -0,0 +1,92 @@
+#include "FrameCopy.h"
+
+#include <string.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define FRAME_COPY_SSE2
+#endif
+
+#ifdef FRAME_COPY_SSE2
+
+static void StreamRow(BYTE* dst, const BYTE* src, size_t size)
+{
+	size_t head = (16 - ((size_t)dst & 15)) & 15;
+	head = head < size ? head : size;
+	memcpy(dst, src, head);
+	dst += head;
+	src += head;
+	size -= head;
+
+	for(; size >= 64; size -= 64, dst += 64, src += 64)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)src);
+		__m128i b = _mm_loadu_si128((const __m128i*)(src + 16));
+		__m128i c = _mm_loadu_si128((const __m128i*)(src + 32));
+		__m128i d = _mm_loadu_si128((const __m128i*)(src + 48));
+		_mm_stream_si128((__m128i*)dst, a);
+		_mm_stream_si128((__m128i*)(dst + 16), b);
+		_mm_stream_si128((__m128i*)(dst + 32), c);
+		_mm_stream_si128((__m128i*)(dst + 48), d);
+	}
+	for(; size >= 16; size -= 16, dst += 16, src += 16)
+	{
+		_mm_stream_si128((__m128i*)dst, _mm_loadu_si128((const __m128i*)src));
+	}
+	memcpy(dst, src, size);
+}
+
+#endif
+
+void CopyPlane(BYTE* dst, int dstPitch, const BYTE* src, int srcPitch, int rowBytes, int lines)
+{
+	if(lines <= 0 || rowBytes <= 0)
+	{
+		return;
+	}
+
+	// Rows of equal pitch are contiguous, the padding between them goes along. Bottom-up
+	// planes of equal pitch are copied as one block from their last row up.
+	int rows = lines;
+	size_t size = rowBytes;
+	if(dstPitch == srcPitch && (dstPitch >= rowBytes || -dstPitch >= rowBytes))
+	{
+		if(dstPitch < 0)
+		{
+			dst += (ptrdiff_t)dstPitch * (lines - 1);
+			src += (ptrdiff_t)srcPitch * (lines - 1);
+		}
+		size = (size_t)(dstPitch < 0 ? -dstPitch : dstPitch) * (lines - 1) + rowBytes;
+		rows = 1;
+	}
+
+#ifdef FRAME_COPY_SSE2
+	if((size_t)rowBytes * lines >= FRAME_COPY_STREAM_BYTES)
+	{
+		for(int y = 0; y < rows; y++)
+		{
+			StreamRow(dst + (ptrdiff_t)y * dstPitch, src + (ptrdiff_t)y * srcPitch, size);
+		}
+		_mm_sfence();
+		return;
+	}
+#endif
+
+	for(int y = 0; y < rows; y++)
+	{
+		memcpy(dst + (ptrdiff_t)y * dstPitch, src + (ptrdiff_t)y * srcPitch, size);
+	}
+}
+
+void CopyFrame(const CPlanarFrame* src, CPlanarFrame* dst)
+{
+	if(src->GetFormat() != dst->GetFormat() || src->GetWidth() != dst->GetWidth() || src->GetHeight() != dst->GetHeight())
+	{
+		throw "Frames differ in size or format";
+	}
+
+	for(int i = 0; i < src->GetPlaneCount(); i++)
+	{
+		CopyPlane(dst->GetPlane(i), dst->GetPitch(i), src->GetPlane(i), src->GetPitch(i), src->GetRowBytes(i), src->GetLines(i));
+	}
+}
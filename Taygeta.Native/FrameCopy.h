@@ -0,0 +1,14 @@
+#pragma once
+
+#include "NativeLib.h"
+#include "PlanarFrame.h"
+
+// Planes at least this large are copied with non-temporal stores, which write around the
+// cache instead of evicting what the caller is working on
+#define FRAME_COPY_STREAM_BYTES (1 << 20)
+
+// Copies rowBytes of every row; planes with equal pitches are copied as one block
+NATIVELIB void CopyPlane(BYTE* dst, int dstPitch, const BYTE* src, int srcPitch, int rowBytes, int lines);
+
+// Copies the pixels of a frame into another of the same size and format
+NATIVELIB void CopyFrame(const CPlanarFrame* src, CPlanarFrame* dst);
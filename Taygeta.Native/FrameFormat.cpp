@@ -0,0 +1,73 @@
+#include "FrameFormat.h"
+
+#include <stddef.h>
+
+#define PLANE(sx, sy, bw, bb) { sx, sy, bw, bb }
+#define NO_PLANE PLANE(0, 0, 1, 0)
+
+static const FrameFormatDesc s_formats[FF_COUNT] =
+{
+	{ "Y800",    1,  8, 1, false, { PLANE(0, 0, 1, 1), NO_PLANE, NO_PLANE, NO_PLANE } },
+	{ "Y16",     1, 16, 2, false, { PLANE(0, 0, 1, 2), NO_PLANE, NO_PLANE, NO_PLANE } },
+	{ "YUV",     3, 24, 1, false, { PLANE(0, 0, 1, 1), PLANE(0, 0, 1, 1), PLANE(0, 0, 1, 1), NO_PLANE } },
+	{ "YUY2",    1, 16, 1, false, { PLANE(0, 0, 2, 4), NO_PLANE, NO_PLANE, NO_PLANE } },
+	{ "UYVY",    1, 16, 1, false, { PLANE(0, 0, 2, 4), NO_PLANE, NO_PLANE, NO_PLANE } },
+	{ "YV12",    3, 12, 1, false, { PLANE(0, 0, 1, 1), PLANE(1, 1, 1, 1), PLANE(1, 1, 1, 1), NO_PLANE } },
+	{ "I420",    3, 12, 1, false, { PLANE(0, 0, 1, 1), PLANE(1, 1, 1, 1), PLANE(1, 1, 1, 1), NO_PLANE } },
+	{ "NV12",    2, 12, 1, false, { PLANE(0, 0, 1, 1), PLANE(1, 1, 1, 2), NO_PLANE, NO_PLANE } },
+	{ "NV21",    2, 12, 1, false, { PLANE(0, 0, 1, 1), PLANE(1, 1, 1, 2), NO_PLANE, NO_PLANE } },
+	{ "Y411",    3, 12, 1, false, { PLANE(0, 0, 1, 1), PLANE(2, 0, 1, 1), PLANE(2, 0, 1, 1), NO_PLANE } },
+	{ "Y410",    3,  9, 1, false, { PLANE(0, 0, 1, 1), PLANE(2, 2, 1, 1), PLANE(2, 2, 1, 1), NO_PLANE } },
+	{ "RGB24",   1, 24, 1, true,  { PLANE(0, 0, 1, 3), NO_PLANE, NO_PLANE, NO_PLANE } },
+	{ "RGBA",    1, 32, 1, true,  { PLANE(0, 0, 1, 4), NO_PLANE, NO_PLANE, NO_PLANE } },
+	{ "ARGB",    1, 32, 1, true,  { PLANE(0, 0, 1, 4), NO_PLANE, NO_PLANE, NO_PLANE } },
+	{ "YUV16",   3, 48, 2, false, { PLANE(0, 0, 1, 2), PLANE(0, 0, 1, 2), PLANE(0, 0, 1, 2), NO_PLANE } },
+	{ "I420P16", 3, 24, 2, false, { PLANE(0, 0, 1, 2), PLANE(1, 1, 1, 2), PLANE(1, 1, 1, 2), NO_PLANE } },
+	{ "I422",    3, 16, 1, false, { PLANE(0, 0, 1, 1), PLANE(1, 0, 1, 1), PLANE(1, 0, 1, 1), NO_PLANE } },
+};
+
+const FrameFormatDesc* GetFrameFormatDesc(FrameFormat format)
+{
+	if(format < 0 || format >= FF_COUNT)
+	{
+		throw "Unknown frame format";
+	}
+	return &s_formats[format];
+}
+
+int GetPlaneRowBytes(FrameFormat format, int plane, int width)
+{
+	const FramePlaneDesc& p = GetFrameFormatDesc(format)->Plane[plane];
+	int samples = (width + (1 << p.ShiftX) - 1) >> p.ShiftX;
+	return (samples + p.BlockWidth - 1) / p.BlockWidth * p.BlockBytes;
+}
+
+int GetPlaneLines(FrameFormat format, int plane, int height)
+{
+	const FramePlaneDesc& p = GetFrameFormatDesc(format)->Plane[plane];
+	return (height + (1 << p.ShiftY) - 1) >> p.ShiftY;
+}
+
+int GetFormatAlignmentX(FrameFormat format)
+{
+	const FrameFormatDesc* desc = GetFrameFormatDesc(format);
+	int alignment = 1;
+	for(int i = 0; i < desc->Planes; i++)
+	{
+		int a = desc->Plane[i].BlockWidth << desc->Plane[i].ShiftX;
+		alignment = a > alignment ? a : alignment;
+	}
+	return alignment;
+}
+
+int GetFormatAlignmentY(FrameFormat format)
+{
+	const FrameFormatDesc* desc = GetFrameFormatDesc(format);
+	int alignment = 1;
+	for(int i = 0; i < desc->Planes; i++)
+	{
+		int a = 1 << desc->Plane[i].ShiftY;
+		alignment = a > alignment ? a : alignment;
+	}
+	return alignment;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "NativeLib.h"
+
+// Values match Taygeta.Imaging.PixelAlignmentType so the two can be cast into each other.
+// Formats after FF_NATIVE have no managed counterpart.
+enum FrameFormat
+{
+	FF_Y800 = 0,
+	FF_Y16,
+	FF_YUV,			// planar 4:4:4
+	FF_YUY2,
+	FF_UYVY,
+	FF_YV12,		// Y, V, U planes
+	FF_I420,
+	FF_NV12,
+	FF_NV21,
+	FF_Y411,
+	FF_Y410,
+	FF_RGB24,
+	FF_RGBA,
+	FF_ARGB,
+	FF_YUV16,
+	FF_I420P16,
+
+	FF_NATIVE,
+	FF_I422 = FF_NATIVE,	// planar 4:2:2, as decoded by libjpeg
+	FF_COUNT
+};
+
+struct FramePlaneDesc
+{
+	int ShiftX;			// log2 of the horizontal subsampling
+	int ShiftY;			// log2 of the vertical subsampling
+	int BlockWidth;		// samples stored together, 2 for packed 4:2:2
+	int BlockBytes;
+};
+
+struct FrameFormatDesc
+{
+	const char* Name;
+	int Planes;
+	int BitsPerPixel;
+	int BytesPerSample;
+	bool Rgb;
+	FramePlaneDesc Plane[4];
+};
+
+NATIVELIB const FrameFormatDesc* GetFrameFormatDesc(FrameFormat format);
+
+// Bytes of pixel data in one row of a plane, without any padding
+NATIVELIB int GetPlaneRowBytes(FrameFormat format, int plane, int width);
+NATIVELIB int GetPlaneLines(FrameFormat format, int plane, int height);
+
+// Granularity of frame origins and sizes that keeps every plane on whole samples and blocks
+NATIVELIB int GetFormatAlignmentX(FrameFormat format);
+NATIVELIB int GetFormatAlignmentY(FrameFormat format);
@@ -0,0 +1,498 @@
+#include "FramePool.h"
+#include "FrameAllocator.h"
+
+#include <map>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#define POOL_THREAD_CACHE_BLOCKS 4
+#define POOL_DEFAULT_MAX_IDLE (256LL * 1024 * 1024)
+
+// Every block starts with a header of one alignment unit that remembers its size and
+// where it came from
+struct BlockHeader
+{
+	size_t Size;
+	IFrameAllocator* Allocator;
+	int Node;
+};
+
+// Idle blocks are reused only for the same size on the same NUMA node
+typedef std::pair<size_t, int> BlockKey;
+
+static inline BlockHeader* GetHeader(BYTE* data)
+{
+	return (BlockHeader*)(data - FRAME_ALIGNMENT);
+}
+
+struct CFramePool::State
+{
+	std::mutex lock;
+	std::map<BlockKey, std::vector<BYTE*> > idle;
+	std::map<BlockKey, long long> lastUse;
+	long long tick;
+	std::atomic<IFrameAllocator*> allocator;
+	std::atomic<long long> maxIdle;
+
+	std::atomic<long long> hits;
+	std::atomic<long long> misses;
+	std::atomic<long long> resident;
+	std::atomic<long long> idleBytes;
+	std::atomic<long long> peak;
+	std::atomic<long long> inUse;
+	std::atomic<long long> inUsePeak;		// since the last Trim
+};
+
+// Blocks released on this thread, handed out again before the shared lists are locked
+struct ThreadCache
+{
+	int Count;
+	BYTE* Blocks[POOL_THREAD_CACHE_BLOCKS];
+
+	static ThreadCache* Get(bool create);
+	static void Flush(ThreadCache* cache);
+};
+
+#ifdef _WIN32
+static DWORD s_cacheSlot = FLS_OUT_OF_INDEXES;
+
+static void WINAPI ThreadCacheExit(void* cache)
+{
+	ThreadCache::Flush((ThreadCache*)cache);
+}
+#else
+static pthread_key_t s_cacheKey;
+
+static void ThreadCacheExit(void* cache)
+{
+	ThreadCache::Flush((ThreadCache*)cache);
+}
+#endif
+
+static std::once_flag s_poolOnce;
+static CFramePool* s_pool = NULL;
+
+ThreadCache* ThreadCache::Get(bool create)
+{
+#ifdef _WIN32
+	ThreadCache* cache = s_cacheSlot == FLS_OUT_OF_INDEXES ? NULL : (ThreadCache*)FlsGetValue(s_cacheSlot);
+#else
+	ThreadCache* cache = (ThreadCache*)pthread_getspecific(s_cacheKey);
+#endif
+	if(cache || !create)
+	{
+		return cache;
+	}
+
+	cache = new ThreadCache();
+	cache->Count = 0;
+#ifdef _WIN32
+	if(s_cacheSlot == FLS_OUT_OF_INDEXES || !FlsSetValue(s_cacheSlot, cache))
+#else
+	if(pthread_setspecific(s_cacheKey, cache) != 0)
+#endif
+	{
+		delete cache;
+		return NULL;
+	}
+	return cache;
+}
+
+void ThreadCache::Flush(ThreadCache* cache)
+{
+	for(int i = 0; i < cache->Count; i++)
+	{
+		BYTE* data = cache->Blocks[i];
+		s_pool->FreeShared(data, GetHeader(data)->Size);
+	}
+	delete cache;
+}
+
+CFramePool* CFramePool::GetDefault(void)
+{
+	std::call_once(s_poolOnce, []()
+	{
+#ifdef _WIN32
+		s_cacheSlot = FlsAlloc(ThreadCacheExit);
+#else
+		pthread_key_create(&s_cacheKey, ThreadCacheExit);
+#endif
+		// Never destroyed, thread caches may hand blocks back during process shutdown
+		s_pool = new CFramePool();
+	});
+	return s_pool;
+}
+
+CFramePool::CFramePool(void)
+{
+	m_state = new State();
+	m_state->tick = 0;
+	m_state->allocator = CHeapFrameAllocator::GetDefault();
+	m_state->maxIdle = POOL_DEFAULT_MAX_IDLE;
+	m_state->hits = 0;
+	m_state->misses = 0;
+	m_state->resident = 0;
+	m_state->idleBytes = 0;
+	m_state->peak = 0;
+	m_state->inUse = 0;
+	m_state->inUsePeak = 0;
+}
+
+CFramePool::~CFramePool(void)
+{
+	Trim();
+	delete m_state;
+}
+
+static void ReleaseBlock(BYTE* data)
+{
+	BlockHeader* header = GetHeader(data);
+	header->Allocator->Free(data - FRAME_ALIGNMENT, header->Size + FRAME_ALIGNMENT, header->Node);
+}
+
+static void UpdateMax(std::atomic<long long>& target, long long value)
+{
+	long long current = target;
+	while(value > current && !target.compare_exchange_weak(current, value))
+	{
+	}
+}
+
+BYTE* CFramePool::Alloc(size_t size)
+{
+	size = (size + FRAME_ALIGNMENT - 1) & ~(size_t)(FRAME_ALIGNMENT - 1);
+	BYTE* data = NULL;
+	IFrameAllocator* allocator = m_state->allocator;
+	int node = allocator->GetNode();
+
+	ThreadCache* cache = ThreadCache::Get(false);
+	for(int i = cache ? cache->Count - 1 : -1; i >= 0 && !data; i--)
+	{
+		BlockHeader* header = GetHeader(cache->Blocks[i]);
+		if(header->Allocator != allocator)
+		{
+			// Left over from before SetAllocator, it would never be handed out again
+			BYTE* stale = cache->Blocks[i];
+			cache->Blocks[i] = cache->Blocks[--cache->Count];
+			m_state->idleBytes -= header->Size;
+			m_state->resident -= header->Size;
+			ReleaseBlock(stale);
+		}
+		else if(header->Size == size && header->Node == node)
+		{
+			data = cache->Blocks[i];
+			cache->Blocks[i] = cache->Blocks[--cache->Count];
+		}
+	}
+
+	if(!data)
+	{
+		std::lock_guard<std::mutex> guard(m_state->lock);
+		BlockKey key(size, node);
+		m_state->lastUse[key] = ++m_state->tick;
+
+		std::map<BlockKey, std::vector<BYTE*> >::iterator it = m_state->idle.find(key);
+		if(it != m_state->idle.end() && !it->second.empty())
+		{
+			data = it->second.back();
+			it->second.pop_back();
+		}
+	}
+
+	if(data)
+	{
+		m_state->hits++;
+		m_state->idleBytes -= size;
+	}
+	else
+	{
+		BYTE* block = allocator->Allocate(size + FRAME_ALIGNMENT, node);
+		if(!block)
+		{
+			throw "Failed to allocate pooled block";
+		}
+
+		data = block + FRAME_ALIGNMENT;
+		GetHeader(data)->Size = size;
+		GetHeader(data)->Allocator = allocator;
+		GetHeader(data)->Node = node;
+		m_state->misses++;
+		UpdateMax(m_state->peak, m_state->resident += size);
+	}
+
+	UpdateMax(m_state->inUsePeak, m_state->inUse += size);
+	return data;
+}
+
+void CFramePool::Free(BYTE* data)
+{
+	if(!data)
+	{
+		return;
+	}
+
+	size_t size = GetHeader(data)->Size;
+	m_state->inUse -= size;
+	m_state->idleBytes += size;
+
+	ThreadCache* cache = ThreadCache::Get(true);
+	if(cache && cache->Count < POOL_THREAD_CACHE_BLOCKS && m_state->idleBytes <= m_state->maxIdle
+		&& GetHeader(data)->Allocator == m_state->allocator)
+	{
+		cache->Blocks[cache->Count++] = data;
+		return;
+	}
+
+	FreeShared(data, size);
+}
+
+// Returns a block to the shared lists, evicting the least recently requested sizes
+// while idle memory is above the limit. Blocks of an allocator the pool no longer uses
+// go straight back to it.
+void CFramePool::FreeShared(BYTE* data, size_t size)
+{
+	std::vector<BYTE*> evicted;
+	{
+		// The allocator is compared under the lock SetAllocator sweeps with, so a block of
+		// the previous one cannot slip into the lists after the sweep
+		std::lock_guard<std::mutex> guard(m_state->lock);
+		if(GetHeader(data)->Allocator != m_state->allocator)
+		{
+			evicted.push_back(data);
+			m_state->idleBytes -= size;
+			m_state->resident -= size;
+		}
+		else
+		{
+			m_state->idle[BlockKey(size, GetHeader(data)->Node)].push_back(data);
+		}
+
+		while(m_state->idleBytes > m_state->maxIdle)
+		{
+			std::map<BlockKey, std::vector<BYTE*> >::iterator victim = m_state->idle.end();
+			for(std::map<BlockKey, std::vector<BYTE*> >::iterator it = m_state->idle.begin(); it != m_state->idle.end(); ++it)
+			{
+				if(!it->second.empty() && (victim == m_state->idle.end() || m_state->lastUse[it->first] < m_state->lastUse[victim->first]))
+				{
+					victim = it;
+				}
+			}
+			if(victim == m_state->idle.end())
+			{
+				break;
+			}
+
+			evicted.push_back(victim->second.back());
+			victim->second.pop_back();
+			m_state->idleBytes -= victim->first.first;
+			m_state->resident -= victim->first.first;
+		}
+	}
+
+	for(size_t i = 0; i < evicted.size(); i++)
+	{
+		ReleaseBlock(evicted[i]);
+	}
+}
+
+void CFramePool::SetMaxIdleBytes(long long bytes)
+{
+	m_state->maxIdle = bytes > 0 ? bytes : 0;
+	Trim();
+}
+
+// Keeps only as many idle bytes as the busiest moment since the last call needed on top
+// of what is in use now, and never more than the idle limit
+void CFramePool::Trim(void)
+{
+	std::vector<BYTE*> evicted;
+	{
+		std::lock_guard<std::mutex> guard(m_state->lock);
+		long long inUse = m_state->inUse;
+		long long maxIdle = m_state->maxIdle;
+		long long keep = m_state->inUsePeak - inUse;
+		keep = keep < maxIdle ? keep : maxIdle;
+		m_state->inUsePeak = inUse;
+
+		// Shared blocks only, thread caches are private to their threads
+		long long shared = 0;
+		for(std::map<BlockKey, std::vector<BYTE*> >::iterator it = m_state->idle.begin(); it != m_state->idle.end(); ++it)
+		{
+			shared += (long long)(it->first.first * it->second.size());
+		}
+		long long excess = m_state->idleBytes - keep;
+		excess = excess < shared ? excess : shared;
+
+		while(excess > 0)
+		{
+			std::map<BlockKey, std::vector<BYTE*> >::iterator victim = m_state->idle.end();
+			for(std::map<BlockKey, std::vector<BYTE*> >::iterator it = m_state->idle.begin(); it != m_state->idle.end(); ++it)
+			{
+				if(!it->second.empty() && (victim == m_state->idle.end() || m_state->lastUse[it->first] < m_state->lastUse[victim->first]))
+				{
+					victim = it;
+				}
+			}
+			if(victim == m_state->idle.end())
+			{
+				break;
+			}
+
+			evicted.push_back(victim->second.back());
+			victim->second.pop_back();
+			excess -= victim->first.first;
+			m_state->idleBytes -= victim->first.first;
+			m_state->resident -= victim->first.first;
+		}
+	}
+
+	for(size_t i = 0; i < evicted.size(); i++)
+	{
+		ReleaseBlock(evicted[i]);
+	}
+}
+
+void CFramePool::SetAllocator(IFrameAllocator* allocator)
+{
+	// Idle blocks of the previous allocator are given back, blocks in use and in thread
+	// caches follow when they are released
+	std::vector<BYTE*> evicted;
+	{
+		std::lock_guard<std::mutex> guard(m_state->lock);
+		m_state->allocator = allocator ? allocator : CHeapFrameAllocator::GetDefault();
+		for(std::map<BlockKey, std::vector<BYTE*> >::iterator it = m_state->idle.begin(); it != m_state->idle.end(); ++it)
+		{
+			std::vector<BYTE*>& blocks = it->second;
+			size_t i = 0;
+			while(i < blocks.size())
+			{
+				if(GetHeader(blocks[i])->Allocator == m_state->allocator)
+				{
+					i++;
+					continue;
+				}
+
+				evicted.push_back(blocks[i]);
+				blocks[i] = blocks.back();
+				blocks.pop_back();
+				m_state->idleBytes -= it->first.first;
+				m_state->resident -= it->first.first;
+			}
+		}
+	}
+
+	for(size_t i = 0; i < evicted.size(); i++)
+	{
+		ReleaseBlock(evicted[i]);
+	}
+}
+
+IFrameAllocator* CFramePool::GetAllocator(void) const
+{
+	return m_state->allocator;
+}
+
+void CFramePool::GetStats(FramePoolStats* stats) const
+{
+	stats->Hits = m_state->hits;
+	stats->Misses = m_state->misses;
+	stats->BytesResident = m_state->resident;
+	stats->BytesIdle = m_state->idleBytes;
+	stats->BytesPeak = m_state->peak;
+}
+
+static void FreePooled(BYTE* data, void* pool)
+{
+	((CFramePool*)pool)->Free(data);
+}
+
+CPlanarFrame* CFramePool::Acquire(int width, int height, FrameFormat format)
+{
+	if(width <= 0 || height <= 0)
+	{
+		throw "Frame size must be positive";
+	}
+
+	size_t size = CPlanarFrame::GetAllocationSize(width, height, format);
+	BYTE* data = Alloc(size);
+	CPlaneBuffer* storage = NULL;
+	try
+	{
+		storage = CPlaneBuffer::Wrap(data, size, FreePooled, this);
+	}
+	catch(...)
+	{
+		Free(data);
+		throw;
+	}
+
+	try
+	{
+		CPlanarFrame* frame = CPlanarFrame::Create(width, height, format, storage);
+		storage->Release();
+		return frame;
+	}
+	catch(...)
+	{
+		storage->Release();
+		throw;
+	}
+}
+
+CPlanarFrame* CFramePool::Acquire(int width, int height, FrameFormat format, const int* pitches)
+{
+	if(width <= 0 || height <= 0)
+	{
+		throw "Frame size must be positive";
+	}
+
+	// Planes keep the pitches they were given and start on FRAME_ALIGNMENT, with the usual padding
+	const FrameFormatDesc* desc = GetFrameFormatDesc(format);
+	size_t offsets[FRAME_MAX_PLANES];
+	size_t size = 0;
+	for(int i = 0; i < desc->Planes; i++)
+	{
+		if(pitches[i] < GetPlaneRowBytes(format, i, width))
+		{
+			throw "Pitch is smaller than a row";
+		}
+		offsets[i] = size;
+		size += ((size_t)pitches[i] * GetPlaneLines(format, i, height) + FRAME_PADDING + FRAME_ALIGNMENT - 1) & ~(size_t)(FRAME_ALIGNMENT - 1);
+	}
+
+	BYTE* data = Alloc(size);
+	CPlaneBuffer* storage = NULL;
+	try
+	{
+		storage = CPlaneBuffer::Wrap(data, size, FreePooled, this);
+	}
+	catch(...)
+	{
+		Free(data);
+		throw;
+	}
+
+	try
+	{
+		BYTE* planes[FRAME_MAX_PLANES];
+		for(int i = 0; i < desc->Planes; i++)
+		{
+			planes[i] = data + offsets[i];
+		}
+		CPlanarFrame* frame = CPlanarFrame::Wrap(width, height, format, planes, pitches, storage);
+		storage->Release();
+		return frame;
+	}
+	catch(...)
+	{
+		storage->Release();
+		throw;
+	}
+}
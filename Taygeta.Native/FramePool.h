@@ -0,0 +1,57 @@
+#pragma once
+
+#include "NativeLib.h"
+#include "PlanarFrame.h"
+#include "FrameAllocator.h"
+
+struct FramePoolStats
+{
+	long long Hits;				// allocations served from idle blocks
+	long long Misses;			// allocations that went to the heap
+	long long BytesResident;	// held by the pool, in use or idle
+	long long BytesIdle;		// released and waiting for reuse, thread caches included
+	long long BytesPeak;		// highest BytesResident seen
+};
+
+// Process wide pool of plane memory. Blocks are recycled by size; frames of the same
+// width, height and format always need the same size, so steady state processing of a
+// stream reuses the same few blocks without touching the heap. Released blocks first go
+// to a small per-thread cache and then to shared lists. Idle memory is capped by
+// SetMaxIdleBytes, and Trim gives back whatever the recent high water mark of blocks in
+// use no longer needs. New blocks come from the pool's allocator, the heap unless
+// SetAllocator picks another.
+class NATIVELIB CFramePool
+{
+public:
+	static CFramePool* GetDefault(void);
+
+	// Memory is aligned to FRAME_ALIGNMENT and must be returned with Free
+	BYTE* Alloc(size_t size);
+	void Free(BYTE* data);
+
+	// Frame laid out like CPlanarFrame::Create whose storage returns to the pool
+	CPlanarFrame* Acquire(int width, int height, FrameFormat format);
+
+	// Frame with the given pitches, as used to copy a frame without changing its layout
+	CPlanarFrame* Acquire(int width, int height, FrameFormat format, const int* pitches);
+
+	// NULL selects the heap again. The allocator must outlive every block it gave out.
+	void SetAllocator(IFrameAllocator* allocator);
+	IFrameAllocator* GetAllocator(void) const;
+
+	void SetMaxIdleBytes(long long bytes);
+	void Trim(void);
+	void GetStats(FramePoolStats* stats) const;
+
+private:
+	CFramePool(void);
+	~CFramePool(void);
+	CFramePool(const CFramePool&);
+	CFramePool& operator=(const CFramePool&);
+
+	struct State;
+	State* m_state;
+
+	void FreeShared(BYTE* data, size_t size);
+	friend struct ThreadCache;
+};
@@ -0,0 +1,172 @@
+#include "FrameReduce.h"
+#include "YuvKernels.h"
+#include "RowBands.h"
+
+#include <vector>
+
+#define MAX_REDUCTION_STEPS 3
+
+typedef void (*ReduceRowFunc)(const BYTE* row0, const BYTE* row1, BYTE* dst, int count);
+
+// Kernel of a plane and the bytes one of its outputs takes
+static ReduceRowFunc GetPlaneKernel(const YuvRowKernels* k, FrameFormat format, int plane, int* bytes)
+{
+	*bytes = 1;
+	switch(format)
+	{
+	case FF_Y800:
+	case FF_YUV:
+	case FF_YV12:
+	case FF_I420:
+	case FF_Y411:
+	case FF_Y410:
+	case FF_I422:
+		return k->Reduce2x2;
+
+	case FF_NV12:
+	case FF_NV21:
+		if(plane == 0)
+		{
+			return k->Reduce2x2;
+		}
+		*bytes = 2;
+		return k->Reduce2x2Pairs;
+
+	case FF_YUY2:
+		*bytes = 4;
+		return k->Reduce2x2Yuy2;
+
+	case FF_UYVY:
+		*bytes = 4;
+		return k->Reduce2x2Uyvy;
+
+	default:
+		return NULL;
+	}
+}
+
+// Rows of every step but the last are made in scratch, two per step for the pair the next
+// step reads, so each source row is read once
+class CReduceTask : public IRowBandTask
+{
+public:
+	CReduceTask(const CPlanarFrame* src, CPlanarFrame* dst, int steps, int bands)
+		: m_src(src), m_dst(dst), m_steps(steps)
+	{
+		const YuvRowKernels* k = GetYuvRowKernels();
+		FrameFormat format = dst->GetFormat();
+		m_planes = GetFrameFormatDesc(format)->Planes;
+
+		size_t bandSize = 0;
+		for(int p = 0; p < m_planes; p++)
+		{
+			int bytes;
+			m_kernel[p] = GetPlaneKernel(k, format, p, &bytes);
+			m_shiftY[p] = GetFrameFormatDesc(format)->Plane[p].ShiftY;
+			int rowBytes = GetPlaneRowBytes(format, p, dst->GetWidth());
+			for(int s = 0; s < steps; s++)
+			{
+				// Output of step s, the last writing the target
+				m_rowBytes[p][s] = rowBytes << (steps - 1 - s);
+				m_count[p][s] = m_rowBytes[p][s] / bytes;
+				m_scratchOffset[p][s] = bandSize;
+				bandSize += s < steps - 1 ? 2 * (size_t)m_rowBytes[p][s] : 0;
+			}
+		}
+		m_bandSize = bandSize;
+		m_scratch.resize(bandSize * bands + 1);
+	}
+
+	virtual void RunRows(int band, int first, int count)
+	{
+		for(int p = 0; p < m_planes; p++)
+		{
+			int last = (first + count) >> m_shiftY[p];
+			for(int row = first >> m_shiftY[p]; row < last; row++)
+			{
+				ReduceRow(band, p, m_steps - 1, row, m_dst->GetPlane(p) + (ptrdiff_t)row * m_dst->GetPitch(p));
+			}
+		}
+	}
+
+private:
+	const CPlanarFrame* m_src;
+	CPlanarFrame* m_dst;
+	int m_steps;
+	int m_planes;
+	ReduceRowFunc m_kernel[4];
+	int m_shiftY[4];
+	int m_rowBytes[4][MAX_REDUCTION_STEPS];
+	int m_count[4][MAX_REDUCTION_STEPS];
+	size_t m_scratchOffset[4][MAX_REDUCTION_STEPS];
+	size_t m_bandSize;
+	std::vector<BYTE> m_scratch;
+
+	BYTE* Scratch(int band, int plane, int step, int slot)
+	{
+		return &m_scratch[m_bandSize * band + m_scratchOffset[plane][step] + (size_t)slot * m_rowBytes[plane][step]];
+	}
+
+	// Row of a plane after step + 1 halvings
+	void ReduceRow(int band, int plane, int step, int row, BYTE* out)
+	{
+		const BYTE* row0;
+		const BYTE* row1;
+		if(step == 0)
+		{
+			row0 = m_src->GetPlane(plane) + (ptrdiff_t)(2 * row) * m_src->GetPitch(plane);
+			row1 = row0 + m_src->GetPitch(plane);
+		}
+		else
+		{
+			BYTE* top = Scratch(band, plane, step - 1, 0);
+			BYTE* bottom = Scratch(band, plane, step - 1, 1);
+			ReduceRow(band, plane, step - 1, 2 * row, top);
+			ReduceRow(band, plane, step - 1, 2 * row + 1, bottom);
+			row0 = top;
+			row1 = bottom;
+		}
+		m_kernel[plane](row0, row1, out, m_count[plane][step]);
+	}
+};
+
+int GetFrameReduction(const CPlanarFrame* src, const CPlanarFrame* dst)
+{
+	FrameFormat format = dst->GetFormat();
+	int bytes;
+	if(src->GetFormat() != format || !GetPlaneKernel(GetYuvRowKernels(0), format, 0, &bytes) ||
+		dst->GetWidth() <= 0 || dst->GetHeight() <= 0 ||
+		dst->GetWidth() % GetFormatAlignmentX(format) != 0 || dst->GetHeight() % GetFormatAlignmentY(format) != 0)
+	{
+		return 0;
+	}
+
+	for(int factor = 2; factor <= 1 << MAX_REDUCTION_STEPS; factor *= 2)
+	{
+		if(src->GetWidth() == factor * dst->GetWidth() && src->GetHeight() == factor * dst->GetHeight())
+		{
+			return factor;
+		}
+	}
+	return 0;
+}
+
+void ReduceFrame(const CPlanarFrame* src, CPlanarFrame* dst, int threads)
+{
+	int factor = GetFrameReduction(src, dst);
+	if(factor == 0)
+	{
+		throw "Unsupported reduction";
+	}
+
+	int steps = 1;
+	while((1 << steps) < factor)
+	{
+		steps++;
+	}
+
+	// Bands are sized by the source pixels each target row reads
+	int bands = GetRowBandCount(src->GetWidth() * factor, dst->GetHeight(), threads);
+	CReduceTask task(src, dst, steps, bands);
+	RunRowBands(&task, dst->GetHeight(), bands, GetFormatAlignmentY(dst->GetFormat()));
+}
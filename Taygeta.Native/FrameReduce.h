@@ -0,0 +1,16 @@
+#pragma once
+
+#include "NativeLib.h"
+#include "FrameFormat.h"
+#include "PlanarFrame.h"
+
+// Exact 2x, 4x and 8x reductions of the 8-bit YUV layouts of YuvConvert.h, keeping the
+// layout. Every step takes the pavgb means of 2x2 blocks with the Reduce2x2 kernels of
+// YuvKernels.h; 4x and 8x cascade the steps row by row without whole intermediate frames.
+// Returns the factor dst is smaller than src by, or 0 when the frames differ in layout or
+// the target size is not a multiple of the layout's chroma blocks.
+NATIVELIB int GetFrameReduction(const CPlanarFrame* src, const CPlanarFrame* dst);
+
+// Rows run in bands on up to threads threads, 0 for one per processor, with identical
+// results for any count. Fails for frames GetFrameReduction gives 0 for.
+NATIVELIB void ReduceFrame(const CPlanarFrame* src, CPlanarFrame* dst, int threads);
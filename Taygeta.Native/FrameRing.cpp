@@ -0,0 +1,687 @@
+#include "FrameRing.h"
+#include "FrameCopy.h"
+#include "RefCount.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <stdint.h>
+#include <limits.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#define FRAME_RING_PAGE 4096
+#define FRAME_RING_WRITER 0x80000000u
+#define FRAME_RING_SLOT_BITS 16
+
+// Control block at the start of the segment. The fields up to Ready are written once by
+// the writer before it sets Ready, the rest change only through lock-free atomics, which
+// work the same between processes as between threads.
+struct RingHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	int32_t Format;
+	int32_t Width;
+	int32_t Height;
+	int32_t Slots;
+	uint64_t SlotSize;
+	uint64_t SlotTableOffset;
+	uint64_t EntryTableOffset;
+	uint64_t DataOffset;
+	uint64_t SegmentSize;
+
+	std::atomic<uint32_t> Ready;
+	std::atomic<uint32_t> Wake;			// bumped on every publish, the futex word
+	std::atomic<uint32_t> Waiters;
+	uint32_t Reserved;
+	std::atomic<uint64_t> Head;			// last published sequence, 0 before the first frame
+};
+
+struct RingSlot
+{
+	std::atomic<uint32_t> Readers;		// FRAME_RING_WRITER while the writer fills the slot
+	uint32_t Reserved;
+	std::atomic<uint64_t> Sequence;
+	int64_t Timestamp;
+};
+
+// Sequence and slot of the frame published as sequence % Slots, packed into one word
+static inline uint64_t PackEntry(uint64_t sequence, int slot)
+{
+	return (sequence << FRAME_RING_SLOT_BITS) | (uint64_t)slot;
+}
+
+static inline size_t AlignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Mapping of the segment, referenced by the writer or reader and by every frame handed
+// out over a slot, so frames stay valid after the ring object is gone
+struct RingSegment
+{
+	volatile long RefCount;
+	BYTE* Base;
+	size_t Size;
+#ifdef _WIN32
+	HANDLE Mapping;
+	HANDLE Wake;
+#endif
+	RingHeader* Header;
+	RingSlot* Slots;
+	std::atomic<uint64_t>* Entries;
+
+	RingSegment(void)
+		: RefCount(1), Base(NULL), Size(0),
+#ifdef _WIN32
+		  Mapping(NULL), Wake(NULL),
+#endif
+		  Header(NULL), Slots(NULL), Entries(NULL)
+	{
+	}
+
+	void AddRef(void)
+	{
+		AtomicIncrement(&RefCount);
+	}
+
+	void Release(void)
+	{
+		if(AtomicDecrement(&RefCount) == 0)
+		{
+			delete this;
+		}
+	}
+
+	void SetBase(BYTE* base)
+	{
+		Base = base;
+		Header = (RingHeader*)base;
+	}
+
+	void SetTables(void)
+	{
+		Slots = (RingSlot*)(Base + Header->SlotTableOffset);
+		Entries = (std::atomic<uint64_t>*)(Base + Header->EntryTableOffset);
+	}
+
+	BYTE* GetSlotData(int slot) const
+	{
+		return Base + Header->DataOffset + (size_t)slot * Header->SlotSize;
+	}
+
+private:
+	~RingSegment(void)
+	{
+#ifdef _WIN32
+		if(Base)
+		{
+			UnmapViewOfFile(Base);
+		}
+		if(Mapping)
+		{
+			CloseHandle(Mapping);
+		}
+		if(Wake)
+		{
+			CloseHandle(Wake);
+		}
+#else
+		if(Base)
+		{
+			munmap(Base, Size);
+		}
+#endif
+	}
+};
+
+static std::string GetSegmentName(const char* name)
+{
+	if(!name || !*name)
+	{
+		throw "Frame ring name must not be empty";
+	}
+#ifdef _WIN32
+	return std::string("Local\\") + name;
+#else
+	return name[0] == '/' ? std::string(name) : std::string("/") + name;
+#endif
+}
+
+static void WakeReaders(RingSegment* segment)
+{
+	RingHeader* header = segment->Header;
+	header->Wake.fetch_add(1);
+	uint32_t waiters = header->Waiters.load();
+	if(waiters == 0)
+	{
+		return;
+	}
+#ifdef _WIN32
+	ReleaseSemaphore(segment->Wake, (LONG)waiters, NULL);
+#elif defined(__linux__)
+	syscall(SYS_futex, &header->Wake, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+// Sleeps until the writer publishes after wake was read, the timeout passes or the wait
+// is interrupted; the caller checks again in every case
+static void WaitForWriter(RingSegment* segment, uint32_t wake, int timeoutMs)
+{
+	RingHeader* header = segment->Header;
+	header->Waiters.fetch_add(1);
+#ifdef _WIN32
+	// Posts left over by readers that found a frame before they waited only cost another
+	// round through the caller's loop
+	if(header->Wake.load() == wake)
+	{
+		WaitForSingleObject(segment->Wake, timeoutMs < 0 ? INFINITE : (DWORD)timeoutMs);
+	}
+#elif defined(__linux__)
+	// Unlike eventfd the futex word lives in the segment itself, so readers need nothing
+	// but the name to wait on it
+	struct timespec timeout;
+	timeout.tv_sec = timeoutMs / 1000;
+	timeout.tv_nsec = (long)(timeoutMs % 1000) * 1000000;
+	syscall(SYS_futex, &header->Wake, FUTEX_WAIT, wake, timeoutMs < 0 ? NULL : &timeout, NULL, 0);
+#else
+	// Other systems have no wait on shared memory, the counter is polled
+	struct timespec pause;
+	pause.tv_sec = 0;
+	pause.tv_nsec = 200000;
+	if(header->Wake.load() == wake && timeoutMs != 0)
+	{
+		nanosleep(&pause, NULL);
+	}
+#endif
+	header->Waiters.fetch_sub(1);
+}
+
+static void ReleaseSegment(BYTE*, void* context)
+{
+	((RingSegment*)context)->Release();
+}
+
+// Read lease on a slot held by the storage of a frame handed to a reader
+struct SlotLease
+{
+	RingSegment* Segment;
+	int Slot;
+};
+
+static void ReleaseSlotLease(BYTE*, void* context)
+{
+	SlotLease* lease = (SlotLease*)context;
+	lease->Segment->Slots[lease->Slot].Readers.fetch_sub(1);
+	lease->Segment->Release();
+	delete lease;
+}
+
+// freeFunc is called with context once the frame goes away, or right away when it cannot
+// be created
+static CPlanarFrame* CreateSlotFrame(RingSegment* segment, int slot, PlaneBufferFree freeFunc, void* context)
+{
+	RingHeader* header = segment->Header;
+	CPlaneBuffer* storage = NULL;
+	try
+	{
+		storage = CPlaneBuffer::Wrap(segment->GetSlotData(slot), (size_t)header->SlotSize, freeFunc, context);
+	}
+	catch(...)
+	{
+		freeFunc(NULL, context);
+		throw;
+	}
+
+	try
+	{
+		CPlanarFrame* frame = CPlanarFrame::Create(header->Width, header->Height, (FrameFormat)header->Format, storage);
+		storage->Release();
+		return frame;
+	}
+	catch(...)
+	{
+		storage->Release();
+		throw;
+	}
+}
+
+struct CFrameRingWriter::State
+{
+	std::string name;
+#ifndef _WIN32
+	int fd;								// holds the writer lock
+#endif
+	RingSegment* segment;
+	int cursor;
+	int current;
+	CPlanarFrame* frame;
+	uint64_t sequence;
+	long long dropped;
+};
+
+CFrameRingWriter::CFrameRingWriter(const char* name, int slots, int width, int height, FrameFormat format)
+	: m_state(NULL)
+{
+	if(format < 0 || format >= FF_COUNT)
+	{
+		throw "Unknown frame format";
+	}
+	if(width <= 0 || height <= 0)
+	{
+		throw "Frame size must be positive";
+	}
+	if(slots < 2 || slots > FRAME_RING_MAX_SLOTS)
+	{
+		throw "Frame ring slot count is out of range";
+	}
+
+	std::string segmentName = GetSegmentName(name);
+
+	uint64_t slotSize = AlignUp(CPlanarFrame::GetAllocationSize(width, height, format), FRAME_RING_PAGE);
+	uint64_t slotTable = AlignUp(sizeof(RingHeader), FRAME_ALIGNMENT);
+	uint64_t entryTable = slotTable + AlignUp(sizeof(RingSlot) * slots, FRAME_ALIGNMENT);
+	uint64_t data = AlignUp((size_t)(entryTable + sizeof(uint64_t) * slots), FRAME_RING_PAGE);
+	uint64_t size = data + slotSize * slots;
+	if(size > (uint64_t)(size_t)-1)
+	{
+		throw "Frame ring is too large";
+	}
+
+	RingSegment* segment = new RingSegment();
+	segment->Size = (size_t)size;
+#ifdef _WIN32
+	segment->Mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, segmentName.c_str());
+	if(segment->Mapping && GetLastError() == ERROR_ALREADY_EXISTS)
+	{
+		segment->Release();
+		throw "Frame ring already exists";
+	}
+	segment->Wake = CreateSemaphoreA(NULL, 0, LONG_MAX, (segmentName + ".wake").c_str());
+	BYTE* base = segment->Mapping && segment->Wake ? (BYTE*)MapViewOfFile(segment->Mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)size) : NULL;
+	if(!base)
+	{
+		segment->Release();
+		throw "Failed to create frame ring";
+	}
+#else
+	// Writers lock their segment for as long as they live and the system drops the lock of
+	// one that dies, so a segment that can be locked was left behind by a crash
+	int stale = shm_open(segmentName.c_str(), O_RDWR, 0);
+	if(stale >= 0)
+	{
+		bool held = flock(stale, LOCK_EX | LOCK_NB) != 0;
+		if(!held)
+		{
+			shm_unlink(segmentName.c_str());
+		}
+		close(stale);
+		if(held)
+		{
+			segment->Release();
+			throw "Frame ring is held by another writer";
+		}
+	}
+
+	int fd = shm_open(segmentName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if(fd >= 0 && flock(fd, LOCK_EX | LOCK_NB) != 0)
+	{
+		close(fd);
+		fd = -1;
+	}
+	if(fd < 0)
+	{
+		segment->Release();
+		throw "Failed to create frame ring";
+	}
+	void* base = MAP_FAILED;
+	if(ftruncate(fd, (off_t)size) == 0)
+	{
+		base = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	if(base == MAP_FAILED)
+	{
+		shm_unlink(segmentName.c_str());
+		close(fd);
+		segment->Release();
+		throw "Failed to create frame ring";
+	}
+#endif
+	segment->SetBase((BYTE*)base);
+
+	// A new segment is zeroed, which leaves every slot free and the head at 0
+	RingHeader* header = segment->Header;
+	header->Magic = FRAME_RING_MAGIC;
+	header->Version = FRAME_RING_VERSION;
+	header->Format = format;
+	header->Width = width;
+	header->Height = height;
+	header->Slots = slots;
+	header->SlotSize = slotSize;
+	header->SlotTableOffset = slotTable;
+	header->EntryTableOffset = entryTable;
+	header->DataOffset = data;
+	header->SegmentSize = size;
+	segment->SetTables();
+	header->Ready.store(1);
+
+	m_state = new State();
+	m_state->name = segmentName;
+#ifndef _WIN32
+	m_state->fd = fd;
+#endif
+	m_state->segment = segment;
+	m_state->cursor = 0;
+	m_state->current = -1;
+	m_state->frame = NULL;
+	m_state->sequence = 0;
+	m_state->dropped = 0;
+}
+
+CFrameRingWriter::~CFrameRingWriter(void)
+{
+	if(m_state->current >= 0)
+	{
+		Cancel(m_state->frame);
+	}
+#ifndef _WIN32
+	shm_unlink(m_state->name.c_str());
+	close(m_state->fd);
+#endif
+	m_state->segment->Release();
+	delete m_state;
+}
+
+CPlanarFrame* CFrameRingWriter::BeginWrite(void)
+{
+	if(m_state->current >= 0)
+	{
+		throw "A frame of the ring is already being written";
+	}
+
+	RingSegment* segment = m_state->segment;
+	int slots = segment->Header->Slots;
+
+	// Slots are taken round robin, so the most recent frames are the last ones reused
+	for(int i = 0; i < slots; i++)
+	{
+		int slot = (m_state->cursor + i) % slots;
+		uint32_t expected = 0;
+		if(segment->Slots[slot].Readers.compare_exchange_strong(expected, FRAME_RING_WRITER))
+		{
+			try
+			{
+				segment->AddRef();
+				m_state->frame = CreateSlotFrame(segment, slot, ReleaseSegment, segment);
+			}
+			catch(...)
+			{
+				segment->Slots[slot].Readers.store(0);
+				throw;
+			}
+			m_state->cursor = (slot + 1) % slots;
+			m_state->current = slot;
+			return m_state->frame;
+		}
+	}
+
+	m_state->dropped++;
+	return NULL;
+}
+
+void CFrameRingWriter::Publish(CPlanarFrame* frame, long long timestamp)
+{
+	if(m_state->current < 0 || frame != m_state->frame)
+	{
+		throw "Frame was not taken from this ring";
+	}
+
+	RingSegment* segment = m_state->segment;
+	RingHeader* header = segment->Header;
+	RingSlot& slot = segment->Slots[m_state->current];
+	uint64_t sequence = ++m_state->sequence;
+
+	slot.Timestamp = timestamp;
+	slot.Sequence.store(sequence);
+	segment->Entries[sequence % header->Slots].store(PackEntry(sequence, m_state->current));
+	slot.Readers.store(0);
+	header->Head.store(sequence);
+	WakeReaders(segment);
+
+	m_state->current = -1;
+	m_state->frame = NULL;
+	frame->Release();
+}
+
+void CFrameRingWriter::Cancel(CPlanarFrame* frame)
+{
+	if(m_state->current < 0 || frame != m_state->frame)
+	{
+		throw "Frame was not taken from this ring";
+	}
+
+	// The entry of the frame the slot held still leads readers here, while its planes may be
+	// half overwritten. Sequence 0 is never published, so leases taken from now on fail.
+	RingSlot& slot = m_state->segment->Slots[m_state->current];
+	slot.Sequence.store(0);
+	slot.Readers.store(0);
+	m_state->current = -1;
+	m_state->frame = NULL;
+	frame->Release();
+}
+
+bool CFrameRingWriter::Write(const CPlanarFrame* frame, long long timestamp)
+{
+	RingHeader* header = m_state->segment->Header;
+	if(frame->GetFormat() != header->Format || frame->GetWidth() != header->Width || frame->GetHeight() != header->Height)
+	{
+		throw "Frame does not match the ring";
+	}
+
+	CPlanarFrame* slot = BeginWrite();
+	if(!slot)
+	{
+		return false;
+	}
+	CopyFrame(frame, slot);
+	Publish(slot, timestamp);
+	return true;
+}
+
+void CFrameRingWriter::GetStats(FrameRingStats* stats) const
+{
+	stats->Frames = (long long)m_state->sequence;
+	stats->Dropped = m_state->dropped;
+}
+
+struct CFrameRingReader::State
+{
+	RingSegment* segment;
+	uint64_t next;
+	long long frames;
+	long long dropped;
+};
+
+CFrameRingReader::CFrameRingReader(const char* name)
+	: m_state(NULL)
+{
+	std::string segmentName = GetSegmentName(name);
+
+	RingSegment* segment = new RingSegment();
+#ifdef _WIN32
+	segment->Mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, segmentName.c_str());
+	segment->Wake = OpenSemaphoreA(SYNCHRONIZE | SEMAPHORE_MODIFY_STATE, FALSE, (segmentName + ".wake").c_str());
+	BYTE* base = segment->Mapping && segment->Wake ? (BYTE*)MapViewOfFile(segment->Mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0) : NULL;
+	MEMORY_BASIC_INFORMATION region;
+	if(!base || !VirtualQuery(base, &region, sizeof(region)))
+	{
+		if(base)
+		{
+			UnmapViewOfFile(base);
+		}
+		segment->Release();
+		throw "Failed to open frame ring";
+	}
+	segment->Size = region.RegionSize;
+#else
+	int fd = shm_open(segmentName.c_str(), O_RDWR, 0);
+	struct stat info;
+	if(fd < 0 || fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(RingHeader))
+	{
+		if(fd >= 0)
+		{
+			close(fd);
+		}
+		segment->Release();
+		throw "Failed to open frame ring";
+	}
+	segment->Size = (size_t)info.st_size;
+	void* base = mmap(NULL, segment->Size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(base == MAP_FAILED)
+	{
+		segment->Release();
+		throw "Failed to open frame ring";
+	}
+#endif
+	segment->SetBase((BYTE*)base);
+
+	RingHeader* header = segment->Header;
+	if(header->Ready.load() != 1)
+	{
+		segment->Release();
+		throw "Frame ring is not ready";
+	}
+	if(header->Magic != FRAME_RING_MAGIC || header->Version != FRAME_RING_VERSION || header->SegmentSize > segment->Size
+		|| header->Format < 0 || header->Format >= FF_COUNT || header->Slots < 2 || header->Slots > FRAME_RING_MAX_SLOTS)
+	{
+		segment->Release();
+		throw "Not a frame ring";
+	}
+	segment->SetTables();
+
+	m_state = new State();
+	m_state->segment = segment;
+	m_state->next = header->Head.load() + 1;
+	m_state->frames = 0;
+	m_state->dropped = 0;
+}
+
+CFrameRingReader::~CFrameRingReader(void)
+{
+	m_state->segment->Release();
+	delete m_state;
+}
+
+CPlanarFrame* CFrameRingReader::Read(int timeoutMs, long long* sequence, long long* timestamp)
+{
+	RingSegment* segment = m_state->segment;
+	RingHeader* header = segment->Header;
+	uint64_t slots = (uint64_t)header->Slots;
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs < 0 ? 0 : timeoutMs);
+
+	for(;;)
+	{
+		uint32_t wake = header->Wake.load();
+		uint64_t head = header->Head.load();
+
+		if(head >= m_state->next)
+		{
+			// Frames more than a ring behind are gone, the oldest one left may still be there
+			if(head - m_state->next >= slots)
+			{
+				uint64_t oldest = head - slots + 1;
+				m_state->dropped += (long long)(oldest - m_state->next);
+				m_state->next = oldest;
+			}
+
+			uint64_t next = m_state->next++;
+			uint64_t entry = segment->Entries[next % slots].load();
+			if((entry >> FRAME_RING_SLOT_BITS) == next)
+			{
+				int index = (int)(entry & ((1 << FRAME_RING_SLOT_BITS) - 1));
+				RingSlot& slot = segment->Slots[index];
+
+				// The read lease keeps the writer off the slot, it only counts once the
+				// slot turns out to still hold this frame
+				uint32_t readers = slot.Readers.load();
+				while(!(readers & FRAME_RING_WRITER) && !slot.Readers.compare_exchange_weak(readers, readers + 1))
+				{
+				}
+				if(!(readers & FRAME_RING_WRITER))
+				{
+					if(slot.Sequence.load() == next)
+					{
+						SlotLease* lease = new SlotLease();
+						lease->Segment = segment;
+						lease->Slot = index;
+						segment->AddRef();
+						CPlanarFrame* frame = CreateSlotFrame(segment, index, ReleaseSlotLease, lease);
+						if(sequence)
+						{
+							*sequence = (long long)next;
+						}
+						if(timestamp)
+						{
+							*timestamp = slot.Timestamp;
+						}
+						m_state->frames++;
+						return frame;
+					}
+					slot.Readers.fetch_sub(1);
+				}
+			}
+
+			// Overwritten between the head and the slot, the reader moves on
+			m_state->dropped++;
+			continue;
+		}
+
+		int remaining = -1;
+		if(timeoutMs >= 0)
+		{
+			long long left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+			if(left <= 0)
+			{
+				return NULL;
+			}
+			remaining = (int)left;
+		}
+		WaitForWriter(segment, wake, remaining);
+	}
+}
+
+void CFrameRingReader::GetStats(FrameRingStats* stats) const
+{
+	stats->Frames = m_state->frames;
+	stats->Dropped = m_state->dropped;
+}
+
+int CFrameRingReader::GetWidth(void) const
+{
+	return m_state->segment->Header->Width;
+}
+
+int CFrameRingReader::GetHeight(void) const
+{
+	return m_state->segment->Header->Height;
+}
+
+FrameFormat CFrameRingReader::GetFormat(void) const
+{
+	return (FrameFormat)m_state->segment->Header->Format;
+}
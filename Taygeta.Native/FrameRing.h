@@ -0,0 +1,76 @@
+#pragma once
+
+#include "NativeLib.h"
+#include "PlanarFrame.h"
+
+#define FRAME_RING_MAGIC 0x474E4954		// "TING"
+#define FRAME_RING_VERSION 1
+#define FRAME_RING_MAX_SLOTS 1024
+
+struct FrameRingStats
+{
+	long long Frames;		// writer: frames published; reader: frames read
+	long long Dropped;		// writer: no slot was free; reader: frames overwritten before they were read
+};
+
+// Single producer side of a named shared memory ring of preallocated frame slots. The
+// producer fills a slot in place and publishes it under the next sequence number; any
+// number of readers in other processes map the same memory and see every frame they keep
+// up with. The producer never waits: slots still held by readers are skipped, and when
+// none is free the frame is dropped. The name is removed when the writer goes away,
+// readers that have it open keep working until they close. On POSIX systems a segment of
+// the same name, left by a writer that crashed, is replaced while one of a live writer
+// makes the constructor fail; on Windows the name must be free. A frame still being
+// written when the writer goes away is cancelled.
+class NATIVELIB CFrameRingWriter
+{
+public:
+	CFrameRingWriter(const char* name, int slots, int width, int height, FrameFormat format);
+	virtual ~CFrameRingWriter(void);
+
+	// Slot to fill, NULL when every slot is held by readers. Must be followed by Publish
+	// or Cancel before the next call; both release the frame.
+	CPlanarFrame* BeginWrite(void);
+	void Publish(CPlanarFrame* frame, long long timestamp);
+	void Cancel(CPlanarFrame* frame);
+
+	// Copies a frame into the next free slot and publishes it; false when it was dropped
+	bool Write(const CPlanarFrame* frame, long long timestamp);
+
+	void GetStats(FrameRingStats* stats) const;
+
+private:
+	struct State;
+	State* m_state;
+
+	CFrameRingWriter(const CFrameRingWriter&);
+	CFrameRingWriter& operator=(const CFrameRingWriter&);
+};
+
+// One consumer of a frame ring. Frames are returned in sequence order and reference the
+// shared slot directly; the slot stays readable, and is not reused by the producer, until
+// the frame is released. Their planes must not be written. A reader that falls more than
+// a ring behind skips to the oldest frame still available. Readers are not shared between
+// threads; open one per consumer instead.
+class NATIVELIB CFrameRingReader
+{
+public:
+	// Starts with the next frame published after opening
+	CFrameRingReader(const char* name);
+	virtual ~CFrameRingReader(void);
+
+	// Waits up to timeoutMs (-1 for ever) for the next frame, NULL on timeout
+	CPlanarFrame* Read(int timeoutMs, long long* sequence, long long* timestamp);
+
+	void GetStats(FrameRingStats* stats) const;
+	int GetWidth(void) const;
+	int GetHeight(void) const;
+	FrameFormat GetFormat(void) const;
+
+private:
+	struct State;
+	State* m_state;
+
+	CFrameRingReader(const CFrameRingReader&);
+	CFrameRingReader& operator=(const CFrameRingReader&);
+};
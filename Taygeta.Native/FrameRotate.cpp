@@ -0,0 +1,289 @@
+#include "FrameRotate.h"
+#include "RotateKernels.h"
+#include "YuvKernels.h"
+#include "RowBands.h"
+
+#include <string.h>
+#include <vector>
+
+#define ROTATE_TILE 64
+
+// Scratch rows of packed tiles hold a tile and the pair its edges may cut into
+#define SCRATCH_PITCH (ROTATE_TILE + 2)
+
+// Target pixel (x, y) reads source column y and row x when Swap is set, column x and row y
+// otherwise, each counted from the far edge where mirrored
+struct RotationMap
+{
+	bool Swap;
+	bool MirrorX;
+	bool MirrorY;
+};
+
+static const RotationMap s_maps[FR_COUNT] =
+{
+	{ false, false, false },	// FR_NONE
+	{ true, false, true },		// FR_ROTATE90
+	{ false, true, true },		// FR_ROTATE180
+	{ true, true, false },		// FR_ROTATE270
+	{ false, true, false },		// FR_FLIP_X
+	{ true, false, false },		// FR_ROTATE90_FLIP_X
+	{ false, false, true },		// FR_FLIP_Y
+	{ true, true, true }		// FR_ROTATE270_FLIP_X
+};
+
+enum PlaneKind
+{
+	PK_NONE,
+	PK_BYTES,
+	PK_PAIRS,
+	PK_YUY2,
+	PK_UYVY
+};
+
+static PlaneKind GetPlaneKind(FrameFormat format, int plane)
+{
+	switch(format)
+	{
+	case FF_Y800:
+	case FF_YUV:
+	case FF_YV12:
+	case FF_I420:
+		return PK_BYTES;
+
+	case FF_NV12:
+	case FF_NV21:
+		return plane == 0 ? PK_BYTES : PK_PAIRS;
+
+	case FF_YUY2:
+		return PK_YUY2;
+
+	case FF_UYVY:
+		return PK_UYVY;
+
+	default:
+		return PK_NONE;
+	}
+}
+
+class CRotateTask : public IRowBandTask
+{
+public:
+	CRotateTask(const CPlanarFrame* src, CPlanarFrame* dst, FrameRotation rotation, int bands)
+		: m_src(src), m_dst(dst), m_map(s_maps[rotation]), m_k(GetRotateKernels()), m_yuv(GetYuvRowKernels())
+	{
+		const FrameFormatDesc* desc = GetFrameFormatDesc(dst->GetFormat());
+		m_planes = desc->Planes;
+		for(int p = 0; p < m_planes; p++)
+		{
+			m_kind[p] = GetPlaneKind(dst->GetFormat(), p);
+			m_shiftX[p] = desc->Plane[p].ShiftX;
+			m_shiftY[p] = desc->Plane[p].ShiftY;
+		}
+
+		// Luma, U and V of a tile's source rows, then the same transposed
+		if(m_map.Swap && (m_kind[0] == PK_YUY2 || m_kind[0] == PK_UYVY))
+		{
+			m_scratch.resize((size_t)bands * 6 * SCRATCH_PITCH * SCRATCH_PITCH);
+		}
+	}
+
+	virtual void RunRows(int band, int first, int count)
+	{
+		for(int p = 0; p < m_planes; p++)
+		{
+			int rows = (first + count) >> m_shiftY[p];
+			int row = first >> m_shiftY[p];
+			if(!m_map.Swap)
+			{
+				for(; row < rows; row++)
+				{
+					CopyRow(p, row);
+				}
+				continue;
+			}
+
+			int width = m_dst->GetWidth() >> m_shiftX[p];
+			for(int y = row; y < rows; y += ROTATE_TILE)
+			{
+				int y1 = y + ROTATE_TILE < rows ? y + ROTATE_TILE : rows;
+				for(int x = 0; x < width; x += ROTATE_TILE)
+				{
+					int x1 = x + ROTATE_TILE < width ? x + ROTATE_TILE : width;
+					if(m_kind[p] == PK_YUY2 || m_kind[p] == PK_UYVY)
+					{
+						TransposePackedTile(band, x, x1, y, y1);
+					}
+					else
+					{
+						TransposeTile(p, x, x1, y, y1);
+					}
+				}
+			}
+		}
+	}
+
+private:
+	const CPlanarFrame* m_src;
+	CPlanarFrame* m_dst;
+	RotationMap m_map;
+	const RotateKernels* m_k;
+	const YuvRowKernels* m_yuv;
+	int m_planes;
+	PlaneKind m_kind[4];
+	int m_shiftX[4];
+	int m_shiftY[4];
+	std::vector<BYTE> m_scratch;
+
+	// Target row of a plane from a source row, mirrored or copied
+	void CopyRow(int plane, int row)
+	{
+		int width = m_dst->GetWidth() >> m_shiftX[plane];
+		int from = m_map.MirrorY ? (m_src->GetHeight() >> m_shiftY[plane]) - 1 - row : row;
+		const BYTE* in = m_src->GetPlane(plane) + (ptrdiff_t)from * m_src->GetPitch(plane);
+		BYTE* out = m_dst->GetPlane(plane) + (ptrdiff_t)row * m_dst->GetPitch(plane);
+		if(!m_map.MirrorX)
+		{
+			memcpy(out, in, GetPlaneRowBytes(m_dst->GetFormat(), plane, m_dst->GetWidth()));
+			return;
+		}
+
+		switch(m_kind[plane])
+		{
+		case PK_PAIRS:
+			m_k->MirrorPairs(in, out, width);
+			break;
+		case PK_YUY2:
+			m_k->MirrorYuy2(in, out, width / 2);
+			break;
+		case PK_UYVY:
+			m_k->MirrorUyvy(in, out, width / 2);
+			break;
+		default:
+			m_k->Mirror(in, out, width);
+			break;
+		}
+	}
+
+	// Target rows y0..y1 and columns x0..x1 of a plane are source columns and rows; mirrors
+	// walk the source rows or the target rows upwards
+	void TransposeTile(int plane, int x0, int x1, int y0, int y1)
+	{
+		int bytes = m_kind[plane] == PK_PAIRS ? 2 : 1;
+		int srcPitch = m_src->GetPitch(plane);
+		int dstPitch = m_dst->GetPitch(plane);
+		int row = m_map.MirrorY ? (m_src->GetHeight() >> m_shiftY[plane]) - 1 - x0 : x0;
+		int column = m_map.MirrorX ? (m_src->GetWidth() >> m_shiftX[plane]) - y1 : y0;
+		const BYTE* in = m_src->GetPlane(plane) + (ptrdiff_t)row * srcPitch + column * bytes;
+		BYTE* out = m_dst->GetPlane(plane) + (ptrdiff_t)(m_map.MirrorX ? y1 - 1 : y0) * dstPitch + x0 * bytes;
+		if(m_map.MirrorY)
+		{
+			srcPitch = -srcPitch;
+		}
+		if(m_map.MirrorX)
+		{
+			dstPitch = -dstPitch;
+		}
+
+		if(bytes == 2)
+		{
+			m_k->TransposePairs(in, srcPitch, out, dstPitch, y1 - y0, x1 - x0);
+		}
+		else
+		{
+			m_k->Transpose(in, srcPitch, out, dstPitch, y1 - y0, x1 - x0);
+		}
+	}
+
+	// Quarter turns of YUY2 and UYVY: the source rows of the tile are unpacked in target
+	// column order, chroma of each pair of them averaged, and all of it transposed and packed
+	// again. x0 and x1 are even, so pairs of rows make whole macropixels.
+	void TransposePackedTile(int band, int x0, int x1, int y0, int y1)
+	{
+		const int size = SCRATCH_PITCH * SCRATCH_PITCH;
+		BYTE* luma = &m_scratch[(size_t)band * 6 * size];
+		BYTE* u = luma + size;
+		BYTE* v = u + size;
+		BYTE* lumaT = v + size;
+		BYTE* uT = lumaT + size;
+		BYTE* vT = uT + size;
+		bool uyvy = m_kind[0] == PK_UYVY;
+
+		// Source columns of the target rows, widened to whole macropixels
+		int width = m_src->GetWidth();
+		int first = m_map.MirrorX ? width - y1 : y0;
+		int last = m_map.MirrorX ? width - y0 : y1;
+		int pair = first / 2;
+		int pairs = (last + 1) / 2 - pair;
+
+		int rows = x1 - x0;
+		for(int k = 0; k < rows; k++)
+		{
+			int row = m_map.MirrorY ? m_src->GetHeight() - 1 - (x0 + k) : x0 + k;
+			const BYTE* in = m_src->GetPlane(0) + (ptrdiff_t)row * m_src->GetPitch(0) + 4 * pair;
+			BYTE* y = luma + k * SCRATCH_PITCH;
+			if(uyvy)
+			{
+				m_yuv->UnpackUyvy(in, y, u + k * SCRATCH_PITCH, v + k * SCRATCH_PITCH, pairs);
+			}
+			else
+			{
+				m_yuv->UnpackYuy2(in, y, u + k * SCRATCH_PITCH, v + k * SCRATCH_PITCH, pairs);
+			}
+		}
+		for(int k = 0; k < rows / 2; k++)
+		{
+			m_yuv->AverageRows(u + 2 * k * SCRATCH_PITCH, u + (2 * k + 1) * SCRATCH_PITCH, u + k * SCRATCH_PITCH, pairs);
+			m_yuv->AverageRows(v + 2 * k * SCRATCH_PITCH, v + (2 * k + 1) * SCRATCH_PITCH, v + k * SCRATCH_PITCH, pairs);
+		}
+		m_k->Transpose(luma, SCRATCH_PITCH, lumaT, SCRATCH_PITCH, 2 * pairs, rows);
+		m_k->Transpose(u, SCRATCH_PITCH, uT, SCRATCH_PITCH, pairs, rows / 2);
+		m_k->Transpose(v, SCRATCH_PITCH, vT, SCRATCH_PITCH, pairs, rows / 2);
+
+		for(int y = y0; y < y1; y++)
+		{
+			int column = m_map.MirrorX ? width - 1 - y : y;
+			const BYTE* ty = lumaT + (column - 2 * pair) * SCRATCH_PITCH;
+			const BYTE* tu = uT + (column / 2 - pair) * SCRATCH_PITCH;
+			const BYTE* tv = vT + (column / 2 - pair) * SCRATCH_PITCH;
+			BYTE* out = m_dst->GetPlane(0) + (ptrdiff_t)y * m_dst->GetPitch(0) + 2 * x0;
+			if(uyvy)
+			{
+				m_yuv->PackUyvy(ty, tu, tv, out, rows / 2);
+			}
+			else
+			{
+				m_yuv->PackYuy2(ty, tu, tv, out, rows / 2);
+			}
+		}
+	}
+};
+
+bool CanRotateFrame(const CPlanarFrame* src, const CPlanarFrame* dst, FrameRotation rotation)
+{
+	FrameFormat format = src->GetFormat();
+	if(rotation < 0 || rotation >= FR_COUNT || dst->GetFormat() != format || GetPlaneKind(format, 0) == PK_NONE)
+	{
+		return false;
+	}
+
+	bool swap = s_maps[rotation].Swap;
+	int width = swap ? src->GetHeight() : src->GetWidth();
+	int height = swap ? src->GetWidth() : src->GetHeight();
+	int alignX = GetFormatAlignmentX(format);
+	int alignY = GetFormatAlignmentY(format);
+	return width > 0 && height > 0 && dst->GetWidth() == width && dst->GetHeight() == height &&
+		width % alignX == 0 && height % alignY == 0 && src->GetWidth() % alignX == 0 && src->GetHeight() % alignY == 0;
+}
+
+void RotateFrame(const CPlanarFrame* src, CPlanarFrame* dst, FrameRotation rotation, int threads)
+{
+	if(!CanRotateFrame(src, dst, rotation))
+	{
+		throw "Unsupported rotation";
+	}
+
+	int bands = GetRowBandCount(dst->GetWidth(), dst->GetHeight(), threads);
+	CRotateTask task(src, dst, rotation, bands);
+	RunRowBands(&task, dst->GetHeight(), bands, GetFormatAlignmentY(dst->GetFormat()));
+}
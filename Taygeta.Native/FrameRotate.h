@@ -0,0 +1,32 @@
+#pragma once
+
+#include "NativeLib.h"
+#include "FrameFormat.h"
+#include "PlanarFrame.h"
+
+// Orientations of RotateFrame, values match System.Drawing.RotateFlipType: a clockwise
+// rotation, then a horizontal flip for the FLIP_X ones
+enum FrameRotation
+{
+	FR_NONE = 0,
+	FR_ROTATE90,
+	FR_ROTATE180,
+	FR_ROTATE270,
+	FR_FLIP_X,
+	FR_ROTATE90_FLIP_X,		// transpose
+	FR_FLIP_Y,
+	FR_ROTATE270_FLIP_X,	// transpose about the other diagonal
+	FR_COUNT
+};
+
+// Rotations and flips of Y800, YUV, I420, NV12, NV21, YUY2 and UYVY, keeping the layout.
+// Whole chroma blocks map onto whole chroma blocks, so planar chroma moves as it is;
+// quarter turns of YUY2 and UYVY average the chroma of the two rows that become one pair
+// and repeat it on the two rows it came from. True when src and dst share the layout, dst
+// has the size of src turned by rotation and both sizes are whole chroma blocks.
+NATIVELIB bool CanRotateFrame(const CPlanarFrame* src, const CPlanarFrame* dst, FrameRotation rotation);
+
+// Transposes run on tiles of 64x64 pixels, so the rows a tile reads and the ones it writes
+// stay in the L1 cache. Rows run in bands on up to threads threads, 0 for one per processor.
+// src and dst must not overlap.
+NATIVELIB void RotateFrame(const CPlanarFrame* src, CPlanarFrame* dst, FrameRotation rotation, int threads);
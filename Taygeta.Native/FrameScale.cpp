@@ -0,0 +1,630 @@
+#include "FrameScale.h"
+#include "RgbKernels.h"
+#include "ScaleKernels.h"
+#include "RowBands.h"
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+#include <mutex>
+
+// Where the samples of one component lie in a frame
+struct ScaleChannel
+{
+	int Plane;			// -1 for components the frame lacks and RGB scratch rows of targets
+	int Offset;			// samples to the first sample of a row
+	int Step;			// samples from one sample to the next
+	int ShiftX;			// log2 of the subsampling against luma
+	int ShiftY;
+};
+
+struct ScaleLayout
+{
+	FrameFormat Format;
+	ScaleChannel Channel[4];	// Y, U, V or R, G, B, A
+};
+
+#define SCRATCH_CHANNEL { -1, 0, 1, 0, 0 }
+
+static const ScaleLayout s_layouts[] =
+{
+	{ FF_Y800,    { { 0, 0, 1, 0, 0 }, SCRATCH_CHANNEL, SCRATCH_CHANNEL, SCRATCH_CHANNEL } },
+	{ FF_Y16,     { { 0, 0, 1, 0, 0 }, SCRATCH_CHANNEL, SCRATCH_CHANNEL, SCRATCH_CHANNEL } },
+	{ FF_YUV,     { { 0, 0, 1, 0, 0 }, { 1, 0, 1, 0, 0 }, { 2, 0, 1, 0, 0 }, SCRATCH_CHANNEL } },
+	{ FF_YUY2,    { { 0, 0, 2, 0, 0 }, { 0, 1, 4, 1, 0 }, { 0, 3, 4, 1, 0 }, SCRATCH_CHANNEL } },
+	{ FF_UYVY,    { { 0, 1, 2, 0, 0 }, { 0, 0, 4, 1, 0 }, { 0, 2, 4, 1, 0 }, SCRATCH_CHANNEL } },
+	{ FF_YV12,    { { 0, 0, 1, 0, 0 }, { 2, 0, 1, 1, 1 }, { 1, 0, 1, 1, 1 }, SCRATCH_CHANNEL } },
+	{ FF_I420,    { { 0, 0, 1, 0, 0 }, { 1, 0, 1, 1, 1 }, { 2, 0, 1, 1, 1 }, SCRATCH_CHANNEL } },
+	{ FF_NV12,    { { 0, 0, 1, 0, 0 }, { 1, 0, 2, 1, 1 }, { 1, 1, 2, 1, 1 }, SCRATCH_CHANNEL } },
+	{ FF_NV21,    { { 0, 0, 1, 0, 0 }, { 1, 1, 2, 1, 1 }, { 1, 0, 2, 1, 1 }, SCRATCH_CHANNEL } },
+	{ FF_Y411,    { { 0, 0, 1, 0, 0 }, { 1, 0, 1, 2, 0 }, { 2, 0, 1, 2, 0 }, SCRATCH_CHANNEL } },
+	{ FF_Y410,    { { 0, 0, 1, 0, 0 }, { 1, 0, 1, 2, 2 }, { 2, 0, 1, 2, 2 }, SCRATCH_CHANNEL } },
+	{ FF_I422,    { { 0, 0, 1, 0, 0 }, { 1, 0, 1, 1, 0 }, { 2, 0, 1, 1, 0 }, SCRATCH_CHANNEL } },
+	{ FF_YUV16,   { { 0, 0, 1, 0, 0 }, { 1, 0, 1, 0, 0 }, { 2, 0, 1, 0, 0 }, SCRATCH_CHANNEL } },
+	{ FF_I420P16, { { 0, 0, 1, 0, 0 }, { 1, 0, 1, 1, 1 }, { 2, 0, 1, 1, 1 }, SCRATCH_CHANNEL } },
+	{ FF_RGB24,   { { 0, 2, 3, 0, 0 }, { 0, 1, 3, 0, 0 }, { 0, 0, 3, 0, 0 }, SCRATCH_CHANNEL } },
+	{ FF_RGBA,    { { 0, 0, 4, 0, 0 }, { 0, 1, 4, 0, 0 }, { 0, 2, 4, 0, 0 }, { 0, 3, 4, 0, 0 } } },
+	{ FF_ARGB,    { { 0, 1, 4, 0, 0 }, { 0, 2, 4, 0, 0 }, { 0, 3, 4, 0, 0 }, { 0, 0, 4, 0, 0 } } },
+};
+
+static const ScaleChannel s_scratchChannel = SCRATCH_CHANNEL;
+
+// Bytes of horizontally filtered rows a band keeps, column tiles narrow to fit them
+#define TILE_RING_BYTES (128 * 1024)
+
+// Column tiles are multiples of this many luma samples
+#define TILE_ALIGNMENT 64
+
+// Filter banks kept across calls, video scales the same way frame after frame
+#define CACHED_TAPS 32
+
+static const ScaleLayout* FindLayout(FrameFormat format)
+{
+	for(size_t i = 0; i < sizeof(s_layouts) / sizeof(s_layouts[0]); i++)
+	{
+		if(s_layouts[i].Format == format)
+		{
+			return &s_layouts[i];
+		}
+	}
+	return NULL;
+}
+
+static RgbLayout GetRgbLayout(FrameFormat format)
+{
+	switch(format)
+	{
+	case FF_RGB24:
+		return RL_BGR24;
+	case FF_RGBA:
+		return RL_RGBA;
+	case FF_ARGB:
+		return RL_ARGB;
+	default:
+		return RL_COUNT;
+	}
+}
+
+// Filter of one axis: output sample i is the sum of Weights[i * Stride + k] times input
+// sample Start[i] + k, counted from the first input of the area
+struct ScaleTaps
+{
+	int Size;			// inputs with weight, at most
+	int Stride;			// Size padded for the kernels, the padding weighs 0
+	std::vector<int> Start;
+	std::vector<short> Weights;
+};
+
+// Half the width of a filter in input samples at scale 1
+static double GetFilterSupport(ScaleFilter filter)
+{
+	switch(filter)
+	{
+	case SF_BICUBIC:
+		return 2;
+	case SF_LANCZOS3:
+		return 3;
+	default:
+		return 1;
+	}
+}
+
+// Weight at distance x from the output, in input samples divided by the reduction
+static double GetFilterWeight(ScaleFilter filter, double x)
+{
+	const double pi = 3.14159265358979323846;
+	x = fabs(x);
+	switch(filter)
+	{
+	case SF_BICUBIC:
+		return x < 1 ? (1.4 * x - 2.4) * x * x + 1 : x < 2 ? ((-0.6 * x + 3) * x - 4.8) * x + 2.4 : 0;
+	case SF_LANCZOS3:
+		return x < 1e-8 ? 1 : x < 3 ? 3 * sin(pi * x) * sin(pi * x / 3) / (pi * pi * x * x) : 0;
+	default:
+		return x < 1 ? 1 - x : 0;
+	}
+}
+
+// Output sample i lies at input position first + i * step. Only inputs lo..hi are read,
+// taps beyond them add to the edge samples.
+static void BuildTaps(ScaleTaps* taps, int count, double first, double step, int lo, int hi, ScaleFilter filter, int multiple)
+{
+	// Area filters are the overlap of the output's span with each input, a tent when enlarging
+	double scale = step > 1 ? step : 1;
+	double radius = filter == SF_AREA ? (scale + 1) / 2 : GetFilterSupport(filter) * scale;
+
+	// No more than 2 * radius inputs lie strictly within the radius, every filter passes
+	// inputs at whole positions at scale 1 through
+	int span = (int)ceil(2 * radius);
+	int size = span < hi - lo + 1 ? span : hi - lo + 1;
+	bool copy = step == 1 && first == floor(first);
+	size = copy ? 1 : size;
+
+	taps->Size = size;
+	taps->Stride = (size + multiple - 1) / multiple * multiple;
+	taps->Start.resize(count);
+	taps->Weights.assign((size_t)count * taps->Stride, 0);
+
+	std::vector<double> weights(size);
+	for(int i = 0; i < count; i++)
+	{
+		double pos = first + i * step;
+		if(copy)
+		{
+			int input = (int)pos < lo ? lo : (int)pos > hi ? hi : (int)pos;
+			taps->Start[i] = input - lo;
+			taps->Weights[(size_t)i * taps->Stride] = 1 << SCALE_WEIGHT_BITS;
+			continue;
+		}
+
+		int from = (int)floor(pos - radius) + 1;
+		int to = (int)ceil(pos + radius) - 1;
+		to = to < from + span - 1 ? to : from + span - 1;
+		int start = from < lo ? lo : from > hi - size + 1 ? hi - size + 1 : from;
+
+		double sum = 0;
+		weights.assign(size, 0);
+		for(int k = from; k <= to; k++)
+		{
+			double w;
+			if(filter == SF_AREA)
+			{
+				double left = k - 0.5 > pos - scale / 2 ? k - 0.5 : pos - scale / 2;
+				double right = k + 0.5 < pos + scale / 2 ? k + 0.5 : pos + scale / 2;
+				w = right > left ? right - left : 0;
+			}
+			else
+			{
+				w = GetFilterWeight(filter, (k - pos) / scale);
+			}
+
+			if(w != 0)
+			{
+				int input = k < lo ? lo : k > hi ? hi : k;
+				weights[input - start] += w;
+				sum += w;
+			}
+		}
+
+		// Round each weight, the largest takes what rounding left over
+		short* out = &taps->Weights[(size_t)i * taps->Stride];
+		int total = 0;
+		int largest = 0;
+		for(int k = 0; k < size; k++)
+		{
+			out[k] = (short)floor(weights[k] / sum * (1 << SCALE_WEIGHT_BITS) + 0.5);
+			total += out[k];
+			largest = out[k] > out[largest] ? k : largest;
+		}
+		out[largest] = (short)(out[largest] + (1 << SCALE_WEIGHT_BITS) - total);
+		taps->Start[i] = start - lo;
+	}
+}
+
+// Arguments of BuildTaps and the kernels' reordering of the weights
+struct TapsKey
+{
+	int Count;
+	double First;
+	double Step;
+	int Lo;
+	int Hi;
+	ScaleFilter Filter;
+	int Multiple;
+	ScalePackFunc Pack;
+
+	bool operator==(const TapsKey& other) const
+	{
+		return Count == other.Count && First == other.First && Step == other.Step && Lo == other.Lo && Hi == other.Hi &&
+			Filter == other.Filter && Multiple == other.Multiple && Pack == other.Pack;
+	}
+};
+
+struct CachedTaps
+{
+	TapsKey Key;
+	ScaleTaps Taps;
+	long long LastUse;
+};
+
+static std::mutex s_tapsLock;
+static std::vector<CachedTaps> s_taps;
+static long long s_tapsTick;
+
+// BuildTaps through the cache, the least recently used bank makes room
+static void GetTaps(ScaleTaps* taps, const TapsKey& key)
+{
+	{
+		std::lock_guard<std::mutex> guard(s_tapsLock);
+		for(size_t i = 0; i < s_taps.size(); i++)
+		{
+			if(s_taps[i].Key == key)
+			{
+				s_taps[i].LastUse = ++s_tapsTick;
+				*taps = s_taps[i].Taps;
+				return;
+			}
+		}
+	}
+
+	BuildTaps(taps, key.Count, key.First, key.Step, key.Lo, key.Hi, key.Filter, key.Multiple);
+	if(key.Pack != NULL)
+	{
+		key.Pack(&taps->Start[0], &taps->Weights[0], key.Count, taps->Stride);
+	}
+
+	std::lock_guard<std::mutex> guard(s_tapsLock);
+	size_t slot = s_taps.size();
+	if(slot == CACHED_TAPS)
+	{
+		slot = 0;
+		for(size_t i = 1; i < s_taps.size(); i++)
+		{
+			slot = s_taps[i].LastUse < s_taps[slot].LastUse ? i : slot;
+		}
+	}
+	else
+	{
+		s_taps.resize(slot + 1);
+	}
+	s_taps[slot].Key = key;
+	s_taps[slot].Taps = *taps;
+	s_taps[slot].LastUse = ++s_tapsTick;
+}
+
+// Resampling of one component from the source to the target
+struct ChannelPlan
+{
+	ScaleChannel Src;
+	ScaleChannel Dst;
+	int Fill;			// value of a component the source lacks, -1 when it has it
+	int SrcX;			// first input sample and row of the area
+	int SrcY;
+	int SrcWidth;		// input samples of the area per row
+	int Width;			// target samples per row
+	ScaleTaps Horizontal;
+	ScaleTaps Vertical;
+};
+
+static inline void FilterRow(const ScaleRowKernels* k, const BYTE* src, short* dst, int width, const int* starts, const short* weights, int taps)
+{
+	k->Horizontal(src, dst, width, starts, weights, taps);
+}
+
+static inline void FilterRow(const ScaleRowKernels* k, const unsigned short* src, int* dst, int width, const int* starts, const short* weights, int taps)
+{
+	k->Horizontal16(src, dst, width, starts, weights, taps);
+}
+
+static inline void SumRows(const ScaleRowKernels* k, const short* const* rows, const short* weights, int taps, BYTE* dst, int width)
+{
+	k->Vertical(rows, weights, taps, dst, width);
+}
+
+static inline void SumRows(const ScaleRowKernels* k, const int* const* rows, const short* weights, int taps, unsigned short* dst, int width)
+{
+	k->Vertical16(rows, weights, taps, dst, width);
+}
+
+// Input rows are filtered horizontally once into a ring of the last rows each band read,
+// and the vertical filter sums rows of the ring. Targets too wide for the rings to stay in
+// cache run in column tiles, each going down all rows of the band.
+template<typename Sample, typename Inter>
+class CScaleTask : public IRowBandTask
+{
+public:
+	CScaleTask(const CPlanarFrame* src, const FrameRect& rect, CPlanarFrame* dst, ScaleFilter filter, int bands)
+		: m_src(src), m_dst(dst), m_k(GetScaleRowKernels()), m_rgb(NULL), m_channels(3)
+	{
+		const ScaleLayout* srcLayout = FindLayout(src->GetFormat());
+		const ScaleLayout* dstLayout = FindLayout(dst->GetFormat());
+		FrameFormat format = dst->GetFormat();
+		const FrameFormatDesc* desc = GetFrameFormatDesc(format);
+		bool convert = desc->Rgb && !GetFrameFormatDesc(src->GetFormat())->Rgb;
+		m_pixelBytes = desc->BitsPerPixel / 8;
+		if(convert)
+		{
+			m_rgb = GetRgbRowKernels()->YuvToRgb[GetRgbLayout(format)][0];
+			GetYuvToRgbCoefs(YM_BT601, YR_LIMITED, &m_coefs);
+		}
+		else if(desc->Rgb)
+		{
+			m_channels = dstLayout->Channel[3].Plane >= 0 ? 4 : 3;
+		}
+		else if(format == FF_Y800 || format == FF_Y16)
+		{
+			m_channels = 1;
+		}
+
+		m_rowSize = 0;
+		int lineSize = 0;
+		for(int c = 0; c < m_channels; c++)
+		{
+			ChannelPlan& plan = m_plan[c];
+			plan.Src = srcLayout->Channel[c];
+			plan.Dst = convert ? s_scratchChannel : dstLayout->Channel[c];
+			plan.Fill = plan.Src.Plane >= 0 ? -1 : c == 3 ? 255 : 1 << (8 * sizeof(Sample) - 1);
+
+			// Packed luma fills whole blocks
+			int block = plan.Dst.Plane < 0 ? 1 : desc->Plane[plan.Dst.Plane].BlockWidth >> plan.Dst.ShiftX;
+			block = block > 1 ? block : 1;
+			int width = (dst->GetWidth() + (1 << plan.Dst.ShiftX) - 1) >> plan.Dst.ShiftX;
+			plan.Width = (width + block - 1) / block * block;
+			m_rowSize = plan.Width > m_rowSize ? plan.Width : m_rowSize;
+			if(plan.Fill >= 0)
+			{
+				continue;
+			}
+
+			plan.SrcX = rect.X >> plan.Src.ShiftX;
+			plan.SrcY = rect.Y >> plan.Src.ShiftY;
+			plan.SrcWidth = ((rect.X + rect.Width - 1) >> plan.Src.ShiftX) - plan.SrcX + 1;
+			ScalePackFunc pack = sizeof(Sample) == 1 ? m_k->PackHorizontal : NULL;
+			BuildChannelTaps(&plan.Horizontal, plan.Width, rect.X, rect.Width, dst->GetWidth(), plan.Src.ShiftX, plan.Dst.ShiftX, filter, 4, pack);
+			int height = (dst->GetHeight() + (1 << plan.Dst.ShiftY) - 1) >> plan.Dst.ShiftY;
+			BuildChannelTaps(&plan.Vertical, height, rect.Y, rect.Height, dst->GetHeight(), plan.Src.ShiftY, plan.Dst.ShiftY, filter, 1, NULL);
+
+			int line = plan.SrcWidth + plan.Horizontal.Stride + 16;
+			lineSize = line > lineSize ? line : lineSize;
+		}
+
+		// Ring bytes per luma column of the target
+		double columnBytes = 0;
+		for(int c = 0; c < m_channels; c++)
+		{
+			if(m_plan[c].Fill < 0)
+			{
+				columnBytes += (double)m_plan[c].Vertical.Size * sizeof(Inter) / (1 << m_plan[c].Dst.ShiftX);
+			}
+		}
+		m_tileWidth = dst->GetWidth();
+		if(columnBytes * m_tileWidth > TILE_RING_BYTES)
+		{
+			int tile = (int)(TILE_RING_BYTES / columnBytes) / TILE_ALIGNMENT * TILE_ALIGNMENT;
+			m_tileWidth = tile > TILE_ALIGNMENT ? tile : TILE_ALIGNMENT;
+		}
+
+		for(int c = 0; c < m_channels; c++)
+		{
+			m_slotSize[c] = 0;
+			for(int x = 0; x < dst->GetWidth(); x += m_tileWidth)
+			{
+				int from, to;
+				GetSpan(m_plan[c], x, &from, &to);
+				m_slotSize[c] = to - from > m_slotSize[c] ? to - from : m_slotSize[c];
+			}
+		}
+
+		m_bands.resize(bands);
+		for(int i = 0; i < bands; i++)
+		{
+			ScaleBand& band = m_bands[i];
+			band.Line.assign(lineSize, 0);
+			band.Out.resize(3 * m_rowSize * sizeof(Sample));
+			int taps = 0;
+			for(int c = 0; c < m_channels; c++)
+			{
+				const ChannelPlan& plan = m_plan[c];
+				if(plan.Fill < 0)
+				{
+					band.Ring[c].resize((size_t)plan.Vertical.Size * m_slotSize[c]);
+					band.RingRows[c].resize(plan.Vertical.Size);
+					taps = plan.Vertical.Size > taps ? plan.Vertical.Size : taps;
+				}
+			}
+			band.Rows.resize(taps);
+			band.Weights.resize(taps);
+		}
+	}
+
+	virtual void RunRows(int index, int first, int count)
+	{
+		ScaleBand& band = m_bands[index];
+		int width = m_dst->GetWidth();
+		for(int x = 0; x < width; x += m_tileWidth)
+		{
+			for(int c = 0; c < m_channels; c++)
+			{
+				band.RingRows[c].assign(band.RingRows[c].size(), -1);
+			}
+
+			for(int y = first; y < first + count; y++)
+			{
+				for(int c = 0; c < m_channels; c++)
+				{
+					const ChannelPlan& plan = m_plan[c];
+					if(y & ((1 << plan.Dst.ShiftY) - 1))
+					{
+						continue;
+					}
+
+					int row = y >> plan.Dst.ShiftY;
+					Sample* out = (Sample*)&band.Out[0] + c * m_rowSize;
+					if(plan.Dst.Plane >= 0)
+					{
+						out = (Sample*)(m_dst->GetPlane(plan.Dst.Plane) + (ptrdiff_t)row * m_dst->GetPitch(plan.Dst.Plane)) + plan.Dst.Offset;
+					}
+
+					int from, to;
+					GetSpan(plan, x, &from, &to);
+					if(plan.Fill >= 0)
+					{
+						for(int i = from; i < to; i++)
+						{
+							out[i * plan.Dst.Step] = (Sample)plan.Fill;
+						}
+						continue;
+					}
+
+					ScaleRow(band, c, row, from, to, out);
+				}
+
+				if(m_rgb)
+				{
+					const BYTE* out = &band.Out[x];
+					m_rgb(out, out + m_rowSize, out + 2 * m_rowSize,
+						m_dst->GetPlane(0) + (ptrdiff_t)y * m_dst->GetPitch(0) + x * m_pixelBytes,
+						width - x < m_tileWidth ? width - x : m_tileWidth, &m_coefs);
+				}
+			}
+		}
+	}
+
+private:
+	struct ScaleBand
+	{
+		std::vector<Sample> Line;			// input samples of the row being filtered, padded for the kernel
+		std::vector<BYTE> Out;				// target rows of RGB and of samples spread over packed layouts
+		std::vector<Inter> Ring[4];			// horizontally filtered input rows of a tile, row r in slot r % Vertical.Size
+		std::vector<int> RingRows[4];		// input row of each slot, -1 for none
+		std::vector<const Inter*> Rows;		// vertical taps of the row being scaled
+		std::vector<short> Weights;
+	};
+
+	const CPlanarFrame* m_src;
+	CPlanarFrame* m_dst;
+	const ScaleRowKernels* m_k;
+	YuvToRgbRowFunc m_rgb;
+	YuvToRgbCoefs m_coefs;
+	int m_pixelBytes;
+	int m_channels;
+	ChannelPlan m_plan[4];
+	int m_rowSize;
+	int m_tileWidth;		// luma samples of the target per column tile
+	int m_slotSize[4];		// samples of the widest tile of each channel
+	std::vector<ScaleBand> m_bands;
+
+	// Target sample i of a channel covers luma (i + 0.5) << dstShift of the target, which
+	// maps onto the area and then onto the source channel
+	static void BuildChannelTaps(ScaleTaps* taps, int count, int offset, int length, int size, int srcShift, int dstShift,
+		ScaleFilter filter, int multiple, ScalePackFunc pack)
+	{
+		double scale = (double)length / size;
+		TapsKey key;
+		key.Count = count;
+		key.First = (0.5 * (1 << dstShift) * scale + offset) / (1 << srcShift) - 0.5;
+		key.Step = scale * (1 << dstShift) / (1 << srcShift);
+		key.Lo = offset >> srcShift;
+		key.Hi = (offset + length - 1) >> srcShift;
+		key.Filter = filter;
+		key.Multiple = multiple;
+		key.Pack = pack;
+		GetTaps(taps, key);
+	}
+
+	// Samples of a channel in the tile starting at luma x, the last tile takes the padding
+	void GetSpan(const ChannelPlan& plan, int x, int* from, int* to) const
+	{
+		*from = x >> plan.Dst.ShiftX;
+		*to = x + m_tileWidth >= m_dst->GetWidth() ? plan.Width : (x + m_tileWidth) >> plan.Dst.ShiftX;
+	}
+
+	// Samples from..to of an input row, filtered horizontally
+	const Inter* InputRow(ScaleBand& band, int channel, int row, int from, int to)
+	{
+		const ChannelPlan& plan = m_plan[channel];
+		int slot = row % plan.Vertical.Size;
+		Inter* out = &band.Ring[channel][(size_t)slot * m_slotSize[channel]];
+		if(band.RingRows[channel][slot] == row)
+		{
+			return out;
+		}
+		band.RingRows[channel][slot] = row;
+
+		// Only the inputs the taps of the tile reach
+		const ScaleTaps& taps = plan.Horizontal;
+		int first = taps.Start[from];
+		int last = taps.Start[to - 1] + taps.Size;
+		last = last < plan.SrcWidth ? last : plan.SrcWidth;
+
+		int step = plan.Src.Step;
+		const Sample* in = (const Sample*)(m_src->GetPlane(plan.Src.Plane) + (ptrdiff_t)(plan.SrcY + row) * m_src->GetPitch(plan.Src.Plane)) +
+			plan.Src.Offset + (plan.SrcX + first) * step;
+		Sample* line = &band.Line[first];
+		if(step == 1)
+		{
+			memcpy(line, in, (last - first) * sizeof(Sample));
+		}
+		else
+		{
+			for(int x = 0; x < last - first; x++)
+			{
+				line[x] = in[x * step];
+			}
+		}
+
+		FilterRow(m_k, &band.Line[0], out, to - from, &taps.Start[from], &taps.Weights[(size_t)from * taps.Stride], taps.Stride);
+		return out;
+	}
+
+	void ScaleRow(ScaleBand& band, int channel, int row, int from, int to, Sample* out)
+	{
+		const ChannelPlan& plan = m_plan[channel];
+		int start = plan.Vertical.Start[row];
+		const short* weights = &plan.Vertical.Weights[(size_t)row * plan.Vertical.Stride];
+
+		int taps = 0;
+		for(int k = 0; k < plan.Vertical.Size; k++)
+		{
+			if(weights[k] != 0)
+			{
+				band.Rows[taps] = InputRow(band, channel, start + k, from, to);
+				band.Weights[taps++] = weights[k];
+			}
+		}
+
+		int step = plan.Dst.Step;
+		Sample* samples = step == 1 ? out + from : (Sample*)&band.Out[0];
+		SumRows(m_k, &band.Rows[0], &band.Weights[0], taps, samples, to - from);
+		for(int x = 0; step != 1 && x < to - from; x++)
+		{
+			out[(from + x) * step] = samples[x];
+		}
+	}
+};
+
+bool CanScaleFrame(FrameFormat src, FrameFormat dst)
+{
+	const ScaleLayout* srcLayout = FindLayout(src);
+	if(!srcLayout || srcLayout->Channel[0].Plane < 0 || !FindLayout(dst))
+	{
+		return false;
+	}
+
+	const FrameFormatDesc* srcDesc = GetFrameFormatDesc(src);
+	const FrameFormatDesc* dstDesc = GetFrameFormatDesc(dst);
+	return srcDesc->BytesPerSample == dstDesc->BytesPerSample && (!srcDesc->Rgb || dstDesc->Rgb);
+}
+
+void ScaleFrame(const CPlanarFrame* src, const FrameRect& rect, CPlanarFrame* dst, ScaleFilter filter, int threads)
+{
+	if(!CanScaleFrame(src->GetFormat(), dst->GetFormat()))
+	{
+		throw "Unsupported conversion";
+	}
+	if(filter < 0 || filter >= SF_COUNT)
+	{
+		throw "Unsupported filter";
+	}
+	if(rect.X < 0 || rect.Y < 0 || rect.Width <= 0 || rect.Height <= 0 ||
+		rect.X > src->GetWidth() - rect.Width || rect.Y > src->GetHeight() - rect.Height)
+	{
+		throw "Rectangle outside the frame";
+	}
+	if(dst->GetWidth() <= 0 || dst->GetHeight() <= 0)
+	{
+		return;
+	}
+
+	int bands = GetRowBandCount(dst->GetWidth(), dst->GetHeight(), threads);
+	if(GetFrameFormatDesc(src->GetFormat())->BytesPerSample == 2)
+	{
+		CScaleTask<unsigned short, int> task(src, rect, dst, filter, bands);
+		RunRowBands(&task, dst->GetHeight(), bands, GetFormatAlignmentY(dst->GetFormat()));
+	}
+	else
+	{
+		CScaleTask<BYTE, short> task(src, rect, dst, filter, bands);
+		RunRowBands(&task, dst->GetHeight(), bands, GetFormatAlignmentY(dst->GetFormat()));
+	}
+}
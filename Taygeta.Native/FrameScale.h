@@ -0,0 +1,39 @@
+#pragma once
+
+#include "NativeLib.h"
+#include "FrameFormat.h"
+#include "PlanarFrame.h"
+
+// Area of a frame in luma pixels
+struct FrameRect
+{
+	int X;
+	int Y;
+	int Width;
+	int Height;
+};
+
+// Resampling filters, values match Taygeta.Imaging.ScaleFilter. Each widens with the
+// reduction when shrinking.
+enum ScaleFilter
+{
+	SF_BILINEAR = 0,	// tent
+	SF_BICUBIC,			// cubic of B = 0, C = 0.6 as swscale's SWS_BICUBIC
+	SF_LANCZOS3,		// sinc windowed by the central lobe of a 3 times wider sinc
+	SF_AREA,			// mean of the inputs the target sample covers, bilinear when enlarging
+	SF_COUNT
+};
+
+// Crop, scale and conversion in one pass. Sources are the 8-bit YUV layouts of
+// YuvConvert.h, Y16, YUV16, I420P16 and RGB24, RGBA and ARGB; targets are those layouts,
+// 8-bit YUV sources also convert to RGB (BT.601, limited range). YUV does not convert to a
+// different sample size and RGB stays RGB. Every component is resampled with a separable
+// filter from the samples inside the area; edges repeat.
+NATIVELIB bool CanScaleFrame(FrameFormat src, FrameFormat dst);
+
+// Scales rect of src to the size of dst. Chroma samples are taken as centred on the luma
+// they cover, in source and target alike, so areas at odd offsets and changes of
+// subsampling keep chroma in place. Rows run in bands on up to threads threads, 0 for
+// one per processor, with identical results for any count. Wide targets are filtered in
+// column tiles whose horizontally filtered rows fit the L2 cache.
+NATIVELIB void ScaleFrame(const CPlanarFrame* src, const FrameRect& rect, CPlanarFrame* dst, ScaleFilter filter, int threads);
@@ -0,0 +1,125 @@
+#include "FrameTone.h"
+#include "ToneKernels.h"
+#include "RowBands.h"
+
+#include <math.h>
+
+// Chroma gains beyond this are as good as saturating every sample
+#define MAX_CHROMA_GAIN (128 * 64)
+
+class CToneTask : public IRowBandTask
+{
+public:
+	CToneTask(const CPlanarFrame* src, CPlanarFrame* dst, const ToneMap* map)
+		: m_src(src), m_dst(dst), m_map(map), m_k(GetToneKernels()), m_format(src->GetFormat())
+	{
+		const FrameFormatDesc* desc = GetFrameFormatDesc(m_format);
+		m_planes = desc->Planes;
+		for(int p = 0; p < m_planes; p++)
+		{
+			m_shiftY[p] = desc->Plane[p].ShiftY;
+		}
+	}
+
+	virtual void RunRows(int /*band*/, int first, int count)
+	{
+		int width = m_src->GetWidth();
+		bool last = first + count == m_src->GetHeight();
+		for(int p = 0; p < m_planes; p++)
+		{
+			int bytes = GetPlaneRowBytes(m_format, p, width);
+			int rows = last ? GetPlaneLines(m_format, p, first + count) : (first + count) >> m_shiftY[p];
+			for(int row = first >> m_shiftY[p]; row < rows; row++)
+			{
+				const BYTE* in = m_src->GetPlane(p) + (ptrdiff_t)row * m_src->GetPitch(p);
+				BYTE* out = m_dst->GetPlane(p) + (ptrdiff_t)row * m_dst->GetPitch(p);
+				if(m_format == FF_YUY2)
+				{
+					m_k->AdjustYuy2(in, out, m_map->Luma, m_map->ChromaGain, bytes / 4);
+				}
+				else if(m_format == FF_UYVY)
+				{
+					m_k->AdjustUyvy(in, out, m_map->Luma, m_map->ChromaGain, bytes / 4);
+				}
+				else if(p == 0)
+				{
+					m_k->Lookup(in, out, m_map->Luma, bytes);
+				}
+				else
+				{
+					m_k->ScaleChroma(in, out, m_map->ChromaGain, bytes);
+				}
+			}
+		}
+	}
+
+private:
+	const CPlanarFrame* m_src;
+	CPlanarFrame* m_dst;
+	const ToneMap* m_map;
+	const ToneKernels* m_k;
+	FrameFormat m_format;
+	int m_planes;
+	int m_shiftY[4];
+};
+
+void BuildToneMap(double brightness, double contrast, double gamma, double saturation, YuvRange range, ToneMap* map)
+{
+	if(!(contrast >= 0 && gamma > 0 && saturation >= 0) || brightness != brightness)
+	{
+		throw "Invalid tone adjustment";
+	}
+
+	double black = range == YR_FULL ? 0 : 16;
+	double white = range == YR_FULL ? 255 : 235;
+	for(int i = 0; i < 256; i++)
+	{
+		// Samples below black or above white keep the slope the curve ends with
+		double n = (i - black) / (white - black);
+		if(n > 0 && n < 1 && gamma != 1)
+		{
+			n = pow(n, 1 / gamma);
+		}
+		n = (n - 0.5) * contrast + 0.5 + brightness;
+
+		double v = floor(black + n * (white - black) + 0.5);
+		map->Luma[i] = (BYTE)(v < 0 ? 0 : v > 255 ? 255 : v);
+	}
+
+	double gain = floor(contrast * saturation * 128 + 0.5);
+	map->ChromaGain = gain > MAX_CHROMA_GAIN ? MAX_CHROMA_GAIN : (int)gain;
+}
+
+bool CanAdjustTone(FrameFormat format)
+{
+	switch(format)
+	{
+	case FF_Y800:
+	case FF_YUV:
+	case FF_YUY2:
+	case FF_UYVY:
+	case FF_YV12:
+	case FF_I420:
+	case FF_NV12:
+	case FF_NV21:
+	case FF_Y411:
+	case FF_Y410:
+	case FF_I422:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void AdjustTone(const CPlanarFrame* src, CPlanarFrame* dst, const ToneMap* map, int threads)
+{
+	if(!CanAdjustTone(src->GetFormat()) || dst->GetFormat() != src->GetFormat() ||
+		dst->GetWidth() != src->GetWidth() || dst->GetHeight() != src->GetHeight())
+	{
+		throw "Unsupported tone adjustment";
+	}
+
+	int bands = GetRowBandCount(src->GetWidth(), src->GetHeight(), threads);
+	CToneTask task(src, dst, map);
+	RunRowBands(&task, src->GetHeight(), bands, GetFormatAlignmentY(src->GetFormat()));
+}
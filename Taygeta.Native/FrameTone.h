@@ -0,0 +1,27 @@
+#pragma once
+
+#include "NativeLib.h"
+#include "FrameFormat.h"
+#include "PlanarFrame.h"
+#include "RgbKernels.h"
+
+// Tone adjustment of YUV samples: luma through a curve, chroma scaled around 128
+struct ToneMap
+{
+	BYTE Luma[256];
+	int ChromaGain;		// in 1/128, 128 leaves chroma as it is
+};
+
+// Luma is taken between the black and white of range: gamma bends it (above 1 lifts the
+// mid tones), contrast scales it around mid gray and brightness, in parts of black to
+// white, is added last. Chroma is scaled by contrast * saturation, as swscale does. The
+// neutral 0, 1, 1, 1 maps every sample onto itself. Throws for negative contrast or
+// saturation and gamma that is not positive.
+NATIVELIB void BuildToneMap(double brightness, double contrast, double gamma, double saturation, YuvRange range, ToneMap* map);
+
+// Y800, YUV, YV12, I420, NV12, NV21, YUY2, UYVY, Y411, Y410 and I422
+NATIVELIB bool CanAdjustTone(FrameFormat format);
+
+// Writes the samples of src through map into dst, a frame of the same size and format
+// or src itself. Rows run in bands on up to threads threads, 0 for one per processor.
+NATIVELIB void AdjustTone(const CPlanarFrame* src, CPlanarFrame* dst, const ToneMap* map, int threads);
@@ -0,0 +1,334 @@
+#include "NativeFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <limits.h>
+#endif
+
+struct MappedView
+{
+	void* Base;
+	size_t Size;
+};
+
+static void UnmapView(BYTE*, void* context)
+{
+	MappedView* view = (MappedView*)context;
+#ifdef _WIN32
+	UnmapViewOfFile(view->Base);
+#else
+	munmap(view->Base, view->Size);
+#endif
+	delete view;
+}
+
+#ifdef _WIN32
+
+struct MemoryRangeEntry
+{
+	PVOID VirtualAddress;
+	SIZE_T NumberOfBytes;
+};
+
+typedef BOOL (WINAPI *PrefetchVirtualMemoryFunc)(HANDLE, ULONG_PTR, MemoryRangeEntry*, ULONG);
+
+// PrefetchVirtualMemory only exists from Windows 8 on
+static PrefetchVirtualMemoryFunc GetPrefetchVirtualMemory(void)
+{
+	static PrefetchVirtualMemoryFunc func = (PrefetchVirtualMemoryFunc)GetProcAddress(GetModuleHandleA("kernel32.dll"), "PrefetchVirtualMemory");
+	return func;
+}
+
+static uint64_t GetMapGranularity(void)
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwAllocationGranularity;
+}
+
+#else
+
+static uint64_t GetMapGranularity(void)
+{
+	return (uint64_t)sysconf(_SC_PAGESIZE);
+}
+
+#endif
+
+CNativeFile::CNativeFile(void)
+#ifdef _WIN32
+	: m_handle(INVALID_HANDLE_VALUE), m_mapping(NULL),
+#else
+	: m_fd(-1),
+#endif
+	  m_size(0), m_writable(false)
+{
+}
+
+CNativeFile::~CNativeFile(void)
+{
+	try
+	{
+		Close();
+	}
+	catch(...)
+	{
+	}
+}
+
+CNativeFile* CNativeFile::Create(const char* path)
+{
+	CNativeFile* file = new CNativeFile();
+	file->m_writable = true;
+#ifdef _WIN32
+	file->m_handle = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(file->m_handle == INVALID_HANDLE_VALUE)
+#else
+	file->m_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(file->m_fd < 0)
+#endif
+	{
+		delete file;
+		throw "Failed to create file";
+	}
+	return file;
+}
+
+CNativeFile* CNativeFile::Open(const char* path)
+{
+	CNativeFile* file = new CNativeFile();
+#ifdef _WIN32
+	file->m_handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	LARGE_INTEGER size;
+	if(file->m_handle == INVALID_HANDLE_VALUE || !GetFileSizeEx(file->m_handle, &size))
+	{
+		delete file;
+		throw "Failed to open file";
+	}
+	file->m_size = size.QuadPart;
+
+	// Empty files cannot be mapped, they are caught by the callers' size checks
+	if(file->m_size > 0)
+	{
+		file->m_mapping = CreateFileMappingA(file->m_handle, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+		if(!file->m_mapping)
+		{
+			delete file;
+			throw "Failed to map file";
+		}
+	}
+#else
+	file->m_fd = open(path, O_RDONLY);
+	struct stat info;
+	if(file->m_fd < 0 || fstat(file->m_fd, &info) != 0)
+	{
+		delete file;
+		throw "Failed to open file";
+	}
+	file->m_size = info.st_size;
+#endif
+	return file;
+}
+
+void CNativeFile::Close(void)
+{
+	bool ok = true;
+#ifdef _WIN32
+	if(m_mapping)
+	{
+		CloseHandle(m_mapping);
+		m_mapping = NULL;
+	}
+	if(m_handle != INVALID_HANDLE_VALUE)
+	{
+		ok = CloseHandle(m_handle) != 0;
+		m_handle = INVALID_HANDLE_VALUE;
+	}
+#else
+	if(m_fd >= 0)
+	{
+		ok = close(m_fd) == 0;
+		m_fd = -1;
+	}
+#endif
+
+	if(!ok && m_writable)
+	{
+		throw "Failed to write file";
+	}
+}
+
+void CNativeFile::Write(const FileSegment* segments, int count)
+{
+	bool ok = true;
+	uint64_t total = 0;
+
+#ifdef _WIN32
+	// Windows has no gather write for buffered files, the segments go out back to back
+	for(int i = 0; i < count && ok; i++)
+	{
+		const BYTE* data = segments[i].Data;
+		size_t left = segments[i].Size;
+		while(left > 0 && ok)
+		{
+			DWORD chunk = left > 0x40000000 ? 0x40000000 : (DWORD)left;
+			DWORD written = 0;
+			ok = WriteFile(m_handle, data, chunk, &written, NULL) && written == chunk;
+			data += chunk;
+			left -= chunk;
+		}
+		total += segments[i].Size;
+	}
+#else
+	struct iovec iov[IOV_MAX < 64 ? IOV_MAX : 64];
+	int maxSegments = sizeof(iov) / sizeof(iov[0]);
+
+	int next = 0;
+	while(next < count && ok)
+	{
+		int n = count - next < maxSegments ? count - next : maxSegments;
+		for(int i = 0; i < n; i++)
+		{
+			iov[i].iov_base = (void*)segments[next + i].Data;
+			iov[i].iov_len = segments[next + i].Size;
+			total += segments[next + i].Size;
+		}
+		next += n;
+
+		// writev may stop early on large frames or signals, the rest is resumed where it left off
+		int first = 0;
+		while(first < n)
+		{
+			ssize_t written = writev(m_fd, iov + first, n - first);
+			if(written < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if(written <= 0)
+			{
+				ok = false;
+				break;
+			}
+			while(first < n && (size_t)written >= iov[first].iov_len)
+			{
+				written -= iov[first].iov_len;
+				first++;
+			}
+			if(first < n)
+			{
+				iov[first].iov_base = (BYTE*)iov[first].iov_base + written;
+				iov[first].iov_len -= written;
+			}
+		}
+	}
+#endif
+
+	if(!ok)
+	{
+		throw "Failed to write file";
+	}
+	m_size += total;
+}
+
+void CNativeFile::Read(uint64_t offset, void* data, size_t size) const
+{
+	BYTE* dst = (BYTE*)data;
+	while(size > 0)
+	{
+#ifdef _WIN32
+		// An explicit offset keeps concurrent reads from racing on the file pointer
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = (DWORD)offset;
+		overlapped.OffsetHigh = (DWORD)(offset >> 32);
+		DWORD chunk = size > 0x40000000 ? 0x40000000 : (DWORD)size;
+		DWORD read = 0;
+		if(!ReadFile(m_handle, dst, chunk, &read, &overlapped) || read == 0)
+#else
+		ssize_t read = pread(m_fd, dst, size, (off_t)offset);
+		if(read < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if(read <= 0)
+#endif
+		{
+			throw "Failed to read file";
+		}
+		dst += read;
+		offset += read;
+		size -= read;
+	}
+}
+
+CPlaneBuffer* CNativeFile::Map(uint64_t offset, size_t size) const
+{
+	if(size == 0 || offset + size > m_size)
+	{
+		throw "Mapped range is outside of the file";
+	}
+
+	uint64_t start = offset - offset % GetMapGranularity();
+	size_t length = (size_t)(offset - start) + size;
+
+	MappedView* view = new MappedView();
+	view->Size = length;
+#ifdef _WIN32
+	view->Base = MapViewOfFile(m_mapping, FILE_MAP_COPY, (DWORD)(start >> 32), (DWORD)start, length);
+	if(!view->Base)
+#else
+	view->Base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, m_fd, (off_t)start);
+	if(view->Base == MAP_FAILED)
+#endif
+	{
+		delete view;
+		throw "Failed to map file";
+	}
+
+	try
+	{
+		return CPlaneBuffer::Wrap((BYTE*)view->Base + (offset - start), size, UnmapView, view);
+	}
+	catch(...)
+	{
+		UnmapView(NULL, view);
+		throw;
+	}
+}
+
+void CNativeFile::WillNeed(uint64_t offset, uint64_t size) const
+{
+	if(offset >= m_size)
+	{
+		return;
+	}
+	size = size < m_size - offset ? size : m_size - offset;
+
+#ifdef _WIN32
+	// Without fadvise the range is prefetched through a temporary view, the pages stay
+	// in the file cache after it is unmapped
+	PrefetchVirtualMemoryFunc prefetch = GetPrefetchVirtualMemory();
+	if(!prefetch || !m_mapping)
+	{
+		return;
+	}
+
+	uint64_t start = offset - offset % GetMapGranularity();
+	MemoryRangeEntry range;
+	range.NumberOfBytes = (SIZE_T)(offset - start + size);
+	range.VirtualAddress = MapViewOfFile(m_mapping, FILE_MAP_READ, (DWORD)(start >> 32), (DWORD)start, range.NumberOfBytes);
+	if(range.VirtualAddress)
+	{
+		prefetch(GetCurrentProcess(), 1, &range, 0);
+		UnmapViewOfFile(range.VirtualAddress);
+	}
+#else
+	posix_fadvise(m_fd, (off_t)offset, (off_t)size, POSIX_FADV_WILLNEED);
+#endif
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "NativeLib.h"
+#include "PlaneBuffer.h"
+
+struct FileSegment
+{
+	const BYTE* Data;
+	size_t Size;
+};
+
+// Thin wrapper over a file descriptor or handle for the raw frame containers. Reads,
+// mapping and advice take explicit offsets and may be used from several threads at once.
+class CNativeFile
+{
+public:
+	static CNativeFile* Create(const char* path);
+	static CNativeFile* Open(const char* path);
+	~CNativeFile(void);
+
+	uint64_t GetSize(void) const { return m_size; }
+
+	// Appends all segments with a single vectored write where the platform has one
+	void Write(const FileSegment* segments, int count);
+	void Read(uint64_t offset, void* data, size_t size) const;
+
+	// Maps a range copy-on-write; the buffer holds the view and stays valid after the
+	// file is closed. Writes to the view never reach the file.
+	CPlaneBuffer* Map(uint64_t offset, size_t size) const;
+
+	// Starts reading a range into the cache without waiting for it
+	void WillNeed(uint64_t offset, uint64_t size) const;
+
+	void Close(void);
+
+private:
+	CNativeFile(void);
+	CNativeFile(const CNativeFile&);
+	CNativeFile& operator=(const CNativeFile&);
+
+#ifdef _WIN32
+	void* m_handle;
+	void* m_mapping;
+#else
+	int m_fd;
+#endif
+	uint64_t m_size;
+	bool m_writable;
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+#if defined(_WIN32)
+#	if defined(NATIVE_LIBRARY_EXPORT)
+#		define NATIVELIB __declspec(dllexport)
+#	else
+#		define NATIVELIB __declspec(dllimport)
+#	endif
+#	define NATIVECALL __cdecl
+#else
+#	define NATIVELIB __attribute__((visibility("default")))
+#	define NATIVECALL
+#endif
+
+typedef unsigned char BYTE;
@@ -0,0 +1,232 @@
+#include "PlanarFrame.h"
+#include "FramePool.h"
+#include "FrameCopy.h"
+#include "RefCount.h"
+
+static inline size_t AlignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+CPlanarFrame::CPlanarFrame(int width, int height, FrameFormat format, CPlaneBuffer* storage)
+	: m_refCount(1), m_width(width), m_height(height), m_format(format), m_storage(storage)
+{
+	m_planeCount = GetFrameFormatDesc(format)->Planes;
+	for(int i = 0; i < FRAME_MAX_PLANES; i++)
+	{
+		m_planes[i] = NULL;
+		m_pitches[i] = 0;
+	}
+
+	if(m_storage)
+	{
+		m_storage->AddRef();
+	}
+}
+
+CPlanarFrame::~CPlanarFrame(void)
+{
+	if(m_storage)
+	{
+		m_storage->Release();
+	}
+}
+
+int CPlanarFrame::GetAlignedPitch(int rowBytes)
+{
+	return (int)AlignUp(rowBytes, FRAME_ALIGNMENT);
+}
+
+size_t CPlanarFrame::GetAllocationSize(int width, int height, FrameFormat format)
+{
+	const FrameFormatDesc* desc = GetFrameFormatDesc(format);
+	size_t size = 0;
+	for(int i = 0; i < desc->Planes; i++)
+	{
+		size_t pitch = GetAlignedPitch(GetPlaneRowBytes(format, i, width));
+		size += AlignUp(pitch * GetPlaneLines(format, i, height) + FRAME_PADDING, FRAME_ALIGNMENT);
+	}
+	return size;
+}
+
+CPlanarFrame* CPlanarFrame::Create(int width, int height, FrameFormat format)
+{
+	if(width <= 0 || height <= 0)
+	{
+		throw "Frame size must be positive";
+	}
+
+	CPlaneBuffer* storage = CPlaneBuffer::Create(GetAllocationSize(width, height, format));
+	try
+	{
+		CPlanarFrame* frame = Create(width, height, format, storage);
+		storage->Release();
+		return frame;
+	}
+	catch(...)
+	{
+		storage->Release();
+		throw;
+	}
+}
+
+CPlanarFrame* CPlanarFrame::Create(int width, int height, FrameFormat format, CPlaneBuffer* storage)
+{
+	if(width <= 0 || height <= 0)
+	{
+		throw "Frame size must be positive";
+	}
+	if(storage->GetSize() < GetAllocationSize(width, height, format) || ((size_t)storage->GetData() & (FRAME_ALIGNMENT - 1)))
+	{
+		throw "Frame storage is too small or misaligned";
+	}
+
+	CPlanarFrame* frame = new CPlanarFrame(width, height, format, storage);
+	BYTE* p = storage->GetData();
+	for(int i = 0; i < frame->m_planeCount; i++)
+	{
+		int pitch = GetAlignedPitch(GetPlaneRowBytes(format, i, width));
+		frame->m_planes[i] = p;
+		frame->m_pitches[i] = pitch;
+		p += AlignUp((size_t)pitch * GetPlaneLines(format, i, height) + FRAME_PADDING, FRAME_ALIGNMENT);
+	}
+	return frame;
+}
+
+CPlanarFrame* CPlanarFrame::Wrap(int width, int height, FrameFormat format,
+	BYTE* const* planes, const int* pitches, CPlaneBuffer* storage)
+{
+	if(width <= 0 || height <= 0)
+	{
+		throw "Frame size must be positive";
+	}
+
+	CPlanarFrame* frame = new CPlanarFrame(width, height, format, storage);
+	for(int i = 0; i < frame->m_planeCount; i++)
+	{
+		frame->m_planes[i] = planes[i];
+		frame->m_pitches[i] = pitches[i];
+	}
+	return frame;
+}
+
+CPlanarFrame* CPlanarFrame::CreateView(int x, int y, int width, int height)
+{
+	int ax = GetFormatAlignmentX(m_format);
+	int ay = GetFormatAlignmentY(m_format);
+	int right = x + width;
+	int bottom = y + height;
+
+	if(x < 0 || y < 0 || width <= 0 || height <= 0 || right > m_width || bottom > m_height)
+	{
+		throw "View is outside of the frame";
+	}
+
+	x -= x % ax;
+	y -= y % ay;
+	right = (right + ax - 1) / ax * ax;
+	bottom = (bottom + ay - 1) / ay * ay;
+	right = right < m_width ? right : m_width;
+	bottom = bottom < m_height ? bottom : m_height;
+
+	CPlanarFrame* view = new CPlanarFrame(right - x, bottom - y, m_format, m_storage);
+	const FrameFormatDesc* desc = GetFrameFormatDesc(m_format);
+	for(int i = 0; i < m_planeCount; i++)
+	{
+		const FramePlaneDesc& p = desc->Plane[i];
+		int offsetX = (x >> p.ShiftX) / p.BlockWidth * p.BlockBytes;
+		int offsetY = y >> p.ShiftY;
+		view->m_planes[i] = m_planes[i] + (ptrdiff_t)offsetY * m_pitches[i] + offsetX;
+		view->m_pitches[i] = m_pitches[i];
+	}
+	return view;
+}
+
+CPlanarFrame* CPlanarFrame::CreateFlippedView(void)
+{
+	CPlanarFrame* view = new CPlanarFrame(m_width, m_height, m_format, m_storage);
+	for(int i = 0; i < m_planeCount; i++)
+	{
+		view->m_planes[i] = m_planes[i] + (ptrdiff_t)(GetLines(i) - 1) * m_pitches[i];
+		view->m_pitches[i] = -m_pitches[i];
+	}
+	return view;
+}
+
+CPlanarFrame* CPlanarFrame::Clone(void) const
+{
+	int pitches[FRAME_MAX_PLANES];
+	for(int i = 0; i < FRAME_MAX_PLANES; i++)
+	{
+		pitches[i] = m_pitches[i] < 0 ? -m_pitches[i] : m_pitches[i];
+	}
+
+	CPlanarFrame* copy = CFramePool::GetDefault()->Acquire(m_width, m_height, m_format, pitches);
+	CopyFrame(this, copy);
+	return copy;
+}
+
+CPlanarFrame* CPlanarFrame::CloneShared(void)
+{
+	if(!m_storage)
+	{
+		return Clone();
+	}
+
+	CPlanarFrame* clone = new CPlanarFrame(m_width, m_height, m_format, m_storage);
+	for(int i = 0; i < m_planeCount; i++)
+	{
+		clone->m_planes[i] = m_planes[i];
+		clone->m_pitches[i] = m_pitches[i];
+	}
+	return clone;
+}
+
+bool CPlanarFrame::LeaseWrite(void)
+{
+	// The last other holder may let go at any time, which only makes the copy unnecessary.
+	// Another holder leasing at the same time copies too, as the old storage is released
+	// only after the copy is done.
+	if(!m_storage || !m_storage->IsShared())
+	{
+		return false;
+	}
+
+	CPlanarFrame* copy = Clone();
+	CPlaneBuffer* old = m_storage;
+	m_storage = copy->m_storage;
+	m_storage->AddRef();
+	for(int i = 0; i < m_planeCount; i++)
+	{
+		m_planes[i] = copy->m_planes[i];
+		m_pitches[i] = copy->m_pitches[i];
+	}
+	copy->Release();
+	old->Release();
+	return true;
+}
+
+long CPlanarFrame::AddRef(void)
+{
+	return AtomicIncrement(&m_refCount);
+}
+
+long CPlanarFrame::Release(void)
+{
+	long count = AtomicDecrement(&m_refCount);
+	if(count == 0)
+	{
+		delete this;
+	}
+	return count;
+}
+
+int CPlanarFrame::GetLines(int plane) const
+{
+	return GetPlaneLines(m_format, plane, m_height);
+}
+
+int CPlanarFrame::GetRowBytes(int plane) const
+{
+	return GetPlaneRowBytes(m_format, plane, m_width);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "NativeLib.h"
+#include "FrameFormat.h"
+#include "PlaneBuffer.h"
+
+// Readable bytes after the last row of every allocated plane, so SIMD kernels may load
+// one full vector past the end of a row
+#define FRAME_PADDING 64
+
+#define FRAME_MAX_PLANES 4
+
+// Intrusively reference counted image. Frames created here have every plane start and
+// pitch aligned to FRAME_ALIGNMENT; wrapped frames and views keep the layout they were
+// given. Planes live in a CPlaneBuffer that views share with their parent.
+// A pitch may be negative for bottom-up planes: the plane pointer is then the top row,
+// at the highest address, and row y starts at plane + y * pitch either way.
+class NATIVELIB CPlanarFrame
+{
+public:
+	static CPlanarFrame* Create(int width, int height, FrameFormat format);
+
+	// Lays the planes out in storage the same way Create does. storage must be aligned to
+	// FRAME_ALIGNMENT and hold at least GetAllocationSize bytes.
+	static CPlanarFrame* Create(int width, int height, FrameFormat format, CPlaneBuffer* storage);
+
+	// Frame over existing planes. storage is referenced for the lifetime of the frame and
+	// may be NULL when the caller keeps the memory alive.
+	static CPlanarFrame* Wrap(int width, int height, FrameFormat format,
+		BYTE* const* planes, const int* pitches, CPlaneBuffer* storage);
+
+	// Sub-rectangle sharing the planes of this frame. The origin and size are rounded out
+	// to the chroma subsampling and packing of the format.
+	CPlanarFrame* CreateView(int x, int y, int width, int height);
+
+	// View of this frame upside down, sharing its planes. Only pointers and pitch signs
+	// change, flipping a flipped view gives the original layout back.
+	CPlanarFrame* CreateFlippedView(void);
+
+	// Deep copy with the same pitches, made positive, in storage from the default frame pool
+	CPlanarFrame* Clone(void) const;
+
+	// Frame sharing the planes of this one until either side takes the write lease. Frames
+	// over memory without a storage object cannot be shared and are copied instead.
+	CPlanarFrame* CloneShared(void);
+
+	// Takes the write lease before the planes are written: while the storage is shared
+	// with a clone or view the planes are first copied into storage of this frame's own.
+	// Returns true when a copy was made. The frame object must not be used by other
+	// threads meanwhile; clones and views each have their own.
+	bool LeaseWrite(void);
+
+	long AddRef(void);
+	long Release(void);
+
+	int GetWidth(void) const { return m_width; }
+	int GetHeight(void) const { return m_height; }
+	FrameFormat GetFormat(void) const { return m_format; }
+	int GetPlaneCount(void) const { return m_planeCount; }
+	BYTE* GetPlane(int plane) const { return m_planes[plane]; }
+	int GetPitch(int plane) const { return m_pitches[plane]; }
+	int GetLines(int plane) const;
+	int GetRowBytes(int plane) const;
+	CPlaneBuffer* GetStorage(void) const { return m_storage; }
+
+	// Bytes Create allocates for a frame, including alignment and padding
+	static size_t GetAllocationSize(int width, int height, FrameFormat format);
+	static int GetAlignedPitch(int rowBytes);
+
+private:
+	CPlanarFrame(int width, int height, FrameFormat format, CPlaneBuffer* storage);
+	~CPlanarFrame(void);
+	CPlanarFrame(const CPlanarFrame&);
+	CPlanarFrame& operator=(const CPlanarFrame&);
+
+	volatile long m_refCount;
+	int m_width;
+	int m_height;
+	FrameFormat m_format;
+	int m_planeCount;
+	BYTE* m_planes[FRAME_MAX_PLANES];
+	int m_pitches[FRAME_MAX_PLANES];
+	CPlaneBuffer* m_storage;
+};
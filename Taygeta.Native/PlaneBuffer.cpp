@@ -0,0 +1,83 @@
+#include "PlaneBuffer.h"
+#include "RefCount.h"
+
+#include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+BYTE* AlignedAlloc(size_t size)
+{
+#ifdef _WIN32
+	return (BYTE*)_aligned_malloc(size, FRAME_ALIGNMENT);
+#else
+	void* data = NULL;
+	return posix_memalign(&data, FRAME_ALIGNMENT, size) == 0 ? (BYTE*)data : NULL;
+#endif
+}
+
+void AlignedFree(BYTE* data)
+{
+#ifdef _WIN32
+	_aligned_free(data);
+#else
+	free(data);
+#endif
+}
+
+static void FreeAligned(BYTE* data, void*)
+{
+	AlignedFree(data);
+}
+
+CPlaneBuffer::CPlaneBuffer(BYTE* data, size_t size, PlaneBufferFree freeFunc, void* context)
+	: m_refCount(1), m_data(data), m_size(size), m_free(freeFunc), m_context(context)
+{
+}
+
+CPlaneBuffer::~CPlaneBuffer(void)
+{
+	if(m_free)
+	{
+		m_free(m_data, m_context);
+	}
+}
+
+CPlaneBuffer* CPlaneBuffer::Create(size_t size)
+{
+	BYTE* data = AlignedAlloc(size > 0 ? size : 1);
+	if(!data)
+	{
+		throw "Failed to allocate plane buffer";
+	}
+
+	try
+	{
+		return new CPlaneBuffer(data, size, FreeAligned, NULL);
+	}
+	catch(...)
+	{
+		AlignedFree(data);
+		throw;
+	}
+}
+
+CPlaneBuffer* CPlaneBuffer::Wrap(BYTE* data, size_t size, PlaneBufferFree freeFunc, void* context)
+{
+	return new CPlaneBuffer(data, size, freeFunc, context);
+}
+
+long CPlaneBuffer::AddRef(void)
+{
+	return AtomicIncrement(&m_refCount);
+}
+
+long CPlaneBuffer::Release(void)
+{
+	long count = AtomicDecrement(&m_refCount);
+	if(count == 0)
+	{
+		delete this;
+	}
+	return count;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+#include "NativeLib.h"
+
+// Start and pitch alignment of every plane allocated by the library
+#define FRAME_ALIGNMENT 64
+
+typedef void (*PlaneBufferFree)(BYTE* data, void* context);
+
+// Intrusively reference counted block of plane memory. Frames and views hold a reference
+// to the storage their planes live in, the memory is released with the last reference.
+class NATIVELIB CPlaneBuffer
+{
+public:
+	// Allocates size bytes aligned to FRAME_ALIGNMENT, the reference count starts at 1
+	static CPlaneBuffer* Create(size_t size);
+
+	// Takes over memory allocated elsewhere (tjAlloc, AllocHGlobal); freeFunc is called
+	// with the last reference and may be NULL for memory the caller keeps alive
+	static CPlaneBuffer* Wrap(BYTE* data, size_t size, PlaneBufferFree freeFunc, void* context);
+
+	long AddRef(void);
+	long Release(void);
+
+	BYTE* GetData(void) const { return m_data; }
+	size_t GetSize(void) const { return m_size; }
+
+	// True while more than one reference exists
+	bool IsShared(void) const { return m_refCount > 1; }
+
+private:
+	CPlaneBuffer(BYTE* data, size_t size, PlaneBufferFree freeFunc, void* context);
+	~CPlaneBuffer(void);
+	CPlaneBuffer(const CPlaneBuffer&);
+	CPlaneBuffer& operator=(const CPlaneBuffer&);
+
+	volatile long m_refCount;
+	BYTE* m_data;
+	size_t m_size;
+	PlaneBufferFree m_free;
+	void* m_context;
+};
+
+NATIVELIB BYTE* AlignedAlloc(size_t size);
+NATIVELIB void AlignedFree(BYTE* data);
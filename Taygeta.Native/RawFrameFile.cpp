@@ -0,0 +1,179 @@
+#include "RawFrameFile.h"
+#include "NativeFile.h"
+
+#include <string.h>
+#include <vector>
+
+static inline uint64_t AlignPage(uint64_t value)
+{
+	return (value + RAW_FRAME_PAGE - 1) & ~(uint64_t)(RAW_FRAME_PAGE - 1);
+}
+
+uint64_t GetRawFrameLayout(const CPlanarFrame* frame, RawFrameHeader* header)
+{
+	memset(header, 0, sizeof(RawFrameHeader));
+	header->Magic = RAW_FRAME_MAGIC;
+	header->Version = RAW_FRAME_VERSION;
+	header->HeaderSize = RAW_FRAME_PAGE;
+	header->Format = frame->GetFormat();
+	header->Width = frame->GetWidth();
+	header->Height = frame->GetHeight();
+	header->Planes = frame->GetPlaneCount();
+
+	uint64_t offset = RAW_FRAME_PAGE;
+	for(int i = 0; i < frame->GetPlaneCount(); i++)
+	{
+		offset = AlignPage(offset);
+		header->Pitches[i] = frame->GetPitch(i) < 0 ? -frame->GetPitch(i) : frame->GetPitch(i);
+		header->Lines[i] = frame->GetLines(i);
+		header->Offsets[i] = offset;
+		offset += (uint64_t)header->Pitches[i] * header->Lines[i];
+	}
+	header->FileSize = offset;
+	return offset;
+}
+
+void ValidateRawFrameHeader(const RawFrameHeader* header, uint64_t fileSize)
+{
+	if(header->Magic != RAW_FRAME_MAGIC)
+	{
+		throw "Not a raw frame file";
+	}
+	if(header->Version != RAW_FRAME_VERSION)
+	{
+		throw "Unsupported raw frame version";
+	}
+	if(header->Format < 0 || header->Format >= FF_COUNT || header->Width <= 0 || header->Height <= 0)
+	{
+		throw "Corrupt raw frame header";
+	}
+
+	FrameFormat format = (FrameFormat)header->Format;
+	if(header->Planes != GetFrameFormatDesc(format)->Planes || header->FileSize > fileSize)
+	{
+		throw "Corrupt raw frame header";
+	}
+
+	for(int i = 0; i < header->Planes; i++)
+	{
+		if(header->Pitches[i] < GetPlaneRowBytes(format, i, header->Width) ||
+			header->Lines[i] < GetPlaneLines(format, i, header->Height) ||
+			header->Offsets[i] % FRAME_ALIGNMENT != 0 ||
+			header->Offsets[i] + (uint64_t)header->Pitches[i] * header->Lines[i] > header->FileSize)
+		{
+			throw "Corrupt raw frame header";
+		}
+	}
+}
+
+static void AddFileSegment(std::vector<FileSegment>& segments, const BYTE* data, size_t size)
+{
+	FileSegment segment;
+	segment.Data = data;
+	segment.Size = size;
+	segments.push_back(segment);
+}
+
+// Zeros come from a page of them, as many times as needed
+static void AddZeroSegments(std::vector<FileSegment>& segments, const BYTE* zeros, size_t size)
+{
+	while(size > 0)
+	{
+		size_t part = size < RAW_FRAME_PAGE ? size : RAW_FRAME_PAGE;
+		AddFileSegment(segments, zeros, part);
+		size -= part;
+	}
+}
+
+void WriteRawFrame(const char* path, const CPlanarFrame* frame)
+{
+	RawFrameHeader header;
+	GetRawFrameLayout(frame, &header);
+
+	// The header page, and a page of zeros to fill the gaps between planes
+	std::vector<BYTE> page(2 * RAW_FRAME_PAGE, 0);
+	memcpy(&page[0], &header, sizeof(header));
+
+	std::vector<FileSegment> segments;
+	const BYTE* zeros = &page[0] + RAW_FRAME_PAGE;
+	uint64_t position = RAW_FRAME_PAGE;
+
+	AddFileSegment(segments, &page[0], RAW_FRAME_PAGE);
+	for(int i = 0; i < header.Planes; i++)
+	{
+		AddZeroSegments(segments, zeros, (size_t)(header.Offsets[i] - position));
+
+		// Files are top-down, the rows of a bottom-up plane go out one by one
+		int pitch = frame->GetPitch(i);
+		if(pitch > 0)
+		{
+			AddFileSegment(segments, frame->GetPlane(i), (size_t)pitch * header.Lines[i]);
+		}
+		else
+		{
+			int rowBytes = frame->GetRowBytes(i);
+			for(int y = 0; y < header.Lines[i]; y++)
+			{
+				AddFileSegment(segments, frame->GetPlane(i) + (ptrdiff_t)y * pitch, rowBytes);
+				AddZeroSegments(segments, zeros, header.Pitches[i] - rowBytes);
+			}
+		}
+		position = header.Offsets[i] + (uint64_t)header.Pitches[i] * header.Lines[i];
+	}
+
+	CNativeFile* file = CNativeFile::Create(path);
+	try
+	{
+		file->Write(&segments[0], (int)segments.size());
+		file->Close();
+	}
+	catch(...)
+	{
+		delete file;
+		throw;
+	}
+	delete file;
+}
+
+CPlanarFrame* MapRawFrame(const char* path)
+{
+	CNativeFile* file = CNativeFile::Open(path);
+	CPlaneBuffer* storage = NULL;
+	try
+	{
+		if(file->GetSize() < sizeof(RawFrameHeader))
+		{
+			throw "Raw frame file is truncated";
+		}
+		storage = file->Map(0, (size_t)file->GetSize());
+	}
+	catch(...)
+	{
+		delete file;
+		throw;
+	}
+	delete file;
+
+	try
+	{
+		const RawFrameHeader* header = (const RawFrameHeader*)storage->GetData();
+		ValidateRawFrameHeader(header, storage->GetSize());
+
+		BYTE* planes[4];
+		int pitches[4];
+		for(int i = 0; i < header->Planes; i++)
+		{
+			planes[i] = storage->GetData() + header->Offsets[i];
+			pitches[i] = header->Pitches[i];
+		}
+
+		CPlanarFrame* frame = CPlanarFrame::Wrap(header->Width, header->Height, (FrameFormat)header->Format, planes, pitches, storage);
+		storage->Release();
+		return frame;
+	}
+	catch(...)
+	{
+		storage->Release();
+		throw;
+	}
+}
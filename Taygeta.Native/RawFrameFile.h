@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+#include "NativeLib.h"
+#include "PlanarFrame.h"
+
+#define RAW_FRAME_MAGIC 0x57415254		// "TRAW"
+#define RAW_FRAME_VERSION 1
+
+// Planes start on page boundaries so a mapped file can be used in place
+#define RAW_FRAME_PAGE 4096
+
+// Little endian file header, followed by every plane as Pitches[i] * Lines[i] bytes at
+// Offsets[i]. Pitches are stored as written, padding included.
+struct RawFrameHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t HeaderSize;
+	int32_t Format;			// FrameFormat, same values as PixelAlignmentType
+	int32_t Width;
+	int32_t Height;
+	int32_t Planes;
+	int32_t Reserved;
+	int32_t Pitches[4];
+	int32_t Lines[4];
+	uint64_t Offsets[4];
+	uint64_t FileSize;
+};
+
+// Fills in the header for a frame and returns the file size
+NATIVELIB uint64_t GetRawFrameLayout(const CPlanarFrame* frame, RawFrameHeader* header);
+
+// Writes header and planes with a single vectored write
+NATIVELIB void WriteRawFrame(const char* path, const CPlanarFrame* frame);
+
+// Maps the file copy-on-write and returns a frame over the mapped planes. Nothing is
+// read until a plane is touched; writing to the frame never changes the file.
+NATIVELIB CPlanarFrame* MapRawFrame(const char* path);
+
+NATIVELIB void ValidateRawFrameHeader(const RawFrameHeader* header, uint64_t fileSize);
@@ -0,0 +1,693 @@
+#include "RawSequence.h"
+#include "RawFrameFile.h"
+#include "NativeFile.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sstream>
+#include <vector>
+
+#define Y4M_SIGNATURE "YUV4MPEG2 "
+#define Y4M_FRAME "FRAME\n"
+#define Y4M_FRAME_LENGTH 6
+#define Y4M_MAX_LINE 4096
+
+struct Y4mColorTag
+{
+	const char* Tag;
+	FrameFormat Format;
+};
+
+// The first entry for a format is the tag it is written with
+static const Y4mColorTag s_y4mTags[] =
+{
+	{ "420jpeg", FF_I420 },
+	{ "420jpeg", FF_YV12 },
+	{ "420", FF_I420 },
+	{ "420mpeg2", FF_I420 },
+	{ "420paldv", FF_I420 },
+	{ "420p16", FF_I420P16 },
+	{ "422", FF_I422 },
+	{ "444", FF_YUV },
+	{ "444p16", FF_YUV16 },
+	{ "411", FF_Y411 },
+	{ "mono", FF_Y800 },
+	{ "mono16", FF_Y16 },
+};
+
+static const char* GetY4mTag(FrameFormat format)
+{
+	for(size_t i = 0; i < sizeof(s_y4mTags) / sizeof(s_y4mTags[0]); i++)
+	{
+		if(s_y4mTags[i].Format == format)
+		{
+			return s_y4mTags[i].Tag;
+		}
+	}
+	throw "Frame format cannot be stored in Y4M";
+}
+
+static FrameFormat GetY4mFormat(const std::string& tag)
+{
+	for(size_t i = 0; i < sizeof(s_y4mTags) / sizeof(s_y4mTags[0]); i++)
+	{
+		if(tag == s_y4mTags[i].Tag)
+		{
+			return s_y4mTags[i].Format;
+		}
+	}
+	throw "Unsupported Y4M colour space";
+}
+
+static inline uint64_t AlignPage(uint64_t value)
+{
+	return (value + RAW_FRAME_PAGE - 1) & ~(uint64_t)(RAW_FRAME_PAGE - 1);
+}
+
+// Plane offsets are counted from the frame header of a native record and from the first
+// sample of a Y4M frame. Returns the bytes from there to the end of the last plane.
+static uint64_t GetSequenceLayout(SequenceContainer container, FrameFormat format, int width, int height, RawSequenceHeader* header)
+{
+	memset(header, 0, sizeof(RawSequenceHeader));
+	header->Magic = RAW_SEQUENCE_MAGIC;
+	header->Version = RAW_SEQUENCE_VERSION;
+	header->HeaderSize = RAW_FRAME_PAGE;
+	header->Format = format;
+	header->Width = width;
+	header->Height = height;
+	header->Planes = GetFrameFormatDesc(format)->Planes;
+
+	uint64_t offset = container == SC_NATIVE ? FRAME_ALIGNMENT : 0;
+	for(int i = 0; i < header->Planes; i++)
+	{
+		int rowBytes = GetPlaneRowBytes(format, i, width);
+		header->Pitches[i] = container == SC_NATIVE ? CPlanarFrame::GetAlignedPitch(rowBytes) : rowBytes;
+		header->Lines[i] = GetPlaneLines(format, i, height);
+		header->PlaneOffsets[i] = (uint32_t)offset;
+		offset += (uint64_t)header->Pitches[i] * header->Lines[i];
+	}
+
+	header->FrameStride = container == SC_NATIVE ? AlignPage(offset) : Y4M_FRAME_LENGTH + offset;
+	return offset;
+}
+
+// Y4M timestamps follow from the frame number, split so that long sequences do not overflow
+static long long GetRateTimestamp(long long frame, int rateNum, int rateDen)
+{
+	long long ticks = rateDen * RAW_SEQUENCE_TICKS;
+	return frame / rateNum * ticks + frame % rateNum * ticks / rateNum;
+}
+
+struct CRawSequenceWriter::State
+{
+	CNativeFile* File;
+	SequenceContainer Container;
+	RawSequenceHeader Layout;
+	uint64_t DataSize;
+	int PlaneOrder[FRAME_MAX_PLANES];
+	std::vector<long long> Timestamps;
+	std::vector<FileSegment> Segments;
+	std::vector<BYTE> Zeros;
+	BYTE RecordHeader[FRAME_ALIGNMENT];
+
+	State(void)
+		: File(NULL)
+	{
+	}
+
+	~State(void)
+	{
+		delete File;
+	}
+
+	void AddSegment(const BYTE* data, size_t size)
+	{
+		if(size > 0)
+		{
+			FileSegment segment = { data, size };
+			Segments.push_back(segment);
+		}
+	}
+
+	void AddZeros(uint64_t size)
+	{
+		while(size > 0)
+		{
+			size_t n = size < Zeros.size() ? (size_t)size : Zeros.size();
+			AddSegment(&Zeros[0], n);
+			size -= n;
+		}
+	}
+
+	// Rows go out one by one only when the frame pitch differs from the stored one, which
+	// includes every bottom-up plane
+	void AddPlane(const BYTE* plane, int pitch, int rowBytes, int lines, int storedPitch)
+	{
+		if(pitch == storedPitch)
+		{
+			AddSegment(plane, (size_t)pitch * lines);
+			return;
+		}
+
+		for(int y = 0; y < lines; y++)
+		{
+			AddSegment(plane + (ptrdiff_t)y * pitch, rowBytes);
+			AddZeros(storedPitch - rowBytes);
+		}
+	}
+};
+
+CRawSequenceWriter::CRawSequenceWriter(const char* path, SequenceContainer container, FrameFormat format,
+	int width, int height, int rateNum, int rateDen)
+	: m_state(new State())
+{
+	try
+	{
+		if(width <= 0 || height <= 0)
+		{
+			throw "Frame size must be positive";
+		}
+		if(rateNum < 0 || rateDen < 0 || (rateNum > 0 && rateDen == 0))
+		{
+			throw "Invalid frame rate";
+		}
+
+		State* s = m_state;
+		s->Container = container;
+		s->DataSize = GetSequenceLayout(container, format, width, height, &s->Layout);
+		s->Layout.RateNum = rateNum;
+		s->Layout.RateDen = rateNum > 0 ? rateDen : 0;
+		s->Zeros.resize(RAW_FRAME_PAGE, 0);
+		memset(s->RecordHeader, 0, sizeof(s->RecordHeader));
+
+		for(int i = 0; i < FRAME_MAX_PLANES; i++)
+		{
+			s->PlaneOrder[i] = i;
+		}
+
+		std::vector<BYTE> header;
+		if(container == SC_NATIVE)
+		{
+			header.resize(RAW_FRAME_PAGE, 0);
+			memcpy(&header[0], &s->Layout, sizeof(s->Layout));
+		}
+		else if(container == SC_Y4M)
+		{
+			// Y4M stores chroma as Cb, Cr
+			if(format == FF_YV12)
+			{
+				s->PlaneOrder[1] = 2;
+				s->PlaneOrder[2] = 1;
+			}
+
+			std::ostringstream line;
+			line << Y4M_SIGNATURE << "W" << width << " H" << height << " F" << (rateNum > 0 ? rateNum : 25) << ":" <<
+				(rateNum > 0 ? rateDen : 1) << " Ip A1:1 C" << GetY4mTag(format) << "\n";
+			std::string text = line.str();
+			header.assign(text.begin(), text.end());
+			memcpy(s->RecordHeader, Y4M_FRAME, Y4M_FRAME_LENGTH);
+		}
+		else
+		{
+			throw "Unknown sequence container";
+		}
+
+		s->File = CNativeFile::Create(path);
+		FileSegment segment = { &header[0], header.size() };
+		s->File->Write(&segment, 1);
+	}
+	catch(...)
+	{
+		delete m_state;
+		throw;
+	}
+}
+
+CRawSequenceWriter::~CRawSequenceWriter(void)
+{
+	try
+	{
+		Close();
+	}
+	catch(...)
+	{
+	}
+	delete m_state;
+}
+
+void CRawSequenceWriter::Append(const CPlanarFrame* frame, long long timestamp)
+{
+	State* s = m_state;
+	if(!s->File)
+	{
+		throw "Sequence is closed";
+	}
+	if(frame->GetFormat() != s->Layout.Format || frame->GetWidth() != s->Layout.Width || frame->GetHeight() != s->Layout.Height)
+	{
+		throw "Frame does not match the sequence";
+	}
+
+	size_t recordHeader = Y4M_FRAME_LENGTH;
+	if(s->Container == SC_NATIVE)
+	{
+		if(!s->Timestamps.empty() && timestamp < s->Timestamps.back())
+		{
+			throw "Timestamps must not decrease";
+		}
+
+		RawSequenceFrameHeader* header = (RawSequenceFrameHeader*)s->RecordHeader;
+		header->Magic = RAW_SEQUENCE_FRAME_MAGIC;
+		header->Index = (int64_t)s->Timestamps.size();
+		header->Timestamp = timestamp;
+		recordHeader = FRAME_ALIGNMENT;
+	}
+
+	s->Segments.clear();
+	s->AddSegment(s->RecordHeader, recordHeader);
+
+	// Plane offsets of Y4M frames start after the FRAME line
+	uint64_t base = s->Container == SC_NATIVE ? 0 : recordHeader;
+	uint64_t position = recordHeader;
+	for(int i = 0; i < s->Layout.Planes; i++)
+	{
+		int plane = s->PlaneOrder[i];
+		uint64_t start = base + s->Layout.PlaneOffsets[i];
+		s->AddZeros(start - position);
+		s->AddPlane(frame->GetPlane(plane), frame->GetPitch(plane), frame->GetRowBytes(plane),
+			s->Layout.Lines[i], s->Layout.Pitches[i]);
+		position = start + (uint64_t)s->Layout.Pitches[i] * s->Layout.Lines[i];
+	}
+	s->AddZeros(s->Layout.FrameStride - position);
+
+	s->File->Write(&s->Segments[0], (int)s->Segments.size());
+	s->Timestamps.push_back(timestamp);
+}
+
+void CRawSequenceWriter::Close(void)
+{
+	State* s = m_state;
+	if(!s->File)
+	{
+		return;
+	}
+
+	CNativeFile* file = s->File;
+	s->File = NULL;
+	try
+	{
+		if(s->Container == SC_NATIVE)
+		{
+			RawSequenceTrailer trailer;
+			trailer.FrameCount = s->Timestamps.size();
+			trailer.IndexOffset = s->Layout.HeaderSize + trailer.FrameCount * s->Layout.FrameStride;
+			trailer.Magic = RAW_SEQUENCE_INDEX_MAGIC;
+			trailer.Version = RAW_SEQUENCE_VERSION;
+
+			s->Segments.clear();
+			s->AddSegment(s->Timestamps.empty() ? NULL : (const BYTE*)&s->Timestamps[0], s->Timestamps.size() * sizeof(long long));
+			s->AddSegment((const BYTE*)&trailer, sizeof(trailer));
+			file->Write(&s->Segments[0], (int)s->Segments.size());
+		}
+		file->Close();
+	}
+	catch(...)
+	{
+		delete file;
+		throw;
+	}
+	delete file;
+}
+
+long long CRawSequenceWriter::GetFrameCount(void) const
+{
+	return (long long)m_state->Timestamps.size();
+}
+
+struct CRawSequenceReader::State
+{
+	CNativeFile* File;
+	SequenceInfo Info;
+	RawSequenceHeader Layout;
+	uint64_t DataSize;
+	uint64_t FirstFrame;
+	std::vector<uint64_t> Offsets;		// Y4M frames with parameters, which vary in size
+	std::vector<long long> Timestamps;	// native container only
+	int Readahead;
+
+	State(void)
+		: File(NULL)
+	{
+	}
+
+	~State(void)
+	{
+		delete File;
+	}
+
+	void OpenNative(void);
+	void OpenY4m(void);
+	void ParseY4mHeader(const std::string& line);
+	std::string ReadLine(uint64_t offset, size_t maxLength) const;
+
+	// Native records start with their frame header, Y4M offsets point past FRAME
+	uint64_t GetFrameOffset(long long frame) const
+	{
+		if(!Offsets.empty())
+		{
+			return Offsets[(size_t)frame];
+		}
+		return FirstFrame + (uint64_t)frame * Layout.FrameStride;
+	}
+};
+
+std::string CRawSequenceReader::State::ReadLine(uint64_t offset, size_t maxLength) const
+{
+	uint64_t left = File->GetSize() > offset ? File->GetSize() - offset : 0;
+	std::vector<char> buffer((size_t)(left < maxLength ? left : maxLength));
+	if(!buffer.empty())
+	{
+		File->Read(offset, &buffer[0], buffer.size());
+	}
+
+	for(size_t i = 0; i < buffer.size(); i++)
+	{
+		if(buffer[i] == '\n')
+		{
+			return std::string(&buffer[0], i + 1);
+		}
+	}
+	return std::string();
+}
+
+void CRawSequenceReader::State::OpenNative(void)
+{
+	uint64_t size = File->GetSize();
+	if(size < sizeof(RawSequenceHeader))
+	{
+		throw "Sequence file is truncated";
+	}
+
+	RawSequenceHeader& h = Layout;
+	File->Read(0, &h, sizeof(h));
+	if(h.Version != RAW_SEQUENCE_VERSION)
+	{
+		throw "Unsupported sequence version";
+	}
+	if(h.Format < 0 || h.Format >= FF_COUNT || h.Width <= 0 || h.Height <= 0 ||
+		h.HeaderSize < sizeof(RawSequenceHeader) || h.HeaderSize % RAW_FRAME_PAGE != 0 ||
+		h.FrameStride == 0 || h.FrameStride % RAW_FRAME_PAGE != 0 ||
+		h.Planes != GetFrameFormatDesc((FrameFormat)h.Format)->Planes)
+	{
+		throw "Corrupt sequence header";
+	}
+
+	DataSize = 0;
+	for(int i = 0; i < h.Planes; i++)
+	{
+		uint64_t end = h.PlaneOffsets[i] + (uint64_t)h.Pitches[i] * h.Lines[i];
+		if(h.Pitches[i] < GetPlaneRowBytes((FrameFormat)h.Format, i, h.Width) ||
+			h.Lines[i] < GetPlaneLines((FrameFormat)h.Format, i, h.Height) ||
+			h.PlaneOffsets[i] < sizeof(RawSequenceFrameHeader) || h.PlaneOffsets[i] % FRAME_ALIGNMENT != 0 ||
+			end > h.FrameStride)
+		{
+			throw "Corrupt sequence header";
+		}
+		DataSize = end > DataSize ? end : DataSize;
+	}
+	FirstFrame = h.HeaderSize;
+
+	RawSequenceTrailer trailer;
+	memset(&trailer, 0, sizeof(trailer));
+	if(size >= FirstFrame + sizeof(trailer))
+	{
+		File->Read(size - sizeof(trailer), &trailer, sizeof(trailer));
+	}
+
+	uint64_t count = trailer.FrameCount;
+	if(trailer.Magic == RAW_SEQUENCE_INDEX_MAGIC && trailer.Version == RAW_SEQUENCE_VERSION &&
+		count <= (size - FirstFrame) / h.FrameStride &&
+		trailer.IndexOffset == FirstFrame + count * h.FrameStride &&
+		trailer.IndexOffset + count * sizeof(long long) + sizeof(trailer) == size)
+	{
+		Timestamps.resize((size_t)count);
+		if(count > 0)
+		{
+			File->Read(trailer.IndexOffset, &Timestamps[0], (size_t)count * sizeof(long long));
+		}
+		return;
+	}
+
+	// No index, the writer did not get to close the file; every complete record is kept
+	count = (size - FirstFrame) / h.FrameStride;
+	for(uint64_t i = 0; i < count; i++)
+	{
+		RawSequenceFrameHeader record;
+		File->Read(GetFrameOffset((long long)i), &record, sizeof(record));
+		if(record.Magic != RAW_SEQUENCE_FRAME_MAGIC || record.Index != (int64_t)i ||
+			(!Timestamps.empty() && record.Timestamp < Timestamps.back()))
+		{
+			break;
+		}
+		Timestamps.push_back(record.Timestamp);
+	}
+}
+
+void CRawSequenceReader::State::ParseY4mHeader(const std::string& line)
+{
+	int width = 0;
+	int height = 0;
+	std::string colour = "420jpeg";
+	Info.RateNum = 25;
+	Info.RateDen = 1;
+
+	size_t pos = strlen(Y4M_SIGNATURE);
+	while(pos < line.size())
+	{
+		size_t end = line.find_first_of(" \n", pos);
+		std::string token = line.substr(pos, end - pos);
+		pos = end + 1;
+		if(token.empty())
+		{
+			continue;
+		}
+
+		switch(token[0])
+		{
+		case 'W':
+			width = atoi(token.c_str() + 1);
+			break;
+		case 'H':
+			height = atoi(token.c_str() + 1);
+			break;
+		case 'F':
+		{
+			char* end = NULL;
+			Info.RateNum = (int)strtol(token.c_str() + 1, &end, 10);
+			Info.RateDen = *end == ':' ? (int)strtol(end + 1, NULL, 10) : 0;
+			if(Info.RateNum <= 0 || Info.RateDen <= 0)
+			{
+				throw "Corrupt Y4M frame rate";
+			}
+			break;
+		}
+		case 'C':
+			colour = token.substr(1);
+			break;
+		case 'I':
+			if(token != "Ip" && token != "I?")
+			{
+				throw "Interlaced Y4M is not supported";
+			}
+			break;
+		}
+	}
+
+	if(width <= 0 || height <= 0)
+	{
+		throw "Corrupt Y4M header";
+	}
+
+	DataSize = GetSequenceLayout(SC_Y4M, GetY4mFormat(colour), width, height, &Layout);
+	Layout.RateNum = Info.RateNum;
+	Layout.RateDen = Info.RateDen;
+}
+
+void CRawSequenceReader::State::OpenY4m(void)
+{
+	std::string header = ReadLine(0, Y4M_MAX_LINE);
+	if(header.empty())
+	{
+		throw "Corrupt Y4M header";
+	}
+	ParseY4mHeader(header);
+	FirstFrame = header.size();
+
+	// Frames without parameters have a fixed size and are found by arithmetic; the last
+	// complete one is checked to make sure no frame in between carries parameters
+	uint64_t size = File->GetSize();
+	uint64_t count = size > FirstFrame ? (size - FirstFrame) / Layout.FrameStride : 0;
+	if(count == 0 || (ReadLine(FirstFrame, Y4M_FRAME_LENGTH) == Y4M_FRAME &&
+		ReadLine(FirstFrame + (count - 1) * Layout.FrameStride, Y4M_FRAME_LENGTH) == Y4M_FRAME))
+	{
+		FirstFrame += Y4M_FRAME_LENGTH;
+		Info.FrameCount = (long long)count;
+		return;
+	}
+
+	uint64_t pos = FirstFrame;
+	while(pos < size)
+	{
+		std::string line = ReadLine(pos, Y4M_MAX_LINE);
+		if(line.compare(0, 5, "FRAME") != 0 || pos + line.size() + DataSize > size)
+		{
+			break;
+		}
+		Offsets.push_back(pos + line.size());
+		pos += line.size() + DataSize;
+	}
+	Info.FrameCount = (long long)Offsets.size();
+}
+
+CRawSequenceReader::CRawSequenceReader(const char* path, int readahead)
+	: m_state(new State())
+{
+	State* s = m_state;
+	try
+	{
+		s->File = CNativeFile::Open(path);
+		s->Readahead = readahead > 0 ? readahead : 0;
+
+		char signature[10] = {};
+		s->File->Read(0, signature, s->File->GetSize() < sizeof(signature) ? (size_t)s->File->GetSize() : sizeof(signature));
+
+		uint32_t magic;
+		memcpy(&magic, signature, sizeof(magic));
+		if(magic == RAW_SEQUENCE_MAGIC)
+		{
+			s->Info.Container = SC_NATIVE;
+			s->OpenNative();
+			s->Info.RateNum = s->Layout.RateNum;
+			s->Info.RateDen = s->Layout.RateDen;
+			s->Info.FrameCount = (long long)s->Timestamps.size();
+		}
+		else if(memcmp(signature, Y4M_SIGNATURE, sizeof(signature)) == 0)
+		{
+			s->Info.Container = SC_Y4M;
+			s->OpenY4m();
+		}
+		else
+		{
+			throw "Not a raw sequence file";
+		}
+
+		s->Info.Format = s->Layout.Format;
+		s->Info.Width = s->Layout.Width;
+		s->Info.Height = s->Layout.Height;
+	}
+	catch(...)
+	{
+		delete m_state;
+		throw;
+	}
+}
+
+CRawSequenceReader::~CRawSequenceReader(void)
+{
+	delete m_state;
+}
+
+void CRawSequenceReader::GetInfo(SequenceInfo* info) const
+{
+	*info = m_state->Info;
+}
+
+long long CRawSequenceReader::GetFrameCount(void) const
+{
+	return m_state->Info.FrameCount;
+}
+
+long long CRawSequenceReader::GetTimestamp(long long frame) const
+{
+	const State* s = m_state;
+	if(frame < 0 || frame >= s->Info.FrameCount)
+	{
+		throw "Frame number out of range";
+	}
+	if(s->Info.Container == SC_NATIVE)
+	{
+		return s->Timestamps[(size_t)frame];
+	}
+	return GetRateTimestamp(frame, s->Info.RateNum, s->Info.RateDen);
+}
+
+long long CRawSequenceReader::FindFrame(long long timestamp) const
+{
+	long long count = m_state->Info.FrameCount;
+	if(count == 0 || timestamp < GetTimestamp(0))
+	{
+		return -1;
+	}
+
+	long long low = 0;
+	long long high = count - 1;
+	while(low < high)
+	{
+		long long mid = low + (high - low + 1) / 2;
+		if(GetTimestamp(mid) <= timestamp)
+		{
+			low = mid;
+		}
+		else
+		{
+			high = mid - 1;
+		}
+	}
+	return low;
+}
+
+CPlanarFrame* CRawSequenceReader::ReadFrame(long long frame) const
+{
+	const State* s = m_state;
+	if(frame < 0 || frame >= s->Info.FrameCount)
+	{
+		throw "Frame number out of range";
+	}
+
+	uint64_t offset = s->GetFrameOffset(frame);
+	CPlaneBuffer* storage = s->File->Map(offset, (size_t)s->DataSize);
+
+	if(s->Info.Container == SC_NATIVE)
+	{
+		const RawSequenceFrameHeader* record = (const RawSequenceFrameHeader*)storage->GetData();
+		if(record->Magic != RAW_SEQUENCE_FRAME_MAGIC || record->Index != frame)
+		{
+			storage->Release();
+			throw "Corrupt sequence frame";
+		}
+	}
+
+	CPlanarFrame* result = NULL;
+	try
+	{
+		BYTE* planes[FRAME_MAX_PLANES];
+		for(int i = 0; i < s->Layout.Planes; i++)
+		{
+			planes[i] = storage->GetData() + s->Layout.PlaneOffsets[i];
+		}
+		result = CPlanarFrame::Wrap(s->Layout.Width, s->Layout.Height, (FrameFormat)s->Layout.Format,
+			planes, s->Layout.Pitches, storage);
+	}
+	catch(...)
+	{
+		storage->Release();
+		throw;
+	}
+	storage->Release();
+
+	if(s->Readahead > 0 && frame + 1 < s->Info.FrameCount)
+	{
+		s->File->WillNeed(s->GetFrameOffset(frame + 1), s->Readahead * s->Layout.FrameStride);
+	}
+	return result;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <stdint.h>
+#include "NativeLib.h"
+#include "PlanarFrame.h"
+
+#define RAW_SEQUENCE_MAGIC 0x51455354			// "TSEQ"
+#define RAW_SEQUENCE_FRAME_MAGIC 0x4D524654		// "TFRM"
+#define RAW_SEQUENCE_INDEX_MAGIC 0x58444954		// "TIDX"
+#define RAW_SEQUENCE_VERSION 1
+
+// Timestamps are counted in 100 ns ticks, the unit of TimeSpan
+#define RAW_SEQUENCE_TICKS 10000000LL
+
+enum SequenceContainer
+{
+	SC_NATIVE = 0,		// fixed size records with a timestamp index footer
+	SC_Y4M				// YUV4MPEG2, timestamps follow from the frame rate
+};
+
+// Little endian file header of the native container, padded to RAW_FRAME_PAGE. Every
+// frame is a record of FrameStride bytes: a RawSequenceFrameHeader and the planes at
+// PlaneOffsets. Records start on page boundaries and planes on FRAME_ALIGNMENT, so
+// mapped records are used in place.
+struct RawSequenceHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t HeaderSize;
+	int32_t Format;			// FrameFormat
+	int32_t Width;
+	int32_t Height;
+	int32_t Planes;
+	int32_t RateNum;		// 0 when the rate is not known
+	int32_t RateDen;
+	int32_t Reserved;
+	int32_t Pitches[4];
+	int32_t Lines[4];
+	uint32_t PlaneOffsets[4];
+	uint64_t FrameStride;
+};
+
+struct RawSequenceFrameHeader
+{
+	uint32_t Magic;
+	uint32_t Reserved;
+	int64_t Index;
+	int64_t Timestamp;
+};
+
+// Closes a native file: FrameCount timestamps (int64) at IndexOffset, then this trailer.
+// A file without it, left by a writer that never closed, is recovered from the records.
+struct RawSequenceTrailer
+{
+	uint64_t FrameCount;
+	uint64_t IndexOffset;
+	uint32_t Magic;
+	uint32_t Version;
+};
+
+struct SequenceInfo
+{
+	int Container;			// SequenceContainer
+	int Format;
+	int Width;
+	int Height;
+	int RateNum;
+	int RateDen;
+	long long FrameCount;
+};
+
+// Appends frames of one size and format to a new sequence file. Y4M only carries
+// Y800, Y16, YUV, YUV16, I420, YV12, I420P16, I422 and Y411, and ignores timestamps.
+class NATIVELIB CRawSequenceWriter
+{
+public:
+	CRawSequenceWriter(const char* path, SequenceContainer container, FrameFormat format,
+		int width, int height, int rateNum, int rateDen);
+	virtual ~CRawSequenceWriter(void);
+
+	// Timestamps of the native container must not decrease
+	void Append(const CPlanarFrame* frame, long long timestamp);
+
+	// Writes the index; the destructor closes without reporting errors
+	void Close(void);
+
+	long long GetFrameCount(void) const;
+
+private:
+	struct State;
+	State* m_state;
+
+	CRawSequenceWriter(const CRawSequenceWriter&);
+	CRawSequenceWriter& operator=(const CRawSequenceWriter&);
+};
+
+// Random access to a native or Y4M sequence. Frames are mapped copy-on-write straight
+// from the file and stay valid after the reader is gone; reading a frame hints the
+// system to read the next readahead frames. All methods may be called from several
+// threads at once.
+class NATIVELIB CRawSequenceReader
+{
+public:
+	CRawSequenceReader(const char* path, int readahead = 2);
+	virtual ~CRawSequenceReader(void);
+
+	void GetInfo(SequenceInfo* info) const;
+	long long GetFrameCount(void) const;
+	long long GetTimestamp(long long frame) const;
+
+	// Last frame at or before the timestamp, -1 when it precedes the first frame
+	long long FindFrame(long long timestamp) const;
+
+	CPlanarFrame* ReadFrame(long long frame) const;
+
+private:
+	struct State;
+	State* m_state;
+
+	CRawSequenceReader(const CRawSequenceReader&);
+	CRawSequenceReader& operator=(const CRawSequenceReader&);
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+// Interlocked counters for the intrusive reference counts, kept out of public headers
+// so that they can be included from /clr code
+#ifdef _WIN32
+#include <windows.h>
+
+inline long AtomicIncrement(volatile long* value)
+{
+	return InterlockedIncrement(value);
+}
+
+inline long AtomicDecrement(volatile long* value)
+{
+	return InterlockedDecrement(value);
+}
+#else
+inline long AtomicIncrement(volatile long* value)
+{
+	return __sync_add_and_fetch(value, 1);
+}
+
+inline long AtomicDecrement(volatile long* value)
+{
+	return __sync_sub_and_fetch(value, 1);
+}
+#endif
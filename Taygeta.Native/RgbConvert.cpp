@@ -0,0 +1,332 @@
+#include "RgbConvert.h"
+#include "YuvKernels.h"
+#include "ToneKernels.h"
+#include "RowBands.h"
+
+#include <string.h>
+#include <vector>
+
+static inline const BYTE* Row(const CPlanarFrame* frame, int plane, int y)
+{
+	return frame->GetPlane(plane) + (ptrdiff_t)y * frame->GetPitch(plane);
+}
+
+// Splits packed and semi-planar rows into planar scratch rows, one set per band. A tone
+// map is applied on the way into scratch, where the rows are still in the cache.
+class CYuvToRgbTask : public IRowBandTask
+{
+public:
+	CYuvToRgbTask(const CPlanarFrame* src, BYTE* dst, int dstPitch, RgbLayout layout,
+		const YuvToRgbCoefs& coefs, const ToneMap* tone, int bands)
+		: m_src(src), m_dst(dst), m_dstPitch(dstPitch), m_coefs(coefs), m_k(GetYuvRowKernels()),
+		m_tone(tone), m_tk(GetToneKernels()), m_format(src->GetFormat()), m_width(src->GetWidth())
+	{
+		bool half = m_format != FF_YUV && m_format != FF_Y800;
+		m_row = GetRgbRowKernels()->YuvToRgb[layout][half ? 1 : 0];
+		m_chromaWidth = half ? (m_width + 1) / 2 : m_width;
+
+		// Odd packed rows unpack a whole pair
+		m_rowSize = m_width + 2;
+		m_scratch.resize((size_t)m_rowSize * (SCRATCH_ROWS * bands + 1));
+		m_neutral = Scratch(bands, 0);
+		memset(m_neutral, 128, m_rowSize);
+	}
+
+	virtual void RunRows(int band, int first, int count)
+	{
+		BYTE* luma = Scratch(band, LUMA);
+		BYTE* u = Scratch(band, CHROMA_U);
+		BYTE* v = Scratch(band, CHROMA_V);
+		int pairs = (m_width + 1) / 2;
+		int split = -1;
+		int toned = -1;
+
+		for(int y = first; y < first + count; y++)
+		{
+			const BYTE* yRow = Row(m_src, 0, y);
+			const BYTE* uRow = u;
+			const BYTE* vRow = v;
+			switch(m_format)
+			{
+			case FF_Y800:
+				uRow = vRow = m_neutral;
+				break;
+
+			case FF_YUV:
+			case FF_I422:
+				uRow = Row(m_src, 1, y);
+				vRow = Row(m_src, 2, y);
+				break;
+
+			case FF_I420:
+				uRow = Row(m_src, 1, y >> 1);
+				vRow = Row(m_src, 2, y >> 1);
+				break;
+
+			case FF_YV12:
+				uRow = Row(m_src, 2, y >> 1);
+				vRow = Row(m_src, 1, y >> 1);
+				break;
+
+			case FF_NV12:
+			case FF_NV21:
+				if(split != y >> 1)
+				{
+					split = y >> 1;
+					if(m_format == FF_NV12)
+					{
+						m_k->Deinterleave(Row(m_src, 1, split), u, v, pairs);
+					}
+					else
+					{
+						m_k->Deinterleave(Row(m_src, 1, split), v, u, pairs);
+					}
+				}
+				break;
+
+			case FF_YUY2:
+				m_k->UnpackYuy2(yRow, luma, u, v, pairs);
+				yRow = luma;
+				break;
+
+			case FF_UYVY:
+				m_k->UnpackUyvy(yRow, luma, u, v, pairs);
+				yRow = luma;
+				break;
+
+			default:
+				return;
+			}
+
+			if(m_tone)
+			{
+				m_tk->Lookup(yRow, luma, m_tone->Luma, m_width);
+				yRow = luma;
+
+				// Gray chroma stays gray; 4:2:0 chroma rows are shared by two luma rows
+				int chromaRow = m_format == FF_I420 || m_format == FF_YV12 || m_format == FF_NV12 || m_format == FF_NV21 ? y >> 1 : y;
+				if(m_format != FF_Y800)
+				{
+					if(toned != chromaRow)
+					{
+						toned = chromaRow;
+						m_tk->ScaleChroma(uRow, u, m_tone->ChromaGain, m_chromaWidth);
+						m_tk->ScaleChroma(vRow, v, m_tone->ChromaGain, m_chromaWidth);
+					}
+					uRow = u;
+					vRow = v;
+				}
+			}
+
+			m_row(yRow, uRow, vRow, m_dst + (ptrdiff_t)y * m_dstPitch, m_width, &m_coefs);
+		}
+	}
+
+private:
+	enum
+	{
+		LUMA = 0,
+		CHROMA_U,
+		CHROMA_V,
+		SCRATCH_ROWS
+	};
+
+	const CPlanarFrame* m_src;
+	BYTE* m_dst;
+	int m_dstPitch;
+	YuvToRgbCoefs m_coefs;
+	const YuvRowKernels* m_k;
+	const ToneMap* m_tone;
+	const ToneKernels* m_tk;
+	YuvToRgbRowFunc m_row;
+	FrameFormat m_format;
+	int m_width;
+	int m_chromaWidth;
+	int m_rowSize;
+	std::vector<BYTE> m_scratch;
+	BYTE* m_neutral;		// chroma of gray sources, shared by the bands
+
+	BYTE* Scratch(int band, int row)
+	{
+		return &m_scratch[((size_t)band * SCRATCH_ROWS + row) * m_rowSize];
+	}
+};
+
+// Chroma of 4:2:0 targets is written straight into planar targets and interleaved from
+// scratch rows into semi-planar ones
+class CRgbToYuvTask : public IRowBandTask
+{
+public:
+	CRgbToYuvTask(const BYTE* src, int srcPitch, RgbLayout layout, CPlanarFrame* dst,
+		const RgbToYuvCoefs& coefs, int bands)
+		: m_src(src), m_srcPitch(srcPitch), m_dst(dst), m_coefs(coefs), m_k(GetYuvRowKernels()),
+		m_format(dst->GetFormat()), m_width(dst->GetWidth()), m_height(dst->GetHeight())
+	{
+		const RgbRowKernels* kernels = GetRgbRowKernels();
+		m_row = kernels->RgbToYuv[layout];
+		m_row420 = kernels->RgbToYuv420[layout];
+
+		m_rowSize = m_width + 1;
+		m_scratch.resize((size_t)m_rowSize * SCRATCH_ROWS * bands);
+	}
+
+	virtual void RunRows(int band, int first, int count)
+	{
+		BYTE* u = Scratch(band, CHROMA_U);
+		BYTE* v = Scratch(band, CHROMA_V);
+		int last = first + count;
+
+		switch(m_format)
+		{
+		case FF_Y800:
+			for(int y = first; y < last; y++)
+			{
+				m_row(Source(y), Row(0, y), u, v, m_width, &m_coefs);
+			}
+			return;
+
+		case FF_YUV:
+			for(int y = first; y < last; y++)
+			{
+				m_row(Source(y), Row(0, y), Row(1, y), Row(2, y), m_width, &m_coefs);
+			}
+			return;
+
+		default:
+			break;
+		}
+
+		// Bands start on even rows, only the last row of the frame goes without a partner
+		for(int y = first; y < last; y += 2)
+		{
+			int y1 = y + 1 < m_height ? y + 1 : y;
+			BYTE* uOut = u;
+			BYTE* vOut = v;
+			if(m_format == FF_I420)
+			{
+				uOut = Row(1, y / 2);
+				vOut = Row(2, y / 2);
+			}
+			else if(m_format == FF_YV12)
+			{
+				uOut = Row(2, y / 2);
+				vOut = Row(1, y / 2);
+			}
+
+			m_row420(Source(y), Source(y1), Row(0, y), Row(0, y1), uOut, vOut, m_width, &m_coefs);
+
+			int pairs = (m_width + 1) / 2;
+			if(m_format == FF_NV12)
+			{
+				m_k->Interleave(u, v, Row(1, y / 2), pairs);
+			}
+			else if(m_format == FF_NV21)
+			{
+				m_k->Interleave(v, u, Row(1, y / 2), pairs);
+			}
+		}
+	}
+
+private:
+	enum
+	{
+		CHROMA_U = 0,
+		CHROMA_V,
+		SCRATCH_ROWS
+	};
+
+	const BYTE* m_src;
+	int m_srcPitch;
+	CPlanarFrame* m_dst;
+	RgbToYuvCoefs m_coefs;
+	const YuvRowKernels* m_k;
+	RgbToYuvRowFunc m_row;
+	RgbToYuv420RowFunc m_row420;
+	FrameFormat m_format;
+	int m_width;
+	int m_height;
+	int m_rowSize;
+	std::vector<BYTE> m_scratch;
+
+	const BYTE* Source(int y)
+	{
+		return m_src + (ptrdiff_t)y * m_srcPitch;
+	}
+
+	BYTE* Row(int plane, int y)
+	{
+		return m_dst->GetPlane(plane) + (ptrdiff_t)y * m_dst->GetPitch(plane);
+	}
+
+	BYTE* Scratch(int band, int row)
+	{
+		return &m_scratch[((size_t)band * SCRATCH_ROWS + row) * m_rowSize];
+	}
+};
+
+bool CanConvertYuvToRgb(FrameFormat src)
+{
+	switch(src)
+	{
+	case FF_Y800:
+	case FF_YUV:
+	case FF_YUY2:
+	case FF_UYVY:
+	case FF_YV12:
+	case FF_I420:
+	case FF_NV12:
+	case FF_NV21:
+	case FF_I422:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void ConvertYuvToRgb(const CPlanarFrame* src, BYTE* dst, int dstPitch, RgbLayout layout,
+	YuvMatrix matrix, YuvRange range, const ToneMap* tone, int threads)
+{
+	if(!CanConvertYuvToRgb(src->GetFormat()) || layout < 0 || layout >= RL_COUNT)
+	{
+		throw "Unsupported conversion";
+	}
+
+	YuvToRgbCoefs coefs;
+	GetYuvToRgbCoefs(matrix, range, &coefs);
+
+	int bands = GetRowBandCount(src->GetWidth(), src->GetHeight(), threads);
+	CYuvToRgbTask task(src, dst, dstPitch, layout, coefs, tone, bands);
+	RunRowBands(&task, src->GetHeight(), bands, 2);
+}
+
+bool CanConvertRgbToYuv(FrameFormat dst)
+{
+	switch(dst)
+	{
+	case FF_Y800:
+	case FF_YUV:
+	case FF_YV12:
+	case FF_I420:
+	case FF_NV12:
+	case FF_NV21:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void ConvertRgbToYuv(const BYTE* src, int srcPitch, RgbLayout layout, CPlanarFrame* dst,
+	YuvMatrix matrix, YuvRange range, int threads)
+{
+	if(!CanConvertRgbToYuv(dst->GetFormat()) || layout < 0 || layout >= RL_COUNT)
+	{
+		throw "Unsupported conversion";
+	}
+
+	RgbToYuvCoefs coefs;
+	GetRgbToYuvCoefs(matrix, range, &coefs);
+
+	int bands = GetRowBandCount(dst->GetWidth(), dst->GetHeight(), threads);
+	CRgbToYuvTask task(src, srcPitch, layout, dst, coefs, bands);
+	RunRowBands(&task, dst->GetHeight(), bands, 2);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "NativeLib.h"
+#include "FrameFormat.h"
+#include "PlanarFrame.h"
+#include "RgbKernels.h"
+#include "FrameTone.h"
+
+// YUV frames (Y800, YUV, YUY2, UYVY, YV12, I420, NV12, NV21 and I422) to packed RGB with
+// the row kernels of RgbKernels.h. Chroma is taken from the nearest row and sample of
+// the subsampled planes; gray sources convert as neutral chroma.
+NATIVELIB bool CanConvertYuvToRgb(FrameFormat src);
+
+// Writes width * 3 or 4 bytes per row at dst + y * dstPitch; dstPitch may be negative
+// for bottom-up images. A tone map, unless NULL, is applied to the rows on their way
+// into the conversion, with the result AdjustTone would give. Rows run in bands on up to
+// threads threads, 0 for one per processor, with identical results for any count.
+NATIVELIB void ConvertYuvToRgb(const CPlanarFrame* src, BYTE* dst, int dstPitch, RgbLayout layout,
+	YuvMatrix matrix, YuvRange range, const ToneMap* tone, int threads);
+
+// Packed RGB to Y800, YUV, YV12, I420, NV12 or NV21 frames of its size, chroma of 4:2:0
+// targets averaged over 2x2 blocks. src rows are at src + y * srcPitch.
+NATIVELIB bool CanConvertRgbToYuv(FrameFormat dst);
+NATIVELIB void ConvertRgbToYuv(const BYTE* src, int srcPitch, RgbLayout layout, CPlanarFrame* dst,
+	YuvMatrix matrix, YuvRange range, int threads);
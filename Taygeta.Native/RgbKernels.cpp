@@ -0,0 +1,755 @@
+#include "RgbKernels.h"
+#include "CpuFeatures.h"
+
+#include <string.h>
+
+#ifdef CPU_X86
+#include <immintrin.h>
+#endif
+
+#define RGB_SHIFT 13
+#define YUV_SHIFT 15
+
+static short Fixed(double value, int shift)
+{
+	double scaled = value * (1 << shift);
+	return (short)(scaled < 0 ? -(int)(-scaled + 0.5) : (int)(scaled + 0.5));
+}
+
+// Weights of red and blue in luma
+static void GetMatrixWeights(YuvMatrix matrix, double* kr, double* kb)
+{
+	switch(matrix)
+	{
+	case YM_BT709:
+		*kr = 0.2126;
+		*kb = 0.0722;
+		break;
+	case YM_FCC:
+		*kr = 0.30;
+		*kb = 0.11;
+		break;
+	case YM_BT601:
+		*kr = 0.299;
+		*kb = 0.114;
+		break;
+	case YM_SMPTE240M:
+		*kr = 0.212;
+		*kb = 0.087;
+		break;
+	default:
+		throw "Unsupported YUV matrix";
+	}
+}
+
+// Spans of limited range samples relative to 0..255
+static void GetRangeScales(YuvRange range, double* yScale, double* cScale)
+{
+	switch(range)
+	{
+	case YR_LIMITED:
+		*yScale = 219.0 / 255;
+		*cScale = 224.0 / 255;
+		break;
+	case YR_FULL:
+		*yScale = 1;
+		*cScale = 1;
+		break;
+	default:
+		throw "Unsupported YUV range";
+	}
+}
+
+void GetYuvToRgbCoefs(YuvMatrix matrix, YuvRange range, YuvToRgbCoefs* coefs)
+{
+	double kr, kb, yScale, cScale;
+	GetMatrixWeights(matrix, &kr, &kb);
+	GetRangeScales(range, &yScale, &cScale);
+	double kg = 1 - kr - kb;
+
+	coefs->YOffset = range == YR_LIMITED ? 16 : 0;
+	coefs->Y = Fixed(1 / yScale, RGB_SHIFT);
+	coefs->Rounding = 1 << (RGB_SHIFT - 1);
+	coefs->CrR = Fixed(2 * (1 - kr) / cScale, RGB_SHIFT);
+	coefs->CbG = Fixed(-2 * kb * (1 - kb) / kg / cScale, RGB_SHIFT);
+	coefs->CrG = Fixed(-2 * kr * (1 - kr) / kg / cScale, RGB_SHIFT);
+	coefs->CbB = Fixed(2 * (1 - kb) / cScale, RGB_SHIFT);
+}
+
+void GetRgbToYuvCoefs(YuvMatrix matrix, YuvRange range, RgbToYuvCoefs* coefs)
+{
+	double kr, kb, yScale, cScale;
+	GetMatrixWeights(matrix, &kr, &kb);
+	GetRangeScales(range, &yScale, &cScale);
+	double kg = 1 - kr - kb;
+
+	coefs->YR = Fixed(kr * yScale, YUV_SHIFT);
+	coefs->YG = Fixed(kg * yScale, YUV_SHIFT);
+	coefs->YB = Fixed(kb * yScale, YUV_SHIFT);
+	coefs->UR = Fixed(-kr / (2 * (1 - kb)) * cScale, YUV_SHIFT);
+	coefs->UG = Fixed(-kg / (2 * (1 - kb)) * cScale, YUV_SHIFT);
+	coefs->UB = Fixed(0.5 * cScale, YUV_SHIFT);
+	coefs->VR = Fixed(0.5 * cScale, YUV_SHIFT);
+	coefs->VG = Fixed(-kg / (2 * (1 - kr)) * cScale, YUV_SHIFT);
+	coefs->VB = Fixed(-kb / (2 * (1 - kr)) * cScale, YUV_SHIFT);
+	coefs->YOffset = range == YR_LIMITED ? 16 : 0;
+	coefs->Rounding = 1 << (YUV_SHIFT - 1);
+}
+
+// Byte offsets of the channels within a pixel
+template<int layout> struct RgbOrder;
+template<> struct RgbOrder<RL_BGR24> { enum { B = 0, G = 1, R = 2, A = -1, Size = 3 }; };
+template<> struct RgbOrder<RL_BGRA> { enum { B = 0, G = 1, R = 2, A = 3, Size = 4 }; };
+template<> struct RgbOrder<RL_RGBA> { enum { B = 2, G = 1, R = 0, A = 3, Size = 4 }; };
+template<> struct RgbOrder<RL_ARGB> { enum { B = 3, G = 2, R = 1, A = 0, Size = 4 }; };
+
+static inline BYTE Clamp(int value)
+{
+	return (BYTE)(value < 0 ? 0 : value > 255 ? 255 : value);
+}
+
+// Scalar reference, the SIMD kernels finish their rows with it
+
+template<int layout, bool half>
+static void YuvToRgbPixels(const BYTE* y, const BYTE* u, const BYTE* v, BYTE* dst, int x, int width, const YuvToRgbCoefs* c)
+{
+	typedef RgbOrder<layout> O;
+	for(; x < width; x++)
+	{
+		int i = half ? x >> 1 : x;
+		int luma = (y[x] - c->YOffset) * c->Y + c->Rounding;
+		int cb = u[i] - 128;
+		int cr = v[i] - 128;
+		BYTE* p = dst + x * O::Size;
+		p[O::R] = Clamp((luma + c->CrR * cr) >> RGB_SHIFT);
+		p[O::G] = Clamp((luma + c->CbG * cb + c->CrG * cr) >> RGB_SHIFT);
+		p[O::B] = Clamp((luma + c->CbB * cb) >> RGB_SHIFT);
+		if(O::A >= 0)
+		{
+			p[O::A] = 255;
+		}
+	}
+}
+
+template<int layout, bool half>
+static void YuvToRgbC(const BYTE* y, const BYTE* u, const BYTE* v, BYTE* dst, int width, const YuvToRgbCoefs* coefs)
+{
+	YuvToRgbPixels<layout, half>(y, u, v, dst, 0, width, coefs);
+}
+
+static inline BYTE Average(int a, int b)
+{
+	return (BYTE)((a + b + 1) >> 1);
+}
+
+static inline BYTE Weigh(int r, int g, int b, short wr, short wg, short wb, int offset)
+{
+	return Clamp(((wr * r + wg * g + wb * b + (1 << (YUV_SHIFT - 1))) >> YUV_SHIFT) + offset);
+}
+
+template<int layout>
+static void RgbToYuvPixels(const BYTE* rgb, BYTE* y, BYTE* u, BYTE* v, int x, int width, const RgbToYuvCoefs* c)
+{
+	typedef RgbOrder<layout> O;
+	for(; x < width; x++)
+	{
+		const BYTE* p = rgb + x * O::Size;
+		y[x] = Weigh(p[O::R], p[O::G], p[O::B], c->YR, c->YG, c->YB, c->YOffset);
+		u[x] = Weigh(p[O::R], p[O::G], p[O::B], c->UR, c->UG, c->UB, 128);
+		v[x] = Weigh(p[O::R], p[O::G], p[O::B], c->VR, c->VG, c->VB, 128);
+	}
+}
+
+template<int layout>
+static void RgbToYuv420Pixels(const BYTE* rgb0, const BYTE* rgb1, BYTE* y0, BYTE* y1, BYTE* u, BYTE* v,
+	int x, int width, const RgbToYuvCoefs* c)
+{
+	typedef RgbOrder<layout> O;
+	for(; x < width; x += 2)
+	{
+		const BYTE* a = rgb0 + x * O::Size;
+		const BYTE* b = rgb1 + x * O::Size;
+		int next = x + 1 < width ? O::Size : 0;
+		BYTE mean[4];
+		for(int k = 0; k < O::Size; k++)
+		{
+			mean[k] = Average(Average(a[k], b[k]), Average(a[k + next], b[k + next]));
+		}
+
+		y0[x] = Weigh(a[O::R], a[O::G], a[O::B], c->YR, c->YG, c->YB, c->YOffset);
+		y1[x] = Weigh(b[O::R], b[O::G], b[O::B], c->YR, c->YG, c->YB, c->YOffset);
+		if(next)
+		{
+			a += next;
+			b += next;
+			y0[x + 1] = Weigh(a[O::R], a[O::G], a[O::B], c->YR, c->YG, c->YB, c->YOffset);
+			y1[x + 1] = Weigh(b[O::R], b[O::G], b[O::B], c->YR, c->YG, c->YB, c->YOffset);
+		}
+		u[x / 2] = Weigh(mean[O::R], mean[O::G], mean[O::B], c->UR, c->UG, c->UB, 128);
+		v[x / 2] = Weigh(mean[O::R], mean[O::G], mean[O::B], c->VR, c->VG, c->VB, 128);
+	}
+}
+
+template<int layout>
+static void RgbToYuvC(const BYTE* rgb, BYTE* y, BYTE* u, BYTE* v, int width, const RgbToYuvCoefs* coefs)
+{
+	RgbToYuvPixels<layout>(rgb, y, u, v, 0, width, coefs);
+}
+
+template<int layout>
+static void RgbToYuv420C(const BYTE* rgb0, const BYTE* rgb1, BYTE* y0, BYTE* y1, BYTE* u, BYTE* v,
+	int width, const RgbToYuvCoefs* coefs)
+{
+	RgbToYuv420Pixels<layout>(rgb0, rgb1, y0, y1, u, v, 0, width, coefs);
+}
+
+static const RgbRowKernels s_scalarKernels =
+{
+	"C",
+	{
+		{ YuvToRgbC<RL_BGR24, false>, YuvToRgbC<RL_BGR24, true> },
+		{ YuvToRgbC<RL_BGRA, false>, YuvToRgbC<RL_BGRA, true> },
+		{ YuvToRgbC<RL_RGBA, false>, YuvToRgbC<RL_RGBA, true> },
+		{ YuvToRgbC<RL_ARGB, false>, YuvToRgbC<RL_ARGB, true> }
+	},
+	{ RgbToYuvC<RL_BGR24>, RgbToYuvC<RL_BGRA>, RgbToYuvC<RL_RGBA>, RgbToYuvC<RL_ARGB> },
+	{ RgbToYuv420C<RL_BGR24>, RgbToYuv420C<RL_BGRA>, RgbToYuv420C<RL_RGBA>, RgbToYuv420C<RL_ARGB> }
+};
+
+#ifdef CPU_X86
+
+#define LOAD128(p) _mm_loadu_si128((const __m128i*)(p))
+#define STORE128(p, x) _mm_storeu_si128((__m128i*)(p), x)
+#define LOAD256(p) _mm256_loadu_si256((const __m256i*)(p))
+#define STORE256(p, x) _mm256_storeu_si256((__m256i*)(p), x)
+
+static inline __m128i Load32(const BYTE* p)
+{
+	int value;
+	memcpy(&value, p, 4);
+	return _mm_cvtsi32_si128(value);
+}
+
+// 16-bit pair (lo, hi) in every 32-bit element, the pmaddwd factors of (sample, other)
+static inline int Pair(short lo, short hi)
+{
+	return (int)(((unsigned)(unsigned short)hi << 16) | (unsigned short)lo);
+}
+
+// Channels in the order the layout stores them, 16-bit samples
+template<int layout, class T> static inline void OrderChannels(const T& b, const T& g, const T& r, const T& a, T* c)
+{
+	typedef RgbOrder<layout> O;
+	c[O::B] = b;
+	c[O::G] = g;
+	c[O::R] = r;
+	c[O::A < 0 ? 3 : O::A] = a;
+}
+
+// SSE2
+
+// 4 pixels of 4 bytes to 12 bytes of 3 at the bottom, dropping every fourth byte
+static inline __m128i DropFourthSSE2(__m128i px)
+{
+	const __m128i low = _mm_set_epi32(0, 0x00FFFFFF, 0, 0x00FFFFFF);
+	const __m128i high = _mm_set_epi32(0x0000FFFF, (int)0xFF000000, 0x0000FFFF, (int)0xFF000000);
+	__m128i t = _mm_or_si128(_mm_and_si128(px, low), _mm_and_si128(_mm_srli_epi64(px, 8), high));
+	return _mm_or_si128(_mm_move_epi64(t), _mm_slli_si128(_mm_srli_si128(t, 8), 6));
+}
+
+// Two runs of 4 pixels of 3 bytes as 24 contiguous bytes
+static inline void Store24(BYTE* dst, __m128i a, __m128i b)
+{
+	STORE128(dst, _mm_or_si128(a, _mm_slli_si128(b, 12)));
+	_mm_storel_epi64((__m128i*)(dst + 16), _mm_srli_si128(b, 4));
+}
+
+template<int layout>
+static inline void StoreRgbSSE2(BYTE* dst, __m128i b, __m128i g, __m128i r, __m128i a)
+{
+	__m128i c[4];
+	OrderChannels<layout>(b, g, r, a, c);
+	__m128i c01 = _mm_packus_epi16(c[0], c[1]);
+	__m128i c23 = _mm_packus_epi16(c[2], c[3]);
+	c01 = _mm_unpacklo_epi8(c01, _mm_srli_si128(c01, 8));
+	c23 = _mm_unpacklo_epi8(c23, _mm_srli_si128(c23, 8));
+	__m128i px0 = _mm_unpacklo_epi16(c01, c23);
+	__m128i px1 = _mm_unpackhi_epi16(c01, c23);
+	if(layout == RL_BGR24)
+	{
+		Store24(dst, DropFourthSSE2(px0), DropFourthSSE2(px1));
+	}
+	else
+	{
+		STORE128(dst, px0);
+		STORE128(dst + 16, px1);
+	}
+}
+
+// Channel of 8 pixels from the luma and chroma products of pixels 0..3 and 4..7
+static inline __m128i ChannelSSE2(__m128i y0, __m128i y1, __m128i uv0, __m128i uv1, __m128i gain)
+{
+	__m128i c0 = _mm_srai_epi32(_mm_add_epi32(y0, _mm_madd_epi16(uv0, gain)), RGB_SHIFT);
+	__m128i c1 = _mm_srai_epi32(_mm_add_epi32(y1, _mm_madd_epi16(uv1, gain)), RGB_SHIFT);
+	return _mm_packs_epi32(c0, c1);
+}
+
+template<int layout, bool half>
+static void YuvToRgbSSE2(const BYTE* y, const BYTE* u, const BYTE* v, BYTE* dst, int width, const YuvToRgbCoefs* c)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi16(1);
+	const __m128i yOffset = _mm_set1_epi16(c->YOffset);
+	const __m128i bias = _mm_set1_epi16(128);
+	const __m128i alpha = _mm_set1_epi16(255);
+	const __m128i yGain = _mm_set1_epi32(Pair(c->Y, c->Rounding));
+	const __m128i rGain = _mm_set1_epi32(Pair(0, c->CrR));
+	const __m128i gGain = _mm_set1_epi32(Pair(c->CbG, c->CrG));
+	const __m128i bGain = _mm_set1_epi32(Pair(c->CbB, 0));
+	const int size = RgbOrder<layout>::Size;
+
+	int x = 0;
+	for(; x + 8 <= width; x += 8)
+	{
+		__m128i luma = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(y + x)), zero), yOffset);
+		__m128i y0 = _mm_madd_epi16(_mm_unpacklo_epi16(luma, one), yGain);
+		__m128i y1 = _mm_madd_epi16(_mm_unpackhi_epi16(luma, one), yGain);
+
+		// (u, v) pairs of pixels 0..3 and 4..7
+		__m128i uv0, uv1;
+		if(half)
+		{
+			__m128i uv = _mm_unpacklo_epi8(Load32(u + x / 2), Load32(v + x / 2));
+			uv = _mm_sub_epi16(_mm_unpacklo_epi8(uv, zero), bias);
+			uv0 = _mm_unpacklo_epi32(uv, uv);
+			uv1 = _mm_unpackhi_epi32(uv, uv);
+		}
+		else
+		{
+			__m128i uv = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(u + x)), _mm_loadl_epi64((const __m128i*)(v + x)));
+			uv0 = _mm_sub_epi16(_mm_unpacklo_epi8(uv, zero), bias);
+			uv1 = _mm_sub_epi16(_mm_unpackhi_epi8(uv, zero), bias);
+		}
+
+		__m128i r = ChannelSSE2(y0, y1, uv0, uv1, rGain);
+		__m128i g = ChannelSSE2(y0, y1, uv0, uv1, gGain);
+		__m128i b = ChannelSSE2(y0, y1, uv0, uv1, bGain);
+		StoreRgbSSE2<layout>(dst + x * size, b, g, r, alpha);
+	}
+	YuvToRgbPixels<layout, half>(y, u, v, dst, x, width, c);
+}
+
+// Factor of the byte at offset k of a pixel, alpha and the padding of 24-bit pixels weigh 0
+template<int layout> static inline short ByteWeight(int k, short wr, short wg, short wb)
+{
+	typedef RgbOrder<layout> O;
+	return k == O::R ? wr : k == O::G ? wg : k == O::B ? wb : 0;
+}
+
+// pmaddwd factors of a pixel's bytes 0, 2 and 1, 3, the pairs DotSSE2 splits it into
+struct PixelWeights
+{
+	int Even;
+	int Odd;
+};
+
+template<int layout> static inline PixelWeights GetPixelWeights(short wr, short wg, short wb)
+{
+	PixelWeights w;
+	w.Even = Pair(ByteWeight<layout>(0, wr, wg, wb), ByteWeight<layout>(2, wr, wg, wb));
+	w.Odd = Pair(ByteWeight<layout>(1, wr, wg, wb), ByteWeight<layout>(3, wr, wg, wb));
+	return w;
+}
+
+// 4 pixels of 3 bytes at the bottom to 4 bytes each, the inverse of DropFourthSSE2
+static inline __m128i ExpandBgr24SSE2(__m128i x)
+{
+	const __m128i low = _mm_set_epi32(0, 0x00FFFFFF, 0, 0x00FFFFFF);
+	const __m128i high = _mm_set_epi32(0x00FFFFFF, 0, 0x00FFFFFF, 0);
+	__m128i t = _mm_unpacklo_epi64(x, _mm_srli_si128(x, 6));
+	return _mm_or_si128(_mm_and_si128(t, low), _mm_and_si128(_mm_slli_epi64(t, 8), high));
+}
+
+// 8 pixels as two registers of 4 bytes per pixel, reading exactly their bytes
+template<int layout> static inline void Load8SSE2(const BYTE* p, __m128i* px0, __m128i* px1)
+{
+	if(layout == RL_BGR24)
+	{
+		__m128i a = LOAD128(p);
+		__m128i b = _mm_loadl_epi64((const __m128i*)(p + 16));
+		*px0 = ExpandBgr24SSE2(a);
+		*px1 = ExpandBgr24SSE2(_mm_or_si128(_mm_srli_si128(a, 12), _mm_slli_si128(b, 4)));
+	}
+	else
+	{
+		*px0 = LOAD128(p);
+		*px1 = LOAD128(p + 16);
+	}
+}
+
+// Weighted sums of 4 pixels, shifted back to whole samples
+static inline __m128i DotSSE2(__m128i px, __m128i even, __m128i odd, __m128i rounding)
+{
+	const __m128i mask = _mm_set1_epi32(0x00FF00FF);
+	__m128i sum = _mm_add_epi32(_mm_madd_epi16(_mm_and_si128(px, mask), even), _mm_madd_epi16(_mm_srli_epi16(px, 8), odd));
+	return _mm_srai_epi32(_mm_add_epi32(sum, rounding), YUV_SHIFT);
+}
+
+// Samples of 8 pixels as bytes in the low half
+static inline __m128i Samples8SSE2(__m128i px0, __m128i px1, __m128i even, __m128i odd, __m128i rounding, __m128i offset)
+{
+	__m128i s = _mm_adds_epi16(_mm_packs_epi32(DotSSE2(px0, even, odd, rounding), DotSSE2(px1, even, odd, rounding)), offset);
+	return _mm_packus_epi16(s, s);
+}
+
+// Rounded means of neighbouring pixels, 8 pixels to 4
+static inline __m128i HalvePixelsSSE2(__m128i px0, __m128i px1)
+{
+	__m128 a = _mm_castsi128_ps(px0);
+	__m128 b = _mm_castsi128_ps(px1);
+	__m128i even = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+	__m128i odd = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+	return _mm_avg_epu8(even, odd);
+}
+
+// Weights and offsets of the three planes
+struct RgbToYuvWeightsSSE2
+{
+	__m128i YEven, YOdd, UEven, UOdd, VEven, VOdd, Rounding, YOffset, COffset;
+
+	template<int layout> void Init(const RgbToYuvCoefs* c)
+	{
+		PixelWeights y = GetPixelWeights<layout>(c->YR, c->YG, c->YB);
+		PixelWeights u = GetPixelWeights<layout>(c->UR, c->UG, c->UB);
+		PixelWeights v = GetPixelWeights<layout>(c->VR, c->VG, c->VB);
+		YEven = _mm_set1_epi32(y.Even);
+		YOdd = _mm_set1_epi32(y.Odd);
+		UEven = _mm_set1_epi32(u.Even);
+		UOdd = _mm_set1_epi32(u.Odd);
+		VEven = _mm_set1_epi32(v.Even);
+		VOdd = _mm_set1_epi32(v.Odd);
+		Rounding = _mm_set1_epi32(c->Rounding);
+		YOffset = _mm_set1_epi16(c->YOffset);
+		COffset = _mm_set1_epi16(128);
+	}
+};
+
+template<int layout>
+static void RgbToYuvSSE2(const BYTE* rgb, BYTE* y, BYTE* u, BYTE* v, int width, const RgbToYuvCoefs* c)
+{
+	RgbToYuvWeightsSSE2 w;
+	w.Init<layout>(c);
+	const int size = RgbOrder<layout>::Size;
+
+	int x = 0;
+	for(; x + 8 <= width; x += 8)
+	{
+		__m128i px0, px1;
+		Load8SSE2<layout>(rgb + x * size, &px0, &px1);
+		_mm_storel_epi64((__m128i*)(y + x), Samples8SSE2(px0, px1, w.YEven, w.YOdd, w.Rounding, w.YOffset));
+		_mm_storel_epi64((__m128i*)(u + x), Samples8SSE2(px0, px1, w.UEven, w.UOdd, w.Rounding, w.COffset));
+		_mm_storel_epi64((__m128i*)(v + x), Samples8SSE2(px0, px1, w.VEven, w.VOdd, w.Rounding, w.COffset));
+	}
+	RgbToYuvPixels<layout>(rgb, y, u, v, x, width, c);
+}
+
+template<int layout>
+static void RgbToYuv420SSE2(const BYTE* rgb0, const BYTE* rgb1, BYTE* y0, BYTE* y1, BYTE* u, BYTE* v,
+	int width, const RgbToYuvCoefs* c)
+{
+	RgbToYuvWeightsSSE2 w;
+	w.Init<layout>(c);
+	const int size = RgbOrder<layout>::Size;
+
+	int x = 0;
+	for(; x + 16 <= width; x += 16)
+	{
+		__m128i a[4], b[4];
+		Load8SSE2<layout>(rgb0 + x * size, &a[0], &a[1]);
+		Load8SSE2<layout>(rgb0 + (x + 8) * size, &a[2], &a[3]);
+		Load8SSE2<layout>(rgb1 + x * size, &b[0], &b[1]);
+		Load8SSE2<layout>(rgb1 + (x + 8) * size, &b[2], &b[3]);
+
+		// Row 1 may be row 0 again, both are read before either is written
+		__m128i luma0 = _mm_unpacklo_epi64(Samples8SSE2(a[0], a[1], w.YEven, w.YOdd, w.Rounding, w.YOffset),
+			Samples8SSE2(a[2], a[3], w.YEven, w.YOdd, w.Rounding, w.YOffset));
+		__m128i luma1 = _mm_unpacklo_epi64(Samples8SSE2(b[0], b[1], w.YEven, w.YOdd, w.Rounding, w.YOffset),
+			Samples8SSE2(b[2], b[3], w.YEven, w.YOdd, w.Rounding, w.YOffset));
+		STORE128(y0 + x, luma0);
+		STORE128(y1 + x, luma1);
+
+		__m128i m0 = HalvePixelsSSE2(_mm_avg_epu8(a[0], b[0]), _mm_avg_epu8(a[1], b[1]));
+		__m128i m1 = HalvePixelsSSE2(_mm_avg_epu8(a[2], b[2]), _mm_avg_epu8(a[3], b[3]));
+		_mm_storel_epi64((__m128i*)(u + x / 2), Samples8SSE2(m0, m1, w.UEven, w.UOdd, w.Rounding, w.COffset));
+		_mm_storel_epi64((__m128i*)(v + x / 2), Samples8SSE2(m0, m1, w.VEven, w.VOdd, w.Rounding, w.COffset));
+	}
+	RgbToYuv420Pixels<layout>(rgb0, rgb1, y0, y1, u, v, x, width, c);
+}
+
+static const RgbRowKernels s_sse2Kernels =
+{
+	"SSE2",
+	{
+		{ YuvToRgbSSE2<RL_BGR24, false>, YuvToRgbSSE2<RL_BGR24, true> },
+		{ YuvToRgbSSE2<RL_BGRA, false>, YuvToRgbSSE2<RL_BGRA, true> },
+		{ YuvToRgbSSE2<RL_RGBA, false>, YuvToRgbSSE2<RL_RGBA, true> },
+		{ YuvToRgbSSE2<RL_ARGB, false>, YuvToRgbSSE2<RL_ARGB, true> }
+	},
+	{ RgbToYuvSSE2<RL_BGR24>, RgbToYuvSSE2<RL_BGRA>, RgbToYuvSSE2<RL_RGBA>, RgbToYuvSSE2<RL_ARGB> },
+	{ RgbToYuv420SSE2<RL_BGR24>, RgbToYuv420SSE2<RL_BGRA>, RgbToYuv420SSE2<RL_RGBA>, RgbToYuv420SSE2<RL_ARGB> }
+};
+
+// AVX2, 16 pixels per step. The 128-bit lanes hold pixels 0..3 | 8..11 and 4..7 | 12..15
+// until the store puts them back in order.
+
+TARGET_AVX2 static inline __m256i DropFourthAVX2(__m256i px)
+{
+	const __m256i low = _mm256_set_epi32(0, 0x00FFFFFF, 0, 0x00FFFFFF, 0, 0x00FFFFFF, 0, 0x00FFFFFF);
+	const __m256i high = _mm256_set_epi32(0x0000FFFF, (int)0xFF000000, 0x0000FFFF, (int)0xFF000000,
+		0x0000FFFF, (int)0xFF000000, 0x0000FFFF, (int)0xFF000000);
+	const __m256i half = _mm256_set_epi32(0, 0, -1, -1, 0, 0, -1, -1);
+	__m256i t = _mm256_or_si256(_mm256_and_si256(px, low), _mm256_and_si256(_mm256_srli_epi64(px, 8), high));
+	return _mm256_or_si256(_mm256_and_si256(t, half), _mm256_slli_si256(_mm256_srli_si256(t, 8), 6));
+}
+
+template<int layout>
+TARGET_AVX2 static inline void StoreRgbAVX2(BYTE* dst, __m256i b, __m256i g, __m256i r, __m256i a)
+{
+	__m256i c[4];
+	OrderChannels<layout>(b, g, r, a, c);
+	__m256i c01 = _mm256_packus_epi16(c[0], c[1]);
+	__m256i c23 = _mm256_packus_epi16(c[2], c[3]);
+	c01 = _mm256_unpacklo_epi8(c01, _mm256_srli_si256(c01, 8));
+	c23 = _mm256_unpacklo_epi8(c23, _mm256_srli_si256(c23, 8));
+	__m256i lo = _mm256_unpacklo_epi16(c01, c23);
+	__m256i hi = _mm256_unpackhi_epi16(c01, c23);
+	__m256i px0 = _mm256_permute2x128_si256(lo, hi, 0x20);
+	__m256i px1 = _mm256_permute2x128_si256(lo, hi, 0x31);
+	if(layout == RL_BGR24)
+	{
+		px0 = DropFourthAVX2(px0);
+		px1 = DropFourthAVX2(px1);
+		Store24(dst, _mm256_castsi256_si128(px0), _mm256_extracti128_si256(px0, 1));
+		Store24(dst + 24, _mm256_castsi256_si128(px1), _mm256_extracti128_si256(px1, 1));
+	}
+	else
+	{
+		STORE256(dst, px0);
+		STORE256(dst + 32, px1);
+	}
+}
+
+TARGET_AVX2 static inline __m256i ChannelAVX2(__m256i y0, __m256i y1, __m256i uv0, __m256i uv1, __m256i gain)
+{
+	__m256i c0 = _mm256_srai_epi32(_mm256_add_epi32(y0, _mm256_madd_epi16(uv0, gain)), RGB_SHIFT);
+	__m256i c1 = _mm256_srai_epi32(_mm256_add_epi32(y1, _mm256_madd_epi16(uv1, gain)), RGB_SHIFT);
+	return _mm256_packs_epi32(c0, c1);
+}
+
+template<int layout, bool half>
+TARGET_AVX2 static void YuvToRgbAVX2(const BYTE* y, const BYTE* u, const BYTE* v, BYTE* dst, int width, const YuvToRgbCoefs* c)
+{
+	const __m256i one = _mm256_set1_epi16(1);
+	const __m256i yOffset = _mm256_set1_epi16(c->YOffset);
+	const __m256i bias = _mm256_set1_epi16(128);
+	const __m256i alpha = _mm256_set1_epi16(255);
+	const __m256i yGain = _mm256_set1_epi32(Pair(c->Y, c->Rounding));
+	const __m256i rGain = _mm256_set1_epi32(Pair(0, c->CrR));
+	const __m256i gGain = _mm256_set1_epi32(Pair(c->CbG, c->CrG));
+	const __m256i bGain = _mm256_set1_epi32(Pair(c->CbB, 0));
+	const int size = RgbOrder<layout>::Size;
+
+	int x = 0;
+	for(; x + 16 <= width; x += 16)
+	{
+		__m256i luma = _mm256_sub_epi16(_mm256_cvtepu8_epi16(LOAD128(y + x)), yOffset);
+		__m256i y0 = _mm256_madd_epi16(_mm256_unpacklo_epi16(luma, one), yGain);
+		__m256i y1 = _mm256_madd_epi16(_mm256_unpackhi_epi16(luma, one), yGain);
+
+		__m256i uv0, uv1;
+		if(half)
+		{
+			__m128i uv = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(u + x / 2)), _mm_loadl_epi64((const __m128i*)(v + x / 2)));
+			__m256i wide = _mm256_sub_epi16(_mm256_cvtepu8_epi16(uv), bias);
+			uv0 = _mm256_unpacklo_epi32(wide, wide);
+			uv1 = _mm256_unpackhi_epi32(wide, wide);
+		}
+		else
+		{
+			__m128i cu = LOAD128(u + x);
+			__m128i cv = LOAD128(v + x);
+			__m256i lo = _mm256_cvtepu8_epi16(_mm_unpacklo_epi8(cu, cv));
+			__m256i hi = _mm256_cvtepu8_epi16(_mm_unpackhi_epi8(cu, cv));
+			uv0 = _mm256_sub_epi16(_mm256_permute2x128_si256(lo, hi, 0x20), bias);
+			uv1 = _mm256_sub_epi16(_mm256_permute2x128_si256(lo, hi, 0x31), bias);
+		}
+
+		__m256i r = ChannelAVX2(y0, y1, uv0, uv1, rGain);
+		__m256i g = ChannelAVX2(y0, y1, uv0, uv1, gGain);
+		__m256i b = ChannelAVX2(y0, y1, uv0, uv1, bGain);
+		StoreRgbAVX2<layout>(dst + x * size, b, g, r, alpha);
+	}
+
+	// x is even, so the chroma of the rest starts on a whole sample
+	int i = half ? x / 2 : x;
+	YuvToRgbSSE2<layout, half>(y + x, u + i, v + i, dst + x * size, width - x, c);
+}
+
+// 8 pixels of 4 bytes in order across the lanes
+template<int layout>
+TARGET_AVX2 static inline __m256i Load8AVX2(const BYTE* p)
+{
+	if(layout == RL_BGR24)
+	{
+		__m128i px0, px1;
+		Load8SSE2<layout>(p, &px0, &px1);
+		return _mm256_inserti128_si256(_mm256_castsi128_si256(px0), px1, 1);
+	}
+	return LOAD256(p);
+}
+
+TARGET_AVX2 static inline __m256i DotAVX2(__m256i px, __m256i even, __m256i odd, __m256i rounding)
+{
+	const __m256i mask = _mm256_set1_epi32(0x00FF00FF);
+	__m256i sum = _mm256_add_epi32(_mm256_madd_epi16(_mm256_and_si256(px, mask), even), _mm256_madd_epi16(_mm256_srli_epi16(px, 8), odd));
+	return _mm256_srai_epi32(_mm256_add_epi32(sum, rounding), YUV_SHIFT);
+}
+
+// Samples of 16 pixels in order, from the sums of pixels 0..7 and 8..15
+TARGET_AVX2 static inline __m128i Samples16AVX2(__m256i dot0, __m256i dot1, __m256i offset)
+{
+	__m256i s = _mm256_permute4x64_epi64(_mm256_packs_epi32(dot0, dot1), _MM_SHUFFLE(3, 1, 2, 0));
+	s = _mm256_adds_epi16(s, offset);
+	return _mm_packus_epi16(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+}
+
+// Rounded means of neighbouring pixels, 16 pixels to 8 in order
+TARGET_AVX2 static inline __m256i HalvePixelsAVX2(__m256i px0, __m256i px1)
+{
+	const __m256i order = _mm256_set_epi32(7, 6, 3, 2, 5, 4, 1, 0);
+	__m256 a = _mm256_castsi256_ps(px0);
+	__m256 b = _mm256_castsi256_ps(px1);
+	__m256i even = _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+	__m256i odd = _mm256_castps_si256(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+	return _mm256_permutevar8x32_epi32(_mm256_avg_epu8(even, odd), order);
+}
+
+struct RgbToYuvWeightsAVX2
+{
+	__m256i YEven, YOdd, UEven, UOdd, VEven, VOdd, Rounding, YOffset, COffset;
+
+	template<int layout> TARGET_AVX2 void Init(const RgbToYuvCoefs* c)
+	{
+		PixelWeights y = GetPixelWeights<layout>(c->YR, c->YG, c->YB);
+		PixelWeights u = GetPixelWeights<layout>(c->UR, c->UG, c->UB);
+		PixelWeights v = GetPixelWeights<layout>(c->VR, c->VG, c->VB);
+		YEven = _mm256_set1_epi32(y.Even);
+		YOdd = _mm256_set1_epi32(y.Odd);
+		UEven = _mm256_set1_epi32(u.Even);
+		UOdd = _mm256_set1_epi32(u.Odd);
+		VEven = _mm256_set1_epi32(v.Even);
+		VOdd = _mm256_set1_epi32(v.Odd);
+		Rounding = _mm256_set1_epi32(c->Rounding);
+		YOffset = _mm256_set1_epi16(c->YOffset);
+		COffset = _mm256_set1_epi16(128);
+	}
+};
+
+template<int layout>
+TARGET_AVX2 static void RgbToYuvAVX2(const BYTE* rgb, BYTE* y, BYTE* u, BYTE* v, int width, const RgbToYuvCoefs* c)
+{
+	RgbToYuvWeightsAVX2 w;
+	w.Init<layout>(c);
+	const int size = RgbOrder<layout>::Size;
+
+	int x = 0;
+	for(; x + 16 <= width; x += 16)
+	{
+		__m256i px0 = Load8AVX2<layout>(rgb + x * size);
+		__m256i px1 = Load8AVX2<layout>(rgb + (x + 8) * size);
+		STORE128(y + x, Samples16AVX2(DotAVX2(px0, w.YEven, w.YOdd, w.Rounding), DotAVX2(px1, w.YEven, w.YOdd, w.Rounding), w.YOffset));
+		STORE128(u + x, Samples16AVX2(DotAVX2(px0, w.UEven, w.UOdd, w.Rounding), DotAVX2(px1, w.UEven, w.UOdd, w.Rounding), w.COffset));
+		STORE128(v + x, Samples16AVX2(DotAVX2(px0, w.VEven, w.VOdd, w.Rounding), DotAVX2(px1, w.VEven, w.VOdd, w.Rounding), w.COffset));
+	}
+	RgbToYuvSSE2<layout>(rgb + x * size, y + x, u + x, v + x, width - x, c);
+}
+
+template<int layout>
+TARGET_AVX2 static void RgbToYuv420AVX2(const BYTE* rgb0, const BYTE* rgb1, BYTE* y0, BYTE* y1, BYTE* u, BYTE* v,
+	int width, const RgbToYuvCoefs* c)
+{
+	RgbToYuvWeightsAVX2 w;
+	w.Init<layout>(c);
+	const int size = RgbOrder<layout>::Size;
+
+	int x = 0;
+	for(; x + 32 <= width; x += 32)
+	{
+		// Two halves of 16 pixels keep the live registers down to those of one
+		__m256i m[2];
+		for(int i = 0; i < 2; i++)
+		{
+			int at = x + 16 * i;
+			__m256i a0 = Load8AVX2<layout>(rgb0 + at * size);
+			__m256i a1 = Load8AVX2<layout>(rgb0 + (at + 8) * size);
+			__m256i b0 = Load8AVX2<layout>(rgb1 + at * size);
+			__m256i b1 = Load8AVX2<layout>(rgb1 + (at + 8) * size);
+			__m128i luma0 = Samples16AVX2(DotAVX2(a0, w.YEven, w.YOdd, w.Rounding), DotAVX2(a1, w.YEven, w.YOdd, w.Rounding), w.YOffset);
+			__m128i luma1 = Samples16AVX2(DotAVX2(b0, w.YEven, w.YOdd, w.Rounding), DotAVX2(b1, w.YEven, w.YOdd, w.Rounding), w.YOffset);
+			STORE128(y0 + at, luma0);
+			STORE128(y1 + at, luma1);
+			m[i] = HalvePixelsAVX2(_mm256_avg_epu8(a0, b0), _mm256_avg_epu8(a1, b1));
+		}
+		STORE128(u + x / 2, Samples16AVX2(DotAVX2(m[0], w.UEven, w.UOdd, w.Rounding), DotAVX2(m[1], w.UEven, w.UOdd, w.Rounding), w.COffset));
+		STORE128(v + x / 2, Samples16AVX2(DotAVX2(m[0], w.VEven, w.VOdd, w.Rounding), DotAVX2(m[1], w.VEven, w.VOdd, w.Rounding), w.COffset));
+	}
+	RgbToYuv420SSE2<layout>(rgb0 + x * size, rgb1 + x * size, y0 + x, y1 + x, u + x / 2, v + x / 2, width - x, c);
+}
+
+static const RgbRowKernels s_avx2Kernels =
+{
+	"AVX2",
+	{
+		{ YuvToRgbAVX2<RL_BGR24, false>, YuvToRgbAVX2<RL_BGR24, true> },
+		{ YuvToRgbAVX2<RL_BGRA, false>, YuvToRgbAVX2<RL_BGRA, true> },
+		{ YuvToRgbAVX2<RL_RGBA, false>, YuvToRgbAVX2<RL_RGBA, true> },
+		{ YuvToRgbAVX2<RL_ARGB, false>, YuvToRgbAVX2<RL_ARGB, true> }
+	},
+	{ RgbToYuvAVX2<RL_BGR24>, RgbToYuvAVX2<RL_BGRA>, RgbToYuvAVX2<RL_RGBA>, RgbToYuvAVX2<RL_ARGB> },
+	{ RgbToYuv420AVX2<RL_BGR24>, RgbToYuv420AVX2<RL_BGRA>, RgbToYuv420AVX2<RL_RGBA>, RgbToYuv420AVX2<RL_ARGB> }
+};
+
+#endif
+
+const RgbRowKernels* GetRgbRowKernels(int feature)
+{
+	switch(feature)
+	{
+	case 0:
+		return &s_scalarKernels;
+#ifdef CPU_X86
+	case CPU_SSE2:
+		return &s_sse2Kernels;
+	case CPU_AVX2:
+		return &s_avx2Kernels;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+const RgbRowKernels* GetRgbRowKernels(void)
+{
+	int features = GetCpuFeatures();
+#ifdef CPU_X86
+	if(features & CPU_AVX2)
+	{
+		return &s_avx2Kernels;
+	}
+	if(features & CPU_SSE2)
+	{
+		return &s_sse2Kernels;
+	}
+#endif
+	return &s_scalarKernels;
+}
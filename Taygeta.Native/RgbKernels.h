@@ -0,0 +1,97 @@
+#pragma once
+
+#include "NativeLib.h"
+
+// Values match the swscale colorspace constants (Taygeta.Imaging.ColorSpace)
+enum YuvMatrix
+{
+	YM_BT709 = 1,
+	YM_FCC = 4,
+	YM_BT601 = 5,
+	YM_SMPTE240M = 7
+};
+
+enum YuvRange
+{
+	YR_LIMITED = 0,		// Y 16..235, chroma 16..240
+	YR_FULL				// all of 0..255
+};
+
+// Packed RGB byte orders in memory
+enum RgbLayout
+{
+	RL_BGR24 = 0,		// Format24bppRgb, FF_RGB24
+	RL_BGRA,			// Format32bppArgb
+	RL_RGBA,			// FF_RGBA
+	RL_ARGB,			// FF_ARGB
+	RL_COUNT
+};
+
+// YUV -> RGB factors in 13-bit fixed point:
+// R = (Y * (y - YOffset) + Rounding + CrR * (v - 128)) >> 13, G and B alike
+struct YuvToRgbCoefs
+{
+	short YOffset;
+	short Y;
+	short Rounding;
+	short CrR;
+	short CbG;
+	short CrG;
+	short CbB;
+};
+
+NATIVELIB void GetYuvToRgbCoefs(YuvMatrix matrix, YuvRange range, YuvToRgbCoefs* coefs);
+
+// RGB -> YUV factors in 15-bit fixed point:
+// y = ((YR * r + YG * g + YB * b + Rounding) >> 15) + YOffset, u and v alike around 128
+struct RgbToYuvCoefs
+{
+	short YR;
+	short YG;
+	short YB;
+	short UR;
+	short UG;
+	short UB;
+	short VR;
+	short VG;
+	short VB;
+	short YOffset;
+	short Rounding;
+};
+
+NATIVELIB void GetRgbToYuvCoefs(YuvMatrix matrix, YuvRange range, RgbToYuvCoefs* coefs);
+
+// One row of planar samples to packed RGB with opaque alpha. With chroma at half the
+// horizontal resolution pixel x takes chroma sample x / 2.
+typedef void (*YuvToRgbRowFunc)(const BYTE* y, const BYTE* u, const BYTE* v, BYTE* dst, int width, const YuvToRgbCoefs* coefs);
+
+// One row of packed RGB to planar 4:4:4, alpha is ignored
+typedef void (*RgbToYuvRowFunc)(const BYTE* rgb, BYTE* y, BYTE* u, BYTE* v, int width, const RgbToYuvCoefs* coefs);
+
+// Two rows of packed RGB to their luma rows and one row of 4:2:0 chroma. Chroma is taken
+// from the 2x2 means pavgb gives, avg(avg(a, c), avg(b, d)) with a, b the top pair; at
+// odd widths the last column stands alone. For the last row of an odd height pass the
+// same row twice, y1 may then equal y0.
+typedef void (*RgbToYuv420RowFunc)(const BYTE* rgb0, const BYTE* rgb1, BYTE* y0, BYTE* y1, BYTE* u, BYTE* v,
+	int width, const RgbToYuvCoefs* coefs);
+
+// Row kernels of the RGB conversions; like those of YuvKernels.h they read and write
+// exactly the samples they are given. Every instruction set computes the same bytes.
+struct RgbRowKernels
+{
+	const char* Name;
+
+	// By RgbLayout, then full and half horizontal chroma resolution
+	YuvToRgbRowFunc YuvToRgb[RL_COUNT][2];
+
+	// By RgbLayout of the source
+	RgbToYuvRowFunc RgbToYuv[RL_COUNT];
+	RgbToYuv420RowFunc RgbToYuv420[RL_COUNT];
+};
+
+// Kernels of the best instruction set GetCpuFeatures allows
+NATIVELIB const RgbRowKernels* GetRgbRowKernels(void);
+
+// Kernels of one instruction set (a CpuFeature, 0 for the scalar reference), NULL when
+// the library was built without them
+NATIVELIB const RgbRowKernels* GetRgbRowKernels(int feature);
@@ -0,0 +1,373 @@
+#include "RotateKernels.h"
+#include "CpuFeatures.h"
+
+#include <string.h>
+
+#ifdef CPU_X86
+#include <immintrin.h>
+#endif
+
+// Scalar reference kernels, the SIMD ones finish their blocks and rows with them
+
+static void TransposeC(const BYTE* src, int srcPitch, BYTE* dst, int dstPitch, int width, int height)
+{
+	for(int i = 0; i < width; i++)
+	{
+		BYTE* out = dst + (ptrdiff_t)i * dstPitch;
+		for(int j = 0; j < height; j++)
+		{
+			out[j] = src[(ptrdiff_t)j * srcPitch + i];
+		}
+	}
+}
+
+static void TransposePairsC(const BYTE* src, int srcPitch, BYTE* dst, int dstPitch, int width, int height)
+{
+	for(int i = 0; i < width; i++)
+	{
+		BYTE* out = dst + (ptrdiff_t)i * dstPitch;
+		for(int j = 0; j < height; j++)
+		{
+			const BYTE* in = src + (ptrdiff_t)j * srcPitch + 2 * i;
+			out[2 * j] = in[0];
+			out[2 * j + 1] = in[1];
+		}
+	}
+}
+
+static void MirrorC(const BYTE* src, BYTE* dst, int count)
+{
+	for(int i = 0; i < count; i++)
+	{
+		dst[i] = src[count - 1 - i];
+	}
+}
+
+static void MirrorPairsC(const BYTE* src, BYTE* dst, int pairs)
+{
+	for(int i = 0; i < pairs; i++)
+	{
+		dst[2 * i] = src[2 * (pairs - 1 - i)];
+		dst[2 * i + 1] = src[2 * (pairs - 1 - i) + 1];
+	}
+}
+
+// y is the byte of the first luma sample of a macropixel, the second is two bytes on
+template<int y>
+static void MirrorPackedC(const BYTE* src, BYTE* dst, int pairs)
+{
+	for(int i = 0; i < pairs; i++)
+	{
+		const BYTE* in = src + 4 * (pairs - 1 - i);
+		BYTE* out = dst + 4 * i;
+		memcpy(out, in, 4);
+		out[y] = in[y + 2];
+		out[y + 2] = in[y];
+	}
+}
+
+static const RotateKernels s_scalarKernels =
+{
+	"C",
+	TransposeC, TransposePairsC,
+	MirrorC, MirrorPairsC, MirrorPackedC<0>, MirrorPackedC<1>
+};
+
+#ifdef CPU_X86
+
+#define LOAD128(p) _mm_loadu_si128((const __m128i*)(p))
+#define STORE128(p, x) _mm_storeu_si128((__m128i*)(p), x)
+#define LOAD256(p) _mm256_loadu_si256((const __m256i*)(p))
+#define STORE256(p, x) _mm256_storeu_si256((__m256i*)(p), x)
+
+// SSE2. A round interleaves row k with row k + n / 2 of an n-row block, which rotates the
+// bits of (row, column) by one; as many rounds as there are row bits swap rows and columns.
+
+static inline void TransposeRoundSSE2(const __m128i* in, __m128i* out)
+{
+	for(int k = 0; k < 8; k++)
+	{
+		out[2 * k] = _mm_unpacklo_epi8(in[k], in[k + 8]);
+		out[2 * k + 1] = _mm_unpackhi_epi8(in[k], in[k + 8]);
+	}
+}
+
+static inline void TransposePairsRoundSSE2(const __m128i* in, __m128i* out)
+{
+	for(int k = 0; k < 4; k++)
+	{
+		out[2 * k] = _mm_unpacklo_epi16(in[k], in[k + 4]);
+		out[2 * k + 1] = _mm_unpackhi_epi16(in[k], in[k + 4]);
+	}
+}
+
+// 16x16 blocks
+static void TransposeSSE2(const BYTE* src, int srcPitch, BYTE* dst, int dstPitch, int width, int height)
+{
+	int i = 0;
+	for(; i + 16 <= width; i += 16)
+	{
+		int j = 0;
+		for(; j + 16 <= height; j += 16)
+		{
+			__m128i a[16], b[16];
+			for(int k = 0; k < 16; k++)
+			{
+				a[k] = LOAD128(src + (ptrdiff_t)(j + k) * srcPitch + i);
+			}
+			TransposeRoundSSE2(a, b);
+			TransposeRoundSSE2(b, a);
+			TransposeRoundSSE2(a, b);
+			TransposeRoundSSE2(b, a);
+			for(int k = 0; k < 16; k++)
+			{
+				STORE128(dst + (ptrdiff_t)(i + k) * dstPitch + j, a[k]);
+			}
+		}
+		TransposeC(src + (ptrdiff_t)j * srcPitch + i, srcPitch, dst + (ptrdiff_t)i * dstPitch + j, dstPitch, 16, height - j);
+	}
+	TransposeC(src + i, srcPitch, dst + (ptrdiff_t)i * dstPitch, dstPitch, width - i, height);
+}
+
+// 8x8 blocks of pairs
+static void TransposePairsSSE2(const BYTE* src, int srcPitch, BYTE* dst, int dstPitch, int width, int height)
+{
+	int i = 0;
+	for(; i + 8 <= width; i += 8)
+	{
+		int j = 0;
+		for(; j + 8 <= height; j += 8)
+		{
+			__m128i a[8], b[8];
+			for(int k = 0; k < 8; k++)
+			{
+				a[k] = LOAD128(src + (ptrdiff_t)(j + k) * srcPitch + 2 * i);
+			}
+			TransposePairsRoundSSE2(a, b);
+			TransposePairsRoundSSE2(b, a);
+			TransposePairsRoundSSE2(a, b);
+			for(int k = 0; k < 8; k++)
+			{
+				STORE128(dst + (ptrdiff_t)(i + k) * dstPitch + 2 * j, b[k]);
+			}
+		}
+		TransposePairsC(src + (ptrdiff_t)j * srcPitch + 2 * i, srcPitch, dst + (ptrdiff_t)i * dstPitch + 2 * j, dstPitch, 8, height - j);
+	}
+	TransposePairsC(src + 2 * i, srcPitch, dst + (ptrdiff_t)i * dstPitch, dstPitch, width - i, height);
+}
+
+// Reverses the dwords, then the words within them
+static inline __m128i ReverseWordsSSE2(__m128i x)
+{
+	x = _mm_shuffle_epi32(x, _MM_SHUFFLE(0, 1, 2, 3));
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+// Each step reads the 16 bytes that end where the previous ones began
+static void MirrorSSE2(const BYTE* src, BYTE* dst, int count)
+{
+	int i = 0;
+	for(; i + 16 <= count; i += 16)
+	{
+		__m128i x = ReverseWordsSSE2(LOAD128(src + count - 16 - i));
+		STORE128(dst + i, _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8)));
+	}
+	MirrorC(src, dst + i, count - i);
+}
+
+static void MirrorPairsSSE2(const BYTE* src, BYTE* dst, int pairs)
+{
+	int i = 0;
+	for(; i + 8 <= pairs; i += 8)
+	{
+		STORE128(dst + 2 * i, ReverseWordsSSE2(LOAD128(src + 2 * (pairs - 8 - i))));
+	}
+	MirrorPairsC(src, dst + 2 * i, pairs - i);
+}
+
+// Luma from the macropixels with their words swapped, chroma from them as they were
+template<bool uyvy>
+static void MirrorPackedSSE2(const BYTE* src, BYTE* dst, int pairs)
+{
+	const __m128i luma = _mm_set1_epi32(uyvy ? 0xff00ff00 : 0x00ff00ff);
+	int i = 0;
+	for(; i + 4 <= pairs; i += 4)
+	{
+		__m128i x = _mm_shuffle_epi32(LOAD128(src + 4 * (pairs - 4 - i)), _MM_SHUFFLE(0, 1, 2, 3));
+		__m128i swapped = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+		STORE128(dst + 4 * i, _mm_or_si128(_mm_and_si128(swapped, luma), _mm_andnot_si128(luma, x)));
+	}
+	if(uyvy)
+	{
+		MirrorPackedC<1>(src, dst + 4 * i, pairs - i);
+	}
+	else
+	{
+		MirrorPackedC<0>(src, dst + 4 * i, pairs - i);
+	}
+}
+
+static const RotateKernels s_sse2Kernels =
+{
+	"SSE2",
+	TransposeSSE2, TransposePairsSSE2,
+	MirrorSSE2, MirrorPairsSSE2, MirrorPackedSSE2<false>, MirrorPackedSSE2<true>
+};
+
+// AVX2. The rounds run within 128-bit lanes, so one pass transposes two blocks side by
+// side; the mirrors shuffle each lane and swap the lanes.
+
+TARGET_AVX2 static inline void TransposeRoundAVX2(const __m256i* in, __m256i* out)
+{
+	for(int k = 0; k < 8; k++)
+	{
+		out[2 * k] = _mm256_unpacklo_epi8(in[k], in[k + 8]);
+		out[2 * k + 1] = _mm256_unpackhi_epi8(in[k], in[k + 8]);
+	}
+}
+
+TARGET_AVX2 static inline void TransposePairsRoundAVX2(const __m256i* in, __m256i* out)
+{
+	for(int k = 0; k < 4; k++)
+	{
+		out[2 * k] = _mm256_unpacklo_epi16(in[k], in[k + 4]);
+		out[2 * k + 1] = _mm256_unpackhi_epi16(in[k], in[k + 4]);
+	}
+}
+
+// 32x16 blocks, the second 16 columns make rows 16 on of dst
+TARGET_AVX2 static void TransposeAVX2(const BYTE* src, int srcPitch, BYTE* dst, int dstPitch, int width, int height)
+{
+	int i = 0;
+	for(; i + 32 <= width; i += 32)
+	{
+		int j = 0;
+		for(; j + 16 <= height; j += 16)
+		{
+			__m256i a[16], b[16];
+			for(int k = 0; k < 16; k++)
+			{
+				a[k] = LOAD256(src + (ptrdiff_t)(j + k) * srcPitch + i);
+			}
+			TransposeRoundAVX2(a, b);
+			TransposeRoundAVX2(b, a);
+			TransposeRoundAVX2(a, b);
+			TransposeRoundAVX2(b, a);
+			for(int k = 0; k < 16; k++)
+			{
+				STORE128(dst + (ptrdiff_t)(i + k) * dstPitch + j, _mm256_castsi256_si128(a[k]));
+				STORE128(dst + (ptrdiff_t)(i + 16 + k) * dstPitch + j, _mm256_extracti128_si256(a[k], 1));
+			}
+		}
+		TransposeC(src + (ptrdiff_t)j * srcPitch + i, srcPitch, dst + (ptrdiff_t)i * dstPitch + j, dstPitch, 32, height - j);
+	}
+	TransposeSSE2(src + i, srcPitch, dst + (ptrdiff_t)i * dstPitch, dstPitch, width - i, height);
+}
+
+// 16x8 blocks of pairs
+TARGET_AVX2 static void TransposePairsAVX2(const BYTE* src, int srcPitch, BYTE* dst, int dstPitch, int width, int height)
+{
+	int i = 0;
+	for(; i + 16 <= width; i += 16)
+	{
+		int j = 0;
+		for(; j + 8 <= height; j += 8)
+		{
+			__m256i a[8], b[8];
+			for(int k = 0; k < 8; k++)
+			{
+				a[k] = LOAD256(src + (ptrdiff_t)(j + k) * srcPitch + 2 * i);
+			}
+			TransposePairsRoundAVX2(a, b);
+			TransposePairsRoundAVX2(b, a);
+			TransposePairsRoundAVX2(a, b);
+			for(int k = 0; k < 8; k++)
+			{
+				STORE128(dst + (ptrdiff_t)(i + k) * dstPitch + 2 * j, _mm256_castsi256_si128(b[k]));
+				STORE128(dst + (ptrdiff_t)(i + 8 + k) * dstPitch + 2 * j, _mm256_extracti128_si256(b[k], 1));
+			}
+		}
+		TransposePairsC(src + (ptrdiff_t)j * srcPitch + 2 * i, srcPitch, dst + (ptrdiff_t)i * dstPitch + 2 * j, dstPitch, 16, height - j);
+	}
+	TransposePairsSSE2(src + 2 * i, srcPitch, dst + (ptrdiff_t)i * dstPitch, dstPitch, width - i, height);
+}
+
+// 32 bytes per step from the end of src, order reversing the units of a lane. Returns the
+// bytes done.
+TARGET_AVX2 static inline int MirrorBlocksAVX2(const BYTE* src, BYTE* dst, int bytes, __m128i order)
+{
+	__m256i shuffle = _mm256_broadcastsi128_si256(order);
+	int i = 0;
+	for(; i + 32 <= bytes; i += 32)
+	{
+		__m256i x = _mm256_shuffle_epi8(LOAD256(src + bytes - 32 - i), shuffle);
+		STORE256(dst + i, _mm256_permute4x64_epi64(x, _MM_SHUFFLE(1, 0, 3, 2)));
+	}
+	return i;
+}
+
+TARGET_AVX2 static void MirrorAVX2(const BYTE* src, BYTE* dst, int count)
+{
+	int i = MirrorBlocksAVX2(src, dst, count, _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+	MirrorSSE2(src, dst + i, count - i);
+}
+
+TARGET_AVX2 static void MirrorPairsAVX2(const BYTE* src, BYTE* dst, int pairs)
+{
+	int i = MirrorBlocksAVX2(src, dst, 2 * pairs, _mm_setr_epi8(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1));
+	MirrorPairsSSE2(src, dst + i, pairs - i / 2);
+}
+
+TARGET_AVX2 static void MirrorYuy2AVX2(const BYTE* src, BYTE* dst, int pairs)
+{
+	int i = MirrorBlocksAVX2(src, dst, 4 * pairs, _mm_setr_epi8(14, 13, 12, 15, 10, 9, 8, 11, 6, 5, 4, 7, 2, 1, 0, 3));
+	MirrorPackedSSE2<false>(src, dst + i, pairs - i / 4);
+}
+
+TARGET_AVX2 static void MirrorUyvyAVX2(const BYTE* src, BYTE* dst, int pairs)
+{
+	int i = MirrorBlocksAVX2(src, dst, 4 * pairs, _mm_setr_epi8(12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1));
+	MirrorPackedSSE2<true>(src, dst + i, pairs - i / 4);
+}
+
+static const RotateKernels s_avx2Kernels =
+{
+	"AVX2",
+	TransposeAVX2, TransposePairsAVX2,
+	MirrorAVX2, MirrorPairsAVX2, MirrorYuy2AVX2, MirrorUyvyAVX2
+};
+
+#endif
+
+const RotateKernels* GetRotateKernels(int feature)
+{
+	switch(feature)
+	{
+	case 0:
+		return &s_scalarKernels;
+#ifdef CPU_X86
+	case CPU_SSE2:
+		return &s_sse2Kernels;
+	case CPU_AVX2:
+		return &s_avx2Kernels;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+const RotateKernels* GetRotateKernels(void)
+{
+#ifdef CPU_X86
+	int features = GetCpuFeatures();
+	if(features & CPU_AVX2)
+	{
+		return &s_avx2Kernels;
+	}
+	if(features & CPU_SSE2)
+	{
+		return &s_sse2Kernels;
+	}
+#endif
+	return &s_scalarKernels;
+}
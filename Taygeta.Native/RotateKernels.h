@@ -0,0 +1,30 @@
+#pragma once
+
+#include "NativeLib.h"
+
+// Block and row kernels behind RotateFrame. Pitches may be negative to walk rows upwards;
+// blocks and rows must not overlap.
+struct RotateKernels
+{
+	const char* Name;
+
+	// Row i of dst is column i of src: dst[i * dstPitch + j] = src[j * srcPitch + i] for
+	// i < width, j < height. TransposePairs moves byte pairs (NV12 chroma), width and the
+	// indices counting pairs.
+	void (*Transpose)(const BYTE* src, int srcPitch, BYTE* dst, int dstPitch, int width, int height);
+	void (*TransposePairs)(const BYTE* src, int srcPitch, BYTE* dst, int dstPitch, int width, int height);
+
+	// Rows in reverse order of samples, of byte pairs, and of YUY2 or UYVY macropixels with
+	// their two luma samples swapped
+	void (*Mirror)(const BYTE* src, BYTE* dst, int count);
+	void (*MirrorPairs)(const BYTE* src, BYTE* dst, int pairs);
+	void (*MirrorYuy2)(const BYTE* src, BYTE* dst, int pairs);
+	void (*MirrorUyvy)(const BYTE* src, BYTE* dst, int pairs);
+};
+
+// Kernels of the best instruction set GetCpuFeatures allows
+NATIVELIB const RotateKernels* GetRotateKernels(void);
+
+// Kernels of one instruction set (a CpuFeature, 0 for the scalar reference), NULL when
+// the library was built without them
+NATIVELIB const RotateKernels* GetRotateKernels(int feature);
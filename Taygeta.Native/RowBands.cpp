@@ -0,0 +1,62 @@
+#include "RowBands.h"
+
+#include <thread>
+#include <vector>
+
+int GetRowBandCount(int width, int rows, int threads)
+{
+	if(threads <= 0)
+	{
+		threads = (int)std::thread::hardware_concurrency();
+	}
+
+	long long pixels = (long long)width * rows;
+	long long bands = pixels / ROW_BAND_MIN_PIXELS;
+	if(bands > threads)
+	{
+		bands = threads;
+	}
+	if(bands > rows)
+	{
+		bands = rows;
+	}
+	return bands < 1 ? 1 : (int)bands;
+}
+
+static void RunBand(IRowBandTask* task, int band, int first, int count)
+{
+	task->RunRows(band, first, count);
+}
+
+void RunRowBands(IRowBandTask* task, int rows, int bands, int alignment)
+{
+	int size = (rows + bands - 1) / bands;
+	size = (size + alignment - 1) / alignment * alignment;
+	if(bands <= 1 || size >= rows)
+	{
+		task->RunRows(0, 0, rows);
+		return;
+	}
+
+	std::vector<std::thread> workers;
+	workers.reserve(bands);
+	int band = 1;
+	for(int first = size; first < rows; first += size, band++)
+	{
+		int count = rows - first < size ? rows - first : size;
+		try
+		{
+			workers.push_back(std::thread(RunBand, task, band, first, count));
+		}
+		catch(...)
+		{
+			task->RunRows(band, first, count);
+		}
+	}
+
+	task->RunRows(0, 0, size);
+	for(size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "NativeLib.h"
+
+// Rows of a frame operation run in horizontal bands, one per thread
+class NATIVELIB IRowBandTask
+{
+public:
+	virtual ~IRowBandTask(void) {}
+
+	// Runs on the thread of the band and must not throw; allocate what bands need up front
+	virtual void RunRows(int band, int first, int count) = 0;
+};
+
+// Bands worth running for rows of the given width: at most threads (0 for one per
+// processor), each of at least ROW_BAND_MIN_PIXELS
+NATIVELIB int GetRowBandCount(int width, int rows, int threads);
+
+#define ROW_BAND_MIN_PIXELS (64 * 1024)
+
+// Splits rows into bands starting on multiples of alignment and runs them, the first on
+// the calling thread. Bands whose thread cannot be started run on the caller as well.
+NATIVELIB void RunRowBands(IRowBandTask* task, int rows, int bands, int alignment);
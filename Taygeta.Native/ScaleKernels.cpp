@@ -0,0 +1,424 @@
+#include "ScaleKernels.h"
+#include "CpuFeatures.h"
+
+#include <string.h>
+
+#ifdef CPU_X86
+#include <immintrin.h>
+#endif
+
+#define H_SHIFT (SCALE_WEIGHT_BITS - SCALE_INTER_BITS)
+#define V_SHIFT (SCALE_WEIGHT_BITS + SCALE_INTER_BITS)
+
+static void HorizontalC(const BYTE* src, short* dst, int width, const int* starts, const short* weights, int taps)
+{
+	for(int x = 0; x < width; x++, weights += taps)
+	{
+		const BYTE* p = src + starts[x];
+		int sum = 0;
+		for(int k = 0; k < taps; k++)
+		{
+			sum += p[k] * weights[k];
+		}
+		int v = (sum + (1 << (H_SHIFT - 1))) >> H_SHIFT;
+		dst[x] = (short)(v < -32768 ? -32768 : v > 32767 ? 32767 : v);
+	}
+}
+
+static inline BYTE VerticalSample(const short* const* rows, const short* weights, int taps, int x)
+{
+	int sum = 0;
+	for(int k = 0; k < taps; k++)
+	{
+		sum += rows[k][x] * weights[k];
+	}
+	int v = (sum + (1 << (V_SHIFT - 1))) >> V_SHIFT;
+	return (BYTE)(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+static void VerticalC(const short* const* rows, const short* weights, int taps, BYTE* dst, int width)
+{
+	for(int x = 0; x < width; x++)
+	{
+		dst[x] = VerticalSample(rows, weights, taps, x);
+	}
+}
+
+// 16-bit sums of positive or negative weights reach 2^30 and intermediates 2^24, the
+// vertical sums take 64 bits
+static void Horizontal16C(const unsigned short* src, int* dst, int width, const int* starts, const short* weights, int taps)
+{
+	for(int x = 0; x < width; x++, weights += taps)
+	{
+		const unsigned short* p = src + starts[x];
+		int sum = 0;
+		for(int k = 0; k < taps; k++)
+		{
+			sum += p[k] * weights[k];
+		}
+		dst[x] = (sum + (1 << (H_SHIFT - 1))) >> H_SHIFT;
+	}
+}
+
+static void Vertical16C(const int* const* rows, const short* weights, int taps, unsigned short* dst, int width)
+{
+	for(int x = 0; x < width; x++)
+	{
+		long long sum = 0;
+		for(int k = 0; k < taps; k++)
+		{
+			sum += (long long)rows[k][x] * weights[k];
+		}
+		long long v = (sum + (1 << (V_SHIFT - 1))) >> V_SHIFT;
+		dst[x] = (unsigned short)(v < 0 ? 0 : v > 65535 ? 65535 : v);
+	}
+}
+
+static const ScaleRowKernels s_scalarKernels =
+{
+	"C",
+	NULL,
+	HorizontalC,
+	VerticalC,
+	Horizontal16C,
+	Vertical16C
+};
+
+#ifdef CPU_X86
+
+#define LOAD128(p) _mm_loadu_si128((const __m128i*)(p))
+#define LOAD64(p) _mm_loadl_epi64((const __m128i*)(p))
+
+static inline __m128i Load32(const BYTE* p)
+{
+	int value;
+	memcpy(&value, p, 4);
+	return _mm_cvtsi32_si128(value);
+}
+
+// 16-bit pair (lo, hi) in every 32-bit element, the pmaddwd factors of (sample, other)
+static inline int Pair(short lo, short hi)
+{
+	return (int)(((unsigned)(unsigned short)hi << 16) | (unsigned short)lo);
+}
+
+// Partial sums of the taps of one output, to be added across the register
+static inline __m128i DotSSE2(const BYTE* p, const short* w, int taps)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i sum = _mm_setzero_si128();
+	int k = 0;
+	for(; k + 8 <= taps; k += 8)
+	{
+		sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi8(LOAD64(p + k), zero), LOAD128(w + k)));
+	}
+	if(k < taps)
+	{
+		sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi8(Load32(p + k), zero), LOAD64(w + k)));
+	}
+	return sum;
+}
+
+// Two outputs of four taps each in one register, their weights being adjacent
+static inline __m128i Dot4x2SSE2(const BYTE* p0, const BYTE* p1, const short* w)
+{
+	__m128i px = _mm_unpacklo_epi32(Load32(p0), Load32(p1));
+	return _mm_madd_epi16(_mm_unpacklo_epi8(px, _mm_setzero_si128()), LOAD128(w));
+}
+
+// Four outputs per step
+static void HorizontalSSE2(const BYTE* src, short* dst, int width, const int* starts, const short* weights, int taps)
+{
+	__m128i rounding = _mm_set1_epi32(1 << (H_SHIFT - 1));
+	int x = 0;
+	if(taps == 4)
+	{
+		for(; x + 4 <= width; x += 4, weights += 16)
+		{
+			__m128i s01 = Dot4x2SSE2(src + starts[x], src + starts[x + 1], weights);
+			__m128i s23 = Dot4x2SSE2(src + starts[x + 2], src + starts[x + 3], weights + 8);
+			__m128 even = _mm_shuffle_ps(_mm_castsi128_ps(s01), _mm_castsi128_ps(s23), _MM_SHUFFLE(2, 0, 2, 0));
+			__m128 odd = _mm_shuffle_ps(_mm_castsi128_ps(s01), _mm_castsi128_ps(s23), _MM_SHUFFLE(3, 1, 3, 1));
+			__m128i sum = _mm_add_epi32(_mm_castps_si128(even), _mm_castps_si128(odd));
+			sum = _mm_srai_epi32(_mm_add_epi32(sum, rounding), H_SHIFT);
+			_mm_storel_epi64((__m128i*)(dst + x), _mm_packs_epi32(sum, sum));
+		}
+	}
+
+	for(; x + 4 <= width; x += 4, weights += 4 * taps)
+	{
+		__m128i s0 = DotSSE2(src + starts[x], weights, taps);
+		__m128i s1 = DotSSE2(src + starts[x + 1], weights + taps, taps);
+		__m128i s2 = DotSSE2(src + starts[x + 2], weights + 2 * taps, taps);
+		__m128i s3 = DotSSE2(src + starts[x + 3], weights + 3 * taps, taps);
+
+		__m128i s01 = _mm_add_epi32(_mm_unpacklo_epi32(s0, s1), _mm_unpackhi_epi32(s0, s1));
+		__m128i s23 = _mm_add_epi32(_mm_unpacklo_epi32(s2, s3), _mm_unpackhi_epi32(s2, s3));
+		__m128i sum = _mm_add_epi32(_mm_unpacklo_epi64(s01, s23), _mm_unpackhi_epi64(s01, s23));
+		sum = _mm_srai_epi32(_mm_add_epi32(sum, rounding), H_SHIFT);
+		_mm_storel_epi64((__m128i*)(dst + x), _mm_packs_epi32(sum, sum));
+	}
+	HorizontalC(src, dst + x, width - x, starts + x, weights, taps);
+}
+
+// Eight outputs per step, rows taken in pairs
+static void VerticalSSE2(const short* const* rows, const short* weights, int taps, BYTE* dst, int width)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i rounding = _mm_set1_epi32(1 << (V_SHIFT - 1));
+	int x = 0;
+	for(; x + 8 <= width; x += 8)
+	{
+		__m128i lo = _mm_setzero_si128();
+		__m128i hi = _mm_setzero_si128();
+		int k = 0;
+		for(; k + 2 <= taps; k += 2)
+		{
+			__m128i a = LOAD128(rows[k] + x);
+			__m128i b = LOAD128(rows[k + 1] + x);
+			__m128i w = _mm_set1_epi32(Pair(weights[k], weights[k + 1]));
+			lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+			hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+		}
+		if(k < taps)
+		{
+			__m128i a = LOAD128(rows[k] + x);
+			__m128i w = _mm_set1_epi32(Pair(weights[k], 0));
+			lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, zero), w));
+			hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, zero), w));
+		}
+
+		lo = _mm_srai_epi32(_mm_add_epi32(lo, rounding), V_SHIFT);
+		hi = _mm_srai_epi32(_mm_add_epi32(hi, rounding), V_SHIFT);
+		__m128i px = _mm_packs_epi32(lo, hi);
+		_mm_storel_epi64((__m128i*)(dst + x), _mm_packus_epi16(px, px));
+	}
+
+	for(; x < width; x++)
+	{
+		dst[x] = VerticalSample(rows, weights, taps, x);
+	}
+}
+
+static const ScaleRowKernels s_sse2Kernels =
+{
+	"SSE2",
+	NULL,
+	HorizontalSSE2,
+	VerticalSSE2,
+	Horizontal16C,
+	Vertical16C
+};
+
+// Groups of eight outputs of four or eight taps whose samples lie within 16 bytes from the
+// first output of each half are filtered from one 16-byte load per half. Their weights are
+// reordered by pairs of taps, the pairs of all eight outputs together, so every pmaddwd
+// adds a pair to each output and no sums need adding across the register.
+static inline bool IsWindowGroup(const int* starts, int taps)
+{
+	return (taps == 4 || taps == 8) && starts[3] - starts[0] <= 16 - taps && starts[7] - starts[4] <= 16 - taps;
+}
+
+static void PackAVX2(const int* starts, short* weights, int width, int taps)
+{
+	short group[64];
+	for(int x = 0; x + 8 <= width; x += 8, weights += 8 * taps)
+	{
+		if(IsWindowGroup(starts + x, taps))
+		{
+			for(int i = 0; i < 8; i++)
+			{
+				for(int k = 0; k < taps; k++)
+				{
+					group[((k >> 1) * 8 + i) * 2 + (k & 1)] = weights[i * taps + k];
+				}
+			}
+			memcpy(weights, group, 8 * taps * sizeof(short));
+		}
+	}
+}
+
+TARGET_AVX2 static inline __m256i ShiftSumsAVX2(__m256i sum)
+{
+	return _mm256_srai_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(1 << (H_SHIFT - 1))), H_SHIFT);
+}
+
+TARGET_AVX2 static inline void StoreSums8AVX2(short* dst, __m256i sum)
+{
+	sum = ShiftSumsAVX2(sum);
+	_mm_storeu_si128((__m128i*)dst, _mm_packs_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1)));
+}
+
+// Sums of eight outputs of a window group
+template<int taps>
+TARGET_AVX2 static inline __m256i WindowAVX2(const BYTE* src, const int* starts, const short* weights)
+{
+	__m256i offsets = _mm256_loadu_si256((const __m256i*)starts);
+	offsets = _mm256_sub_epi32(offsets, _mm256_permutevar8x32_epi32(offsets, _mm256_setr_epi32(0, 0, 0, 0, 4, 4, 4, 4)));
+
+	// Bytes 0 and 2 of each output pick its pair of samples, 1 and 3 zero extend them
+	__m256i pick = _mm256_add_epi32(_mm256_or_si256(offsets, _mm256_slli_epi32(offsets, 16)), _mm256_set1_epi32(0x80018000));
+	__m256i px = _mm256_inserti128_si256(_mm256_castsi128_si256(LOAD128(src + starts[0])), LOAD128(src + starts[4]), 1);
+	__m256i sum = _mm256_madd_epi16(_mm256_shuffle_epi8(px, pick), _mm256_loadu_si256((const __m256i*)weights));
+	for(int k = 2; k < taps; k += 2)
+	{
+		pick = _mm256_add_epi32(pick, _mm256_set1_epi32(0x00020002));
+		sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_shuffle_epi8(px, pick), _mm256_loadu_si256((const __m256i*)(weights + 8 * k))));
+	}
+	return sum;
+}
+
+// Window groups in pairs where they can, the packs of both store at once
+template<int taps>
+TARGET_AVX2 static int WindowsAVX2(const BYTE* src, short* dst, int width, const int* starts, const short* weights)
+{
+	int x = 0;
+	for(; x + 16 <= width && IsWindowGroup(starts + x, taps) && IsWindowGroup(starts + x + 8, taps); x += 16, weights += 16 * taps)
+	{
+		__m256i a = ShiftSumsAVX2(WindowAVX2<taps>(src, starts + x, weights));
+		__m256i b = ShiftSumsAVX2(WindowAVX2<taps>(src, starts + x + 8, weights + 8 * taps));
+		_mm256_storeu_si256((__m256i*)(dst + x), _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), _MM_SHUFFLE(3, 1, 2, 0)));
+	}
+	if(x + 8 <= width && IsWindowGroup(starts + x, taps))
+	{
+		StoreSums8AVX2(dst + x, WindowAVX2<taps>(src, starts + x, weights));
+		x += 8;
+	}
+	return x;
+}
+
+// Taps of two outputs as words, those of the first in the low lane
+TARGET_AVX2 static inline __m256i Dot2AVX2(const BYTE* p0, const BYTE* p1, const short* w0, const short* w1, int taps)
+{
+	__m256i sum = _mm256_setzero_si256();
+	int k = 0;
+	for(; k + 8 <= taps; k += 8)
+	{
+		__m256i px = _mm256_cvtepu8_epi16(_mm_unpacklo_epi64(LOAD64(p0 + k), LOAD64(p1 + k)));
+		__m256i w = _mm256_inserti128_si256(_mm256_castsi128_si256(LOAD128(w0 + k)), LOAD128(w1 + k), 1);
+		sum = _mm256_add_epi32(sum, _mm256_madd_epi16(px, w));
+	}
+	if(k < taps)
+	{
+		__m256i px = _mm256_cvtepu8_epi16(_mm_unpacklo_epi64(Load32(p0 + k), Load32(p1 + k)));
+		__m256i w = _mm256_inserti128_si256(_mm256_castsi128_si256(LOAD64(w0 + k)), LOAD64(w1 + k), 1);
+		sum = _mm256_add_epi32(sum, _mm256_madd_epi16(px, w));
+	}
+	return sum;
+}
+
+// Eight outputs per step
+TARGET_AVX2 static void HorizontalAVX2(const BYTE* src, short* dst, int width, const int* starts, const short* weights, int taps)
+{
+	__m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	int x = 0;
+	while(x + 8 <= width)
+	{
+		const int* s = starts + x;
+		if(IsWindowGroup(s, taps))
+		{
+			int done = taps == 4 ? WindowsAVX2<4>(src, dst + x, width - x, s, weights) : WindowsAVX2<8>(src, dst + x, width - x, s, weights);
+			x += done;
+			weights += done * taps;
+			continue;
+		}
+
+		__m256i m01 = Dot2AVX2(src + s[0], src + s[1], weights, weights + taps, taps);
+		__m256i m23 = Dot2AVX2(src + s[2], src + s[3], weights + 2 * taps, weights + 3 * taps, taps);
+		__m256i m45 = Dot2AVX2(src + s[4], src + s[5], weights + 4 * taps, weights + 5 * taps, taps);
+		__m256i m67 = Dot2AVX2(src + s[6], src + s[7], weights + 6 * taps, weights + 7 * taps, taps);
+
+		// Even outputs in the low lane, odd ones in the high one
+		__m256i sum = _mm256_hadd_epi32(_mm256_hadd_epi32(m01, m23), _mm256_hadd_epi32(m45, m67));
+		StoreSums8AVX2(dst + x, _mm256_permutevar8x32_epi32(sum, order));
+		x += 8;
+		weights += 8 * taps;
+	}
+	HorizontalSSE2(src, dst + x, width - x, starts + x, weights, taps);
+}
+
+// Sixteen outputs per step
+TARGET_AVX2 static void VerticalAVX2(const short* const* rows, const short* weights, int taps, BYTE* dst, int width)
+{
+	__m256i zero = _mm256_setzero_si256();
+	__m256i rounding = _mm256_set1_epi32(1 << (V_SHIFT - 1));
+	int x = 0;
+	for(; x + 16 <= width; x += 16)
+	{
+		__m256i lo = _mm256_setzero_si256();
+		__m256i hi = _mm256_setzero_si256();
+		int k = 0;
+		for(; k + 2 <= taps; k += 2)
+		{
+			__m256i a = _mm256_loadu_si256((const __m256i*)(rows[k] + x));
+			__m256i b = _mm256_loadu_si256((const __m256i*)(rows[k + 1] + x));
+			__m256i w = _mm256_set1_epi32(Pair(weights[k], weights[k + 1]));
+			lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), w));
+			hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), w));
+		}
+		if(k < taps)
+		{
+			__m256i a = _mm256_loadu_si256((const __m256i*)(rows[k] + x));
+			__m256i w = _mm256_set1_epi32(Pair(weights[k], 0));
+			lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, zero), w));
+			hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, zero), w));
+		}
+
+		// The unpacks split each lane, packing them back keeps the order
+		lo = _mm256_srai_epi32(_mm256_add_epi32(lo, rounding), V_SHIFT);
+		hi = _mm256_srai_epi32(_mm256_add_epi32(hi, rounding), V_SHIFT);
+		__m256i px = _mm256_packs_epi32(lo, hi);
+		px = _mm256_permute4x64_epi64(_mm256_packus_epi16(px, px), _MM_SHUFFLE(3, 1, 2, 0));
+		_mm_storeu_si128((__m128i*)(dst + x), _mm256_castsi256_si128(px));
+	}
+
+	for(; x < width; x++)
+	{
+		dst[x] = VerticalSample(rows, weights, taps, x);
+	}
+}
+
+static const ScaleRowKernels s_avx2Kernels =
+{
+	"AVX2",
+	PackAVX2,
+	HorizontalAVX2,
+	VerticalAVX2,
+	Horizontal16C,
+	Vertical16C
+};
+
+#endif
+
+const ScaleRowKernels* GetScaleRowKernels(int feature)
+{
+	switch(feature)
+	{
+	case 0:
+		return &s_scalarKernels;
+#ifdef CPU_X86
+	case CPU_SSE2:
+		return &s_sse2Kernels;
+	case CPU_AVX2:
+		return &s_avx2Kernels;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+const ScaleRowKernels* GetScaleRowKernels(void)
+{
+#ifdef CPU_X86
+	int features = GetCpuFeatures();
+	if(features & CPU_AVX2)
+	{
+		return &s_avx2Kernels;
+	}
+	if(features & CPU_SSE2)
+	{
+		return &s_sse2Kernels;
+	}
+#endif
+	return &s_scalarKernels;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "NativeLib.h"
+
+// Fraction bits of filter weights, each output's weights sum to exactly 1 << SCALE_WEIGHT_BITS
+#define SCALE_WEIGHT_BITS 14
+
+// Fraction bits of the samples between the horizontal and vertical passes
+#define SCALE_INTER_BITS 7
+
+// Horizontal pass: dst[x] = (sum of src[starts[x] + k] * weights[x * taps + k] over k < taps,
+// rounded) >> (SCALE_WEIGHT_BITS - SCALE_INTER_BITS), saturated to 16 bits where filters with
+// negative lobes overshoot. taps is a multiple of 4 and src must be readable up to
+// starts[x] + taps + 16 for every x. The weights are in the order PackHorizontal left them,
+// and calls may start at any multiple of 8 outputs into the filter.
+typedef void (*ScaleHorizontalFunc)(const BYTE* src, short* dst, int width, const int* starts, const short* weights, int taps);
+
+// Reorders the weights of all width outputs of a horizontal filter, in place, into the
+// order Horizontal reads them
+typedef void (*ScalePackFunc)(const int* starts, short* weights, int width, int taps);
+
+// Vertical pass: dst[x] = the sum of rows[k][x] * weights[k] over k < taps, rounded off the
+// fraction bits of both passes and clamped to 0..255
+typedef void (*ScaleVerticalFunc)(const short* const* rows, const short* weights, int taps, BYTE* dst, int width);
+
+// The same passes over 16-bit samples, through 32-bit intermediates clamped to 0..65535
+typedef void (*ScaleHorizontal16Func)(const unsigned short* src, int* dst, int width, const int* starts, const short* weights, int taps);
+typedef void (*ScaleVertical16Func)(const int* const* rows, const short* weights, int taps, unsigned short* dst, int width);
+
+// Filter kernels of ScaleFrame; every instruction set computes the same samples. The 16-bit
+// passes are scalar in every table.
+struct ScaleRowKernels
+{
+	const char* Name;
+	ScalePackFunc PackHorizontal;		// NULL when Horizontal takes the weights as they are
+	ScaleHorizontalFunc Horizontal;
+	ScaleVerticalFunc Vertical;
+	ScaleHorizontal16Func Horizontal16;
+	ScaleVertical16Func Vertical16;
+};
+
+// Kernels of the best instruction set GetCpuFeatures allows
+NATIVELIB const ScaleRowKernels* GetScaleRowKernels(void);
+
+// Kernels of one instruction set (a CpuFeature, 0 for the scalar reference), NULL when
+// the library was built without them
+NATIVELIB const ScaleRowKernels* GetScaleRowKernels(int feature);
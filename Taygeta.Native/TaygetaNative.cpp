@@ -0,0 +1,912 @@
+#include "TaygetaNative.h"
+#include "RawFrameFile.h"
+#include "FrameCopy.h"
+#include "YuvConvert.h"
+#include "RgbConvert.h"
+#include "FrameScale.h"
+#include "FrameReduce.h"
+#include "FrameRotate.h"
+#include "FrameTone.h"
+#include "CpuFeatures.h"
+
+#include <new>
+
+#ifdef _WIN32
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+static THREAD_LOCAL const char* s_lastError = NULL;
+
+// Error messages are string literals, so keeping the pointer is enough
+static void SetError(const char* message)
+{
+	s_lastError = message;
+}
+
+const char* NATIVECALL tn_get_last_error(void)
+{
+	return s_lastError ? s_lastError : "";
+}
+
+void* NATIVECALL tn_pool_alloc(size_t size)
+{
+	try
+	{
+		return CFramePool::GetDefault()->Alloc(size);
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+		return NULL;
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+		return NULL;
+	}
+}
+
+void NATIVECALL tn_pool_free(void* data)
+{
+	CFramePool::GetDefault()->Free((BYTE*)data);
+}
+
+void NATIVECALL tn_pool_trim(void)
+{
+	CFramePool::GetDefault()->Trim();
+}
+
+void NATIVECALL tn_pool_set_max_idle(long long bytes)
+{
+	CFramePool::GetDefault()->SetMaxIdleBytes(bytes);
+}
+
+int NATIVECALL tn_pool_set_allocator(int largePages, int numaLocal)
+{
+	try
+	{
+		IFrameAllocator* allocator = NULL;
+		if(largePages != LP_NONE || numaLocal)
+		{
+			allocator = CSystemFrameAllocator::GetDefault((LargePageMode)largePages, numaLocal != 0);
+		}
+		CFramePool::GetDefault()->SetAllocator(allocator);
+		return 0;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+		return -1;
+	}
+}
+
+void NATIVECALL tn_pool_get_stats(FramePoolStats* stats)
+{
+	CFramePool::GetDefault()->GetStats(stats);
+}
+
+void NATIVECALL tn_frame_release(CPlanarFrame* frame)
+{
+	if(frame)
+	{
+		frame->Release();
+	}
+}
+
+void NATIVECALL tn_frame_get_info(CPlanarFrame* frame, FrameInfo* info)
+{
+	info->Width = frame->GetWidth();
+	info->Height = frame->GetHeight();
+	info->Format = frame->GetFormat();
+	info->Planes = frame->GetPlaneCount();
+	for(int i = 0; i < 4; i++)
+	{
+		info->Data[i] = i < info->Planes ? frame->GetPlane(i) : NULL;
+		info->Pitches[i] = i < info->Planes ? frame->GetPitch(i) : 0;
+		info->Lines[i] = i < info->Planes ? frame->GetLines(i) : 0;
+	}
+}
+
+struct AdoptedPlanes
+{
+	int Count;
+	BYTE* Planes[FRAME_MAX_PLANES];
+};
+
+static void FreeAdoptedPlanes(BYTE*, void* context)
+{
+	AdoptedPlanes* adopted = (AdoptedPlanes*)context;
+	for(int i = 0; i < adopted->Count; i++)
+	{
+		CFramePool::GetDefault()->Free(adopted->Planes[i]);
+	}
+	delete adopted;
+}
+
+CPlanarFrame* NATIVECALL tn_frame_adopt(int format, int width, int height, void* const* planes, const int* pitches, const int* lines)
+{
+	AdoptedPlanes* adopted = NULL;
+	CPlaneBuffer* storage = NULL;
+	try
+	{
+		adopted = new AdoptedPlanes();
+		adopted->Count = GetFrameFormatDesc((FrameFormat)format)->Planes;
+		for(int i = 0; i < adopted->Count; i++)
+		{
+			if(pitches[i] < GetPlaneRowBytes((FrameFormat)format, i, width) || lines[i] < GetPlaneLines((FrameFormat)format, i, height))
+			{
+				throw "Planes are smaller than the frame format needs";
+			}
+			adopted->Planes[i] = (BYTE*)planes[i];
+		}
+
+		storage = CPlaneBuffer::Wrap(adopted->Planes[0], 0, FreeAdoptedPlanes, adopted);
+		CPlanarFrame* frame = CPlanarFrame::Wrap(width, height, (FrameFormat)format, adopted->Planes, pitches, storage);
+		storage->Release();
+		return frame;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+
+	// The planes stay with the caller on failure
+	if(storage)
+	{
+		adopted->Count = 0;
+		storage->Release();
+	}
+	else
+	{
+		delete adopted;
+	}
+	return NULL;
+}
+
+CPlanarFrame* NATIVECALL tn_frame_clone(CPlanarFrame* frame)
+{
+	try
+	{
+		return frame->Clone();
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	return NULL;
+}
+
+CPlanarFrame* NATIVECALL tn_frame_clone_shared(CPlanarFrame* frame)
+{
+	try
+	{
+		return frame->CloneShared();
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	return NULL;
+}
+
+int NATIVECALL tn_frame_lease_write(CPlanarFrame* frame)
+{
+	try
+	{
+		return frame->LeaseWrite() ? 1 : 0;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	return -1;
+}
+
+CPlanarFrame* NATIVECALL tn_frame_flip(CPlanarFrame* frame)
+{
+	try
+	{
+		return frame->CreateFlippedView();
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	return NULL;
+}
+
+void NATIVECALL tn_copy_plane(void* dst, int dstPitch, const void* src, int srcPitch, int rowBytes, int lines)
+{
+	CopyPlane((BYTE*)dst, dstPitch, (const BYTE*)src, srcPitch, rowBytes, lines);
+}
+
+int NATIVECALL tn_get_cpu_features(void)
+{
+	return GetCpuFeatures();
+}
+
+void NATIVECALL tn_set_cpu_feature_mask(int mask)
+{
+	SetCpuFeatureMask(mask);
+}
+
+int NATIVECALL tn_can_convert(int srcFormat, int dstFormat)
+{
+	return CanConvertYuv((FrameFormat)srcFormat, (FrameFormat)dstFormat) ? 1 : 0;
+}
+
+// Whether planes of the given pitches and lines hold the native layout of the format
+static bool HoldsFormat(FrameFormat format, int width, int height, const int* pitches, const int* lines)
+{
+	for(int i = 0; i < GetFrameFormatDesc(format)->Planes; i++)
+	{
+		int pitch = pitches[i] < 0 ? -pitches[i] : pitches[i];
+		if(pitch < GetPlaneRowBytes(format, i, width) || lines[i] < GetPlaneLines(format, i, height))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int NATIVECALL tn_convert(int width, int height, int srcFormat, void* const* srcPlanes, const int* srcPitches, const int* srcLines,
+	int dstFormat, void* const* dstPlanes, const int* dstPitches, const int* dstLines)
+{
+	CPlanarFrame* src = NULL;
+	CPlanarFrame* dst = NULL;
+	try
+	{
+		if(!CanConvertYuv((FrameFormat)srcFormat, (FrameFormat)dstFormat))
+		{
+			throw "Unsupported conversion";
+		}
+		if(!HoldsFormat((FrameFormat)srcFormat, width, height, srcPitches, srcLines) ||
+			!HoldsFormat((FrameFormat)dstFormat, width, height, dstPitches, dstLines))
+		{
+			return 1;
+		}
+
+		src = CPlanarFrame::Wrap(width, height, (FrameFormat)srcFormat, (BYTE* const*)srcPlanes, srcPitches, NULL);
+		dst = CPlanarFrame::Wrap(width, height, (FrameFormat)dstFormat, (BYTE* const*)dstPlanes, dstPitches, NULL);
+		ConvertYuvFrame(src, dst);
+		src->Release();
+		dst->Release();
+		return 0;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+
+	if(src)
+	{
+		src->Release();
+	}
+	if(dst)
+	{
+		dst->Release();
+	}
+	return -1;
+}
+
+int NATIVECALL tn_can_convert_to_rgb(int srcFormat)
+{
+	return CanConvertYuvToRgb((FrameFormat)srcFormat) ? 1 : 0;
+}
+
+int NATIVECALL tn_convert_to_rgb(int width, int height, int srcFormat, void* const* srcPlanes, const int* srcPitches, const int* srcLines,
+	void* dst, int dstPitch, int layout, int matrix, int range, const ToneMap* tone, int threads)
+{
+	CPlanarFrame* src = NULL;
+	try
+	{
+		if(!CanConvertYuvToRgb((FrameFormat)srcFormat))
+		{
+			throw "Unsupported conversion";
+		}
+		if(!HoldsFormat((FrameFormat)srcFormat, width, height, srcPitches, srcLines))
+		{
+			return 1;
+		}
+
+		src = CPlanarFrame::Wrap(width, height, (FrameFormat)srcFormat, (BYTE* const*)srcPlanes, srcPitches, NULL);
+		ConvertYuvToRgb(src, (BYTE*)dst, dstPitch, (RgbLayout)layout, (YuvMatrix)matrix, (YuvRange)range, tone, threads);
+		src->Release();
+		return 0;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+
+	if(src)
+	{
+		src->Release();
+	}
+	return -1;
+}
+
+int NATIVECALL tn_can_convert_from_rgb(int dstFormat)
+{
+	return CanConvertRgbToYuv((FrameFormat)dstFormat) ? 1 : 0;
+}
+
+int NATIVECALL tn_convert_from_rgb(int width, int height, const void* src, int srcPitch, int layout,
+	int dstFormat, void* const* dstPlanes, const int* dstPitches, const int* dstLines, int matrix, int range, int threads)
+{
+	CPlanarFrame* dst = NULL;
+	try
+	{
+		if(!CanConvertRgbToYuv((FrameFormat)dstFormat))
+		{
+			throw "Unsupported conversion";
+		}
+		if(!HoldsFormat((FrameFormat)dstFormat, width, height, dstPitches, dstLines))
+		{
+			return 1;
+		}
+
+		dst = CPlanarFrame::Wrap(width, height, (FrameFormat)dstFormat, (BYTE* const*)dstPlanes, dstPitches, NULL);
+		ConvertRgbToYuv((const BYTE*)src, srcPitch, (RgbLayout)layout, dst, (YuvMatrix)matrix, (YuvRange)range, threads);
+		dst->Release();
+		return 0;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+
+	if(dst)
+	{
+		dst->Release();
+	}
+	return -1;
+}
+
+int NATIVECALL tn_can_scale(int srcFormat, int dstFormat)
+{
+	return CanScaleFrame((FrameFormat)srcFormat, (FrameFormat)dstFormat) ? 1 : 0;
+}
+
+int NATIVECALL tn_scale(int srcWidth, int srcHeight, int srcFormat, void* const* srcPlanes, const int* srcPitches, const int* srcLines,
+	int x, int y, int rectWidth, int rectHeight,
+	int dstWidth, int dstHeight, int dstFormat, void* const* dstPlanes, const int* dstPitches, const int* dstLines, int filter, int threads)
+{
+	CPlanarFrame* src = NULL;
+	CPlanarFrame* dst = NULL;
+	try
+	{
+		if(!CanScaleFrame((FrameFormat)srcFormat, (FrameFormat)dstFormat))
+		{
+			throw "Unsupported conversion";
+		}
+		if(!HoldsFormat((FrameFormat)srcFormat, srcWidth, srcHeight, srcPitches, srcLines) ||
+			!HoldsFormat((FrameFormat)dstFormat, dstWidth, dstHeight, dstPitches, dstLines))
+		{
+			return 1;
+		}
+
+		FrameRect rect = { x, y, rectWidth, rectHeight };
+		src = CPlanarFrame::Wrap(srcWidth, srcHeight, (FrameFormat)srcFormat, (BYTE* const*)srcPlanes, srcPitches, NULL);
+		dst = CPlanarFrame::Wrap(dstWidth, dstHeight, (FrameFormat)dstFormat, (BYTE* const*)dstPlanes, dstPitches, NULL);
+		ScaleFrame(src, rect, dst, (ScaleFilter)filter, threads);
+		src->Release();
+		dst->Release();
+		return 0;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+
+	if(src)
+	{
+		src->Release();
+	}
+	if(dst)
+	{
+		dst->Release();
+	}
+	return -1;
+}
+
+int NATIVECALL tn_reduce(int srcWidth, int srcHeight, int format, void* const* srcPlanes, const int* srcPitches, const int* srcLines,
+	int dstWidth, int dstHeight, void* const* dstPlanes, const int* dstPitches, const int* dstLines, int threads)
+{
+	CPlanarFrame* src = NULL;
+	CPlanarFrame* dst = NULL;
+	try
+	{
+		if(!HoldsFormat((FrameFormat)format, srcWidth, srcHeight, srcPitches, srcLines) ||
+			!HoldsFormat((FrameFormat)format, dstWidth, dstHeight, dstPitches, dstLines))
+		{
+			return 1;
+		}
+
+		src = CPlanarFrame::Wrap(srcWidth, srcHeight, (FrameFormat)format, (BYTE* const*)srcPlanes, srcPitches, NULL);
+		dst = CPlanarFrame::Wrap(dstWidth, dstHeight, (FrameFormat)format, (BYTE* const*)dstPlanes, dstPitches, NULL);
+		int result = 1;
+		if(GetFrameReduction(src, dst) != 0)
+		{
+			ReduceFrame(src, dst, threads);
+			result = 0;
+		}
+		src->Release();
+		dst->Release();
+		return result;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+
+	if(src)
+	{
+		src->Release();
+	}
+	if(dst)
+	{
+		dst->Release();
+	}
+	return -1;
+}
+
+int NATIVECALL tn_rotate(int srcWidth, int srcHeight, int format, void* const* srcPlanes, const int* srcPitches, const int* srcLines,
+	int dstWidth, int dstHeight, void* const* dstPlanes, const int* dstPitches, const int* dstLines, int rotation, int threads)
+{
+	CPlanarFrame* src = NULL;
+	CPlanarFrame* dst = NULL;
+	try
+	{
+		if(!HoldsFormat((FrameFormat)format, srcWidth, srcHeight, srcPitches, srcLines) ||
+			!HoldsFormat((FrameFormat)format, dstWidth, dstHeight, dstPitches, dstLines))
+		{
+			return 1;
+		}
+
+		src = CPlanarFrame::Wrap(srcWidth, srcHeight, (FrameFormat)format, (BYTE* const*)srcPlanes, srcPitches, NULL);
+		dst = CPlanarFrame::Wrap(dstWidth, dstHeight, (FrameFormat)format, (BYTE* const*)dstPlanes, dstPitches, NULL);
+		int result = 1;
+		if(CanRotateFrame(src, dst, (FrameRotation)rotation))
+		{
+			RotateFrame(src, dst, (FrameRotation)rotation, threads);
+			result = 0;
+		}
+		src->Release();
+		dst->Release();
+		return result;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+
+	if(src)
+	{
+		src->Release();
+	}
+	if(dst)
+	{
+		dst->Release();
+	}
+	return -1;
+}
+
+int NATIVECALL tn_tone_map(double brightness, double contrast, double gamma, double saturation, int range, ToneMap* map)
+{
+	try
+	{
+		BuildToneMap(brightness, contrast, gamma, saturation, (YuvRange)range, map);
+		return 0;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	return -1;
+}
+
+int NATIVECALL tn_can_adjust_tone(int format)
+{
+	return CanAdjustTone((FrameFormat)format) ? 1 : 0;
+}
+
+int NATIVECALL tn_adjust_tone(int width, int height, int format, void* const* planes, const int* pitches, const int* lines,
+	const ToneMap* map, int threads)
+{
+	CPlanarFrame* frame = NULL;
+	try
+	{
+		if(!CanAdjustTone((FrameFormat)format) || !HoldsFormat((FrameFormat)format, width, height, pitches, lines))
+		{
+			return 1;
+		}
+
+		frame = CPlanarFrame::Wrap(width, height, (FrameFormat)format, (BYTE* const*)planes, pitches, NULL);
+		AdjustTone(frame, frame, map, threads);
+		frame->Release();
+		return 0;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+
+	if(frame)
+	{
+		frame->Release();
+	}
+	return -1;
+}
+
+int NATIVECALL tn_raw_write(const char* path, int format, int width, int height, void* const* planes, const int* pitches)
+{
+	CPlanarFrame* frame = NULL;
+	try
+	{
+		frame = CPlanarFrame::Wrap(width, height, (FrameFormat)format, (BYTE* const*)planes, pitches, NULL);
+		WriteRawFrame(path, frame);
+		frame->Release();
+		return 0;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+
+	if(frame)
+	{
+		frame->Release();
+	}
+	return -1;
+}
+
+CPlanarFrame* NATIVECALL tn_raw_map(const char* path)
+{
+	try
+	{
+		return MapRawFrame(path);
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	return NULL;
+}
+
+CRawSequenceWriter* NATIVECALL tn_seq_create(const char* path, int container, int format, int width, int height, int rateNum, int rateDen)
+{
+	try
+	{
+		return new CRawSequenceWriter(path, (SequenceContainer)container, (FrameFormat)format, width, height, rateNum, rateDen);
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	return NULL;
+}
+
+int NATIVECALL tn_seq_append(CRawSequenceWriter* writer, int format, int width, int height, void* const* planes, const int* pitches, long long timestamp)
+{
+	CPlanarFrame* frame = NULL;
+	try
+	{
+		frame = CPlanarFrame::Wrap(width, height, (FrameFormat)format, (BYTE* const*)planes, pitches, NULL);
+		writer->Append(frame, timestamp);
+		frame->Release();
+		return 0;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+
+	if(frame)
+	{
+		frame->Release();
+	}
+	return -1;
+}
+
+int NATIVECALL tn_seq_close_writer(CRawSequenceWriter* writer)
+{
+	int result = 0;
+	try
+	{
+		writer->Close();
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+		result = -1;
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+		result = -1;
+	}
+	delete writer;
+	return result;
+}
+
+CRawSequenceReader* NATIVECALL tn_seq_open(const char* path, int readahead)
+{
+	try
+	{
+		return new CRawSequenceReader(path, readahead);
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	return NULL;
+}
+
+void NATIVECALL tn_seq_get_info(CRawSequenceReader* reader, SequenceInfo* info)
+{
+	reader->GetInfo(info);
+}
+
+int NATIVECALL tn_seq_get_timestamp(CRawSequenceReader* reader, long long frame, long long* timestamp)
+{
+	try
+	{
+		*timestamp = reader->GetTimestamp(frame);
+		return 0;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+		return -1;
+	}
+}
+
+long long NATIVECALL tn_seq_find_frame(CRawSequenceReader* reader, long long timestamp)
+{
+	return reader->FindFrame(timestamp);
+}
+
+CPlanarFrame* NATIVECALL tn_seq_read(CRawSequenceReader* reader, long long frame)
+{
+	try
+	{
+		return reader->ReadFrame(frame);
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	return NULL;
+}
+
+void NATIVECALL tn_seq_close_reader(CRawSequenceReader* reader)
+{
+	delete reader;
+}
+
+CFrameRingWriter* NATIVECALL tn_ring_create(const char* name, int slots, int format, int width, int height)
+{
+	try
+	{
+		return new CFrameRingWriter(name, slots, width, height, (FrameFormat)format);
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	return NULL;
+}
+
+CPlanarFrame* NATIVECALL tn_ring_begin_write(CFrameRingWriter* writer)
+{
+	try
+	{
+		CPlanarFrame* frame = writer->BeginWrite();
+		if(!frame)
+		{
+			SetError("Every frame ring slot is in use");
+		}
+		return frame;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	return NULL;
+}
+
+int NATIVECALL tn_ring_publish(CFrameRingWriter* writer, CPlanarFrame* frame, long long timestamp)
+{
+	try
+	{
+		writer->Publish(frame, timestamp);
+		return 0;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+		return -1;
+	}
+}
+
+int NATIVECALL tn_ring_cancel(CFrameRingWriter* writer, CPlanarFrame* frame)
+{
+	try
+	{
+		writer->Cancel(frame);
+		return 0;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+		return -1;
+	}
+}
+
+int NATIVECALL tn_ring_write(CFrameRingWriter* writer, int format, int width, int height, void* const* planes, const int* pitches, long long timestamp)
+{
+	CPlanarFrame* frame = NULL;
+	try
+	{
+		frame = CPlanarFrame::Wrap(width, height, (FrameFormat)format, (BYTE* const*)planes, pitches, NULL);
+		bool written = writer->Write(frame, timestamp);
+		frame->Release();
+		return written ? 0 : 1;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+
+	if(frame)
+	{
+		frame->Release();
+	}
+	return -1;
+}
+
+void NATIVECALL tn_ring_get_writer_stats(CFrameRingWriter* writer, FrameRingStats* stats)
+{
+	writer->GetStats(stats);
+}
+
+void NATIVECALL tn_ring_close_writer(CFrameRingWriter* writer)
+{
+	delete writer;
+}
+
+CFrameRingReader* NATIVECALL tn_ring_open(const char* name)
+{
+	try
+	{
+		return new CFrameRingReader(name);
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	return NULL;
+}
+
+void NATIVECALL tn_ring_get_format(CFrameRingReader* reader, int* format, int* width, int* height)
+{
+	*format = reader->GetFormat();
+	*width = reader->GetWidth();
+	*height = reader->GetHeight();
+}
+
+int NATIVECALL tn_ring_read(CFrameRingReader* reader, int timeoutMs, CPlanarFrame** frame, long long* sequence, long long* timestamp)
+{
+	try
+	{
+		*frame = reader->Read(timeoutMs, sequence, timestamp);
+		return *frame ? 0 : 1;
+	}
+	catch(const char* msg)
+	{
+		SetError(msg);
+	}
+	catch(const std::bad_alloc&)
+	{
+		SetError("Out of memory");
+	}
+	*frame = NULL;
+	return -1;
+}
+
+void NATIVECALL tn_ring_get_reader_stats(CFrameRingReader* reader, FrameRingStats* stats)
+{
+	reader->GetStats(stats);
+}
+
+void NATIVECALL tn_ring_close_reader(CFrameRingReader* reader)
+{
+	delete reader;
+}
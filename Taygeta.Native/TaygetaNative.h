@@ -0,0 +1,152 @@
+#pragma once
+
+#include <stddef.h>
+#include "NativeLib.h"
+#include "FramePool.h"
+#include "PlanarFrame.h"
+#include "RawSequence.h"
+#include "FrameRing.h"
+#include "FrameTone.h"
+
+// Flat C entry points for callers that cannot use the C++ classes, such as P/Invoke from
+// Taygeta.Imaging. Functions never throw; failures are reported through return values.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Geometry and planes of a frame handle
+struct FrameInfo
+{
+	int Width;
+	int Height;
+	int Format;				// FrameFormat, same values as PixelAlignmentType
+	int Planes;
+	void* Data[4];
+	int Pitches[4];
+	int Lines[4];
+};
+
+// Message of the last failed call on this thread
+NATIVELIB const char* NATIVECALL tn_get_last_error(void);
+
+// Plane memory from the default frame pool, NULL when out of memory
+NATIVELIB void* NATIVECALL tn_pool_alloc(size_t size);
+NATIVELIB void NATIVECALL tn_pool_free(void* data);
+NATIVELIB void NATIVECALL tn_pool_trim(void);
+NATIVELIB void NATIVECALL tn_pool_set_max_idle(long long bytes);
+// Backs new pool blocks with system mappings using a LargePageMode and, with numaLocal,
+// memory of the calling thread's NUMA node; LP_NONE without numaLocal is the heap again
+NATIVELIB int NATIVECALL tn_pool_set_allocator(int largePages, int numaLocal);
+NATIVELIB void NATIVECALL tn_pool_get_stats(FramePoolStats* stats);
+
+NATIVELIB void NATIVECALL tn_frame_release(CPlanarFrame* frame);
+NATIVELIB void NATIVECALL tn_frame_get_info(CPlanarFrame* frame, FrameInfo* info);
+
+// Frame taking over planes from tn_pool_alloc, they go back to the pool with the frame.
+// Fails, leaving the planes to the caller, when they are smaller than the format needs.
+NATIVELIB CPlanarFrame* NATIVECALL tn_frame_adopt(int format, int width, int height, void* const* planes, const int* pitches, const int* lines);
+
+// Deep and copy-on-write clones, see CPlanarFrame. Lease returns 1 when the planes were
+// copied, 0 when the frame already owned them and -1 on failure.
+NATIVELIB CPlanarFrame* NATIVECALL tn_frame_clone(CPlanarFrame* frame);
+NATIVELIB CPlanarFrame* NATIVECALL tn_frame_clone_shared(CPlanarFrame* frame);
+NATIVELIB int NATIVECALL tn_frame_lease_write(CPlanarFrame* frame);
+
+// Upside down view sharing the planes, its pitches are negated
+NATIVELIB CPlanarFrame* NATIVECALL tn_frame_flip(CPlanarFrame* frame);
+
+NATIVELIB void NATIVECALL tn_copy_plane(void* dst, int dstPitch, const void* src, int srcPitch, int rowBytes, int lines);
+
+// Instruction sets the SIMD kernels use, a mask of CpuFeature; a mask of 0 selects the
+// scalar reference kernels
+NATIVELIB int NATIVECALL tn_get_cpu_features(void);
+NATIVELIB void NATIVECALL tn_set_cpu_feature_mask(int mask);
+
+// Same size conversion between 8-bit YUV layouts, see YuvConvert.h. can_convert returns
+// 1 for supported pairs. convert returns 0 on success, 1 without touching the planes
+// when they are smaller than the formats need, such as chroma rounded down at odd sizes,
+// and -1 on failure.
+NATIVELIB int NATIVECALL tn_can_convert(int srcFormat, int dstFormat);
+NATIVELIB int NATIVECALL tn_convert(int width, int height, int srcFormat, void* const* srcPlanes, const int* srcPitches, const int* srcLines,
+	int dstFormat, void* const* dstPlanes, const int* dstPitches, const int* dstLines);
+
+// YUV to packed RGB, see RgbConvert.h: layout is a RgbLayout, matrix a YuvMatrix, range a
+// YuvRange, tone a tone map to apply on the way or NULL, and threads the most threads to
+// run on, 0 for one per processor. Returns as tn_convert does.
+NATIVELIB int NATIVECALL tn_can_convert_to_rgb(int srcFormat);
+NATIVELIB int NATIVECALL tn_convert_to_rgb(int width, int height, int srcFormat, void* const* srcPlanes, const int* srcPitches, const int* srcLines,
+	void* dst, int dstPitch, int layout, int matrix, int range, const ToneMap* tone, int threads);
+
+// Packed RGB to YUV frames, the reverse of the above
+NATIVELIB int NATIVECALL tn_can_convert_from_rgb(int dstFormat);
+NATIVELIB int NATIVECALL tn_convert_from_rgb(int width, int height, const void* src, int srcPitch, int layout,
+	int dstFormat, void* const* dstPlanes, const int* dstPitches, const int* dstLines, int matrix, int range, int threads);
+
+// Crop of the area x, y, rectWidth, rectHeight of the source, scaled to the target size with
+// a ScaleFilter and converted to dstFormat in one pass, see FrameScale.h. Returns as
+// tn_convert does, and -1 for areas outside the source.
+NATIVELIB int NATIVECALL tn_can_scale(int srcFormat, int dstFormat);
+NATIVELIB int NATIVECALL tn_scale(int srcWidth, int srcHeight, int srcFormat, void* const* srcPlanes, const int* srcPitches, const int* srcLines,
+	int x, int y, int rectWidth, int rectHeight,
+	int dstWidth, int dstHeight, int dstFormat, void* const* dstPlanes, const int* dstPitches, const int* dstLines, int filter, int threads);
+
+// Exact 2x, 4x or 8x reduction keeping the layout, see FrameReduce.h. Returns 0 on success,
+// 1 without touching the planes for sizes that are not such a reduction or planes smaller
+// than the format needs, and -1 on failure.
+NATIVELIB int NATIVECALL tn_reduce(int srcWidth, int srcHeight, int format, void* const* srcPlanes, const int* srcPitches, const int* srcLines,
+	int dstWidth, int dstHeight, void* const* dstPlanes, const int* dstPitches, const int* dstLines, int threads);
+
+// Rotation or flip keeping the layout, see FrameRotate.h; rotation is a FrameRotation, the
+// values of System.Drawing.RotateFlipType. Returns 0 on success, 1 without touching the
+// planes for layouts, sizes or rotations RotateFrame does not cover or planes smaller than
+// the format needs, and -1 on failure.
+NATIVELIB int NATIVECALL tn_rotate(int srcWidth, int srcHeight, int format, void* const* srcPlanes, const int* srcPitches, const int* srcLines,
+	int dstWidth, int dstHeight, void* const* dstPlanes, const int* dstPitches, const int* dstLines, int rotation, int threads);
+
+// Tone adjustment, see FrameTone.h. tn_tone_map fills map and returns 0, or -1 for invalid
+// settings. tn_can_adjust_tone returns 1 for formats the kernels cover. tn_adjust_tone
+// applies map to the planes in place and returns 0 on success, 1 without touching them
+// for layouts it does not cover or planes smaller than the format needs, and -1 on failure.
+NATIVELIB int NATIVECALL tn_tone_map(double brightness, double contrast, double gamma, double saturation, int range, ToneMap* map);
+NATIVELIB int NATIVECALL tn_can_adjust_tone(int format);
+NATIVELIB int NATIVECALL tn_adjust_tone(int width, int height, int format, void* const* planes, const int* pitches, const int* lines,
+	const ToneMap* map, int threads);
+
+// Raw frame files, see RawFrameFile.h. Write returns 0 on success, map returns NULL on failure.
+NATIVELIB int NATIVECALL tn_raw_write(const char* path, int format, int width, int height, void* const* planes, const int* pitches);
+NATIVELIB CPlanarFrame* NATIVECALL tn_raw_map(const char* path);
+
+// Raw sequences, see RawSequence.h. Calls returning int give 0 on success and -1 on
+// failure; writer and reader handles are released by their close function.
+NATIVELIB CRawSequenceWriter* NATIVECALL tn_seq_create(const char* path, int container, int format, int width, int height, int rateNum, int rateDen);
+NATIVELIB int NATIVECALL tn_seq_append(CRawSequenceWriter* writer, int format, int width, int height, void* const* planes, const int* pitches, long long timestamp);
+NATIVELIB int NATIVECALL tn_seq_close_writer(CRawSequenceWriter* writer);
+
+NATIVELIB CRawSequenceReader* NATIVECALL tn_seq_open(const char* path, int readahead);
+NATIVELIB void NATIVECALL tn_seq_get_info(CRawSequenceReader* reader, SequenceInfo* info);
+NATIVELIB int NATIVECALL tn_seq_get_timestamp(CRawSequenceReader* reader, long long frame, long long* timestamp);
+NATIVELIB long long NATIVECALL tn_seq_find_frame(CRawSequenceReader* reader, long long timestamp);
+NATIVELIB CPlanarFrame* NATIVECALL tn_seq_read(CRawSequenceReader* reader, long long frame);
+NATIVELIB void NATIVECALL tn_seq_close_reader(CRawSequenceReader* reader);
+
+// Shared memory frame rings, see FrameRing.h. tn_ring_write gives 1 when the frame was
+// dropped and tn_ring_read 1 when it timed out; tn_ring_begin_write returns NULL both on
+// failure and when no slot is free, the last error tells which.
+NATIVELIB CFrameRingWriter* NATIVECALL tn_ring_create(const char* name, int slots, int format, int width, int height);
+NATIVELIB CPlanarFrame* NATIVECALL tn_ring_begin_write(CFrameRingWriter* writer);
+NATIVELIB int NATIVECALL tn_ring_publish(CFrameRingWriter* writer, CPlanarFrame* frame, long long timestamp);
+NATIVELIB int NATIVECALL tn_ring_cancel(CFrameRingWriter* writer, CPlanarFrame* frame);
+NATIVELIB int NATIVECALL tn_ring_write(CFrameRingWriter* writer, int format, int width, int height, void* const* planes, const int* pitches, long long timestamp);
+NATIVELIB void NATIVECALL tn_ring_get_writer_stats(CFrameRingWriter* writer, FrameRingStats* stats);
+NATIVELIB void NATIVECALL tn_ring_close_writer(CFrameRingWriter* writer);
+
+NATIVELIB CFrameRingReader* NATIVECALL tn_ring_open(const char* name);
+NATIVELIB void NATIVECALL tn_ring_get_format(CFrameRingReader* reader, int* format, int* width, int* height);
+NATIVELIB int NATIVECALL tn_ring_read(CFrameRingReader* reader, int timeoutMs, CPlanarFrame** frame, long long* sequence, long long* timestamp);
+NATIVELIB void NATIVECALL tn_ring_get_reader_stats(CFrameRingReader* reader, FrameRingStats* stats);
+NATIVELIB void NATIVECALL tn_ring_close_reader(CFrameRingReader* reader);
+
+#ifdef __cplusplus
+}
+#endif
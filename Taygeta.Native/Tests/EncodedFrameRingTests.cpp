@@ -0,0 +1,95 @@
+#include "EncodedFrameRing.h"
+#include "TestCheck.h"
+
+#include <string.h>
+
+static void AppendFrames(CEncodedFrameRing& ring, int count, long long firstTimestamp)
+{
+	BYTE data[100];
+	for(int i = 0; i < count; i++)
+	{
+		memset(data, i, sizeof(data));
+		CHECK(ring.Append(data, sizeof(data), firstTimestamp + i));
+	}
+}
+
+// Empty snapshots hold no frames, so they take no pin: any number of them may be open
+// and none keeps the writer from evicting
+static void TestEmptySnapshotTakesNoPin(void)
+{
+	CEncodedFrameRing ring(1000, 8);
+	AppendFrames(ring, 4, 10);
+
+	CEncodedFrameSnapshot* empty[ENCODED_RING_MAX_SNAPSHOTS + 1];
+	for(int i = 0; i <= ENCODED_RING_MAX_SNAPSHOTS; i++)
+	{
+		// Between the timestamps of the last frame and the next one
+		empty[i] = ring.Snapshot(14, 14);
+		CHECK_EQ(empty[i]->GetCount(), 0);
+	}
+
+	CEncodedFrameSnapshot* held = NULL;
+	try
+	{
+		held = ring.Snapshot(10, 13);
+	}
+	catch(const char*)
+	{
+	}
+	CHECK(held != NULL);
+
+	// The ring wraps while the empty snapshots are open, only the held frames are kept
+	if(held)
+	{
+		CHECK_EQ(held->GetCount(), 4);
+		delete held;
+	}
+	AppendFrames(ring, 20, 20);
+
+	EncodedRingStats stats;
+	ring.GetStats(&stats);
+	CHECK_EQ(stats.Appended, 24);
+	CHECK_EQ(stats.Dropped, 0);
+
+	for(int i = 0; i <= ENCODED_RING_MAX_SNAPSHOTS; i++)
+	{
+		delete empty[i];
+	}
+}
+
+static void TestSnapshotHoldsFrames(void)
+{
+	CEncodedFrameRing ring(1000, 8);
+	AppendFrames(ring, 8, 0);
+
+	CEncodedFrameSnapshot* snapshot = ring.Snapshot(5, 6);
+	CHECK_EQ(snapshot->GetCount(), 2);
+
+	// Frames 5 and 6 stay pinned, so the ring fills up behind them
+	AppendFrames(ring, 5, 8);
+	BYTE data[100] = {};
+	CHECK(!ring.Append(data, sizeof(data), 13));
+
+	EncodedFrame frame;
+	snapshot->GetFrame(0, &frame);
+	CHECK_EQ(frame.Number, 5);
+	CHECK_EQ(frame.Data[0], 5);
+	delete snapshot;
+
+	CHECK(ring.Append(data, sizeof(data), 14));
+}
+
+int main()
+{
+	try
+	{
+		TestEmptySnapshotTakesNoPin();
+		TestSnapshotHoldsFrames();
+	}
+	catch(const char* msg)
+	{
+		fprintf(stderr, "unexpected exception: %s\n", msg);
+		s_testFailures++;
+	}
+	return TEST_RESULT();
+}
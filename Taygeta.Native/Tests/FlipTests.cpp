@@ -0,0 +1,493 @@
+#include "PlanarFrame.h"
+#include "FrameCopy.h"
+#include "YuvConvert.h"
+#include "RgbConvert.h"
+#include "FrameScale.h"
+#include "FrameRotate.h"
+#include "FrameTone.h"
+#include "FrameReduce.h"
+#include "RawFrameFile.h"
+#include "TestCheck.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Every kernel is run on bottom-up frames, with negative pitches, and on frames without
+// pitch padding, and has to give the image it gives for top-down frames of aligned
+// pitches. The frames of each layout are filled row by row with memcpy, so the reference
+// does not depend on the copy kernels under test.
+
+enum FrameLayout
+{
+	FL_TOP_DOWN = 0,
+	FL_BOTTOM_UP,
+	FL_TIGHT_TOP_DOWN,
+	FL_TIGHT_BOTTOM_UP,
+	FL_COUNT
+};
+
+static const char* s_layoutNames[FL_COUNT] = { "top-down", "bottom-up", "tight top-down", "tight bottom-up" };
+
+static CPlanarFrame* CreateFrame(int width, int height, FrameFormat format, FrameLayout layout)
+{
+	CPlanarFrame* frame;
+	if(layout == FL_TOP_DOWN || layout == FL_BOTTOM_UP)
+	{
+		frame = CPlanarFrame::Create(width, height, format);
+	}
+	else
+	{
+		// Rows back to back, only the padding SIMD kernels may read past the last row
+		int planes = GetFrameFormatDesc(format)->Planes;
+		size_t size = 0;
+		for(int i = 0; i < planes; i++)
+		{
+			size += (size_t)GetPlaneRowBytes(format, i, width) * GetPlaneLines(format, i, height) + FRAME_PADDING;
+		}
+
+		CPlaneBuffer* storage = CPlaneBuffer::Create(size);
+		BYTE* planePointers[FRAME_MAX_PLANES];
+		int pitches[FRAME_MAX_PLANES];
+		BYTE* p = storage->GetData();
+		for(int i = 0; i < planes; i++)
+		{
+			planePointers[i] = p;
+			pitches[i] = GetPlaneRowBytes(format, i, width);
+			p += (size_t)pitches[i] * GetPlaneLines(format, i, height) + FRAME_PADDING;
+		}
+		frame = CPlanarFrame::Wrap(width, height, format, planePointers, pitches, storage);
+		storage->Release();
+	}
+
+	// Garbage outside of what a kernel should write
+	for(int i = 0; i < frame->GetPlaneCount(); i++)
+	{
+		memset(frame->GetPlane(i), 0xcd, (size_t)frame->GetPitch(i) * frame->GetLines(i));
+	}
+
+	if(layout == FL_BOTTOM_UP || layout == FL_TIGHT_BOTTOM_UP)
+	{
+		CPlanarFrame* flipped = frame->CreateFlippedView();
+		frame->Release();
+		frame = flipped;
+	}
+	return frame;
+}
+
+static void FillFrame(CPlanarFrame* frame, unsigned seed)
+{
+	for(int i = 0; i < frame->GetPlaneCount(); i++)
+	{
+		for(int y = 0; y < frame->GetLines(i); y++)
+		{
+			BYTE* row = frame->GetPlane(i) + (ptrdiff_t)y * frame->GetPitch(i);
+			for(int x = 0; x < frame->GetRowBytes(i); x++)
+			{
+				seed = seed * 1103515245 + 12345;
+				row[x] = (BYTE)(seed >> 16);
+			}
+		}
+	}
+}
+
+static CPlanarFrame* CopyToLayout(const CPlanarFrame* src, FrameLayout layout)
+{
+	CPlanarFrame* frame = CreateFrame(src->GetWidth(), src->GetHeight(), src->GetFormat(), layout);
+	for(int i = 0; i < src->GetPlaneCount(); i++)
+	{
+		for(int y = 0; y < src->GetLines(i); y++)
+		{
+			memcpy(frame->GetPlane(i) + (ptrdiff_t)y * frame->GetPitch(i),
+				src->GetPlane(i) + (ptrdiff_t)y * src->GetPitch(i), src->GetRowBytes(i));
+		}
+	}
+	return frame;
+}
+
+static bool SameImage(const CPlanarFrame* a, const CPlanarFrame* b)
+{
+	if(a->GetWidth() != b->GetWidth() || a->GetHeight() != b->GetHeight() || a->GetFormat() != b->GetFormat())
+	{
+		return false;
+	}
+	for(int i = 0; i < a->GetPlaneCount(); i++)
+	{
+		for(int y = 0; y < a->GetLines(i); y++)
+		{
+			if(memcmp(a->GetPlane(i) + (ptrdiff_t)y * a->GetPitch(i),
+				b->GetPlane(i) + (ptrdiff_t)y * b->GetPitch(i), a->GetRowBytes(i)) != 0)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Operation of one test case from src into dst
+class IFrameOperation
+{
+public:
+	virtual ~IFrameOperation(void) {}
+	virtual void Run(const CPlanarFrame* src, CPlanarFrame* dst) = 0;
+};
+
+// Runs an operation for every combination of source and target layout and compares the
+// targets with the one of top-down frames
+static void CheckLayouts(const char* name, IFrameOperation& operation, int srcWidth, int srcHeight, FrameFormat srcFormat,
+	int dstWidth, int dstHeight, FrameFormat dstFormat)
+{
+	CPlanarFrame* src = CreateFrame(srcWidth, srcHeight, srcFormat, FL_TOP_DOWN);
+	FillFrame(src, (unsigned)srcFormat * 7919 + srcWidth);
+	CPlanarFrame* expected = CreateFrame(dstWidth, dstHeight, dstFormat, FL_TOP_DOWN);
+	operation.Run(src, expected);
+
+	for(int s = 0; s < FL_COUNT; s++)
+	{
+		for(int d = 0; d < FL_COUNT; d++)
+		{
+			if(s == FL_TOP_DOWN && d == FL_TOP_DOWN)
+			{
+				continue;
+			}
+
+			CPlanarFrame* source = CopyToLayout(src, (FrameLayout)s);
+			CPlanarFrame* target = CreateFrame(dstWidth, dstHeight, dstFormat, (FrameLayout)d);
+			operation.Run(source, target);
+			if(!SameImage(expected, target))
+			{
+				fprintf(stderr, "%s %s to %s, %s source, %s target: differs from top-down\n", name,
+					GetFrameFormatDesc(srcFormat)->Name, GetFrameFormatDesc(dstFormat)->Name, s_layoutNames[s], s_layoutNames[d]);
+				s_testFailures++;
+			}
+			target->Release();
+			source->Release();
+		}
+	}
+
+	expected->Release();
+	src->Release();
+}
+
+class CCopyOperation : public IFrameOperation
+{
+public:
+	virtual void Run(const CPlanarFrame* src, CPlanarFrame* dst)
+	{
+		CopyFrame(src, dst);
+	}
+};
+
+class CConvertOperation : public IFrameOperation
+{
+public:
+	virtual void Run(const CPlanarFrame* src, CPlanarFrame* dst)
+	{
+		ConvertYuvFrame(src, dst);
+	}
+};
+
+class CToRgbOperation : public IFrameOperation
+{
+public:
+	CToRgbOperation(RgbLayout layout) : m_layout(layout) {}
+
+	virtual void Run(const CPlanarFrame* src, CPlanarFrame* dst)
+	{
+		ConvertYuvToRgb(src, dst->GetPlane(0), dst->GetPitch(0), m_layout, YM_BT601, YR_LIMITED, NULL, 3);
+	}
+
+private:
+	RgbLayout m_layout;
+};
+
+class CFromRgbOperation : public IFrameOperation
+{
+public:
+	CFromRgbOperation(RgbLayout layout) : m_layout(layout) {}
+
+	virtual void Run(const CPlanarFrame* src, CPlanarFrame* dst)
+	{
+		ConvertRgbToYuv(src->GetPlane(0), src->GetPitch(0), m_layout, dst, YM_BT709, YR_FULL, 3);
+	}
+
+private:
+	RgbLayout m_layout;
+};
+
+class CScaleOperation : public IFrameOperation
+{
+public:
+	CScaleOperation(FrameRect rect, ScaleFilter filter) : m_rect(rect), m_filter(filter) {}
+
+	virtual void Run(const CPlanarFrame* src, CPlanarFrame* dst)
+	{
+		ScaleFrame(src, m_rect, dst, m_filter, 3);
+	}
+
+private:
+	FrameRect m_rect;
+	ScaleFilter m_filter;
+};
+
+class CRotateOperation : public IFrameOperation
+{
+public:
+	CRotateOperation(FrameRotation rotation) : m_rotation(rotation) {}
+
+	virtual void Run(const CPlanarFrame* src, CPlanarFrame* dst)
+	{
+		CHECK(CanRotateFrame(src, dst, m_rotation));
+		RotateFrame(src, dst, m_rotation, 3);
+	}
+
+private:
+	FrameRotation m_rotation;
+};
+
+class CToneOperation : public IFrameOperation
+{
+public:
+	CToneOperation(bool inPlace) : m_inPlace(inPlace)
+	{
+		BuildToneMap(0.05, 1.2, 0.9, 1.3, YR_LIMITED, &m_map);
+	}
+
+	virtual void Run(const CPlanarFrame* src, CPlanarFrame* dst)
+	{
+		if(m_inPlace)
+		{
+			// The target gets the source first, so the adjustment reads and writes its layout
+			for(int i = 0; i < src->GetPlaneCount(); i++)
+			{
+				for(int y = 0; y < src->GetLines(i); y++)
+				{
+					memcpy(dst->GetPlane(i) + (ptrdiff_t)y * dst->GetPitch(i),
+						src->GetPlane(i) + (ptrdiff_t)y * src->GetPitch(i), src->GetRowBytes(i));
+				}
+			}
+			AdjustTone(dst, dst, &m_map, 3);
+		}
+		else
+		{
+			AdjustTone(src, dst, &m_map, 3);
+		}
+	}
+
+private:
+	bool m_inPlace;
+	ToneMap m_map;
+};
+
+class CReduceOperation : public IFrameOperation
+{
+public:
+	virtual void Run(const CPlanarFrame* src, CPlanarFrame* dst)
+	{
+		CHECK(GetFrameReduction(src, dst) > 0);
+		ReduceFrame(src, dst, 3);
+	}
+};
+
+class CRawFileOperation : public IFrameOperation
+{
+public:
+	CRawFileOperation(const char* path) : m_path(path) {}
+
+	virtual void Run(const CPlanarFrame* src, CPlanarFrame* dst)
+	{
+		WriteRawFrame(m_path, src);
+		CPlanarFrame* mapped = MapRawFrame(m_path);
+		unlink(m_path);
+		CopyFrame(mapped, dst);
+		mapped->Release();
+	}
+
+private:
+	const char* m_path;
+};
+
+// Each combination of signs with equal and different magnitudes; equal pitches take the
+// block copy
+static void TestCopyPlane(void)
+{
+	const int rowBytes = 37;
+	const int lines = 9;
+	const int magnitudes[][2] = { { 48, 48 }, { 48, 64 }, { 37, 37 }, { 64, 37 } };
+
+	for(size_t m = 0; m < sizeof(magnitudes) / sizeof(magnitudes[0]); m++)
+	{
+		for(int signs = 0; signs < 4; signs++)
+		{
+			int srcPitch = signs & 1 ? -magnitudes[m][0] : magnitudes[m][0];
+			int dstPitch = signs & 2 ? -magnitudes[m][1] : magnitudes[m][1];
+			BYTE* srcBuffer = new BYTE[(size_t)magnitudes[m][0] * lines];
+			BYTE* dstBuffer = new BYTE[(size_t)magnitudes[m][1] * lines];
+			for(int i = 0; i < magnitudes[m][0] * lines; i++)
+			{
+				srcBuffer[i] = (BYTE)(i * 13 + 7);
+			}
+			memset(dstBuffer, 0, (size_t)magnitudes[m][1] * lines);
+
+			const BYTE* src = srcPitch < 0 ? srcBuffer + (size_t)-srcPitch * (lines - 1) : srcBuffer;
+			BYTE* dst = dstPitch < 0 ? dstBuffer + (size_t)-dstPitch * (lines - 1) : dstBuffer;
+			CopyPlane(dst, dstPitch, src, srcPitch, rowBytes, lines);
+
+			for(int y = 0; y < lines; y++)
+			{
+				CHECK(memcmp(dst + (ptrdiff_t)y * dstPitch, src + (ptrdiff_t)y * srcPitch, rowBytes) == 0);
+			}
+			delete[] dstBuffer;
+			delete[] srcBuffer;
+		}
+	}
+}
+
+static void TestFlippedView(void)
+{
+	CPlanarFrame* frame = CreateFrame(70, 38, FF_NV12, FL_TOP_DOWN);
+	FillFrame(frame, 1);
+
+	CPlanarFrame* flipped = frame->CreateFlippedView();
+	CPlanarFrame* back = flipped->CreateFlippedView();
+	for(int i = 0; i < frame->GetPlaneCount(); i++)
+	{
+		CHECK_EQ(flipped->GetPitch(i), -frame->GetPitch(i));
+		CHECK(flipped->GetPlane(i) == frame->GetPlane(i) + (ptrdiff_t)(frame->GetLines(i) - 1) * frame->GetPitch(i));
+		CHECK_EQ(back->GetPitch(i), frame->GetPitch(i));
+		CHECK(back->GetPlane(i) == frame->GetPlane(i));
+	}
+	CHECK(flipped->GetStorage() == frame->GetStorage());
+
+	// Rows of the view are the rows of the frame from the bottom
+	for(int i = 0; i < frame->GetPlaneCount(); i++)
+	{
+		int lines = frame->GetLines(i);
+		for(int y = 0; y < lines; y++)
+		{
+			CHECK(flipped->GetPlane(i) + (ptrdiff_t)y * flipped->GetPitch(i) == frame->GetPlane(i) + (ptrdiff_t)(lines - 1 - y) * frame->GetPitch(i));
+		}
+	}
+
+	// Clones of bottom-up frames are top-down with the same image
+	CPlanarFrame* clone = flipped->Clone();
+	for(int i = 0; i < clone->GetPlaneCount(); i++)
+	{
+		CHECK_EQ(clone->GetPitch(i), frame->GetPitch(i));
+	}
+	CHECK(SameImage(clone, flipped));
+
+	clone->Release();
+	back->Release();
+	flipped->Release();
+	frame->Release();
+}
+
+// Clone of every layout, the result always has positive pitches
+static void TestClone(FrameFormat format)
+{
+	CPlanarFrame* src = CreateFrame(70, 38, format, FL_TOP_DOWN);
+	FillFrame(src, 2);
+	for(int l = 0; l < FL_COUNT; l++)
+	{
+		CPlanarFrame* source = CopyToLayout(src, (FrameLayout)l);
+		CPlanarFrame* clone = source->Clone();
+		for(int i = 0; i < clone->GetPlaneCount(); i++)
+		{
+			CHECK(clone->GetPitch(i) > 0);
+		}
+		CHECK(SameImage(clone, src));
+		clone->Release();
+		source->Release();
+	}
+	src->Release();
+}
+
+int main()
+{
+	try
+	{
+		TestCopyPlane();
+		TestFlippedView();
+
+		const FrameFormat copyFormats[] = { FF_Y800, FF_Y16, FF_YUV, FF_YUY2, FF_UYVY, FF_YV12, FF_I420, FF_NV12, FF_NV21,
+			FF_Y411, FF_Y410, FF_RGB24, FF_RGBA, FF_ARGB, FF_YUV16, FF_I420P16, FF_I422 };
+		for(size_t i = 0; i < sizeof(copyFormats) / sizeof(copyFormats[0]); i++)
+		{
+			CCopyOperation copy;
+			CheckLayouts("CopyFrame", copy, 72, 40, copyFormats[i], 72, 40, copyFormats[i]);
+			TestClone(copyFormats[i]);
+		}
+
+		CConvertOperation convert;
+		CheckLayouts("ConvertYuvFrame", convert, 72, 40, FF_YUY2, 72, 40, FF_I420);
+		CheckLayouts("ConvertYuvFrame", convert, 72, 40, FF_I420, 72, 40, FF_UYVY);
+		CheckLayouts("ConvertYuvFrame", convert, 72, 40, FF_NV12, 72, 40, FF_YV12);
+		CheckLayouts("ConvertYuvFrame", convert, 72, 40, FF_YUV, 72, 40, FF_NV21);
+		CheckLayouts("ConvertYuvFrame", convert, 72, 40, FF_Y411, 72, 40, FF_I420);
+		CheckLayouts("ConvertYuvFrame", convert, 72, 40, FF_Y800, 72, 40, FF_I422);
+
+		CToRgbOperation toBgr(RL_BGR24);
+		CToRgbOperation toRgba(RL_RGBA);
+		CheckLayouts("ConvertYuvToRgb", toBgr, 70, 38, FF_I420, 70, 38, FF_RGB24);
+		CheckLayouts("ConvertYuvToRgb", toRgba, 70, 38, FF_NV12, 70, 38, FF_RGBA);
+		CheckLayouts("ConvertYuvToRgb", toRgba, 70, 38, FF_YUY2, 70, 38, FF_RGBA);
+
+		CFromRgbOperation fromBgr(RL_BGR24);
+		CFromRgbOperation fromRgba(RL_RGBA);
+		CheckLayouts("ConvertRgbToYuv", fromBgr, 70, 38, FF_RGB24, 70, 38, FF_I420);
+		CheckLayouts("ConvertRgbToYuv", fromRgba, 70, 38, FF_RGBA, 70, 38, FF_NV12);
+		CheckLayouts("ConvertRgbToYuv", fromBgr, 70, 38, FF_RGB24, 70, 38, FF_YUV);
+
+		FrameRect full = { 0, 0, 72, 40 };
+		FrameRect area = { 3, 5, 61, 31 };
+		CScaleOperation shrink(area, SF_BICUBIC);
+		CScaleOperation enlarge(full, SF_LANCZOS3);
+		CScaleOperation average(full, SF_AREA);
+		CScaleOperation bilinear(area, SF_BILINEAR);
+		CheckLayouts("ScaleFrame", shrink, 72, 40, FF_I420, 50, 26, FF_I420);
+		CheckLayouts("ScaleFrame", enlarge, 72, 40, FF_YUY2, 100, 62, FF_NV12);
+		CheckLayouts("ScaleFrame", average, 72, 40, FF_RGB24, 30, 18, FF_RGB24);
+		CheckLayouts("ScaleFrame", bilinear, 72, 40, FF_Y16, 45, 33, FF_Y16);
+		CheckLayouts("ScaleFrame", shrink, 72, 40, FF_I420, 48, 28, FF_RGBA);
+
+		const FrameFormat rotateFormats[] = { FF_Y800, FF_YUV, FF_I420, FF_NV12, FF_YUY2 };
+		for(size_t i = 0; i < sizeof(rotateFormats) / sizeof(rotateFormats[0]); i++)
+		{
+			for(int r = FR_NONE; r < FR_COUNT; r++)
+			{
+				CRotateOperation rotate((FrameRotation)r);
+				bool quarter = r == FR_ROTATE90 || r == FR_ROTATE270 || r == FR_ROTATE90_FLIP_X || r == FR_ROTATE270_FLIP_X;
+				CheckLayouts("RotateFrame", rotate, 72, 40, rotateFormats[i], quarter ? 40 : 72, quarter ? 72 : 40, rotateFormats[i]);
+			}
+		}
+
+		const FrameFormat toneFormats[] = { FF_Y800, FF_YUV, FF_YUY2, FF_UYVY, FF_I420, FF_NV12, FF_Y411, FF_I422 };
+		for(size_t i = 0; i < sizeof(toneFormats) / sizeof(toneFormats[0]); i++)
+		{
+			CToneOperation tone(false);
+			CToneOperation toneInPlace(true);
+			CheckLayouts("AdjustTone", tone, 72, 40, toneFormats[i], 72, 40, toneFormats[i]);
+			CheckLayouts("AdjustTone in place", toneInPlace, 72, 40, toneFormats[i], 72, 40, toneFormats[i]);
+		}
+
+		CReduceOperation reduce;
+		CheckLayouts("ReduceFrame", reduce, 72, 40, FF_I420, 36, 20, FF_I420);
+		CheckLayouts("ReduceFrame", reduce, 72, 40, FF_YUY2, 36, 20, FF_YUY2);
+		CheckLayouts("ReduceFrame", reduce, 72, 40, FF_NV12, 18, 10, FF_NV12);
+		CheckLayouts("ReduceFrame", reduce, 128, 64, FF_I420, 16, 8, FF_I420);
+
+		char path[64];
+		snprintf(path, sizeof(path), "/tmp/TaygetaFlipTests.%d.raw", (int)getpid());
+		CRawFileOperation raw(path);
+		CheckLayouts("Raw frame file", raw, 70, 38, FF_I420, 70, 38, FF_I420);
+		CheckLayouts("Raw frame file", raw, 70, 38, FF_YUY2, 70, 38, FF_YUY2);
+	}
+	catch(const char* msg)
+	{
+		fprintf(stderr, "unexpected exception: %s\n", msg);
+		s_testFailures++;
+	}
+	return TEST_RESULT();
+}
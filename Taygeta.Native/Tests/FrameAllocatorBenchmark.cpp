@@ -0,0 +1,100 @@
+#include "FramePool.h"
+#include "FrameCopy.h"
+#include "YuvConvert.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// Copy and convert throughput of 4K frames from the default pool with each allocator. Every
+// worker thread takes fresh frames from the pool for each step, as a decode pipeline does,
+// so the numbers include the page faults and TLB misses of the pool's memory.
+//
+//   FrameAllocatorBenchmark [threads] [frames per thread]
+
+#define BENCH_WIDTH 3840
+#define BENCH_HEIGHT 2160
+
+struct BenchAllocator
+{
+	const char* Name;
+	IFrameAllocator* Allocator;
+};
+
+static void RunWorker(const CPlanarFrame* source, int frames, bool convert)
+{
+	CFramePool* pool = CFramePool::GetDefault();
+	for(int i = 0; i < frames; i++)
+	{
+		CPlanarFrame* copy = pool->Acquire(BENCH_WIDTH, BENCH_HEIGHT, FF_YUY2);
+		CopyFrame(source, copy);
+		if(convert)
+		{
+			CPlanarFrame* converted = pool->Acquire(BENCH_WIDTH, BENCH_HEIGHT, FF_I420);
+			ConvertYuvFrame(copy, converted);
+			converted->Release();
+		}
+		copy->Release();
+	}
+}
+
+static double Measure(const CPlanarFrame* source, int threads, int frames, bool convert)
+{
+	CFramePool* pool = CFramePool::GetDefault();
+	pool->Trim();
+	pool->Trim();
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	for(int t = 0; t < threads; t++)
+	{
+		workers.push_back(std::thread(RunWorker, source, frames, convert));
+	}
+	for(size_t t = 0; t < workers.size(); t++)
+	{
+		workers[t].join();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return (double)threads * frames / seconds;
+}
+
+int main(int argc, char** argv)
+{
+	int threads = argc > 1 ? atoi(argv[1]) : (int)std::thread::hardware_concurrency();
+	int frames = argc > 2 ? atoi(argv[2]) : 200;
+	threads = threads > 0 ? threads : 1;
+	frames = frames > 0 ? frames : 1;
+
+	CPlanarFrame* source = CPlanarFrame::Create(BENCH_WIDTH, BENCH_HEIGHT, FF_YUY2);
+	for(int y = 0; y < BENCH_HEIGHT; y++)
+	{
+		memset(source->GetPlane(0) + (size_t)y * source->GetPitch(0), y & 0xff, source->GetRowBytes(0));
+	}
+
+	BenchAllocator allocators[] =
+	{
+		{ "heap", CHeapFrameAllocator::GetDefault() },
+		{ "system", CSystemFrameAllocator::GetDefault(LP_NONE, false) },
+		{ "transparent huge pages", CSystemFrameAllocator::GetDefault(LP_TRANSPARENT, false) },
+		{ "explicit huge pages", CSystemFrameAllocator::GetDefault(LP_EXPLICIT, false) },
+		{ "transparent huge pages, NUMA local", CSystemFrameAllocator::GetDefault(LP_TRANSPARENT, true) },
+		{ "explicit huge pages, NUMA local", CSystemFrameAllocator::GetDefault(LP_EXPLICIT, true) }
+	};
+
+	printf("%d threads, %d frames each, %dx%d YUY2\n", threads, frames, BENCH_WIDTH, BENCH_HEIGHT);
+	printf("%-36s %12s %12s\n", "allocator", "copy fps", "convert fps");
+	for(size_t i = 0; i < sizeof(allocators) / sizeof(allocators[0]); i++)
+	{
+		CFramePool::GetDefault()->SetAllocator(allocators[i].Allocator);
+		double copy = Measure(source, threads, frames, false);
+		double convert = Measure(source, threads, frames, true);
+		printf("%-36s %12.1f %12.1f\n", allocators[i].Name, copy, convert);
+	}
+
+	CFramePool::GetDefault()->SetAllocator(NULL);
+	source->Release();
+	return 0;
+}
@@ -0,0 +1,134 @@
+#include "FrameRing.h"
+#include "TestCheck.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
+#define RING_WIDTH 64
+#define RING_HEIGHT 48
+
+static void WriteFilled(CFrameRingWriter& writer, BYTE value, long long timestamp)
+{
+	CPlanarFrame* frame = writer.BeginWrite();
+	CHECK(frame != NULL);
+	if(frame)
+	{
+		memset(frame->GetPlane(0), value, (size_t)frame->GetPitch(0) * RING_HEIGHT);
+		writer.Publish(frame, timestamp);
+	}
+}
+
+// A cancelled frame must not turn up as the frame its slot held before, for a reader
+// that has fallen behind
+static void TestCancelHidesSlot(const char* name)
+{
+	CFrameRingWriter writer(name, 2, RING_WIDTH, RING_HEIGHT, FF_Y800);
+	CFrameRingReader reader(name);
+
+	WriteFilled(writer, 0x01, 1);
+	WriteFilled(writer, 0x02, 2);
+
+	// Round robin hands out the slot of frame 1 again
+	CPlanarFrame* frame = writer.BeginWrite();
+	CHECK(frame != NULL);
+	memset(frame->GetPlane(0), 0xee, (size_t)frame->GetPitch(0) * RING_HEIGHT);
+	writer.Cancel(frame);
+
+	long long sequence = 0;
+	long long timestamp = 0;
+	CPlanarFrame* read = reader.Read(0, &sequence, &timestamp);
+	CHECK(read != NULL);
+	if(read)
+	{
+		CHECK_EQ(sequence, 2);
+		CHECK_EQ(timestamp, 2);
+		CHECK_EQ(read->GetPlane(0)[0], 0x02);
+		read->Release();
+	}
+
+	FrameRingStats stats;
+	reader.GetStats(&stats);
+	CHECK_EQ(stats.Frames, 1);
+	CHECK_EQ(stats.Dropped, 1);
+	CHECK(reader.Read(0, NULL, NULL) == NULL);
+}
+
+static void TestSecondWriterFails(const char* name)
+{
+	CFrameRingWriter* first = new CFrameRingWriter(name, 2, RING_WIDTH, RING_HEIGHT, FF_Y800);
+	CFrameRingReader reader(name);
+
+	const char* error = NULL;
+	try
+	{
+		CFrameRingWriter second(name, 2, RING_WIDTH, RING_HEIGHT, FF_Y800);
+	}
+	catch(const char* msg)
+	{
+		error = msg;
+	}
+	CHECK(error != NULL);
+
+	// The readers of the first writer still get its frames
+	WriteFilled(*first, 0x05, 5);
+	long long sequence = 0;
+	CPlanarFrame* read = reader.Read(0, &sequence, NULL);
+	CHECK(read != NULL);
+	if(read)
+	{
+		CHECK_EQ(sequence, 1);
+		CHECK_EQ(read->GetPlane(0)[0], 0x05);
+		read->Release();
+	}
+
+	// Once it is gone the name is free again, a frame it left half written included
+	CHECK(first->BeginWrite() != NULL);
+	delete first;
+	CFrameRingWriter third(name, 2, RING_WIDTH, RING_HEIGHT, FF_Y800);
+}
+
+#ifndef _WIN32
+// A segment nobody holds the lock of was left by a crashed writer and is replaced
+static void TestStaleSegmentReplaced(const char* name)
+{
+	std::string path = std::string("/") + name;
+	int fd = shm_open(path.c_str(), O_RDWR | O_CREAT, 0600);
+	CHECK(fd >= 0);
+	if(fd >= 0)
+	{
+		CHECK_EQ(ftruncate(fd, 4096), 0);
+		close(fd);
+	}
+
+	CFrameRingWriter writer(name, 2, RING_WIDTH, RING_HEIGHT, FF_Y800);
+	CFrameRingReader reader(name);
+	CHECK_EQ(reader.GetWidth(), RING_WIDTH);
+}
+#endif
+
+int main()
+{
+	char name[64];
+	snprintf(name, sizeof(name), "TaygetaFrameRingTests.%d", (int)getpid());
+
+	try
+	{
+		TestCancelHidesSlot(name);
+		TestSecondWriterFails(name);
+#ifndef _WIN32
+		TestStaleSegmentReplaced(name);
+#endif
+	}
+	catch(const char* msg)
+	{
+		fprintf(stderr, "unexpected exception: %s\n", msg);
+		s_testFailures++;
+	}
+	return TEST_RESULT();
+}
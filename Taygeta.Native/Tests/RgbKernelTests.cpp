@@ -0,0 +1,327 @@
+#include "CpuFeatures.h"
+#include "RgbKernels.h"
+#include "RgbConvert.h"
+#include "PlanarFrame.h"
+#include "TestCheck.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// Every instruction set the library has RGB kernels for must give the bytes of the
+// scalar reference. Rows are allocated to their exact size, so a kernel that reads or
+// writes past the samples it is given shows up under AddressSanitizer, and the bytes
+// after each target row are checked to stay untouched.
+
+#define GUARD_BYTES 64
+#define GUARD_VALUE 0xa5
+
+static const int s_features[] = { CPU_SSE2, CPU_SSSE3, CPU_AVX2, CPU_AVX512VBMI };
+static const YuvMatrix s_matrices[] = { YM_BT709, YM_FCC, YM_BT601, YM_SMPTE240M };
+static const int s_rgbBytes[RL_COUNT] = { 3, 4, 4, 4 };
+
+static unsigned s_seed = 1;
+
+static void FillRandom(BYTE* data, size_t size)
+{
+	for(size_t i = 0; i < size; i++)
+	{
+		s_seed = s_seed * 1103515245 + 12345;
+		data[i] = (BYTE)(s_seed >> 16);
+	}
+}
+
+static bool GuardIntact(const std::vector<BYTE>& row, size_t size)
+{
+	for(size_t i = size; i < row.size(); i++)
+	{
+		if(row[i] != GUARD_VALUE)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static void TestYuvToRgbRows(const RgbRowKernels* reference, const RgbRowKernels* kernels)
+{
+	for(size_t m = 0; m < sizeof(s_matrices) / sizeof(s_matrices[0]); m++)
+	{
+		for(int range = YR_LIMITED; range <= YR_FULL; range++)
+		{
+			YuvToRgbCoefs coefs;
+			GetYuvToRgbCoefs(s_matrices[m], (YuvRange)range, &coefs);
+
+			for(int width = 1; width <= 161; width += width < 72 ? 1 : 11)
+			{
+				for(int half = 0; half < 2; half++)
+				{
+					int chromaWidth = half ? (width + 1) / 2 : width;
+					std::vector<BYTE> y(width), u(chromaWidth), v(chromaWidth);
+					FillRandom(&y[0], y.size());
+					FillRandom(&u[0], u.size());
+					FillRandom(&v[0], v.size());
+
+					for(int layout = 0; layout < RL_COUNT; layout++)
+					{
+						size_t size = (size_t)width * s_rgbBytes[layout];
+						std::vector<BYTE> expected(size + GUARD_BYTES, GUARD_VALUE);
+						std::vector<BYTE> actual(size + GUARD_BYTES, GUARD_VALUE);
+						reference->YuvToRgb[layout][half](&y[0], &u[0], &v[0], &expected[0], width, &coefs);
+						kernels->YuvToRgb[layout][half](&y[0], &u[0], &v[0], &actual[0], width, &coefs);
+						if(memcmp(&expected[0], &actual[0], size) != 0 || !GuardIntact(actual, size))
+						{
+							fprintf(stderr, "%s YuvToRgb layout %d, %s chroma, matrix %d, range %d, width %d: differs from %s\n",
+								kernels->Name, layout, half ? "half" : "full", s_matrices[m], range, width, reference->Name);
+							s_testFailures++;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+static void TestRgbToYuvRows(const RgbRowKernels* reference, const RgbRowKernels* kernels)
+{
+	for(size_t m = 0; m < sizeof(s_matrices) / sizeof(s_matrices[0]); m++)
+	{
+		for(int range = YR_LIMITED; range <= YR_FULL; range++)
+		{
+			RgbToYuvCoefs coefs;
+			GetRgbToYuvCoefs(s_matrices[m], (YuvRange)range, &coefs);
+
+			for(int width = 1; width <= 161; width += width < 72 ? 1 : 11)
+			{
+				int chromaWidth = (width + 1) / 2;
+				for(int layout = 0; layout < RL_COUNT; layout++)
+				{
+					std::vector<BYTE> rgb0((size_t)width * s_rgbBytes[layout]);
+					std::vector<BYTE> rgb1((size_t)width * s_rgbBytes[layout]);
+					FillRandom(&rgb0[0], rgb0.size());
+					FillRandom(&rgb1[0], rgb1.size());
+
+					std::vector<BYTE> expected[4], actual[4];
+					for(int i = 0; i < 4; i++)
+					{
+						expected[i].assign(width + GUARD_BYTES, GUARD_VALUE);
+						actual[i].assign(width + GUARD_BYTES, GUARD_VALUE);
+					}
+
+					reference->RgbToYuv[layout](&rgb0[0], &expected[0][0], &expected[1][0], &expected[2][0], width, &coefs);
+					kernels->RgbToYuv[layout](&rgb0[0], &actual[0][0], &actual[1][0], &actual[2][0], width, &coefs);
+					for(int i = 0; i < 3; i++)
+					{
+						if(memcmp(&expected[i][0], &actual[i][0], width) != 0 || !GuardIntact(actual[i], width))
+						{
+							fprintf(stderr, "%s RgbToYuv layout %d, matrix %d, range %d, width %d, plane %d: differs from %s\n",
+								kernels->Name, layout, s_matrices[m], range, width, i, reference->Name);
+							s_testFailures++;
+						}
+					}
+
+					// Two rows, then the last row of an odd height passed twice with one luma target
+					for(int last = 0; last < 2; last++)
+					{
+						const BYTE* second = last ? &rgb0[0] : &rgb1[0];
+						for(int i = 0; i < 4; i++)
+						{
+							memset(&expected[i][0], GUARD_VALUE, expected[i].size());
+							memset(&actual[i][0], GUARD_VALUE, actual[i].size());
+						}
+						reference->RgbToYuv420[layout](&rgb0[0], second, &expected[0][0], last ? &expected[0][0] : &expected[1][0],
+							&expected[2][0], &expected[3][0], width, &coefs);
+						kernels->RgbToYuv420[layout](&rgb0[0], second, &actual[0][0], last ? &actual[0][0] : &actual[1][0],
+							&actual[2][0], &actual[3][0], width, &coefs);
+
+						for(int i = 0; i < 4; i++)
+						{
+							int size = i < 2 ? width : chromaWidth;
+							if(memcmp(&expected[i][0], &actual[i][0], size) != 0 || !GuardIntact(actual[i], size))
+							{
+								fprintf(stderr, "%s RgbToYuv420 layout %d, matrix %d, range %d, width %d, plane %d%s: differs from %s\n",
+									kernels->Name, layout, s_matrices[m], range, width, i, last ? ", last row" : "", reference->Name);
+								s_testFailures++;
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+// Frame with aligned pitches or rows back to back
+static CPlanarFrame* CreateFrame(int width, int height, FrameFormat format, bool padded)
+{
+	CPlanarFrame* frame;
+	if(padded)
+	{
+		frame = CPlanarFrame::Create(width, height, format);
+	}
+	else
+	{
+		int planes = GetFrameFormatDesc(format)->Planes;
+		size_t size = 0;
+		for(int i = 0; i < planes; i++)
+		{
+			size += (size_t)GetPlaneRowBytes(format, i, width) * GetPlaneLines(format, i, height);
+		}
+
+		CPlaneBuffer* storage = CPlaneBuffer::Create(size);
+		BYTE* planePointers[FRAME_MAX_PLANES];
+		int pitches[FRAME_MAX_PLANES];
+		BYTE* p = storage->GetData();
+		for(int i = 0; i < planes; i++)
+		{
+			planePointers[i] = p;
+			pitches[i] = GetPlaneRowBytes(format, i, width);
+			p += (size_t)pitches[i] * GetPlaneLines(format, i, height);
+		}
+		frame = CPlanarFrame::Wrap(width, height, format, planePointers, pitches, storage);
+		storage->Release();
+	}
+
+	for(int i = 0; i < frame->GetPlaneCount(); i++)
+	{
+		for(int y = 0; y < frame->GetLines(i); y++)
+		{
+			FillRandom(frame->GetPlane(i) + (ptrdiff_t)y * frame->GetPitch(i), frame->GetRowBytes(i));
+		}
+	}
+	return frame;
+}
+
+static bool SameRows(const CPlanarFrame* a, const CPlanarFrame* b)
+{
+	for(int i = 0; i < a->GetPlaneCount(); i++)
+	{
+		for(int y = 0; y < a->GetLines(i); y++)
+		{
+			if(memcmp(a->GetPlane(i) + (ptrdiff_t)y * a->GetPitch(i), b->GetPlane(i) + (ptrdiff_t)y * b->GetPitch(i), a->GetRowBytes(i)) != 0)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Whole conversions with the kernels picked under a feature mask against those of the
+// scalar mask, at odd sizes and with tight and padded pitches on both sides
+static void TestFrames(int mask, const char* name)
+{
+	static const FrameFormat yuvFormats[] = { FF_Y800, FF_YUV, FF_YUY2, FF_UYVY, FF_YV12, FF_I420, FF_NV12, FF_NV21, FF_I422 };
+	static const FrameFormat rgbTargets[] = { FF_Y800, FF_YUV, FF_YV12, FF_I420, FF_NV12, FF_NV21 };
+	static const int sizes[][2] = { { 37, 9 }, { 130, 7 }, { 2, 2 } };
+
+	for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+	{
+		int width = sizes[s][0];
+		int height = sizes[s][1];
+		for(int padded = 0; padded < 2; padded++)
+		{
+			for(int layout = 0; layout < RL_COUNT; layout++)
+			{
+				int rowBytes = width * s_rgbBytes[layout];
+				int pitch = padded ? CPlanarFrame::GetAlignedPitch(rowBytes) + FRAME_ALIGNMENT : rowBytes;
+				std::vector<BYTE> expected((size_t)pitch * height);
+				std::vector<BYTE> actual((size_t)pitch * height);
+
+				for(size_t f = 0; f < sizeof(yuvFormats) / sizeof(yuvFormats[0]); f++)
+				{
+					// Packed 4:2:2 and subsampled chroma need even widths
+					int frameWidth = GetFormatAlignmentX(yuvFormats[f]) > 1 ? width & ~1 : width;
+					int frameHeight = GetFormatAlignmentY(yuvFormats[f]) > 1 ? height & ~1 : height;
+					if(frameWidth == 0 || frameHeight == 0)
+					{
+						continue;
+					}
+
+					CPlanarFrame* src = CreateFrame(frameWidth, frameHeight, yuvFormats[f], padded != 0);
+					SetCpuFeatureMask(0);
+					ConvertYuvToRgb(src, &expected[0], pitch, (RgbLayout)layout, YM_BT601, YR_LIMITED, NULL, 2);
+					SetCpuFeatureMask(mask);
+					ConvertYuvToRgb(src, &actual[0], pitch, (RgbLayout)layout, YM_BT601, YR_LIMITED, NULL, 2);
+
+					bool same = true;
+					for(int y = 0; y < frameHeight; y++)
+					{
+						same = same && memcmp(&expected[(size_t)y * pitch], &actual[(size_t)y * pitch], (size_t)frameWidth * s_rgbBytes[layout]) == 0;
+					}
+					if(!same)
+					{
+						fprintf(stderr, "%s ConvertYuvToRgb %s %dx%d to layout %d, %s pitches: differs from the scalar kernels\n",
+							name, GetFrameFormatDesc(yuvFormats[f])->Name, frameWidth, frameHeight, layout, padded ? "padded" : "tight");
+						s_testFailures++;
+					}
+					src->Release();
+				}
+
+				FillRandom(&expected[0], expected.size());
+				for(size_t f = 0; f < sizeof(rgbTargets) / sizeof(rgbTargets[0]); f++)
+				{
+					int frameWidth = GetFormatAlignmentX(rgbTargets[f]) > 1 ? width & ~1 : width;
+					int frameHeight = GetFormatAlignmentY(rgbTargets[f]) > 1 ? height & ~1 : height;
+					if(frameWidth == 0 || frameHeight == 0)
+					{
+						continue;
+					}
+
+					CPlanarFrame* reference = CreateFrame(frameWidth, frameHeight, rgbTargets[f], padded != 0);
+					CPlanarFrame* target = CreateFrame(frameWidth, frameHeight, rgbTargets[f], padded != 0);
+					SetCpuFeatureMask(0);
+					ConvertRgbToYuv(&expected[0], pitch, (RgbLayout)layout, reference, YM_BT709, YR_FULL, 2);
+					SetCpuFeatureMask(mask);
+					ConvertRgbToYuv(&expected[0], pitch, (RgbLayout)layout, target, YM_BT709, YR_FULL, 2);
+					if(!SameRows(reference, target))
+					{
+						fprintf(stderr, "%s ConvertRgbToYuv layout %d to %s %dx%d, %s pitches: differs from the scalar kernels\n",
+							name, layout, GetFrameFormatDesc(rgbTargets[f])->Name, frameWidth, frameHeight, padded ? "padded" : "tight");
+						s_testFailures++;
+					}
+					target->Release();
+					reference->Release();
+				}
+			}
+		}
+	}
+}
+
+int main()
+{
+	SetCpuFeatureMask(CPU_ALL);
+	int available = GetCpuFeatures();
+	const RgbRowKernels* reference = GetRgbRowKernels(0);
+	CHECK(reference != NULL);
+
+	try
+	{
+		for(size_t f = 0; f < sizeof(s_features) / sizeof(s_features[0]); f++)
+		{
+			const RgbRowKernels* kernels = GetRgbRowKernels(s_features[f]);
+			if(!kernels || !(available & s_features[f]))
+			{
+				continue;
+			}
+			printf("%s\n", kernels->Name);
+
+			TestYuvToRgbRows(reference, kernels);
+			TestRgbToYuvRows(reference, kernels);
+
+			// The mask up to this set makes it the best one, as on a processor without the later ones
+			int mask = s_features[f] | (s_features[f] - 1);
+			SetCpuFeatureMask(mask);
+			CHECK(GetRgbRowKernels() == kernels);
+			TestFrames(mask, kernels->Name);
+		}
+	}
+	catch(const char* msg)
+	{
+		fprintf(stderr, "unexpected exception: %s\n", msg);
+		s_testFailures++;
+	}
+
+	SetCpuFeatureMask(CPU_ALL);
+	return TEST_RESULT();
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdio.h>
+
+// Checks of the test programs. A failed check is reported and counted, and main returns
+// TEST_RESULT() so that make check stops at the first program with failures.
+static int s_testFailures = 0;
+
+#define CHECK(cond) \
+	do \
+	{ \
+		if(!(cond)) \
+		{ \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			s_testFailures++; \
+		} \
+	} while(0)
+
+#define CHECK_EQ(a, b) \
+	do \
+	{ \
+		long long a_ = (long long)(a); \
+		long long b_ = (long long)(b); \
+		if(a_ != b_) \
+		{ \
+			fprintf(stderr, "%s:%d: check failed: %s == %s (%lld, %lld)\n", __FILE__, __LINE__, #a, #b, a_, b_); \
+			s_testFailures++; \
+		} \
+	} while(0)
+
+#define TEST_RESULT() (printf("%s: %d failures\n", __FILE__, s_testFailures), s_testFailures != 0)
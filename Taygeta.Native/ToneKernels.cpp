@@ -0,0 +1,342 @@
+#include "ToneKernels.h"
+#include "CpuFeatures.h"
+
+#ifdef CPU_X86
+#include <immintrin.h>
+#endif
+
+// Scalar reference kernels, the SIMD ones finish their rows with them
+
+static inline BYTE ScaleChromaSample(BYTE c, int gain)
+{
+	int v = 128 + (((c - 128) * gain + 64) >> 7);
+	return (BYTE)(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+static void LookupC(const BYTE* src, BYTE* dst, const BYTE* table, int count)
+{
+	for(int i = 0; i < count; i++)
+	{
+		dst[i] = table[src[i]];
+	}
+}
+
+static void ScaleChromaC(const BYTE* src, BYTE* dst, int gain, int count)
+{
+	for(int i = 0; i < count; i++)
+	{
+		dst[i] = ScaleChromaSample(src[i], gain);
+	}
+}
+
+// y is the byte of the first luma sample in a macropixel, 0 for YUY2 and 1 for UYVY
+template<int y>
+static void AdjustPackedC(const BYTE* src, BYTE* dst, const BYTE* table, int gain, int pairs)
+{
+	for(int i = 0; i < 2 * pairs; i++)
+	{
+		BYTE luma = table[src[2 * i + y]];
+		dst[2 * i + (y ^ 1)] = ScaleChromaSample(src[2 * i + (y ^ 1)], gain);
+		dst[2 * i + y] = luma;
+	}
+}
+
+static const ToneKernels s_scalarKernels =
+{
+	"C",
+	LookupC, ScaleChromaC, AdjustPackedC<0>, AdjustPackedC<1>
+};
+
+#ifdef CPU_X86
+
+#define LOAD128(p) _mm_loadu_si128((const __m128i*)(p))
+#define STORE128(p, x) _mm_storeu_si128((__m128i*)(p), x)
+#define LOAD256(p) _mm256_loadu_si256((const __m256i*)(p))
+#define STORE256(p, x) _mm256_storeu_si256((__m256i*)(p), x)
+
+// SSSE3. pshufb looks up 16 entries by the low nibble and returns zero where the index has
+// its top bit set. The table is taken as two halves of eight rows of 16 entries, each half
+// stored as row 0 and the XOR of every row with the one before it. Samples of the other
+// half are set to 0xff and all samples lowered by 16 before every row: a sample in row h
+// of its half indexes rows 0..h and falls below zero, to 0x80 and above, for the rest,
+// so XOR-ing the lookups leaves row h.
+
+TARGET_SSSE3 static inline void LoadTableSSSE3(const BYTE* table, __m128i* rows)
+{
+	for(int k = 0; k < 16; k++)
+	{
+		rows[k] = LOAD128(table + 16 * k);
+		if(k & 7)
+		{
+			rows[k] = _mm_xor_si128(rows[k], LOAD128(table + 16 * (k - 1)));
+		}
+	}
+}
+
+TARGET_SSSE3 static inline __m128i LookupBlockSSSE3(__m128i x, const __m128i* rows)
+{
+	const __m128i step = _mm_set1_epi8(16);
+	__m128i upper = _mm_cmplt_epi8(x, _mm_setzero_si128());
+	__m128i lo = _mm_or_si128(x, upper);
+	__m128i hi = _mm_or_si128(_mm_xor_si128(x, _mm_set1_epi8(-128)), _mm_cmpeq_epi8(upper, _mm_setzero_si128()));
+	__m128i r0 = _mm_shuffle_epi8(rows[0], lo);
+	__m128i r1 = _mm_shuffle_epi8(rows[8], hi);
+	for(int k = 1; k < 8; k++)
+	{
+		lo = _mm_sub_epi8(lo, step);
+		hi = _mm_sub_epi8(hi, step);
+		r0 = _mm_xor_si128(r0, _mm_shuffle_epi8(rows[k], lo));
+		r1 = _mm_xor_si128(r1, _mm_shuffle_epi8(rows[k + 8], hi));
+	}
+	return _mm_xor_si128(r0, r1);
+}
+
+// Chroma as signed c - 128 in the high bytes of words: pmulhrsw gives (c - 128) * gain / 128
+// rounded as the scalar shift does, packsswb saturates
+TARGET_SSSE3 static inline __m128i ScaleChromaBlockSSSE3(__m128i x, __m128i gain)
+{
+	const __m128i offset = _mm_set1_epi8(-128);
+	__m128i s = _mm_xor_si128(x, offset);
+	__m128i lo = _mm_mulhrs_epi16(_mm_unpacklo_epi8(_mm_setzero_si128(), s), gain);
+	__m128i hi = _mm_mulhrs_epi16(_mm_unpackhi_epi8(_mm_setzero_si128(), s), gain);
+	return _mm_xor_si128(_mm_packs_epi16(lo, hi), offset);
+}
+
+TARGET_SSSE3 static void LookupSSSE3(const BYTE* src, BYTE* dst, const BYTE* table, int count)
+{
+	__m128i rows[16];
+	LoadTableSSSE3(table, rows);
+	int i = 0;
+	for(; i + 16 <= count; i += 16)
+	{
+		STORE128(dst + i, LookupBlockSSSE3(LOAD128(src + i), rows));
+	}
+	LookupC(src + i, dst + i, table, count - i);
+}
+
+TARGET_SSSE3 static void ScaleChromaSSSE3(const BYTE* src, BYTE* dst, int gain, int count)
+{
+	const __m128i g = _mm_set1_epi16((short)gain);
+	int i = 0;
+	for(; i + 16 <= count; i += 16)
+	{
+		STORE128(dst + i, ScaleChromaBlockSSSE3(LOAD128(src + i), g));
+	}
+	ScaleChromaC(src + i, dst + i, gain, count - i);
+}
+
+template<int y>
+TARGET_SSSE3 static void AdjustPackedSSSE3(const BYTE* src, BYTE* dst, const BYTE* table, int gain, int pairs)
+{
+	const __m128i luma = _mm_set1_epi16(y ? (short)0xff00 : 0x00ff);
+	const __m128i g = _mm_set1_epi16((short)gain);
+	__m128i rows[16];
+	LoadTableSSSE3(table, rows);
+	int i = 0;
+	for(; i + 4 <= pairs; i += 4)
+	{
+		__m128i x = LOAD128(src + 4 * i);
+		__m128i a = LookupBlockSSSE3(x, rows);
+		__m128i b = ScaleChromaBlockSSSE3(x, g);
+		STORE128(dst + 4 * i, _mm_or_si128(_mm_and_si128(luma, a), _mm_andnot_si128(luma, b)));
+	}
+	AdjustPackedC<y>(src + 4 * i, dst + 4 * i, table, gain, pairs - i);
+}
+
+static const ToneKernels s_ssse3Kernels =
+{
+	"SSSE3",
+	LookupSSSE3, ScaleChromaSSSE3, AdjustPackedSSSE3<0>, AdjustPackedSSSE3<1>
+};
+
+// AVX2, the same with the table rows in both lanes
+
+TARGET_AVX2 static inline void LoadTableAVX2(const BYTE* table, __m256i* rows)
+{
+	__m128i half[16];
+	LoadTableSSSE3(table, half);
+	for(int k = 0; k < 16; k++)
+	{
+		rows[k] = _mm256_broadcastsi128_si256(half[k]);
+	}
+}
+
+TARGET_AVX2 static inline __m256i LookupBlockAVX2(__m256i x, const __m256i* rows)
+{
+	const __m256i step = _mm256_set1_epi8(16);
+	__m256i upper = _mm256_cmpgt_epi8(_mm256_setzero_si256(), x);
+	__m256i lo = _mm256_or_si256(x, upper);
+	__m256i hi = _mm256_or_si256(_mm256_xor_si256(x, _mm256_set1_epi8(-128)), _mm256_cmpeq_epi8(upper, _mm256_setzero_si256()));
+	__m256i r0 = _mm256_shuffle_epi8(rows[0], lo);
+	__m256i r1 = _mm256_shuffle_epi8(rows[8], hi);
+	for(int k = 1; k < 8; k++)
+	{
+		lo = _mm256_sub_epi8(lo, step);
+		hi = _mm256_sub_epi8(hi, step);
+		r0 = _mm256_xor_si256(r0, _mm256_shuffle_epi8(rows[k], lo));
+		r1 = _mm256_xor_si256(r1, _mm256_shuffle_epi8(rows[k + 8], hi));
+	}
+	return _mm256_xor_si256(r0, r1);
+}
+
+TARGET_AVX2 static inline __m256i ScaleChromaBlockAVX2(__m256i x, __m256i gain)
+{
+	const __m256i offset = _mm256_set1_epi8(-128);
+	__m256i s = _mm256_xor_si256(x, offset);
+	__m256i lo = _mm256_mulhrs_epi16(_mm256_unpacklo_epi8(_mm256_setzero_si256(), s), gain);
+	__m256i hi = _mm256_mulhrs_epi16(_mm256_unpackhi_epi8(_mm256_setzero_si256(), s), gain);
+	return _mm256_xor_si256(_mm256_packs_epi16(lo, hi), offset);
+}
+
+TARGET_AVX2 static void LookupAVX2(const BYTE* src, BYTE* dst, const BYTE* table, int count)
+{
+	__m256i rows[16];
+	LoadTableAVX2(table, rows);
+	int i = 0;
+	for(; i + 32 <= count; i += 32)
+	{
+		STORE256(dst + i, LookupBlockAVX2(LOAD256(src + i), rows));
+	}
+	LookupSSSE3(src + i, dst + i, table, count - i);
+}
+
+TARGET_AVX2 static void ScaleChromaAVX2(const BYTE* src, BYTE* dst, int gain, int count)
+{
+	const __m256i g = _mm256_set1_epi16((short)gain);
+	int i = 0;
+	for(; i + 32 <= count; i += 32)
+	{
+		STORE256(dst + i, ScaleChromaBlockAVX2(LOAD256(src + i), g));
+	}
+	ScaleChromaSSSE3(src + i, dst + i, gain, count - i);
+}
+
+template<int y>
+TARGET_AVX2 static void AdjustPackedAVX2(const BYTE* src, BYTE* dst, const BYTE* table, int gain, int pairs)
+{
+	const __m256i luma = _mm256_set1_epi16(y ? (short)0xff00 : 0x00ff);
+	const __m256i g = _mm256_set1_epi16((short)gain);
+	__m256i rows[16];
+	LoadTableAVX2(table, rows);
+	int i = 0;
+	for(; i + 8 <= pairs; i += 8)
+	{
+		__m256i x = LOAD256(src + 4 * i);
+		__m256i a = LookupBlockAVX2(x, rows);
+		__m256i b = ScaleChromaBlockAVX2(x, g);
+		STORE256(dst + 4 * i, _mm256_blendv_epi8(b, a, luma));
+	}
+	AdjustPackedSSSE3<y>(src + 4 * i, dst + 4 * i, table, gain, pairs - i);
+}
+
+static const ToneKernels s_avx2Kernels =
+{
+	"AVX2",
+	LookupAVX2, ScaleChromaAVX2, AdjustPackedAVX2<0>, AdjustPackedAVX2<1>
+};
+
+// AVX-512 VBMI. vpermi2b looks up 128 entries from two registers by the low seven bits of
+// every byte, so two of them and a blend on the top bit cover the table.
+
+#define LOAD512(p) _mm512_loadu_si512((const void*)(p))
+#define STORE512(p, x) _mm512_storeu_si512((void*)(p), x)
+
+TARGET_AVX512VBMI static inline __m512i LookupBlockAVX512(__m512i x, const __m512i* table)
+{
+	__m512i lo = _mm512_permutex2var_epi8(table[0], x, table[1]);
+	__m512i hi = _mm512_permutex2var_epi8(table[2], x, table[3]);
+	return _mm512_mask_blend_epi8(_mm512_movepi8_mask(x), lo, hi);
+}
+
+TARGET_AVX512VBMI static inline __m512i ScaleChromaBlockAVX512(__m512i x, __m512i gain)
+{
+	const __m512i offset = _mm512_set1_epi8(-128);
+	__m512i s = _mm512_xor_si512(x, offset);
+	__m512i lo = _mm512_mulhrs_epi16(_mm512_unpacklo_epi8(_mm512_setzero_si512(), s), gain);
+	__m512i hi = _mm512_mulhrs_epi16(_mm512_unpackhi_epi8(_mm512_setzero_si512(), s), gain);
+	return _mm512_xor_si512(_mm512_packs_epi16(lo, hi), offset);
+}
+
+TARGET_AVX512VBMI static void LookupAVX512(const BYTE* src, BYTE* dst, const BYTE* table, int count)
+{
+	__m512i t[4] = { LOAD512(table), LOAD512(table + 64), LOAD512(table + 128), LOAD512(table + 192) };
+	int i = 0;
+	for(; i + 64 <= count; i += 64)
+	{
+		STORE512(dst + i, LookupBlockAVX512(LOAD512(src + i), t));
+	}
+	LookupAVX2(src + i, dst + i, table, count - i);
+}
+
+TARGET_AVX512VBMI static void ScaleChromaAVX512(const BYTE* src, BYTE* dst, int gain, int count)
+{
+	const __m512i g = _mm512_set1_epi16((short)gain);
+	int i = 0;
+	for(; i + 64 <= count; i += 64)
+	{
+		STORE512(dst + i, ScaleChromaBlockAVX512(LOAD512(src + i), g));
+	}
+	ScaleChromaAVX2(src + i, dst + i, gain, count - i);
+}
+
+template<int y>
+TARGET_AVX512VBMI static void AdjustPackedAVX512(const BYTE* src, BYTE* dst, const BYTE* table, int gain, int pairs)
+{
+	const __mmask64 luma = y ? 0xaaaaaaaaaaaaaaaaULL : 0x5555555555555555ULL;
+	const __m512i g = _mm512_set1_epi16((short)gain);
+	__m512i t[4] = { LOAD512(table), LOAD512(table + 64), LOAD512(table + 128), LOAD512(table + 192) };
+	int i = 0;
+	for(; i + 16 <= pairs; i += 16)
+	{
+		__m512i x = LOAD512(src + 4 * i);
+		STORE512(dst + 4 * i, _mm512_mask_blend_epi8(luma, ScaleChromaBlockAVX512(x, g), LookupBlockAVX512(x, t)));
+	}
+	AdjustPackedAVX2<y>(src + 4 * i, dst + 4 * i, table, gain, pairs - i);
+}
+
+static const ToneKernels s_avx512Kernels =
+{
+	"AVX512VBMI",
+	LookupAVX512, ScaleChromaAVX512, AdjustPackedAVX512<0>, AdjustPackedAVX512<1>
+};
+
+#endif
+
+const ToneKernels* GetToneKernels(int feature)
+{
+	switch(feature)
+	{
+	case 0:
+		return &s_scalarKernels;
+#ifdef CPU_X86
+	case CPU_SSSE3:
+		return &s_ssse3Kernels;
+	case CPU_AVX2:
+		return &s_avx2Kernels;
+	case CPU_AVX512VBMI:
+		return &s_avx512Kernels;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+const ToneKernels* GetToneKernels(void)
+{
+#ifdef CPU_X86
+	int features = GetCpuFeatures();
+	if(features & CPU_AVX512VBMI)
+	{
+		return &s_avx512Kernels;
+	}
+	if(features & CPU_AVX2)
+	{
+		return &s_avx2Kernels;
+	}
+	if(features & CPU_SSSE3)
+	{
+		return &s_ssse3Kernels;
+	}
+#endif
+	return &s_scalarKernels;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "NativeLib.h"
+
+// Row kernels behind AdjustTone: luma through a 256-byte table, chroma scaled around 128
+// by gain / 128, rounded and saturated. dst may be src, for adjustments in place. Every
+// instruction set computes the same bytes.
+struct ToneKernels
+{
+	const char* Name;
+
+	// dst[i] = table[src[i]]
+	void (*Lookup)(const BYTE* src, BYTE* dst, const BYTE* table, int count);
+
+	// dst[i] = 128 + ((src[i] - 128) * gain + 64 >> 7), gain 0..32767
+	void (*ScaleChroma)(const BYTE* src, BYTE* dst, int gain, int count);
+
+	// Both at once on YUY2 and UYVY macropixels
+	void (*AdjustYuy2)(const BYTE* src, BYTE* dst, const BYTE* table, int gain, int pairs);
+	void (*AdjustUyvy)(const BYTE* src, BYTE* dst, const BYTE* table, int gain, int pairs);
+};
+
+// Kernels of the best instruction set GetCpuFeatures allows
+NATIVELIB const ToneKernels* GetToneKernels(void);
+
+// Kernels of one instruction set (a CpuFeature, 0 for the scalar reference), NULL when
+// the library was built without them
+NATIVELIB const ToneKernels* GetToneKernels(int feature);
@@ -0,0 +1,412 @@
+#include "YuvConvert.h"
+#include "YuvKernels.h"
+#include "FrameCopy.h"
+
+#include <string.h>
+#include <vector>
+
+enum YuvPacking
+{
+	YP_GRAY,
+	YP_PLANAR,
+	YP_SEMIPLANAR,
+	YP_YUY2,
+	YP_UYVY
+};
+
+struct YuvLayout
+{
+	YuvPacking Packing;
+	int ShiftX;			// log2 of the chroma subsampling
+	int ShiftY;
+	int UPlane;			// planar chroma planes
+	int VPlane;
+	bool VFirst;		// semi-planar chroma stored as V, U pairs
+};
+
+static bool GetYuvLayout(FrameFormat format, YuvLayout& layout)
+{
+	static const YuvLayout gray = { YP_GRAY, 0, 0, 0, 0, false };
+	static const YuvLayout yuv = { YP_PLANAR, 0, 0, 1, 2, false };
+	static const YuvLayout yuy2 = { YP_YUY2, 1, 0, 0, 0, false };
+	static const YuvLayout uyvy = { YP_UYVY, 1, 0, 0, 0, false };
+	static const YuvLayout yv12 = { YP_PLANAR, 1, 1, 2, 1, false };
+	static const YuvLayout i420 = { YP_PLANAR, 1, 1, 1, 2, false };
+	static const YuvLayout nv12 = { YP_SEMIPLANAR, 1, 1, 1, 1, false };
+	static const YuvLayout nv21 = { YP_SEMIPLANAR, 1, 1, 1, 1, true };
+	static const YuvLayout y411 = { YP_PLANAR, 2, 0, 1, 2, false };
+	static const YuvLayout y410 = { YP_PLANAR, 2, 2, 1, 2, false };
+	static const YuvLayout i422 = { YP_PLANAR, 1, 0, 1, 2, false };
+
+	switch(format)
+	{
+	case FF_Y800: layout = gray; return true;
+	case FF_YUV: layout = yuv; return true;
+	case FF_YUY2: layout = yuy2; return true;
+	case FF_UYVY: layout = uyvy; return true;
+	case FF_YV12: layout = yv12; return true;
+	case FF_I420: layout = i420; return true;
+	case FF_NV12: layout = nv12; return true;
+	case FF_NV21: layout = nv21; return true;
+	case FF_Y411: layout = y411; return true;
+	case FF_Y410: layout = y410; return true;
+	case FF_I422: layout = i422; return true;
+	default: return false;
+	}
+}
+
+static bool IsPacked(const YuvLayout& layout)
+{
+	return layout.Packing == YP_YUY2 || layout.Packing == YP_UYVY;
+}
+
+static inline BYTE* Row(BYTE* plane, int pitch, int y)
+{
+	return plane + (ptrdiff_t)y * pitch;
+}
+
+static inline int ChromaCount(int size, int shift)
+{
+	return (size + (1 << shift) - 1) >> shift;
+}
+
+// Converts chroma one target chroma row at a time: source rows are fetched as planar
+// U and V rows, combined vertically, resampled horizontally and stored in the target
+// layout. Luma is copied by plane, or unpacked and packed along with the chroma.
+class CYuvFrameConverter
+{
+public:
+	CYuvFrameConverter(const CPlanarFrame* src, CPlanarFrame* dst, const YuvLayout& srcLayout, const YuvLayout& dstLayout)
+		: m_src(src), m_dst(dst), m_in(srcLayout), m_out(dstLayout), m_k(GetYuvRowKernels()),
+		m_width(src->GetWidth()), m_height(src->GetHeight())
+	{
+		// Neutral chroma stands in for the planes of a gray source at the target's sampling
+		if(m_in.Packing == YP_GRAY)
+		{
+			m_in.ShiftX = m_out.ShiftX;
+			m_in.ShiftY = m_out.ShiftY;
+		}
+
+		m_rowSize = m_width + 4;
+		m_scratch.resize((size_t)m_rowSize * SCRATCH_ROWS);
+		for(int i = 0; i < 4; i++)
+		{
+			m_slotRow[i] = -1;
+		}
+		if(m_in.Packing == YP_GRAY)
+		{
+			memset(Scratch(NEUTRAL), 128, m_rowSize);
+		}
+	}
+
+	void Run(void)
+	{
+		if(!IsPacked(m_in) && !IsPacked(m_out))
+		{
+			CopyPlane(m_dst->GetPlane(0), m_dst->GetPitch(0), m_src->GetPlane(0), m_src->GetPitch(0), m_width, m_height);
+		}
+
+		if(m_out.Packing == YP_GRAY)
+		{
+			// Only packed sources still have luma to unpack
+			if(IsPacked(m_in))
+			{
+				for(int y = 0; y < m_height; y++)
+				{
+					const BYTE* u;
+					const BYTE* v;
+					FetchChroma(y, &u, &v);
+				}
+			}
+			return;
+		}
+
+		int rows = ChromaCount(m_height, m_out.ShiftY);
+		for(int j = 0; j < rows; j++)
+		{
+			const BYTE* u;
+			const BYTE* v;
+			BYTE* uOut = NULL;
+			BYTE* vOut = NULL;
+			if(m_out.Packing == YP_PLANAR)
+			{
+				uOut = Row(m_dst->GetPlane(m_out.UPlane), m_dst->GetPitch(m_out.UPlane), j);
+				vOut = Row(m_dst->GetPlane(m_out.VPlane), m_dst->GetPitch(m_out.VPlane), j);
+			}
+
+			bool resample = m_in.ShiftX != m_out.ShiftX;
+			CombineRows(j, &u, &v, resample ? NULL : uOut, resample ? NULL : vOut);
+			if(resample)
+			{
+				ResampleRow(&u, &v, uOut, vOut);
+			}
+			StoreRow(j, u, v, uOut, vOut);
+		}
+	}
+
+private:
+	enum
+	{
+		SLOT_U = 0,			// four fetched source rows of U, then of V
+		SLOT_V = 4,
+		COMBINED_U = 8,		// vertical averages
+		COMBINED_V = 10,
+		RESAMPLED_U = 12,	// horizontal resampling, ping-ponged
+		RESAMPLED_V = 14,
+		NEUTRAL = 16,
+		SCRATCH_ROWS = 17
+	};
+
+	const CPlanarFrame* m_src;
+	CPlanarFrame* m_dst;
+	YuvLayout m_in;
+	YuvLayout m_out;
+	const YuvRowKernels* m_k;
+	int m_width;
+	int m_height;
+	int m_rowSize;
+	std::vector<BYTE> m_scratch;
+	int m_slotRow[4];
+
+	BYTE* Scratch(int row)
+	{
+		return &m_scratch[(size_t)row * m_rowSize];
+	}
+
+	// Planar U and V of source chroma row r. Unpacking a packed row writes its luma into
+	// the target luma plane on the way. Rows split from interleaved sources go into uOut
+	// and vOut when given, and are kept for the next fetch otherwise.
+	void FetchChroma(int r, const BYTE** u, const BYTE** v, BYTE* uOut = NULL, BYTE* vOut = NULL)
+	{
+		switch(m_in.Packing)
+		{
+		case YP_GRAY:
+			*u = *v = Scratch(NEUTRAL);
+			return;
+
+		case YP_PLANAR:
+			*u = Row(m_src->GetPlane(m_in.UPlane), m_src->GetPitch(m_in.UPlane), r);
+			*v = Row(m_src->GetPlane(m_in.VPlane), m_src->GetPitch(m_in.VPlane), r);
+			return;
+
+		default:
+			break;
+		}
+
+		int slot = r & 3;
+		BYTE* su = uOut ? uOut : Scratch(SLOT_U + slot);
+		BYTE* sv = vOut ? vOut : Scratch(SLOT_V + slot);
+		*u = su;
+		*v = sv;
+		if(!uOut)
+		{
+			if(m_slotRow[slot] == r)
+			{
+				return;
+			}
+			m_slotRow[slot] = r;
+		}
+
+		if(m_in.Packing == YP_SEMIPLANAR)
+		{
+			const BYTE* uv = Row(m_src->GetPlane(1), m_src->GetPitch(1), r);
+			m_k->Deinterleave(uv, m_in.VFirst ? sv : su, m_in.VFirst ? su : sv, ChromaCount(m_width, 1));
+			return;
+		}
+
+		const BYTE* in = Row(m_src->GetPlane(0), m_src->GetPitch(0), r);
+
+		bool uyvy = m_in.Packing == YP_UYVY;
+		BYTE* y = Row(m_dst->GetPlane(0), m_dst->GetPitch(0), r);
+		int pairs = m_width / 2;
+		(uyvy ? m_k->UnpackUyvy : m_k->UnpackYuy2)(in, y, su, sv, pairs);
+		if(m_width & 1)
+		{
+			const BYTE* last = in + 4 * pairs;
+			y[2 * pairs] = last[uyvy ? 1 : 0];
+			su[pairs] = last[uyvy ? 0 : 1];
+			sv[pairs] = last[uyvy ? 2 : 3];
+		}
+	}
+
+	// Source chroma for target chroma row j: the average of the rows it covers, or the
+	// row covering it. Rows used once go straight into uOut and vOut when given.
+	void CombineRows(int j, const BYTE** u, const BYTE** v, BYTE* uOut, BYTE* vOut)
+	{
+		if(m_out.ShiftY == m_in.ShiftY)
+		{
+			FetchChroma(j, u, v, uOut, vOut);
+			return;
+		}
+		if(m_out.ShiftY < m_in.ShiftY)
+		{
+			FetchChroma(j >> (m_in.ShiftY - m_out.ShiftY), u, v);
+			return;
+		}
+
+		int count = ChromaCount(m_width, m_in.ShiftX);
+		int lastRow = ChromaCount(m_height, m_in.ShiftY) - 1;
+		int n = 1 << (m_out.ShiftY - m_in.ShiftY);
+		int first = j * n;
+
+		const BYTE* us[4];
+		const BYTE* vs[4];
+		for(int i = 0; i < n; i++)
+		{
+			FetchChroma(first + i < lastRow ? first + i : lastRow, &us[i], &vs[i]);
+		}
+
+		BYTE* cu = uOut ? uOut : Scratch(COMBINED_U);
+		BYTE* cv = vOut ? vOut : Scratch(COMBINED_V);
+		if(n == 2)
+		{
+			m_k->AverageRows(us[0], us[1], cu, count);
+			m_k->AverageRows(vs[0], vs[1], cv, count);
+		}
+		else
+		{
+			// Pairwise, so every row weighs the same
+			BYTE* tu = Scratch(COMBINED_U + 1);
+			BYTE* tv = Scratch(COMBINED_V + 1);
+			m_k->AverageRows(us[0], us[1], tu, count);
+			m_k->AverageRows(us[2], us[3], cu, count);
+			m_k->AverageRows(tu, cu, cu, count);
+			m_k->AverageRows(vs[0], vs[1], tv, count);
+			m_k->AverageRows(vs[2], vs[3], cv, count);
+			m_k->AverageRows(tv, cv, cv, count);
+		}
+		*u = cu;
+		*v = cv;
+	}
+
+	// Halves or doubles the chroma row until it matches the target subsampling. The last
+	// halving goes straight into uOut and vOut when given.
+	void ResampleRow(const BYTE** u, const BYTE** v, BYTE* uOut, BYTE* vOut)
+	{
+		int count = ChromaCount(m_width, m_in.ShiftX);
+		int steps = m_out.ShiftX - m_in.ShiftX;
+		int buffer = 0;
+
+		for(int s = 0; s < (steps > 0 ? steps : -steps); s++)
+		{
+			bool last = s == (steps > 0 ? steps : -steps) - 1;
+			BYTE* ru = Scratch(RESAMPLED_U + buffer);
+			BYTE* rv = Scratch(RESAMPLED_V + buffer);
+			if(steps > 0)
+			{
+				if(last && uOut)
+				{
+					ru = uOut;
+					rv = vOut;
+				}
+				m_k->HalveRow(*u, ru, count / 2);
+				m_k->HalveRow(*v, rv, count / 2);
+				if(count & 1)
+				{
+					ru[count / 2] = (*u)[count - 1];
+					rv[count / 2] = (*v)[count - 1];
+				}
+				count = (count + 1) / 2;
+			}
+			else
+			{
+				// Rounds up past the target width, the scratch rows have room for that
+				m_k->DoubleRow(*u, ru, count);
+				m_k->DoubleRow(*v, rv, count);
+				count *= 2;
+			}
+			*u = ru;
+			*v = rv;
+			buffer ^= 1;
+		}
+	}
+
+	void StoreRow(int j, const BYTE* u, const BYTE* v, BYTE* uOut, BYTE* vOut)
+	{
+		int count = ChromaCount(m_width, m_out.ShiftX);
+		switch(m_out.Packing)
+		{
+		case YP_PLANAR:
+			if(u != uOut)
+			{
+				memcpy(uOut, u, count);
+				memcpy(vOut, v, count);
+			}
+			break;
+
+		case YP_SEMIPLANAR:
+		{
+			BYTE* out = Row(m_dst->GetPlane(1), m_dst->GetPitch(1), j);
+			m_k->Interleave(m_out.VFirst ? v : u, m_out.VFirst ? u : v, out, count);
+			break;
+		}
+
+		default:
+		{
+			bool uyvy = m_out.Packing == YP_UYVY;
+			const BYTE* y = Row(m_src->GetPlane(0), m_src->GetPitch(0), j);
+			BYTE* out = Row(m_dst->GetPlane(0), m_dst->GetPitch(0), j);
+			int pairs = m_width / 2;
+			(uyvy ? m_k->PackUyvy : m_k->PackYuy2)(y, u, v, out, pairs);
+			if(m_width & 1)
+			{
+				// The last pair repeats the last luma sample
+				BYTE* last = out + 4 * pairs;
+				last[uyvy ? 1 : 0] = y[2 * pairs];
+				last[uyvy ? 3 : 2] = y[2 * pairs];
+				last[uyvy ? 0 : 1] = u[pairs];
+				last[uyvy ? 2 : 3] = v[pairs];
+			}
+			break;
+		}
+		}
+	}
+};
+
+bool CanConvertYuv(FrameFormat src, FrameFormat dst)
+{
+	YuvLayout a, b;
+	return GetYuvLayout(src, a) && GetYuvLayout(dst, b);
+}
+
+void ConvertYuvFrame(const CPlanarFrame* src, CPlanarFrame* dst)
+{
+	YuvLayout in, out;
+	if(!GetYuvLayout(src->GetFormat(), in) || !GetYuvLayout(dst->GetFormat(), out))
+	{
+		throw "Unsupported conversion";
+	}
+	if(src->GetWidth() != dst->GetWidth() || src->GetHeight() != dst->GetHeight())
+	{
+		throw "Frames differ in size";
+	}
+
+	if(src->GetFormat() == dst->GetFormat())
+	{
+		CopyFrame(src, dst);
+		return;
+	}
+
+	// Layouts differing only in the order of U and V swap byte pairs in one pass
+	const YuvRowKernels* k = GetYuvRowKernels();
+	if(IsPacked(in) && IsPacked(out))
+	{
+		for(int y = 0; y < src->GetHeight(); y++)
+		{
+			k->SwapPairs(Row(src->GetPlane(0), src->GetPitch(0), y), Row(dst->GetPlane(0), dst->GetPitch(0), y), src->GetRowBytes(0) / 2);
+		}
+		return;
+	}
+	if(in.Packing == YP_SEMIPLANAR && out.Packing == YP_SEMIPLANAR)
+	{
+		CopyPlane(dst->GetPlane(0), dst->GetPitch(0), src->GetPlane(0), src->GetPitch(0), src->GetRowBytes(0), src->GetLines(0));
+		for(int y = 0; y < src->GetLines(1); y++)
+		{
+			k->SwapPairs(Row(src->GetPlane(1), src->GetPitch(1), y), Row(dst->GetPlane(1), dst->GetPitch(1), y), src->GetRowBytes(1) / 2);
+		}
+		return;
+	}
+
+	CYuvFrameConverter converter(src, dst, in, out);
+	converter.Run();
+}
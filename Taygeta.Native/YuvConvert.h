@@ -0,0 +1,14 @@
+#pragma once
+
+#include "NativeLib.h"
+#include "FrameFormat.h"
+#include "PlanarFrame.h"
+
+// Repacking between the 8-bit YUV layouts (Y800, YUV, YUY2, UYVY, YV12, I420, NV12,
+// NV21, Y411, Y410 and I422) at the same size, with the row kernels of YuvKernels.h.
+// Chroma is averaged where the target subsamples further and repeated where it
+// subsamples less; gray sources get neutral chroma and gray targets keep the luma.
+NATIVELIB bool CanConvertYuv(FrameFormat src, FrameFormat dst);
+
+// Frames must be of the same size; fails for pairs CanConvertYuv rejects
+NATIVELIB void ConvertYuvFrame(const CPlanarFrame* src, CPlanarFrame* dst);
@@ -0,0 +1,693 @@
+#include "YuvKernels.h"
+#include "CpuFeatures.h"
+
+#ifdef CPU_X86
+#include <immintrin.h>
+#endif
+
+// Scalar reference kernels, the SIMD ones finish their rows with them
+
+static void InterleaveC(const BYTE* u, const BYTE* v, BYTE* uv, int count)
+{
+	for(int i = 0; i < count; i++)
+	{
+		uv[2 * i] = u[i];
+		uv[2 * i + 1] = v[i];
+	}
+}
+
+static void DeinterleaveC(const BYTE* uv, BYTE* u, BYTE* v, int count)
+{
+	for(int i = 0; i < count; i++)
+	{
+		u[i] = uv[2 * i];
+		v[i] = uv[2 * i + 1];
+	}
+}
+
+static void SwapPairsC(const BYTE* src, BYTE* dst, int pairs)
+{
+	for(int i = 0; i < pairs; i++)
+	{
+		BYTE a = src[2 * i];
+		dst[2 * i] = src[2 * i + 1];
+		dst[2 * i + 1] = a;
+	}
+}
+
+static void PackYuy2C(const BYTE* y, const BYTE* u, const BYTE* v, BYTE* dst, int pairs)
+{
+	for(int i = 0; i < pairs; i++)
+	{
+		dst[4 * i] = y[2 * i];
+		dst[4 * i + 1] = u[i];
+		dst[4 * i + 2] = y[2 * i + 1];
+		dst[4 * i + 3] = v[i];
+	}
+}
+
+static void PackUyvyC(const BYTE* y, const BYTE* u, const BYTE* v, BYTE* dst, int pairs)
+{
+	for(int i = 0; i < pairs; i++)
+	{
+		dst[4 * i] = u[i];
+		dst[4 * i + 1] = y[2 * i];
+		dst[4 * i + 2] = v[i];
+		dst[4 * i + 3] = y[2 * i + 1];
+	}
+}
+
+static void UnpackYuy2C(const BYTE* src, BYTE* y, BYTE* u, BYTE* v, int pairs)
+{
+	for(int i = 0; i < pairs; i++)
+	{
+		y[2 * i] = src[4 * i];
+		u[i] = src[4 * i + 1];
+		y[2 * i + 1] = src[4 * i + 2];
+		v[i] = src[4 * i + 3];
+	}
+}
+
+static void UnpackUyvyC(const BYTE* src, BYTE* y, BYTE* u, BYTE* v, int pairs)
+{
+	for(int i = 0; i < pairs; i++)
+	{
+		u[i] = src[4 * i];
+		y[2 * i] = src[4 * i + 1];
+		v[i] = src[4 * i + 2];
+		y[2 * i + 1] = src[4 * i + 3];
+	}
+}
+
+static void AverageRowsC(const BYTE* a, const BYTE* b, BYTE* dst, int count)
+{
+	for(int i = 0; i < count; i++)
+	{
+		dst[i] = (BYTE)((a[i] + b[i] + 1) >> 1);
+	}
+}
+
+static void HalveRowC(const BYTE* src, BYTE* dst, int count)
+{
+	for(int i = 0; i < count; i++)
+	{
+		dst[i] = (BYTE)((src[2 * i] + src[2 * i + 1] + 1) >> 1);
+	}
+}
+
+static void DoubleRowC(const BYTE* src, BYTE* dst, int count)
+{
+	for(int i = 0; i < count; i++)
+	{
+		dst[2 * i] = src[i];
+		dst[2 * i + 1] = src[i];
+	}
+}
+
+static inline BYTE Mean2x2(const BYTE* row0, const BYTE* row1, int a, int b)
+{
+	int left = (row0[a] + row1[a] + 1) >> 1;
+	int right = (row0[b] + row1[b] + 1) >> 1;
+	return (BYTE)((left + right + 1) >> 1);
+}
+
+static void Reduce2x2C(const BYTE* row0, const BYTE* row1, BYTE* dst, int count)
+{
+	for(int i = 0; i < count; i++)
+	{
+		dst[i] = Mean2x2(row0, row1, 2 * i, 2 * i + 1);
+	}
+}
+
+static void Reduce2x2PairsC(const BYTE* row0, const BYTE* row1, BYTE* dst, int pairs)
+{
+	for(int i = 0; i < pairs; i++)
+	{
+		dst[2 * i] = Mean2x2(row0, row1, 4 * i, 4 * i + 2);
+		dst[2 * i + 1] = Mean2x2(row0, row1, 4 * i + 1, 4 * i + 3);
+	}
+}
+
+// Macropixels of luma at l, l + 2 and chroma at c, c + 2
+template<int l, int c>
+static void Reduce2x2PackedC(const BYTE* row0, const BYTE* row1, BYTE* dst, int pairs)
+{
+	for(int i = 0; i < pairs; i++, row0 += 8, row1 += 8, dst += 4)
+	{
+		dst[l] = Mean2x2(row0, row1, l, l + 2);
+		dst[l + 2] = Mean2x2(row0, row1, l + 4, l + 6);
+		dst[c] = Mean2x2(row0, row1, c, c + 4);
+		dst[c + 2] = Mean2x2(row0, row1, c + 2, c + 6);
+	}
+}
+
+static const YuvRowKernels s_scalarKernels =
+{
+	"C",
+	InterleaveC, DeinterleaveC, SwapPairsC,
+	PackYuy2C, PackUyvyC, UnpackYuy2C, UnpackUyvyC,
+	AverageRowsC, HalveRowC, DoubleRowC,
+	Reduce2x2C, Reduce2x2PairsC, Reduce2x2PackedC<0, 1>, Reduce2x2PackedC<1, 0>
+};
+
+#ifdef CPU_X86
+
+#define LOAD128(p) _mm_loadu_si128((const __m128i*)(p))
+#define STORE128(p, x) _mm_storeu_si128((__m128i*)(p), x)
+#define LOAD256(p) _mm256_loadu_si256((const __m256i*)(p))
+#define STORE256(p, x) _mm256_storeu_si256((__m256i*)(p), x)
+
+// SSE2
+
+static void InterleaveSSE2(const BYTE* u, const BYTE* v, BYTE* uv, int count)
+{
+	int i = 0;
+	for(; i + 16 <= count; i += 16)
+	{
+		__m128i a = LOAD128(u + i);
+		__m128i b = LOAD128(v + i);
+		STORE128(uv + 2 * i, _mm_unpacklo_epi8(a, b));
+		STORE128(uv + 2 * i + 16, _mm_unpackhi_epi8(a, b));
+	}
+	InterleaveC(u + i, v + i, uv + 2 * i, count - i);
+}
+
+static void DeinterleaveSSE2(const BYTE* uv, BYTE* u, BYTE* v, int count)
+{
+	const __m128i mask = _mm_set1_epi16(0xff);
+	int i = 0;
+	for(; i + 16 <= count; i += 16)
+	{
+		__m128i a = LOAD128(uv + 2 * i);
+		__m128i b = LOAD128(uv + 2 * i + 16);
+		STORE128(u + i, _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+		STORE128(v + i, _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+	}
+	DeinterleaveC(uv + 2 * i, u + i, v + i, count - i);
+}
+
+static void SwapPairsSSE2(const BYTE* src, BYTE* dst, int pairs)
+{
+	int i = 0;
+	for(; i + 8 <= pairs; i += 8)
+	{
+		__m128i a = LOAD128(src + 2 * i);
+		STORE128(dst + 2 * i, _mm_or_si128(_mm_slli_epi16(a, 8), _mm_srli_epi16(a, 8)));
+	}
+	SwapPairsC(src + 2 * i, dst + 2 * i, pairs - i);
+}
+
+template<bool uyvy>
+static void Pack422SSE2(const BYTE* y, const BYTE* u, const BYTE* v, BYTE* dst, int pairs)
+{
+	int i = 0;
+	for(; i + 16 <= pairs; i += 16)
+	{
+		__m128i y0 = LOAD128(y + 2 * i);
+		__m128i y1 = LOAD128(y + 2 * i + 16);
+		__m128i uu = LOAD128(u + i);
+		__m128i vv = LOAD128(v + i);
+		__m128i uvlo = _mm_unpacklo_epi8(uu, vv);
+		__m128i uvhi = _mm_unpackhi_epi8(uu, vv);
+		BYTE* out = dst + 4 * i;
+		if(uyvy)
+		{
+			STORE128(out, _mm_unpacklo_epi8(uvlo, y0));
+			STORE128(out + 16, _mm_unpackhi_epi8(uvlo, y0));
+			STORE128(out + 32, _mm_unpacklo_epi8(uvhi, y1));
+			STORE128(out + 48, _mm_unpackhi_epi8(uvhi, y1));
+		}
+		else
+		{
+			STORE128(out, _mm_unpacklo_epi8(y0, uvlo));
+			STORE128(out + 16, _mm_unpackhi_epi8(y0, uvlo));
+			STORE128(out + 32, _mm_unpacklo_epi8(y1, uvhi));
+			STORE128(out + 48, _mm_unpackhi_epi8(y1, uvhi));
+		}
+	}
+	if(uyvy)
+	{
+		PackUyvyC(y + 2 * i, u + i, v + i, dst + 4 * i, pairs - i);
+	}
+	else
+	{
+		PackYuy2C(y + 2 * i, u + i, v + i, dst + 4 * i, pairs - i);
+	}
+}
+
+template<bool uyvy>
+static void Unpack422SSE2(const BYTE* src, BYTE* y, BYTE* u, BYTE* v, int pairs)
+{
+	const __m128i mask = _mm_set1_epi16(0xff);
+	int i = 0;
+	for(; i + 16 <= pairs; i += 16)
+	{
+		const BYTE* in = src + 4 * i;
+		__m128i a = LOAD128(in);
+		__m128i b = LOAD128(in + 16);
+		__m128i c = LOAD128(in + 32);
+		__m128i d = LOAD128(in + 48);
+
+		__m128i y0, y1, uv0, uv1;
+		if(uyvy)
+		{
+			y0 = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+			y1 = _mm_packus_epi16(_mm_srli_epi16(c, 8), _mm_srli_epi16(d, 8));
+			uv0 = _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+			uv1 = _mm_packus_epi16(_mm_and_si128(c, mask), _mm_and_si128(d, mask));
+		}
+		else
+		{
+			y0 = _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+			y1 = _mm_packus_epi16(_mm_and_si128(c, mask), _mm_and_si128(d, mask));
+			uv0 = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+			uv1 = _mm_packus_epi16(_mm_srli_epi16(c, 8), _mm_srli_epi16(d, 8));
+		}
+
+		STORE128(y + 2 * i, y0);
+		STORE128(y + 2 * i + 16, y1);
+		STORE128(u + i, _mm_packus_epi16(_mm_and_si128(uv0, mask), _mm_and_si128(uv1, mask)));
+		STORE128(v + i, _mm_packus_epi16(_mm_srli_epi16(uv0, 8), _mm_srli_epi16(uv1, 8)));
+	}
+	if(uyvy)
+	{
+		UnpackUyvyC(src + 4 * i, y + 2 * i, u + i, v + i, pairs - i);
+	}
+	else
+	{
+		UnpackYuy2C(src + 4 * i, y + 2 * i, u + i, v + i, pairs - i);
+	}
+}
+
+static void AverageRowsSSE2(const BYTE* a, const BYTE* b, BYTE* dst, int count)
+{
+	int i = 0;
+	for(; i + 16 <= count; i += 16)
+	{
+		STORE128(dst + i, _mm_avg_epu8(LOAD128(a + i), LOAD128(b + i)));
+	}
+	AverageRowsC(a + i, b + i, dst + i, count - i);
+}
+
+static void HalveRowSSE2(const BYTE* src, BYTE* dst, int count)
+{
+	const __m128i mask = _mm_set1_epi16(0xff);
+	int i = 0;
+	for(; i + 16 <= count; i += 16)
+	{
+		__m128i a = LOAD128(src + 2 * i);
+		__m128i b = LOAD128(src + 2 * i + 16);
+		__m128i even = _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+		__m128i odd = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+		STORE128(dst + i, _mm_avg_epu8(even, odd));
+	}
+	HalveRowC(src + 2 * i, dst + i, count - i);
+}
+
+static void DoubleRowSSE2(const BYTE* src, BYTE* dst, int count)
+{
+	int i = 0;
+	for(; i + 16 <= count; i += 16)
+	{
+		__m128i a = LOAD128(src + i);
+		STORE128(dst + 2 * i, _mm_unpacklo_epi8(a, a));
+		STORE128(dst + 2 * i + 16, _mm_unpackhi_epi8(a, a));
+	}
+	DoubleRowC(src + i, dst + 2 * i, count - i);
+}
+
+static void Reduce2x2SSE2(const BYTE* row0, const BYTE* row1, BYTE* dst, int count)
+{
+	const __m128i mask = _mm_set1_epi16(0xff);
+	int i = 0;
+	for(; i + 16 <= count; i += 16)
+	{
+		__m128i a = _mm_avg_epu8(LOAD128(row0 + 2 * i), LOAD128(row1 + 2 * i));
+		__m128i b = _mm_avg_epu8(LOAD128(row0 + 2 * i + 16), LOAD128(row1 + 2 * i + 16));
+		__m128i even = _mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+		__m128i odd = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+		STORE128(dst + i, _mm_avg_epu8(even, odd));
+	}
+	Reduce2x2C(row0 + 2 * i, row1 + 2 * i, dst + i, count - i);
+}
+
+// Pairs are 16-bit words; they pass the signed 32-bit pack offset by 0x8000
+static void Reduce2x2PairsSSE2(const BYTE* row0, const BYTE* row1, BYTE* dst, int pairs)
+{
+	const __m128i mask = _mm_set1_epi32(0xffff);
+	const __m128i offset = _mm_set1_epi32(0x8000);
+	int i = 0;
+	for(; i + 8 <= pairs; i += 8)
+	{
+		__m128i a = _mm_avg_epu8(LOAD128(row0 + 4 * i), LOAD128(row1 + 4 * i));
+		__m128i b = _mm_avg_epu8(LOAD128(row0 + 4 * i + 16), LOAD128(row1 + 4 * i + 16));
+		a = _mm_sub_epi32(_mm_avg_epu8(_mm_and_si128(a, mask), _mm_srli_epi32(a, 16)), offset);
+		b = _mm_sub_epi32(_mm_avg_epu8(_mm_and_si128(b, mask), _mm_srli_epi32(b, 16)), offset);
+		STORE128(dst + 2 * i, _mm_xor_si128(_mm_packs_epi32(a, b), _mm_set1_epi16((short)0x8000)));
+	}
+	Reduce2x2PairsC(row0 + 4 * i, row1 + 4 * i, dst + 2 * i, pairs - i);
+}
+
+// Luma and chroma as 16-bit samples: neighbouring luma words are averaged, and chroma words
+// two apart, then the words are put back together
+template<bool uyvy>
+static inline __m128i Reduce2x2PackedSSE2(__m128i a, __m128i b)
+{
+	const __m128i mask = _mm_set1_epi16(0xff);
+	const __m128i lowWord = _mm_set1_epi32(0xffff);
+	__m128i ya = uyvy ? _mm_srli_epi16(a, 8) : _mm_and_si128(a, mask);
+	__m128i yb = uyvy ? _mm_srli_epi16(b, 8) : _mm_and_si128(b, mask);
+	__m128i ca = uyvy ? _mm_and_si128(a, mask) : _mm_srli_epi16(a, 8);
+	__m128i cb = uyvy ? _mm_and_si128(b, mask) : _mm_srli_epi16(b, 8);
+
+	ya = _mm_avg_epu16(_mm_and_si128(ya, lowWord), _mm_srli_epi32(ya, 16));
+	yb = _mm_avg_epu16(_mm_and_si128(yb, lowWord), _mm_srli_epi32(yb, 16));
+	__m128i luma = _mm_packs_epi32(ya, yb);
+
+	ca = _mm_avg_epu16(_mm_shuffle_epi32(ca, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_epi32(ca, _MM_SHUFFLE(3, 1, 3, 1)));
+	cb = _mm_avg_epu16(_mm_shuffle_epi32(cb, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_epi32(cb, _MM_SHUFFLE(3, 1, 3, 1)));
+	__m128i chroma = _mm_unpacklo_epi64(ca, cb);
+
+	return uyvy ? _mm_or_si128(chroma, _mm_slli_epi16(luma, 8)) : _mm_or_si128(luma, _mm_slli_epi16(chroma, 8));
+}
+
+template<bool uyvy>
+static void Reduce2x2PackedSSE2(const BYTE* row0, const BYTE* row1, BYTE* dst, int pairs)
+{
+	int i = 0;
+	for(; i + 4 <= pairs; i += 4)
+	{
+		__m128i a = _mm_avg_epu8(LOAD128(row0 + 8 * i), LOAD128(row1 + 8 * i));
+		__m128i b = _mm_avg_epu8(LOAD128(row0 + 8 * i + 16), LOAD128(row1 + 8 * i + 16));
+		STORE128(dst + 4 * i, Reduce2x2PackedSSE2<uyvy>(a, b));
+	}
+	if(uyvy)
+	{
+		Reduce2x2PackedC<1, 0>(row0 + 8 * i, row1 + 8 * i, dst + 4 * i, pairs - i);
+	}
+	else
+	{
+		Reduce2x2PackedC<0, 1>(row0 + 8 * i, row1 + 8 * i, dst + 4 * i, pairs - i);
+	}
+}
+
+static const YuvRowKernels s_sse2Kernels =
+{
+	"SSE2",
+	InterleaveSSE2, DeinterleaveSSE2, SwapPairsSSE2,
+	Pack422SSE2<false>, Pack422SSE2<true>, Unpack422SSE2<false>, Unpack422SSE2<true>,
+	AverageRowsSSE2, HalveRowSSE2, DoubleRowSSE2,
+	Reduce2x2SSE2, Reduce2x2PairsSSE2, Reduce2x2PackedSSE2<false>, Reduce2x2PackedSSE2<true>
+};
+
+// SSSE3, byte shuffles split interleaved samples in fewer steps
+
+TARGET_SSSE3 static void DeinterleaveSSSE3(const BYTE* uv, BYTE* u, BYTE* v, int count)
+{
+	const __m128i split = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+	int i = 0;
+	for(; i + 16 <= count; i += 16)
+	{
+		__m128i a = _mm_shuffle_epi8(LOAD128(uv + 2 * i), split);
+		__m128i b = _mm_shuffle_epi8(LOAD128(uv + 2 * i + 16), split);
+		STORE128(u + i, _mm_unpacklo_epi64(a, b));
+		STORE128(v + i, _mm_unpackhi_epi64(a, b));
+	}
+	DeinterleaveC(uv + 2 * i, u + i, v + i, count - i);
+}
+
+// Every 16 bytes become 8 luma, 4 U and 4 V samples
+template<bool uyvy>
+TARGET_SSSE3 static void Unpack422SSSE3(const BYTE* src, BYTE* y, BYTE* u, BYTE* v, int pairs)
+{
+	const __m128i split = uyvy
+		? _mm_setr_epi8(1, 3, 5, 7, 9, 11, 13, 15, 0, 4, 8, 12, 2, 6, 10, 14)
+		: _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 5, 9, 13, 3, 7, 11, 15);
+	int i = 0;
+	for(; i + 16 <= pairs; i += 16)
+	{
+		const BYTE* in = src + 4 * i;
+		__m128i a = _mm_shuffle_epi8(LOAD128(in), split);
+		__m128i b = _mm_shuffle_epi8(LOAD128(in + 16), split);
+		__m128i c = _mm_shuffle_epi8(LOAD128(in + 32), split);
+		__m128i d = _mm_shuffle_epi8(LOAD128(in + 48), split);
+
+		STORE128(y + 2 * i, _mm_unpacklo_epi64(a, b));
+		STORE128(y + 2 * i + 16, _mm_unpacklo_epi64(c, d));
+
+		// U and V dwords of a and b, then of c and d
+		__m128i ab = _mm_unpackhi_epi32(a, b);
+		__m128i cd = _mm_unpackhi_epi32(c, d);
+		STORE128(u + i, _mm_unpacklo_epi64(ab, cd));
+		STORE128(v + i, _mm_unpackhi_epi64(ab, cd));
+	}
+	if(uyvy)
+	{
+		UnpackUyvyC(src + 4 * i, y + 2 * i, u + i, v + i, pairs - i);
+	}
+	else
+	{
+		UnpackYuy2C(src + 4 * i, y + 2 * i, u + i, v + i, pairs - i);
+	}
+}
+
+static const YuvRowKernels s_ssse3Kernels =
+{
+	"SSSE3",
+	InterleaveSSE2, DeinterleaveSSSE3, SwapPairsSSE2,
+	Pack422SSE2<false>, Pack422SSE2<true>, Unpack422SSSE3<false>, Unpack422SSSE3<true>,
+	AverageRowsSSE2, HalveRowSSE2, DoubleRowSSE2,
+	Reduce2x2SSE2, Reduce2x2PairsSSE2, Reduce2x2PackedSSE2<false>, Reduce2x2PackedSSE2<true>
+};
+
+// AVX2. Unpacks and packs work within 128-bit lanes, the lanes are put back in order
+// with permutes.
+
+TARGET_AVX2 static void InterleaveAVX2(const BYTE* u, const BYTE* v, BYTE* uv, int count)
+{
+	int i = 0;
+	for(; i + 32 <= count; i += 32)
+	{
+		__m256i a = LOAD256(u + i);
+		__m256i b = LOAD256(v + i);
+		__m256i lo = _mm256_unpacklo_epi8(a, b);
+		__m256i hi = _mm256_unpackhi_epi8(a, b);
+		STORE256(uv + 2 * i, _mm256_permute2x128_si256(lo, hi, 0x20));
+		STORE256(uv + 2 * i + 32, _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+	InterleaveSSE2(u + i, v + i, uv + 2 * i, count - i);
+}
+
+TARGET_AVX2 static void DeinterleaveAVX2(const BYTE* uv, BYTE* u, BYTE* v, int count)
+{
+	const __m256i split = _mm256_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15,
+		0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+	int i = 0;
+	for(; i + 32 <= count; i += 32)
+	{
+		__m256i a = _mm256_shuffle_epi8(LOAD256(uv + 2 * i), split);
+		__m256i b = _mm256_shuffle_epi8(LOAD256(uv + 2 * i + 32), split);
+		STORE256(u + i, _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(a, b), 0xd8));
+		STORE256(v + i, _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(a, b), 0xd8));
+	}
+	DeinterleaveSSSE3(uv + 2 * i, u + i, v + i, count - i);
+}
+
+TARGET_AVX2 static void SwapPairsAVX2(const BYTE* src, BYTE* dst, int pairs)
+{
+	int i = 0;
+	for(; i + 16 <= pairs; i += 16)
+	{
+		__m256i a = LOAD256(src + 2 * i);
+		STORE256(dst + 2 * i, _mm256_or_si256(_mm256_slli_epi16(a, 8), _mm256_srli_epi16(a, 8)));
+	}
+	SwapPairsSSE2(src + 2 * i, dst + 2 * i, pairs - i);
+}
+
+template<bool uyvy>
+TARGET_AVX2 static void Pack422AVX2(const BYTE* y, const BYTE* u, const BYTE* v, BYTE* dst, int pairs)
+{
+	int i = 0;
+	for(; i + 32 <= pairs; i += 32)
+	{
+		__m256i y0 = LOAD256(y + 2 * i);
+		__m256i y1 = LOAD256(y + 2 * i + 32);
+		__m256i uu = LOAD256(u + i);
+		__m256i vv = LOAD256(v + i);
+
+		// Chroma pairs 0..15 and 16..31 in order
+		__m256i uvlo = _mm256_unpacklo_epi8(uu, vv);
+		__m256i uvhi = _mm256_unpackhi_epi8(uu, vv);
+		__m256i uv0 = _mm256_permute2x128_si256(uvlo, uvhi, 0x20);
+		__m256i uv1 = _mm256_permute2x128_si256(uvlo, uvhi, 0x31);
+
+		__m256i lo0, hi0, lo1, hi1;
+		if(uyvy)
+		{
+			lo0 = _mm256_unpacklo_epi8(uv0, y0);
+			hi0 = _mm256_unpackhi_epi8(uv0, y0);
+			lo1 = _mm256_unpacklo_epi8(uv1, y1);
+			hi1 = _mm256_unpackhi_epi8(uv1, y1);
+		}
+		else
+		{
+			lo0 = _mm256_unpacklo_epi8(y0, uv0);
+			hi0 = _mm256_unpackhi_epi8(y0, uv0);
+			lo1 = _mm256_unpacklo_epi8(y1, uv1);
+			hi1 = _mm256_unpackhi_epi8(y1, uv1);
+		}
+
+		BYTE* out = dst + 4 * i;
+		STORE256(out, _mm256_permute2x128_si256(lo0, hi0, 0x20));
+		STORE256(out + 32, _mm256_permute2x128_si256(lo0, hi0, 0x31));
+		STORE256(out + 64, _mm256_permute2x128_si256(lo1, hi1, 0x20));
+		STORE256(out + 96, _mm256_permute2x128_si256(lo1, hi1, 0x31));
+	}
+	Pack422SSE2<uyvy>(y + 2 * i, u + i, v + i, dst + 4 * i, pairs - i);
+}
+
+template<bool uyvy>
+TARGET_AVX2 static void Unpack422AVX2(const BYTE* src, BYTE* y, BYTE* u, BYTE* v, int pairs)
+{
+	const __m256i mask = _mm256_set1_epi16(0xff);
+	int i = 0;
+	for(; i + 32 <= pairs; i += 32)
+	{
+		const BYTE* in = src + 4 * i;
+		__m256i a = LOAD256(in);
+		__m256i b = LOAD256(in + 32);
+		__m256i c = LOAD256(in + 64);
+		__m256i d = LOAD256(in + 96);
+
+		__m256i y0, y1, uv0, uv1;
+		if(uyvy)
+		{
+			y0 = _mm256_packus_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+			y1 = _mm256_packus_epi16(_mm256_srli_epi16(c, 8), _mm256_srli_epi16(d, 8));
+			uv0 = _mm256_packus_epi16(_mm256_and_si256(a, mask), _mm256_and_si256(b, mask));
+			uv1 = _mm256_packus_epi16(_mm256_and_si256(c, mask), _mm256_and_si256(d, mask));
+		}
+		else
+		{
+			y0 = _mm256_packus_epi16(_mm256_and_si256(a, mask), _mm256_and_si256(b, mask));
+			y1 = _mm256_packus_epi16(_mm256_and_si256(c, mask), _mm256_and_si256(d, mask));
+			uv0 = _mm256_packus_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+			uv1 = _mm256_packus_epi16(_mm256_srli_epi16(c, 8), _mm256_srli_epi16(d, 8));
+		}
+		uv0 = _mm256_permute4x64_epi64(uv0, 0xd8);
+		uv1 = _mm256_permute4x64_epi64(uv1, 0xd8);
+
+		__m256i uu = _mm256_packus_epi16(_mm256_and_si256(uv0, mask), _mm256_and_si256(uv1, mask));
+		__m256i vv = _mm256_packus_epi16(_mm256_srli_epi16(uv0, 8), _mm256_srli_epi16(uv1, 8));
+
+		STORE256(y + 2 * i, _mm256_permute4x64_epi64(y0, 0xd8));
+		STORE256(y + 2 * i + 32, _mm256_permute4x64_epi64(y1, 0xd8));
+		STORE256(u + i, _mm256_permute4x64_epi64(uu, 0xd8));
+		STORE256(v + i, _mm256_permute4x64_epi64(vv, 0xd8));
+	}
+	Unpack422SSSE3<uyvy>(src + 4 * i, y + 2 * i, u + i, v + i, pairs - i);
+}
+
+TARGET_AVX2 static void AverageRowsAVX2(const BYTE* a, const BYTE* b, BYTE* dst, int count)
+{
+	int i = 0;
+	for(; i + 32 <= count; i += 32)
+	{
+		STORE256(dst + i, _mm256_avg_epu8(LOAD256(a + i), LOAD256(b + i)));
+	}
+	AverageRowsSSE2(a + i, b + i, dst + i, count - i);
+}
+
+TARGET_AVX2 static void HalveRowAVX2(const BYTE* src, BYTE* dst, int count)
+{
+	const __m256i mask = _mm256_set1_epi16(0xff);
+	int i = 0;
+	for(; i + 32 <= count; i += 32)
+	{
+		__m256i a = LOAD256(src + 2 * i);
+		__m256i b = LOAD256(src + 2 * i + 32);
+		__m256i even = _mm256_packus_epi16(_mm256_and_si256(a, mask), _mm256_and_si256(b, mask));
+		__m256i odd = _mm256_packus_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+		STORE256(dst + i, _mm256_permute4x64_epi64(_mm256_avg_epu8(even, odd), 0xd8));
+	}
+	HalveRowSSE2(src + 2 * i, dst + i, count - i);
+}
+
+TARGET_AVX2 static void DoubleRowAVX2(const BYTE* src, BYTE* dst, int count)
+{
+	int i = 0;
+	for(; i + 32 <= count; i += 32)
+	{
+		__m256i a = LOAD256(src + i);
+		__m256i lo = _mm256_unpacklo_epi8(a, a);
+		__m256i hi = _mm256_unpackhi_epi8(a, a);
+		STORE256(dst + 2 * i, _mm256_permute2x128_si256(lo, hi, 0x20));
+		STORE256(dst + 2 * i + 32, _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+	DoubleRowSSE2(src + i, dst + 2 * i, count - i);
+}
+
+TARGET_AVX2 static void Reduce2x2AVX2(const BYTE* row0, const BYTE* row1, BYTE* dst, int count)
+{
+	const __m256i mask = _mm256_set1_epi16(0xff);
+	int i = 0;
+	for(; i + 32 <= count; i += 32)
+	{
+		__m256i a = _mm256_avg_epu8(LOAD256(row0 + 2 * i), LOAD256(row1 + 2 * i));
+		__m256i b = _mm256_avg_epu8(LOAD256(row0 + 2 * i + 32), LOAD256(row1 + 2 * i + 32));
+		__m256i even = _mm256_packus_epi16(_mm256_and_si256(a, mask), _mm256_and_si256(b, mask));
+		__m256i odd = _mm256_packus_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8));
+		STORE256(dst + i, _mm256_permute4x64_epi64(_mm256_avg_epu8(even, odd), 0xd8));
+	}
+	Reduce2x2SSE2(row0 + 2 * i, row1 + 2 * i, dst + i, count - i);
+}
+
+static const YuvRowKernels s_avx2Kernels =
+{
+	"AVX2",
+	InterleaveAVX2, DeinterleaveAVX2, SwapPairsAVX2,
+	Pack422AVX2<false>, Pack422AVX2<true>, Unpack422AVX2<false>, Unpack422AVX2<true>,
+	AverageRowsAVX2, HalveRowAVX2, DoubleRowAVX2,
+	Reduce2x2AVX2, Reduce2x2PairsSSE2, Reduce2x2PackedSSE2<false>, Reduce2x2PackedSSE2<true>
+};
+
+#endif
+
+const YuvRowKernels* GetYuvRowKernels(int feature)
+{
+	switch(feature)
+	{
+	case 0:
+		return &s_scalarKernels;
+#ifdef CPU_X86
+	case CPU_SSE2:
+		return &s_sse2Kernels;
+	case CPU_SSSE3:
+		return &s_ssse3Kernels;
+	case CPU_AVX2:
+		return &s_avx2Kernels;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+const YuvRowKernels* GetYuvRowKernels(void)
+{
+	int features = GetCpuFeatures();
+#ifdef CPU_X86
+	if(features & CPU_AVX2)
+	{
+		return &s_avx2Kernels;
+	}
+	if(features & CPU_SSSE3)
+	{
+		return &s_ssse3Kernels;
+	}
+	if(features & CPU_SSE2)
+	{
+		return &s_sse2Kernels;
+	}
+#endif
+	return &s_scalarKernels;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "NativeLib.h"
+
+// Row kernels behind the YUV repacking conversions. Rows must not overlap, but for
+// AverageRows writing over one of its inputs. Kernels read and write exactly the samples
+// they are given, so rows need no padding.
+struct YuvRowKernels
+{
+	const char* Name;
+
+	// u, v <-> uv pairs (NV12 chroma)
+	void (*Interleave)(const BYTE* u, const BYTE* v, BYTE* uv, int count);
+	void (*Deinterleave)(const BYTE* uv, BYTE* u, BYTE* v, int count);
+
+	// Swaps the bytes of every pair: NV12 <-> NV21 chroma, YUY2 <-> UYVY
+	void (*SwapPairs)(const BYTE* src, BYTE* dst, int pairs);
+
+	// Planar 4:2:2 rows <-> packed YUY2 or UYVY, two luma samples per pair
+	void (*PackYuy2)(const BYTE* y, const BYTE* u, const BYTE* v, BYTE* dst, int pairs);
+	void (*PackUyvy)(const BYTE* y, const BYTE* u, const BYTE* v, BYTE* dst, int pairs);
+	void (*UnpackYuy2)(const BYTE* src, BYTE* y, BYTE* u, BYTE* v, int pairs);
+	void (*UnpackUyvy)(const BYTE* src, BYTE* y, BYTE* u, BYTE* v, int pairs);
+
+	// Rounded average of two rows, and of neighbouring samples: dst[i] = (src[2i] + src[2i + 1] + 1) / 2
+	void (*AverageRows)(const BYTE* a, const BYTE* b, BYTE* dst, int count);
+	void (*HalveRow)(const BYTE* src, BYTE* dst, int count);
+
+	// Repeats every sample: dst[2i] = dst[2i + 1] = src[i]
+	void (*DoubleRow)(const BYTE* src, BYTE* dst, int count);
+
+	// Two rows to one at half the width, each output the pavgb mean of a 2x2 block:
+	// avg(avg(a, c), avg(b, d)) with a, b the top pair. Reduce2x2 takes single samples,
+	// Reduce2x2Pairs interleaved pairs (NV12 chroma) and the packed kernels macropixels, of
+	// which 2 * count are read for count written.
+	void (*Reduce2x2)(const BYTE* row0, const BYTE* row1, BYTE* dst, int count);
+	void (*Reduce2x2Pairs)(const BYTE* row0, const BYTE* row1, BYTE* dst, int pairs);
+	void (*Reduce2x2Yuy2)(const BYTE* row0, const BYTE* row1, BYTE* dst, int pairs);
+	void (*Reduce2x2Uyvy)(const BYTE* row0, const BYTE* row1, BYTE* dst, int pairs);
+};
+
+// Kernels of the best instruction set GetCpuFeatures allows
+NATIVELIB const YuvRowKernels* GetYuvRowKernels(void);
+
+// Kernels of one instruction set (a CpuFeature, 0 for the scalar reference), NULL when
+// the library was built without them
+NATIVELIB const YuvRowKernels* GetYuvRowKernels(int feature);
@@ -35,6 +35,19 @@ namespace Taygeta.Processing
             return frame;
         }
 
+        /// <summary>
+        /// Clone sharing the pixel data, for branches that only read it. Target.LeaseWrite has to be
+        /// called before either image is written.
+        /// </summary>
+        public VideoSequenceItem CloneShared()
+        {
+            VideoSequenceItem frame = new VideoSequenceItem();
+            frame.Target = this.Target.CloneShared();
+            frame.ShouldContinueProcessing = this.ShouldContinueProcessing;
+
+            return frame;
+        }
+
         public static VideoSequenceItem FromPlanarFrame(PlanarFrame data, BitmapFormat format)
         {
             VideoSequenceItem frame = new VideoSequenceItem();
@@ -381,7 +381,22 @@ HRESULT D3D9RenderImpl::FillBuffer(BYTE* pPlanes[4], int pitches[4])
 	case D3DFMT_X1R5G5B5:
 	case D3DFMT_A8R8G8B8:
 	case D3DFMT_X8R8G8B8:
-		memcpy(pict, Y, d3drect.Pitch * newHeight);
+		// Rows go one by one unless the source has the layout of the surface, bottom-up
+		// sources have a negative pitch
+		if(pitches[0] == d3drect.Pitch)
+		{
+			memcpy(pict, Y, d3drect.Pitch * newHeight);
+		}
+		else
+		{
+			int rowBytes = newWidth * (m_format == D3DFMT_A8R8G8B8 || m_format == D3DFMT_X8R8G8B8 ? 4 : 2);
+			for (int y = 0 ; y < newHeight ; y++)
+			{
+				memcpy(pict, Y, rowBytes);
+				pict += d3drect.Pitch;
+				Y += pitches[0];
+			}
+		}
 		break;
 	}
 	return m_pOffsceenSurface->UnlockRect();